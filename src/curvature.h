@@ -0,0 +1,135 @@
+/*********************************************************************************************************************
+ *
+ * curvature.h
+ *
+ * Discrete curvature operators shared by the half-edge meshes (TriMeshHE and TriMeshCHE)
+ * Meyer et al., "Discrete Differential-Geometry Operators for Triangulated 2-Manifolds", Visualization and Mathematics III, 2003
+ * http://multires.caltech.edu/pubs/diffGeoOps.pdf
+ *
+ * Mesh_viewer
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+#ifndef CURVATURE_H
+#define CURVATURE_H
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+
+/*!
+* \fn compCurvatureTerms
+* \brief Compute, once per triangle (in parallel), the per-corner terms of the curvature operators.
+*        Terms are indexed by halfedge: the halfedge k of a face starts at its corner k and ends at its corner k+1,
+*        so the angle opposite to it is located at the corner k+2.
+*        Halfedges which do not belong to any face (boundary halfedges) keep a null contribution.
+* \param _nbFaces : number of triangles
+* \param _nbHalfedges : number of halfedges (size of the returned arrays)
+* \param _faceCorners : function (f, hh, p) filling the 3 halfedges hh of the face f, and the positions p of their from-vertices
+* \param _cotOpp : cotangent of the angle opposite to each halfedge
+* \param _angle : angle at the corner of each halfedge (at its from-vertex)
+* \param _areaMixed : mixed area of the corner of each halfedge
+*/
+template <typename FaceCorners>
+void compCurvatureTerms(int _nbFaces, size_t _nbHalfedges, FaceCorners _faceCorners,
+                        std::vector<float>& _cotOpp, std::vector<float>& _angle, std::vector<float>& _areaMixed)
+{
+    _cotOpp.assign(_nbHalfedges, 0.0f);
+    _angle.assign(_nbHalfedges, 0.0f);
+    _areaMixed.assign(_nbHalfedges, 0.0f);
+
+    // each triangle is evaluated exactly once, and only writes to its own three halfedges
+    #pragma omp parallel for
+    for (int f = 0; f < _nbFaces; f++)
+    {
+        size_t hh[3];
+        glm::vec3 p[3];
+        _faceCorners(f, hh, p);
+
+        // twice the area of the triangle
+        float doubleArea = glm::length( glm::cross(p[1] - p[0], p[2] - p[0]) );
+        if (doubleArea <= std::numeric_limits<float>::epsilon())
+            continue;
+
+        // cotangent and angle at each corner
+        float cot[3];
+        bool isObtuse[3];
+        for (int k = 0; k < 3; k++)
+        {
+            glm::vec3 e1 = p[(k + 1) % 3] - p[k];
+            glm::vec3 e2 = p[(k + 2) % 3] - p[k];
+
+            float cosA = glm::dot(e1, e2);     // A.B = ||A|| * ||B|| * cos(AB)
+            // ||AxB|| = ||A|| * ||B|| * sin(AB) = twice the area for every corner
+            cot[k] = cosA / doubleArea;
+            isObtuse[k] = (cosA < 0.0f);
+            _angle[hh[k]] = std::atan2(doubleArea, cosA);
+        }
+
+        bool isTriObtuse = isObtuse[0] || isObtuse[1] || isObtuse[2];
+        for (int k = 0; k < 3; k++)
+        {
+            _cotOpp[hh[k]] = cot[(k + 2) % 3];
+
+            // mixed area (see Fig 4. in  http://multires.caltech.edu/pubs/diffGeoOps.pdf)
+            float AM;
+            if (!isTriObtuse)
+            {
+                // Voronoi region of the corner (see Fig 3.)
+                float l2Next = glm::dot(p[(k + 1) % 3] - p[k], p[(k + 1) % 3] - p[k]);
+                float l2Prev = glm::dot(p[(k + 2) % 3] - p[k], p[(k + 2) % 3] - p[k]);
+                AM = (l2Prev * cot[(k + 1) % 3] + l2Next * cot[(k + 2) % 3]) / 8.0f;
+            }
+            else if (isObtuse[k])
+                AM = doubleArea / 4.0f;
+            else
+                AM = doubleArea / 8.0f;
+
+            _areaMixed[hh[k]] = AM;
+        }
+    }
+}
+
+
+/*!
+* \fn compCurvatures
+* \brief Compute mean, Gaussian and principal curvatures of a vertex x_i from the terms gathered around it
+* \param _K : sum over the neighbors x_j of (cot(alpha_ij) + cot(beta_ij)) * (x_i - x_j)
+* \param _area : mixed area of the vertex (sum of the mixed areas of its corners)
+* \param _sumAngles : sum of the angles at the corners of the vertex
+* \param _isBoundary : true if the vertex is on a boundary (the angle deficit is then relative to pi)
+* \param _mean : mean curvature
+* \param _gauss : Gaussian curvature
+* \param _min : minimal principal curvature
+* \param _max : maximal principal curvature
+* \return false if the mixed area is null (curvatures are then left unchanged)
+*/
+inline bool compCurvatures(const glm::vec3& _K, double _area, double _sumAngles, bool _isBoundary,
+                           float& _mean /* return */, float& _gauss /* return */, float& _min /* return */, float& _max /* return */)
+{
+    if (_area <= std::numeric_limits<float>::epsilon())
+        return false;
+
+    // mean curvature
+    double H = 0.5 * glm::length(_K / (2.0f * (float)_area));
+    // Gaussian curvature (angle deficit)
+    double deficit = _isBoundary ? M_PI - _sumAngles : 2.0 * M_PI - _sumAngles;
+    double KG = deficit / _area;
+    // principal curvatures
+    double delta = std::sqrt( std::max(H * H - KG, 0.0) );
+
+    _mean = (float)H;
+    _gauss = (float)KG;
+    _min = (float)(H - delta);
+    _max = (float)(H + delta);
+    return true;
+}
+
+
+#endif // CURVATURE_H
@@ -8,17 +8,29 @@
  *********************************************************************************************************************/
 
 
-#include <QImage>
+#include <chrono>
+#include <cstring>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <QString>
 
 #include "drawablemesh.h"
 
 
 DrawableMesh::DrawableMesh() :
-      m_ambientColor(0.04f, 0.04f, 0.06f)
+      m_indexType(GL_UNSIGNED_INT)
+    , m_ambientColor(0.04f, 0.04f, 0.06f)
     , m_diffuseColor(0.82f, 0.66f, 0.43f)
     , m_specularColor(0.9f, 0.9f, 0.9f)
     , m_wireColor(0.5f, 0.5f, 0.5f)
+    , m_wireWidth(1.0f)
+    , m_scalarRange(0.0f, 1.0f)
+    , m_colormapId(CMAP_REDGREEN)
     , m_specPow(128.0f)
     , m_vertexProvided(false)
     , m_normalProvided(false)
@@ -27,9 +39,14 @@ DrawableMesh::DrawableMesh() :
     , m_bitangentProvided(false)
     , m_uvProvided(false)
     , m_indexProvided(false)
+    , m_scalarProvided(false)
     , m_shadedRenderOn(true)
     , m_wireframeRenderOn(false)
     , m_wireframeShadingOn(true)
+    , m_wireframeSinglePassOn(true)
+    , m_frustumCullingOn(true)
+    , m_backfaceCullingOn(false)
+    , m_lodOn(true)
     , m_useAmbient(true)
     , m_useDiffuse(true)
     , m_useSpecular(true)
@@ -39,64 +56,116 @@ DrawableMesh::DrawableMesh() :
     , m_flatShading(false)
     , m_useGammaCorrec(true)
     , m_useMeshCol(false)
+    , m_useScalar(false)
+    , m_uniformsUploaded(false)
+    , m_programCacheHits(0)
+    , m_timerFrame(0)
+    , m_gpuTime(-1.0)
 {
-    // Load wireframe program
-    m_programWF = loadShaderProgram("../../src/shaders/wireframe.vert", "../../src/shaders/wireframe.frag");
+    // textures are owned by TextureManager (shared between meshes)
+    m_tex = m_normalMap = m_metalMap = m_glossMap = m_ambientMap = m_cubeMap = 0;
+
+    // Uniform buffers shared by the phong and wireframe programs
+    glGenBuffers(1, &(m_frameUBO));
+    glBindBuffer(GL_UNIFORM_BUFFER, m_frameUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glGenBuffers(1, &(m_materialUBO));
+    glBindBuffer(GL_UNIFORM_BUFFER, m_materialUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(MaterialUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // Shader compilation: program binary cache and driver compiler threads, when available
+    GLint nbBinaryFormats = 0;
+    if(GLEW_ARB_get_program_binary)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nbBinaryFormats);
+    m_programBinarySupported = (nbBinaryFormats > 0);
+    m_parallelCompileSupported = GLEW_KHR_parallel_shader_compile;
+    if(m_parallelCompileSupported)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);  // as many threads as the driver wants
+
+    // Uniform blocks declared once for all shaders (see startShaderProgram())
+    m_uniformBlocksSource = readShaderSource("../../src/shaders/uniforms.glsl");
+    if(m_uniformBlocksSource.empty())
+        qWarning() << "[Warning] DrawableMesh::DrawableMesh: uniform blocks not found, shaders will not compile";
+
+    // Load wireframe program (finished on first use, or by finishPrograms())
+    m_programWF = startShaderProgram(readShaderSource("../../src/shaders/wireframe.vert"), readShaderSource("../../src/shaders/wireframe.frag"));
+
+    // Colormaps used to display scalar fields
+    m_colormapTex = createColormapTexture();
+
+    // Buffer textures giving access to the VBOs for the single-pass wireframe
+    glGenTextures(1, &(m_wireIndexTex));
+    glGenTextures(1, &(m_wirePositionTex));
+
+    // GPU time of draw()
+    m_timerQuerySupported = GLEW_ARB_timer_query;
+    if(m_timerQuerySupported)
+        glGenQueries(2, m_timerQueries);
 
 }
 
 
 DrawableMesh::~DrawableMesh()
 {
+    cancelUpload();
+    clearLODs();
     glDeleteBuffers(1, &(m_vertexVBO));
     glDeleteBuffers(1, &(m_normalVBO));
     glDeleteBuffers(1, &(m_colorVBO));
     glDeleteBuffers(1, &(m_tangentVBO));
     glDeleteBuffers(1, &(m_bitangentVBO));
     glDeleteBuffers(1, &(m_uvVBO));
-    glDeleteBuffers(1, &(m_facenormalVBO));
+    glDeleteBuffers(1, &(m_scalarVBO));
     glDeleteBuffers(1, &(m_indexVBO));
     glDeleteVertexArrays(1, &(m_meshVAO));
+    for(auto& program : m_programs)
+        deleteShaderProgram(program.second);
+    deleteShaderProgram(m_programWF);
+    glDeleteBuffers(1, &(m_frameUBO));
+    glDeleteBuffers(1, &(m_materialUBO));
+    glDeleteTextures(1, &(m_colormapTex));
+    glDeleteTextures(1, &(m_wireIndexTex));
+    glDeleteTextures(1, &(m_wirePositionTex));
+    if(m_timerQuerySupported)
+        glDeleteQueries(2, m_timerQueries);
 }
 
 
-void DrawableMesh::createVAO(std::shared_ptr<Mesh> _triMesh)
+void DrawableMesh::createVAO()
 {
-    fillVAO(_triMesh, true);
-}
-
+    // Generates the VBOs and the VAO (storage is allocated by uploadBuffer())
+    for(unsigned int bit = ATTRIB_VERTEX; bit <= ATTRIB_SCALAR; bit <<= 1)
+    {
+        if(bit == ATTRIB_FACENORMAL)    // no VBO, face normals are derived by the shader
+            continue;
+        glGenBuffers(1, getVBO((MeshAttrib)bit));
+        getVBOCapacity((MeshAttrib)bit) = 0;
+    }
+    glGenVertexArrays(1, &(m_meshVAO));
 
-void DrawableMesh::updateVAO(std::shared_ptr<Mesh> _triMesh)
-{
-    fillVAO(_triMesh, false);
+    m_numVertices = 0;
+    m_numIndices = 0;
+    setVAOAttribs();
 }
 
 
-void DrawableMesh::fillVAO(std::shared_ptr<Mesh> _triMesh, bool _create)
+void DrawableMesh::updateVAO(const MeshBuffers& _buffers, const IndexLayout& _layout, std::shared_ptr<MeshRemap> _remap)
 {
+    m_remap = _remap;
+
     // mandatory data
-    std::vector<glm::vec3> vertices;
-    std::vector<glm::vec3> normals;
-    std::vector<uint32_t> indices;      // !! uint32_t !!
+    const std::vector<glm::vec3>& vertices = _buffers.vertices;
+    const std::vector<glm::vec3>& normals = _buffers.normals;
+    const std::vector<uint32_t>& indices = _buffers.indices;      // !! uint32_t !!
 
     // optional data
-    std::vector<glm::vec3> colors;
-    std::vector<glm::vec2> texcoords;   // !! vec2 !!
-    std::vector<glm::vec3> tangents;
-    std::vector<glm::vec3> bitangents;
+    const std::vector<glm::vec3>& colors = _buffers.colors;
+    const std::vector<glm::vec2>& texcoords = _buffers.texcoords;   // !! vec2 !!
+    const std::vector<glm::vec3>& tangents = _buffers.tangents;
+    const std::vector<glm::vec3>& bitangents = _buffers.bitangents;
 
-    std::vector<glm::vec3> facenormals;
-
-    _triMesh->getVertices(vertices);
-    _triMesh->getNormals(normals);
-    _triMesh->getIndices(indices);
-
-    _triMesh->getColors(colors);
-    _triMesh->getTexCoords(texcoords);
-    _triMesh->getTangents(tangents);
-    _triMesh->getBitangents(bitangents);
-
-    _triMesh->getFaceNormals(facenormals);
+    const std::vector<float>& scalars = _buffers.scalars;
 
     // update flags according to data provided
     vertices.size() ?  m_vertexProvided = true :  m_vertexProvided = false;
@@ -106,396 +175,1289 @@ void DrawableMesh::fillVAO(std::shared_ptr<Mesh> _triMesh, bool _create)
     texcoords.size() ?  m_uvProvided = true :  m_uvProvided = false;
     tangents.size() ?  m_tangentProvided = true :  m_tangentProvided = false;
     bitangents.size() ?  m_bitangentProvided = true :  m_bitangentProvided = false;
-    facenormals.size() ?  m_facenormalProvided = true :  m_facenormalProvided = false;
+    scalars.size() ?  m_scalarProvided = true :  m_scalarProvided = false;
 
                 
     if(!m_vertexProvided)
-        qWarning() << "[Warning] DrawableMesh::createVAO: No vertex provided";
+        qWarning() << "[Warning] DrawableMesh::updateVAO: No vertex provided";
     if(!m_normalProvided)
-        qWarning() << "[Warning] DrawableMesh::createVAO: No normal provided";
+        qWarning() << "[Warning] DrawableMesh::updateVAO: No normal provided";
     if(!m_indexProvided)
-        qWarning() << "[Warning] DrawableMesh::createVAO: No index provided";
-
-    // Generates and populates a VBO for vertex coords
-    if(_create)
-        glGenBuffers(1, &(m_vertexVBO));
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertexVBO);
-    size_t verticesNBytes = vertices.size() * sizeof(vertices[0]);
-    glBufferData(GL_ARRAY_BUFFER, verticesNBytes, vertices.data(), GL_STATIC_DRAW);
-
-    // Generates and populates a VBO for vertex normals
-    if(_create)
-        glGenBuffers(1, &(m_normalVBO));
-    glBindBuffer(GL_ARRAY_BUFFER, m_normalVBO);
-    size_t normalsNBytes = normals.size() * sizeof(normals[0]);
-    glBufferData(GL_ARRAY_BUFFER, normalsNBytes, normals.data(), GL_STATIC_DRAW);
-
-    // Generates and populates a VBO for the element indices
-    if(_create)
-        glGenBuffers(1, &(m_indexVBO));
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexVBO);
-    auto indicesNBytes = indices.size() * sizeof(indices[0]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesNBytes, indices.data(), GL_STATIC_DRAW);
+        qWarning() << "[Warning] DrawableMesh::updateVAO: No index provided";
+
+    // Populates the VBOs, reusing their storage when possible
+    // (absent attributes are not uploaded, a constant value is used instead, see setVAOAttribs())
+    uploadBuffer(ATTRIB_VERTEX, vertices.data(), vertices.size() * sizeof(glm::vec3));
+    uploadBuffer(ATTRIB_NORMAL, normals.data(), normals.size() * sizeof(glm::vec3));
+    m_indexType = _layout.indices16.empty() ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+    m_indexClusters = _layout.clusters;
+    m_meshlets = _layout.meshlets;
+    if(m_indexType == GL_UNSIGNED_SHORT)
+        uploadBuffer(ATTRIB_INDEX, _layout.indices16.data(), _layout.indices16.size() * sizeof(uint16_t));
+    else
+        uploadBuffer(ATTRIB_INDEX, indices.data(), indices.size() * sizeof(uint32_t));
+    uploadBuffer(ATTRIB_COLOR, colors.data(), colors.size() * sizeof(glm::vec3));
+    uploadBuffer(ATTRIB_TEXCOORD, texcoords.data(), texcoords.size() * sizeof(glm::vec2));
+    uploadBuffer(ATTRIB_TANGENT, tangents.data(), tangents.size() * sizeof(glm::vec3));
+    uploadBuffer(ATTRIB_BITANGENT, bitangents.data(), bitangents.size() * sizeof(glm::vec3));
+    uploadBuffer(ATTRIB_SCALAR, scalars.data(), scalars.size() * sizeof(float));
+
+    // Binds the VBOs of the provided attributes to the VAO
+    setVAOAttribs();
+
+    // Additional information required by draw calls
+    m_numVertices = static_cast<int>(vertices.size());
+    m_numIndices = static_cast<int>(indices.size());
+}
 
 
-    // Generates and populates a VBO for vertex colors
-    if(_create)
-        glGenBuffers(1, &(m_colorVBO));
-    glBindBuffer(GL_ARRAY_BUFFER, m_colorVBO);
-    if(m_colorProvided)
+void DrawableMesh::updateScalars(std::shared_ptr<Mesh> _triMesh)
+{
+    MeshBuffers buffers;
+    _triMesh->getBuffers(buffers, ATTRIB_SCALAR);
+    if(m_remap && !IndexOptimizer::applyRemap(buffers, *m_remap))
+        buffers.scalars.clear();
+    std::vector<float>& scalars = buffers.scalars;
+
+    // scalar field must match the vertex layout of the other VBOs
+    const bool wasProvided = m_scalarProvided;
+    if(scalars.size() != (size_t)m_numVertices)
     {
-        size_t colorsNBytes = colors.size() * sizeof(colors[0]);
-        glBufferData(GL_ARRAY_BUFFER, colorsNBytes, colors.data(), GL_STATIC_DRAW);
+        qWarning() << "[Warning] DrawableMesh::updateScalars: scalar field size does not match number of vertices";
+        m_scalarProvided = false;
     }
     else
     {
-        size_t colorsNBytes = 1.0f * sizeof(colors[0]);
-        glBufferData(GL_ARRAY_BUFFER, colorsNBytes, nullptr, GL_STATIC_DRAW);
+        // only the scalar VBO is refreshed (4 bytes per vertex), in its current storage
+        uploadBuffer(ATTRIB_SCALAR, scalars.data(), scalars.size() * sizeof(float));
+        m_scalarProvided = true;
     }
 
+    // scalar attribute switches between VBO and constant value
+    if(m_scalarProvided != wasProvided)
+        setVAOAttribs();
+}
+
 
-    // Generates and populates a VBO for UV coords
-    if(_create)
-        glGenBuffers(1, &(m_uvVBO));
-    glBindBuffer(GL_ARRAY_BUFFER, m_uvVBO);
-    if(m_uvProvided) 
+void DrawableMesh::setVAOAttribs()
+{
+    struct VertexAttrib
     {
-        size_t texcoordsNBytes = texcoords.size() * sizeof(texcoords[0]);
-        glBufferData(GL_ARRAY_BUFFER, texcoordsNBytes, texcoords.data(), GL_STATIC_DRAW);
+        GLuint vbo;
+        AttributeLocation location;
+        GLint nbComponents;
+        bool provided;
+    };
+    const VertexAttrib attribs[] = 
+    {
+        { m_vertexVBO,      POSITION,   3, m_vertexProvided },
+        { m_normalVBO,      NORMAL,     3, m_normalProvided },
+        { m_colorVBO,       COLOR,      3, m_colorProvided },
+        { m_uvVBO,          UV,         2, m_uvProvided },
+        { m_tangentVBO,     TANGENT,    3, m_tangentProvided },
+        { m_bitangentVBO,   BITANGENT,  3, m_bitangentProvided },
+        { m_scalarVBO,      SCALAR,     1, m_scalarProvided }
+    };
+
+    glBindVertexArray(m_meshVAO);
+
+    for(const VertexAttrib& attrib : attribs)
+    {
+        if(attrib.provided)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, attrib.vbo);
+            glEnableVertexAttribArray(attrib.location);
+            glVertexAttribPointer(attrib.location, attrib.nbComponents, GL_FLOAT, GL_FALSE, 0, nullptr);
+        }
+        else
+        {
+            // absent attribute: the shader reads a constant value (no VBO needed)
+            glDisableVertexAttribArray(attrib.location);
+            glVertexAttrib4f(attrib.location, 0.0f, 0.0f, 0.0f, 1.0f);
+        }
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexVBO);
+    glBindVertexArray(m_defaultVAO); // unbinds the VAO
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+size_t& DrawableMesh::getVBOCapacity(MeshAttrib _attrib)
+{
+    // one slot per bit of MeshAttrib
+    int slot = 0;
+    while((1u << slot) != (unsigned int)_attrib && slot < 8)
+        slot++;
+    return m_vboCapacity[slot];
+}
+
+
+void DrawableMesh::uploadBuffer(MeshAttrib _attrib, const void* _data, size_t _nbBytes)
+{
+    // absent attribute: storage is kept for a later reuse
+    if(_nbBytes == 0)
+        return;
+
+    size_t& capacity = getVBOCapacity(_attrib);
+
+    // GL_COPY_WRITE_BUFFER does not interfere with the VAO currently bound
+    glBindBuffer(GL_COPY_WRITE_BUFFER, *getVBO(_attrib));
+    if(_nbBytes <= capacity && 2 * _nbBytes >= capacity)
+    {
+        // data fits in the current storage: orphan it (draws still in flight keep the old one, no stall), 
+        // the driver recycles a block of the same size, then fill it
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STATIC_DRAW);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, 0, _nbBytes, _data);
     }
     else
     {
-        size_t texcoordsNBytes = 1.0f * sizeof(texcoords[0]);
-        glBufferData(GL_ARRAY_BUFFER, texcoordsNBytes, nullptr, GL_STATIC_DRAW);
+        // (re)allocate storage to the exact size
+        glBufferData(GL_COPY_WRITE_BUFFER, _nbBytes, _data, GL_STATIC_DRAW);
+        capacity = _nbBytes;
     }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
 
-    // Generates and populates a VBO for tangent vectors
-    if(_create)
-        glGenBuffers(1, &(m_tangentVBO));
-    glBindBuffer(GL_ARRAY_BUFFER, m_tangentVBO);
-    if(m_tangentProvided) 
+
+void DrawableMesh::drawTriangles(GLint _wireClusterLocation)
+{
+    if(m_meshletRunsOn)
     {
-        size_t tangentsNBytes = tangents.size() * sizeof(tangents[0]);
-        glBufferData(GL_ARRAY_BUFFER, tangentsNBytes, tangents.data(), GL_STATIC_DRAW);
+        // visible meshlets only (see cullMeshlets())
+        if(m_runCounts.empty())
+            return;
+        if(_wireClusterLocation >= 0)
+        {
+            // single-pass wireframe: first triangle of each draw is needed (gl_PrimitiveID restarts at 0)
+            const size_t indexSize = (m_indexType == GL_UNSIGNED_SHORT) ? sizeof(uint16_t) : sizeof(uint32_t);
+            for(size_t r = 0; r < m_runCounts.size(); r++)
+            {
+                glUniform2i(_wireClusterLocation, (GLint)((size_t)m_runOffsets[r] / indexSize / 3), m_runBaseVertices[r]);
+                glDrawElementsBaseVertex(GL_TRIANGLES, m_runCounts[r], m_indexType, m_runOffsets[r], m_runBaseVertices[r]);
+            }
+            m_drawStats.glCalls += 2 * (int)m_runCounts.size();
+            m_drawStats.drawCalls += (int)m_runCounts.size();
+        }
+        else
+        {
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, m_runCounts.data(), m_indexType, m_runOffsets.data(), 
+                                          (GLsizei)m_runCounts.size(), m_runBaseVertices.data());
+            m_drawStats.glCalls++;
+            m_drawStats.drawCalls++;
+        }
+        return;
     }
-    else
+
+    // full resolution mesh, or level of detail (see selectLOD())
+    const int numIndices = (m_activeLOD >= 0) ? m_lods[m_activeLOD].numIndices : m_numIndices;
+    const std::vector<IndexCluster>& indexClusters = (m_activeLOD >= 0) ? m_lods[m_activeLOD].indexClusters : m_indexClusters;
+
+    if(indexClusters.empty())
     {
-        size_t tangentsNBytes = 1.0f * sizeof(tangents[0]);
-        glBufferData(GL_ARRAY_BUFFER, tangentsNBytes, nullptr, GL_STATIC_DRAW);
+        // 32 bits indices: a single draw call
+        if(_wireClusterLocation >= 0)
+        {
+            glUniform2i(_wireClusterLocation, 0, 0);
+            m_drawStats.glCalls++;
+        }
+        glDrawElements(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, 0);
+        m_drawStats.glCalls++;
+        m_drawStats.drawCalls++;
+        return;
     }
 
-    // Generates and populates a VBO for bitangent vectors
-    if(_create)
-        glGenBuffers(1, &(m_bitangentVBO));
-    glBindBuffer(GL_ARRAY_BUFFER, m_bitangentVBO);
-    if(m_bitangentProvided) 
+    // 16 bits indices: one draw call per range, indices being relative to the base vertex of their range
+    for(const IndexCluster& cluster : indexClusters)
     {
-        size_t bitangentsNBytes = bitangents.size() * sizeof(bitangents[0]);
-        glBufferData(GL_ARRAY_BUFFER, bitangentsNBytes, bitangents.data(), GL_STATIC_DRAW);
+        if(_wireClusterLocation >= 0)
+        {
+            // gl_PrimitiveID restarts at 0 at each draw call
+            glUniform2i(_wireClusterLocation, cluster.firstIndex / 3, cluster.baseVertex);
+            m_drawStats.glCalls++;
+        }
+        glDrawElementsBaseVertex(GL_TRIANGLES, cluster.nbIndices, GL_UNSIGNED_SHORT,
+                                 (const void*)(cluster.firstIndex * sizeof(uint16_t)), cluster.baseVertex);
+        m_drawStats.glCalls++;
+        m_drawStats.drawCalls++;
     }
-    else
+}
+
+
+void DrawableMesh::cullMeshlets(const glm::mat4& _mv, const glm::mat4& _mvp)
+{
+    // meshlets only cover the full resolution mesh
+    m_meshletRunsOn = (m_activeLOD < 0) && !m_meshlets.empty() && (m_frustumCullingOn || m_backfaceCullingOn);
+    if(!m_meshletRunsOn)
+    {
+        m_drawStats.meshletsDrawn = (m_activeLOD < 0) ? (int)m_meshlets.size() : 0;
+        return;
+    }
+
+    // frustum planes in model space, from the rows of the modelview-projection matrix (Gribb & Hartmann)
+    glm::vec4 rows[4];
+    for(int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(_mvp[0][i], _mvp[1][i], _mvp[2][i], _mvp[3][i]);
+    glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2] };
+    float planeNorms[6];
+    for(int p = 0; p < 6; p++)
+        planeNorms[p] = glm::length(glm::vec3(planes[p]));
+
+    // camera position in model space
+    const glm::vec3 eye = glm::vec3(glm::inverse(_mv)[3]);
+
+    const int nbMeshlets = (int)m_meshlets.size();
+    m_meshletVisible.resize(nbMeshlets);
+    int nbFrustumCulled = 0;
+    int nbBackfaceCulled = 0;
+    #pragma omp parallel for schedule(static) reduction(+:nbFrustumCulled, nbBackfaceCulled)
+    for(int i = 0; i < nbMeshlets; i++)
+    {
+        const Meshlet& meshlet = m_meshlets[i];
+        char visible = 1;
+        if(m_frustumCullingOn)
+        {
+            for(int p = 0; p < 6 && visible; p++)
+            {
+                if(glm::dot(glm::vec3(planes[p]), meshlet.center) + planes[p].w < -meshlet.radius * planeNorms[p])
+                    visible = 0;
+            }
+            nbFrustumCulled += 1 - visible;
+        }
+        if(visible && m_backfaceCullingOn)
+        {
+            // every triangle faces away from the camera, from any point of the bounding sphere
+            glm::vec3 toCenter = meshlet.center - eye;
+            if(glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius)
+            {
+                visible = 0;
+                nbBackfaceCulled++;
+            }
+        }
+        m_meshletVisible[i] = visible;
+    }
+
+    // consecutive visible meshlets of the same range are drawn as a single run
+    const size_t indexSize = (m_indexType == GL_UNSIGNED_SHORT) ? sizeof(uint16_t) : sizeof(uint32_t);
+    m_runCounts.clear();
+    m_runOffsets.clear();
+    m_runBaseVertices.clear();
+    uint32_t runEnd = 0;
+    for(int i = 0; i < nbMeshlets; i++)
     {
-        size_t bitangentsNBytes = 1.0f * sizeof(bitangents[0]);
-        glBufferData(GL_ARRAY_BUFFER, bitangentsNBytes, nullptr, GL_STATIC_DRAW);
+        if(!m_meshletVisible[i])
+            continue;
+        const Meshlet& meshlet = m_meshlets[i];
+        if(!m_runCounts.empty() && meshlet.firstIndex == runEnd && (GLint)meshlet.baseVertex == m_runBaseVertices.back())
+            m_runCounts.back() += meshlet.nbIndices;
+        else
+        {
+            m_runCounts.push_back(meshlet.nbIndices);
+            m_runOffsets.push_back((const void*)(meshlet.firstIndex * indexSize));
+            m_runBaseVertices.push_back(meshlet.baseVertex);
+        }
+        runEnd = meshlet.firstIndex + meshlet.nbIndices;
     }
 
-    // Generates and populates a VBO for face normals
-    if(_create)
-        glGenBuffers(1, &(m_facenormalVBO));
-    glBindBuffer(GL_ARRAY_BUFFER, m_facenormalVBO);
-    if(m_facenormalProvided)
+    m_drawStats.meshletsFrustumCulled = nbFrustumCulled;
+    m_drawStats.meshletsBackfaceCulled = nbBackfaceCulled;
+    m_drawStats.meshletsDrawn = nbMeshlets - nbFrustumCulled - nbBackfaceCulled;
+}
+
+
+void DrawableMesh::selectLOD(const glm::mat4& _mv, const glm::mat4& _mvp)
+{
+    m_activeLOD = -1;
+    m_drawStats.lod = 0;
+    if(!m_lodOn || m_lods.empty() || m_viewportHeight <= 0 || m_useNormalMap || m_useScalar)
+        return;
+
+    // scale of the modelview matrix, and projection matrix
+    const float scale = glm::length(glm::vec3(_mv[0]));
+    const glm::mat4 proj = _mvp * glm::inverse(_mv);
+
+    // size of a model space unit on screen, in pixels, at the closest point of the bounding sphere
+    float pixelsPerUnit = 0.5f * (float)m_viewportHeight * proj[1][1] * scale;
+    if(proj[2][3] != 0.0f)
     {
-        size_t facenormalsNBytes = facenormals.size() * sizeof(facenormals[0]);
-        glBufferData(GL_ARRAY_BUFFER, facenormalsNBytes, facenormals.data(), GL_STATIC_DRAW);
+        // perspective projection: divided by the depth
+        const float depth = -(_mv * glm::vec4(m_lodCenter, 1.0f)).z - m_lodRadius * scale;
+        if(depth <= 0.0f)
+            return;     // camera inside the bounding sphere
+        pixelsPerUnit /= depth;
     }
-    else
+
+    // coarsest level whose error is not visible
+    for(int l = (int)m_lods.size() - 1; l >= 0; l--)
     {
-        size_t facenormalsNBytes = 1.0f * sizeof(facenormals[0]);
-        glBufferData(GL_ARRAY_BUFFER, facenormalsNBytes, nullptr, GL_STATIC_DRAW);
+        if(m_lods[l].error * pixelsPerUnit <= m_lodPixelError)
+        {
+            m_activeLOD = l;
+            m_drawStats.lod = l + 1;
+            return;
+        }
     }
+}
 
-    // Creates a vertex array object (VAO) for drawing the mesh
-    if(_create)
-        glGenVertexArrays(1, &(m_meshVAO));
-    glBindVertexArray(m_meshVAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_vertexVBO);
-    glEnableVertexAttribArray(POSITION);
-    glVertexAttribPointer(POSITION, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+void DrawableMesh::setLODs(const std::vector<LODBuffers>& _levels)
+{
+    clearLODs();
+    if(_levels.empty() || _levels[0].buffers.vertices.empty())
+        return;
+
+    // bounding sphere of the levels (the same as the mesh, up to the error of the levels)
+    const std::vector<glm::vec3>& vertices = _levels[0].buffers.vertices;
+    glm::vec3 bbMin = vertices[0];
+    glm::vec3 bbMax = vertices[0];
+    for(const glm::vec3& v : vertices)
+    {
+        bbMin = glm::min(bbMin, v);
+        bbMax = glm::max(bbMax, v);
+    }
+    m_lodCenter = 0.5f * (bbMin + bbMax);
+    m_lodRadius = 0.0f;
+    for(const glm::vec3& v : vertices)
+        m_lodRadius = std::max(m_lodRadius, glm::length(v - m_lodCenter));
+
+    for(const LODBuffers& level : _levels)
+    {
+        const MeshBuffers& buffers = level.buffers;
+        if(buffers.vertices.empty() || buffers.indices.empty())
+            continue;
+
+        MeshLOD lod;
+        lod.error = level.error;
+        lod.numIndices = static_cast<int>(buffers.indices.size());
+        // indices are packed with the buffers (see GLWidget::buildLODs())
+        const std::vector<uint16_t>& indices16 = level.layout.indices16;
+        lod.indexType = indices16.empty() ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+        lod.indexClusters = level.layout.clusters;
+
+        struct LODAttrib
+        {
+            const void* data;
+            size_t nbBytes;
+            AttributeLocation location;
+            GLint nbComponents;
+        };
+        const LODAttrib attribs[4] =
+        {
+            { buffers.vertices.data(),  buffers.vertices.size() * sizeof(glm::vec3),    POSITION,   3 },
+            { buffers.normals.data(),   buffers.normals.size() * sizeof(glm::vec3),     NORMAL,     3 },
+            { buffers.texcoords.data(), buffers.texcoords.size() * sizeof(glm::vec2),   UV,         2 },
+            { buffers.colors.data(),    buffers.colors.size() * sizeof(glm::vec3),     COLOR,      3 }
+        };
+
+        // other attributes are disabled in a new VAO: the shader reads the constant value set by setVAOAttribs()
+        glGenVertexArrays(1, &(lod.vao));
+        glBindVertexArray(lod.vao);
+        for(int a = 0; a < 4; a++)
+        {
+            if(attribs[a].nbBytes == 0)
+                continue;
+            glGenBuffers(1, &(lod.vbos[a]));
+            glBindBuffer(GL_ARRAY_BUFFER, lod.vbos[a]);
+            glBufferData(GL_ARRAY_BUFFER, attribs[a].nbBytes, attribs[a].data, GL_STATIC_DRAW);
+            glEnableVertexAttribArray(attribs[a].location);
+            glVertexAttribPointer(attribs[a].location, attribs[a].nbComponents, GL_FLOAT, GL_FALSE, 0, nullptr);
+        }
+        glGenBuffers(1, &(lod.indexVBO));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod.indexVBO);
+        if(lod.indexType == GL_UNSIGNED_SHORT)
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices16.size() * sizeof(uint16_t), indices16.data(), GL_STATIC_DRAW);
+        else
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, buffers.indices.size() * sizeof(uint32_t), buffers.indices.data(), GL_STATIC_DRAW);
+        glBindVertexArray(m_defaultVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_normalVBO);
-    glEnableVertexAttribArray(NORMAL);
-    glVertexAttribPointer(NORMAL, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+        qInfo() << "[info] DrawableMesh::setLODs: level " << m_lods.size() + 1 << ": " << lod.numIndices / 3 << " triangles, error " << lod.error;
+        m_lods.push_back(std::move(lod));
+    }
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_colorVBO);
-    glEnableVertexAttribArray(COLOR);
-    glVertexAttribPointer(COLOR, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_uvVBO);
-    glEnableVertexAttribArray(UV);
-    glVertexAttribPointer(UV, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+void DrawableMesh::clearLODs()
+{
+    if(m_lods.empty())
+        return;
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_tangentVBO);
-    glEnableVertexAttribArray(TANGENT);
-    glVertexAttribPointer(TANGENT, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    for(MeshLOD& lod : m_lods)
+    {
+        glDeleteBuffers(4, lod.vbos);
+        glDeleteBuffers(1, &(lod.indexVBO));
+        glDeleteVertexArrays(1, &(lod.vao));
+    }
+    m_lods.clear();
+    m_activeLOD = -1;
+    qInfo() << "[info] DrawableMesh::clearLODs: levels of detail deleted";
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_bitangentVBO);
-    glEnableVertexAttribArray(BITANGENT);
-    glVertexAttribPointer(BITANGENT, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_facenormalVBO);
-    glEnableVertexAttribArray(FACENORMAL);
-    glVertexAttribPointer(FACENORMAL, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+GLuint* DrawableMesh::getVBO(MeshAttrib _attrib)
+{
+    switch(_attrib)
+    {
+        case ATTRIB_VERTEX:     return &m_vertexVBO;
+        case ATTRIB_NORMAL:     return &m_normalVBO;
+        case ATTRIB_INDEX:      return &m_indexVBO;
+        case ATTRIB_COLOR:      return &m_colorVBO;
+        case ATTRIB_TEXCOORD:   return &m_uvVBO;
+        case ATTRIB_TANGENT:    return &m_tangentVBO;
+        case ATTRIB_BITANGENT:  return &m_bitangentVBO;
+        case ATTRIB_SCALAR:     return &m_scalarVBO;
+        default:                return nullptr;
+    }
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexVBO);
-    glBindVertexArray(m_defaultVAO); // unbinds the VAO
 
-    // Additional information required by draw calls
-    m_numVertices = static_cast<int>(vertices.size());
-    m_numIndices = static_cast<int>(indices.size());
+void DrawableMesh::queueUpload(std::shared_ptr<MeshBuffers> _buffers, unsigned int _attribs, std::shared_ptr<MeshRemap> _remap,
+                               std::shared_ptr<IndexLayout> _layout)
+{
+    m_uploadData.push_back(_buffers);
+    if(_remap)
+        m_uploadRemap = _remap;
 
-    // Clear temporary vectors
-    vertices.clear();
-    normals.clear();
-    indices.clear();
-    colors.clear();
-    texcoords.clear();
-    tangents.clear();
-    bitangents.clear();
-    facenormals.clear();
+    for(unsigned int bit = ATTRIB_VERTEX; bit <= ATTRIB_SCALAR; bit <<= 1)
+    {
+        if(!(_attribs & bit) || bit == ATTRIB_FACENORMAL)    // no VBO for face normals (derived by the shader)
+            continue;
+
+        BufferUpload upload = { (MeshAttrib)bit, 0, nullptr, 0, 0, 0 };
+        size_t elemSize = 0;
+        switch(bit)
+        {
+            case ATTRIB_VERTEX:     upload.data = (const char*)_buffers->vertices.data();    upload.nbElements = _buffers->vertices.size();    elemSize = sizeof(glm::vec3); break;
+            case ATTRIB_NORMAL:     upload.data = (const char*)_buffers->normals.data();     upload.nbElements = _buffers->normals.size();     elemSize = sizeof(glm::vec3); break;
+            case ATTRIB_INDEX:
+                // 16 bits indices and meshlets are built with the buffers (see IndexOptimizer::buildLayout())
+                m_uploadLayout = _layout;
+                if(m_uploadLayout && !m_uploadLayout->indices16.empty())
+                {
+                    upload.data = (const char*)m_uploadLayout->indices16.data(); upload.nbElements = m_uploadLayout->indices16.size(); elemSize = sizeof(uint16_t);
+                }
+                else
+                {
+                    upload.data = (const char*)_buffers->indices.data(); upload.nbElements = _buffers->indices.size(); elemSize = sizeof(uint32_t);
+                }
+                break;
+            case ATTRIB_COLOR:      upload.data = (const char*)_buffers->colors.data();      upload.nbElements = _buffers->colors.size();      elemSize = sizeof(glm::vec3); break;
+            case ATTRIB_TEXCOORD:   upload.data = (const char*)_buffers->texcoords.data();   upload.nbElements = _buffers->texcoords.size();   elemSize = sizeof(glm::vec2); break;
+            case ATTRIB_TANGENT:    upload.data = (const char*)_buffers->tangents.data();    upload.nbElements = _buffers->tangents.size();    elemSize = sizeof(glm::vec3); break;
+            case ATTRIB_BITANGENT:  upload.data = (const char*)_buffers->bitangents.data();  upload.nbElements = _buffers->bitangents.size();  elemSize = sizeof(glm::vec3); break;
+            case ATTRIB_SCALAR:     upload.data = (const char*)_buffers->scalars.data();     upload.nbElements = _buffers->scalars.size();     elemSize = sizeof(float);     break;
+        }
+        upload.nbBytes = upload.nbElements * elemSize;
+
+        // storage is allocated now, data is copied later (absent attributes keep their current VBO, which is not read)
+        // GL_COPY_WRITE_BUFFER does not interfere with the VAO currently bound
+        if(upload.nbBytes)
+        {
+            glGenBuffers(1, &(upload.vbo));
+            glBindBuffer(GL_COPY_WRITE_BUFFER, upload.vbo);
+            glBufferData(GL_COPY_WRITE_BUFFER, upload.nbBytes, nullptr, GL_STATIC_DRAW);
+        }
+        else
+            upload.data = nullptr;
+        m_uploads.push_back(upload);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
 }
 
 
-void DrawableMesh::draw(glm::mat4& _mv, glm::mat4& _mvp, glm::vec3& _lightPos, glm::vec3& _lightCol) const
+size_t DrawableMesh::continueUpload(size_t _maxBytes)
 {
+    size_t remaining = 0;
+    for(BufferUpload& upload : m_uploads)
+    {
+        if(upload.data && upload.offset < upload.nbBytes && _maxBytes > 0)
+        {
+            size_t chunk = std::min(_maxBytes, upload.nbBytes - upload.offset);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, upload.vbo);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, upload.offset, chunk, upload.data + upload.offset);
+            upload.offset += chunk;
+            _maxBytes -= chunk;
+        }
+        if(upload.data)
+            remaining += upload.nbBytes - upload.offset;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return remaining;
+}
+
+
+void DrawableMesh::finishUpload()
+{
+    // flush the remaining data (if any)
+    continueUpload(std::numeric_limits<size_t>::max());
+
+    for(BufferUpload& upload : m_uploads)
+    {
+        if(upload.vbo)
+        {
+            GLuint* vbo = getVBO(upload.attrib);
+            glDeleteBuffers(1, vbo);
+            *vbo = upload.vbo;
+            getVBOCapacity(upload.attrib) = upload.nbBytes;
+        }
+
+        bool provided = (upload.nbElements > 0);
+        switch(upload.attrib)
+        {
+            case ATTRIB_VERTEX:     m_vertexProvided = provided;  m_numVertices = static_cast<int>(upload.nbElements); break;
+            case ATTRIB_NORMAL:     m_normalProvided = provided;      break;
+            case ATTRIB_INDEX:
+                m_indexProvided = provided;
+                m_numIndices = static_cast<int>(upload.nbElements);
+                if(m_uploadLayout)
+                {
+                    m_indexType = m_uploadLayout->indices16.empty() ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+                    m_indexClusters = m_uploadLayout->clusters;
+                    m_meshlets = m_uploadLayout->meshlets;
+                }
+                else
+                {
+                    m_indexType = GL_UNSIGNED_INT;
+                    m_indexClusters.clear();
+                    m_meshlets.clear();
+                }
+                break;
+            case ATTRIB_COLOR:      m_colorProvided = provided;       break;
+            case ATTRIB_TEXCOORD:   m_uvProvided = provided;          break;
+            case ATTRIB_TANGENT:    m_tangentProvided = provided;     break;
+            case ATTRIB_BITANGENT:  m_bitangentProvided = provided;   break;
+            case ATTRIB_SCALAR:     m_scalarProvided = provided;      break;
+            default: break;
+        }
+    }
+    m_uploads.clear();
+    m_uploadData.clear();
+    clearLODs();
+    m_remap = m_uploadRemap;
+    m_uploadRemap = nullptr;
+    m_uploadLayout = nullptr;
+
+    if(!m_vertexProvided)
+        qWarning() << "[Warning] DrawableMesh::finishUpload: No vertex provided";
+    if(!m_indexProvided)
+        qWarning() << "[Warning] DrawableMesh::finishUpload: No index provided";
+
+    // VBO names changed
+    setVAOAttribs();
+}
+
+
+void DrawableMesh::cancelUpload()
+{
+    for(BufferUpload& upload : m_uploads)
+    {
+        if(upload.vbo)
+            glDeleteBuffers(1, &(upload.vbo));
+    }
+    m_uploads.clear();
+    m_uploadData.clear();
+    m_uploadRemap = nullptr;
+    m_uploadLayout = nullptr;
+}
+
+
+void DrawableMesh::beginStream(size_t _vertexCapacity, size_t _indexCapacity)
+{
+    cancelUpload();
+    clearLODs();
+    m_remap = nullptr;
+    m_indexType = GL_UNSIGNED_INT;      // the final number of vertices is unknown
+    m_indexClusters.clear();
+    m_meshlets.clear();
+
+    m_streamVertexCapacity = std::max<size_t>(_vertexCapacity, 1);
+    m_streamIndexCapacity = std::max<size_t>(_indexCapacity, 3);
+
+    // pre-grown buffers, filled by appendStream()
+    MeshAttrib streamAttribs[3] = { ATTRIB_VERTEX, ATTRIB_NORMAL, ATTRIB_INDEX };
+    size_t streamBytes[3] = { m_streamVertexCapacity * sizeof(glm::vec3), m_streamVertexCapacity * sizeof(glm::vec3), m_streamIndexCapacity * sizeof(uint32_t) };
+    for(int i = 0; i < 3; i++)
+    {
+        GLuint* vbo = getVBO(streamAttribs[i]);
+        glDeleteBuffers(1, vbo);
+        glGenBuffers(1, vbo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, *vbo);
+        glBufferData(GL_COPY_WRITE_BUFFER, streamBytes[i], nullptr, GL_DYNAMIC_DRAW);
+        getVBOCapacity(streamAttribs[i]) = streamBytes[i];
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    m_numVertices = 0;
+    m_numIndices = 0;
+    m_vertexProvided = m_normalProvided = m_indexProvided = true;
+    m_colorProvided = m_uvProvided = m_tangentProvided = m_bitangentProvided = m_scalarProvided = false;
+
+    // other attributes are not streamed: constant values are used instead
+    setVAOAttribs();
+}
+
+
+void DrawableMesh::appendStream(const MeshBuffers& _batch)
+{
+    const size_t nbVertices = (size_t)m_numVertices + _batch.vertices.size();
+    const size_t nbIndices = (size_t)m_numIndices + _batch.indices.size();
+
+    // grow buffers (x2) if the batch does not fit
+    bool grown = false;
+    if(nbVertices > m_streamVertexCapacity)
+    {
+        size_t newCapacity = std::max(nbVertices, 2 * m_streamVertexCapacity);
+        growBuffer(ATTRIB_VERTEX, m_numVertices * sizeof(glm::vec3), newCapacity * sizeof(glm::vec3));
+        growBuffer(ATTRIB_NORMAL, m_numVertices * sizeof(glm::vec3), newCapacity * sizeof(glm::vec3));
+        m_streamVertexCapacity = newCapacity;
+        grown = true;
+    }
+    if(nbIndices > m_streamIndexCapacity)
+    {
+        size_t newCapacity = std::max(nbIndices, 2 * m_streamIndexCapacity);
+        growBuffer(ATTRIB_INDEX, m_numIndices * sizeof(uint32_t), newCapacity * sizeof(uint32_t));
+        m_streamIndexCapacity = newCapacity;
+        grown = true;
+    }
+    if(grown)
+        setVAOAttribs();
+
+    // append the batch after the data already streamed
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vertexVBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, m_numVertices * sizeof(glm::vec3), _batch.vertices.size() * sizeof(glm::vec3), _batch.vertices.data());
+    if(_batch.normals.size() == _batch.vertices.size())
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_normalVBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, m_numVertices * sizeof(glm::vec3), _batch.normals.size() * sizeof(glm::vec3), _batch.normals.data());
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_indexVBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, m_numIndices * sizeof(uint32_t), _batch.indices.size() * sizeof(uint32_t), _batch.indices.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    m_numVertices = static_cast<int>(nbVertices);
+    m_numIndices = static_cast<int>(nbIndices);
+}
+
+
+void DrawableMesh::growBuffer(MeshAttrib _attrib, size_t _usedBytes, size_t _newBytes)
+{
+    GLuint& _vbo = *getVBO(_attrib);
+    GLuint newVBO;
+    glGenBuffers(1, &newVBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newVBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, _newBytes, nullptr, GL_DYNAMIC_DRAW);
+    if(_usedBytes > 0)
+    {
+        // GPU-side copy, the streamed data is not kept on the CPU
+        glBindBuffer(GL_COPY_READ_BUFFER, _vbo);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, _usedBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &_vbo);
+    _vbo = newVBO;
+    getVBOCapacity(_attrib) = _newBytes;
+}
+
+
+void DrawableMesh::draw(glm::mat4& _mv, glm::mat4& _mvp, glm::vec3& _lightPos, glm::vec3& _lightCol)
+{
+    m_drawStats = DrawStats();
+
+    if(m_timerQuerySupported)
+    {
+        glBeginQuery(GL_TIME_ELAPSED, m_timerQueries[m_timerFrame % 2]);
+        m_drawStats.glCalls++;
+    }
+
+    // edges are drawn by the Phong shader when the surface is rendered, in a second pass otherwise
+    const bool singlePassWireframe = m_shadedRenderOn && m_wireframeRenderOn && m_wireframeSinglePassOn;
+
+    // Pass uniforms (only the blocks which changed are uploaded)
+    updateUniformBuffers(_mv, _mvp, _lightPos, _lightCol);
+
+    // A level of detail is drawn when the difference is not visible, meshlets outside the view are not submitted otherwise
+    selectLOD(_mv, _mvp);
+    cullMeshlets(_mv, _mvp);
+    const MeshLOD* lod = (m_activeLOD >= 0) ? &m_lods[m_activeLOD] : nullptr;
+
+    glBindVertexArray(lod ? lod->vao : m_meshVAO);   // bind the VAO (index buffer is part of the VAO state)
+    m_drawStats.glCalls++;
+
+    GLint wireClusterLocation = -1;
     if(m_shadedRenderOn)
     {
-        // Activate program
-        glUseProgram(m_program);
+        // Activate the program specialized for the enabled features
+        GLuint program = getPhongProgram(getShaderFeatures());
+        glUseProgram(program);
+        m_drawStats.glCalls++;
 
         // Bind textures
         if(m_useTex)
         {
             glActiveTexture(GL_TEXTURE0);
             glBindTexture(GL_TEXTURE_2D, m_tex);
+            m_drawStats.glCalls += 2;
         }
         if(m_useNormalMap)
         {
             glActiveTexture(GL_TEXTURE1);
             glBindTexture(GL_TEXTURE_2D, m_normalMap);
+            m_drawStats.glCalls += 2;
+        }
+        if(m_useScalar)
+        {
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_1D_ARRAY, m_colormapTex);
+            m_drawStats.glCalls += 2;
+        }
+        if(singlePassWireframe)
+        {
+            // VBO names change when a mesh is (re)loaded: attach them every frame
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_BUFFER, m_wireIndexTex);
+            const GLenum indexType = lod ? lod->indexType : m_indexType;
+            glTexBuffer(GL_TEXTURE_BUFFER, (indexType == GL_UNSIGNED_SHORT) ? GL_R16UI : GL_R32UI, lod ? lod->indexVBO : m_indexVBO);
+            glActiveTexture(GL_TEXTURE4);
+            glBindTexture(GL_TEXTURE_BUFFER, m_wirePositionTex);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, lod ? lod->vbos[0] : m_vertexVBO);
+            auto location = m_wireClusterLocations.find(program);
+            if(location != m_wireClusterLocations.end())
+                wireClusterLocation = location->second;
+            m_drawStats.glCalls += 6;
         }
         // ...
 
-        // Pass uniforms
-        glUniformMatrix4fv(glGetUniformLocation(m_program, "u_mv"), 1, GL_FALSE, &_mv[0][0]);
-        glUniformMatrix4fv(glGetUniformLocation(m_program, "u_mvp"), 1, GL_FALSE, &_mvp[0][0]);
-        glUniform3fv(glGetUniformLocation(m_program, "u_lightPosition"), 1, &_lightPos[0]);
+        // Draw!
+        if(m_wireframeRenderOn && !singlePassWireframe)
+        {
+            // polygon offset to avoid z-fighting artefacts when wireframe overlay is activated
+            glEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(1.5, 0.5);
+            m_drawStats.glCalls += 2;
+        }
+        drawTriangles(wireClusterLocation);
+        if(m_wireframeRenderOn && !singlePassWireframe)
+        {
+            glDisable(GL_POLYGON_OFFSET_FILL);
+            m_drawStats.glCalls++;
+        }
+    }
+    if(m_wireframeRenderOn && !singlePassWireframe)
+    {
+        // Activate program
+        finishShaderProgram(m_programWF);
+        glUseProgram(m_programWF);
 
-        glUniform3fv(glGetUniformLocation(m_program, "u_lightColor"), 1, &_lightCol[0]);
+        // Draw!
+        glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+        drawTriangles(-1);
+        glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
+        m_drawStats.glCalls += 3;
+    }
 
-        glUniform3fv(glGetUniformLocation(m_program, "u_ambientColor"), 1, &m_ambientColor[0]);
-        glUniform3fv(glGetUniformLocation(m_program, "u_diffuseColor"), 1, &m_diffuseColor[0]);
-        glUniform3fv(glGetUniformLocation(m_program, "u_specularColor"), 1, &m_specularColor[0]);
-        glUniform1f(glGetUniformLocation(m_program, "u_specularPower"), m_specPow);
- 
-        glUniform1i(glGetUniformLocation(m_program, "u_tex"), 0);
-        glUniform1i(glGetUniformLocation(m_program, "u_normalMap"), 1);
+    glBindVertexArray(m_defaultVAO);
+    glUseProgram(0);
+    m_drawStats.glCalls += 2;
 
+    if(m_timerQuerySupported)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_drawStats.glCalls++;
 
-        if(m_useAmbient)
-            glUniform1i(glGetUniformLocation(m_program, "u_useAmbient"), 1);
-        else
-            glUniform1i(glGetUniformLocation(m_program, "u_useAmbient"), 0);
-        if(m_useDiffuse)
-            glUniform1i(glGetUniformLocation(m_program, "u_useDiffuse"), 1);
-        else
-            glUniform1i(glGetUniformLocation(m_program, "u_useDiffuse"), 0);
-        if(m_useSpecular)
-            glUniform1i(glGetUniformLocation(m_program, "u_useSpecular"), 1);
-        else
-            glUniform1i(glGetUniformLocation(m_program, "u_useSpecular"), 0);
+        // read the query of the previous frame, if available (no stall)
+        if(m_timerFrame > 0)
+        {
+            GLuint previousQuery = m_timerQueries[(m_timerFrame + 1) % 2];
+            GLint available = 0;
+            glGetQueryObjectiv(previousQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+            m_drawStats.glCalls++;
+            if(available)
+            {
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(previousQuery, GL_QUERY_RESULT, &elapsed);
+                m_gpuTime = (double)elapsed * 1e-6;
+                m_drawStats.glCalls++;
+            }
+        }
+        m_timerFrame++;
+        m_drawStats.gpuTime = m_gpuTime;
+    }
+}
 
-        if(m_useTex)
-            glUniform1i(glGetUniformLocation(m_program, "u_useTex"), 1);
-        else
-            glUniform1i(glGetUniformLocation(m_program, "u_useTex"), 0);
-        if(m_useNormalMap)
-            glUniform1i(glGetUniformLocation(m_program, "u_useNormalMap"), 1);
-        else
-            glUniform1i(glGetUniformLocation(m_program, "u_useNormalMap"), 0);
 
-        if(m_showNormals)
-            glUniform1i(glGetUniformLocation(m_program, "u_showNormals"), 1);
-        else
-            glUniform1i(glGetUniformLocation(m_program, "u_showNormals"), 0);
+void DrawableMesh::setProgram(const std::string& _vertShaderFilename, const std::string& _fragShaderFilename)
+{
+    m_phongVertSource = readShaderSource(_vertShaderFilename);
+    m_phongFragSource = readShaderSource(_fragShaderFilename);
 
-        if(m_flatShading)
-            glUniform1i(glGetUniformLocation(m_program, "u_flatShading"), 1);
-        else
-            glUniform1i(glGetUniformLocation(m_program, "u_flatShading"), 0);
+    // programs compiled from the previous sources are obsolete
+    for(auto& program : m_programs)
+        deleteShaderProgram(program.second);
+    m_programs.clear();
 
-        if(m_useGammaCorrec)
-            glUniform1i(glGetUniformLocation(m_program, "u_useGammaCorrec"), 1);
-        else
-            glUniform1i(glGetUniformLocation(m_program, "u_useGammaCorrec"), 0);
+    // start compiling the default combination now (finished on first use, or by finishPrograms()), the others on first use
+    getPhongProgram(getShaderFeatures(), false);
+}
 
-        if(m_useFaceNormals)
-            glUniform1i(glGetUniformLocation(m_program, "u_useFaceNormals"), 1);
-        else
-            glUniform1i(glGetUniformLocation(m_program, "u_useFaceNormals"), 0);
 
-        if(m_useMeshCol)
-            glUniform1i(glGetUniformLocation(m_program, "u_useMeshCol"), 1);
-        else
-            glUniform1i(glGetUniformLocation(m_program, "u_useMeshCol"), 0);
-        // ...
+void DrawableMesh::finishPrograms(bool _wait)
+{
+    std::vector<GLuint*> programs = { &m_programWF };
+    for(auto& program : m_programs)
+        programs.push_back(&program.second);
+
+    // programs already compiled by the driver are finished first, without stalling
+    for(GLuint* program : programs)
+    {
+        if(isShaderProgramReady(*program))
+            finishShaderProgram(*program);
+    }
+    if(!_wait)
+        return;
+    for(GLuint* program : programs)
+        finishShaderProgram(*program);
+}
 
-        // Draw!
-        glBindVertexArray(m_meshVAO);                       // bind the VAO
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexVBO);  // do not forget to bind the index buffer AFTER !
 
-        if(m_wireframeRenderOn)
+unsigned int DrawableMesh::getShaderFeatures() const
+{
+    unsigned int features = 0;
+
+    if(m_useNormalMap)                      features |= SHADER_NORMAL_MAP;
+    if(m_flatShading)                       features |= SHADER_FLAT_SHADING;
+    if(m_useGammaCorrec)                    features |= SHADER_GAMMA_CORREC;
+    if(m_wireframeRenderOn && m_wireframeSinglePassOn)  features |= SHADER_WIREFRAME;
+
+    // shading and colors are not used when normals are displayed
+    if(m_showNormals)
+        return features | SHADER_SHOW_NORMALS;
+
+    if(m_useAmbient)                        features |= SHADER_AMBIENT;
+    if(m_useDiffuse)                        features |= SHADER_DIFFUSE;
+    if(m_useSpecular)                       features |= SHADER_SPECULAR;
+    if(m_useTex)                            features |= SHADER_TEX;
+    if(m_useMeshCol)                        features |= SHADER_MESH_COL;
+    if(m_useScalar && m_scalarProvided)     features |= SHADER_SCALAR;
+
+    return features;
+}
+
+
+GLuint DrawableMesh::getPhongProgram(unsigned int _features, bool _wait)
+{
+    auto it = m_programs.find(_features);
+    if(it == m_programs.end())
+    {
+        // names of the defines, in the order of enum ShaderFeature
+        const char* featureDefines[SHADER_FEATURE_COUNT] = { "USE_AMBIENT", "USE_DIFFUSE", "USE_SPECULAR", "USE_TEX", "USE_NORMAL_MAP", 
+                                                             "SHOW_NORMALS", "FLAT_SHADING", "USE_GAMMA_CORREC", "USE_MESH_COL", "USE_SCALAR", "USE_WIREFRAME" };
+        std::string defines;
+        for(int i = 0; i < SHADER_FEATURE_COUNT; i++)
         {
-            // polygon offset to avoid z-fighting artefacts when wireframe overlay is activated
-            glEnable(GL_POLYGON_OFFSET_FILL);
-            glPolygonOffset(1.5, 0.5);
+            if(_features & (1u << i))
+                defines += std::string("#define ") + featureDefines[i] + "\n";
         }
-        glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, 0);
-        if(m_wireframeRenderOn)
-            glDisable(GL_POLYGON_OFFSET_FILL);
-        glBindVertexArray(m_defaultVAO);
+
+        it = m_programs.emplace(_features, startShaderProgram(m_phongVertSource, m_phongFragSource, defines)).first;
+        qInfo() << "[info] DrawableMesh::getPhongProgram: program " << _features << " requested (" << m_programs.size() << " programs)";
+    }
+
+    // a failed compilation is not retried every frame (program 0 draws nothing)
+    if(_wait)
+        finishShaderProgram(it->second);
+    return it->second;
+}
 
 
+void DrawableMesh::updateUniformBuffers(const glm::mat4& _mv, const glm::mat4& _mvp, const glm::vec3& _lightPos, const glm::vec3& _lightCol)
+{
+    FrameUniforms frame;
+    frame.mv = _mv;
+    frame.mvp = _mvp;
+    frame.lightPosition = glm::vec4(_lightPos, 1.0f);
+    frame.lightColor = glm::vec4(_lightCol, 1.0f);
+
+    MaterialUniforms material;
+    material.ambientColor = glm::vec4(m_ambientColor, 1.0f);
+    material.diffuseColor = glm::vec4(m_diffuseColor, 1.0f);
+    material.specularColor = glm::vec4(m_specularColor, 1.0f);
+    material.wireColor = glm::vec4(m_wireColor, 1.0f);
+    material.scalarRange = m_scalarRange;
+    material.specularPower = m_specPow;
+    material.colormapId = m_colormapId;
+    material.wireShading = m_wireframeShadingOn ? 1 : 0;
+    material.wireWidth = m_wireWidth;
+    material.padding[0] = material.padding[1] = 0;
+
+    // upload a block only if its content changed (e.g. camera moved, or a rendering option was toggled)
+    if(!m_uniformsUploaded || std::memcmp(&frame, &m_frameUniforms, sizeof(FrameUniforms)) != 0)
+    {
+        m_frameUniforms = frame;
+        glBindBuffer(GL_UNIFORM_BUFFER, m_frameUBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &m_frameUniforms);
+        m_drawStats.glCalls += 2;
+        m_drawStats.uniformUpdates++;
     }
-    if(m_wireframeRenderOn)
+    if(!m_uniformsUploaded || std::memcmp(&material, &m_materialUniforms, sizeof(MaterialUniforms)) != 0)
     {
-        // Activate program
-        glUseProgram(m_programWF);
+        m_materialUniforms = material;
+        glBindBuffer(GL_UNIFORM_BUFFER, m_materialUBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(MaterialUniforms), &m_materialUniforms);
+        m_drawStats.glCalls += 2;
+        m_drawStats.uniformUpdates++;
+    }
+    m_uniformsUploaded = true;
 
-        // Pass uniforms
-        glUniformMatrix4fv(glGetUniformLocation(m_programWF, "u_mv"), 1, GL_FALSE, &_mv[0][0]);
-        glUniformMatrix4fv(glGetUniformLocation(m_programWF, "u_mvp"), 1, GL_FALSE, &_mvp[0][0]);
-        glUniform3fv(glGetUniformLocation(m_programWF, "u_lightPosition"), 1, &_lightPos[0]);
-        glUniform3fv(glGetUniformLocation(m_programWF, "u_diffuseColor"), 1, &m_wireColor[0]);
+    // binding points are global: bind the buffers of this mesh
+    glBindBufferBase(GL_UNIFORM_BUFFER, UBO_FRAME, m_frameUBO);
+    glBindBufferBase(GL_UNIFORM_BUFFER, UBO_MATERIAL, m_materialUBO);
+    m_drawStats.glCalls += 2;
+}
 
-        if(m_wireframeShadingOn)
-            glUniform1i(glGetUniformLocation(m_programWF, "u_shading"), 1);
-        else
-            glUniform1i(glGetUniformLocation(m_programWF, "u_shading"), 0);
 
-        // Draw!
-        glBindVertexArray(m_meshVAO);
-        glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
-        glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, 0);
-        glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
-        glBindVertexArray(m_defaultVAO);
+void DrawableMesh::initProgramUniforms(GLuint _program)
+{
+    // Uniform blocks
+    const std::pair<const char*, UniformBinding> blocks[] = { {"FrameData", UBO_FRAME}, {"MaterialData", UBO_MATERIAL} };
+    for(const auto& block : blocks)
+    {
+        GLuint blockIndex = glGetUniformBlockIndex(_program, block.first);
+        if(blockIndex != GL_INVALID_INDEX)
+            glUniformBlockBinding(_program, blockIndex, block.second);
+        else
+            qWarning() << "[Warning] DrawableMesh::initProgramUniforms: uniform block " << block.first << " not found";
     }
 
+    // Texture units (constant)
+    const std::pair<const char*, GLint> samplers[] = { {"u_tex", 0}, {"u_normalMap", 1}, {"u_colormap", 2}, 
+                                                       {"u_wireIndices", 3}, {"u_wirePositions", 4} };
+    glUseProgram(_program);
+    for(const auto& sampler : samplers)
+    {
+        GLint location = glGetUniformLocation(_program, sampler.first);
+        if(location != -1)
+            glUniform1i(location, sampler.second);
+    }
     glUseProgram(0);
+
+    // Per-draw uniforms: location looked up once
+    GLint wireClusterLocation = glGetUniformLocation(_program, "u_wireCluster");
+    if(wireClusterLocation != -1)
+        m_wireClusterLocations[_program] = wireClusterLocation;
 }
 
 
-GLuint DrawableMesh::load2DTexture(const std::string& _filename, bool _repeat)
+GLuint DrawableMesh::createColormapTexture()
 {
-    QImage image = QImage(QString(_filename.c_str()));
-    image = image.convertToFormat(QImage::Format_RGBA8888);
+    const int width = 256;
+
+    // control points of each colormap, evenly spaced in [0;1]
+    // Viridis and Cool-warm (Moreland) are subsampled from their reference tables
+    std::vector< std::vector<glm::vec3> > ctrlPts(CMAP_COUNT);
+    ctrlPts[CMAP_REDGREEN] = { glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f) };  // HSV hue from 120 to 0 degrees
+    ctrlPts[CMAP_VIRIDIS] = { glm::vec3(0.267f, 0.005f, 0.329f), glm::vec3(0.283f, 0.141f, 0.458f), glm::vec3(0.254f, 0.265f, 0.530f),
+                              glm::vec3(0.207f, 0.372f, 0.553f), glm::vec3(0.164f, 0.471f, 0.558f), glm::vec3(0.128f, 0.567f, 0.551f),
+                              glm::vec3(0.135f, 0.659f, 0.518f), glm::vec3(0.267f, 0.749f, 0.441f), glm::vec3(0.478f, 0.821f, 0.318f),
+                              glm::vec3(0.741f, 0.873f, 0.150f), glm::vec3(0.993f, 0.906f, 0.144f) };
+    ctrlPts[CMAP_COOLWARM] = { glm::vec3(0.230f, 0.299f, 0.754f), glm::vec3(0.552f, 0.690f, 0.996f), glm::vec3(0.865f, 0.865f, 0.865f),
+                               glm::vec3(0.958f, 0.604f, 0.482f), glm::vec3(0.706f, 0.016f, 0.150f) };
+    ctrlPts[CMAP_GRAYSCALE] = { glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f) };
+
+    // linear interpolation of the control points
+    std::vector<unsigned char> texels(CMAP_COUNT * width * 3);
+    for(int c = 0; c < CMAP_COUNT; c++)
+    {
+        int nbSegments = (int)ctrlPts[c].size() - 1;
+        for(int i = 0; i < width; i++)
+        {
+            float t = (float)i / (float)(width-1) * (float)nbSegments;
+            int seg = std::min((int)t, nbSegments-1);
+            glm::vec3 col = glm::mix(ctrlPts[c][seg], ctrlPts[c][seg+1], t - (float)seg);
+
+            for(int k = 0; k < 3; k++)
+                texels[(c*width + i)*3 + k] = (unsigned char)(glm::clamp(col[k], 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+    }
 
-    qInfo() << "[info] DrawableMesh::load2DTexture: image format: " << image.format();
-    
     GLuint texture;
     glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    if(!_repeat)
-    {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    }
-    else
-    {
-        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );  
-        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT ); 
-    }
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, image.width(), image.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, &(image.constBits()[0]));
-    
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindTexture(GL_TEXTURE_1D_ARRAY, texture);
+    glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_1D_ARRAY, 0, GL_RGB8, width, CMAP_COUNT, 0, GL_RGB, GL_UNSIGNED_BYTE, texels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glBindTexture(GL_TEXTURE_1D_ARRAY, 0);
 
     return texture;
 }
 
 
+GLuint DrawableMesh::loadShaderProgram(const std::string& _vertShaderFilename, const std::string& _fragShaderFilename)
+{
+    return compileShaderProgram(readShaderSource(_vertShaderFilename), readShaderSource(_fragShaderFilename));
+}
 
 
-GLuint DrawableMesh::loadShaderProgram(const std::string& _vertShaderFilename, const std::string& _fragShaderFilename)
+GLuint DrawableMesh::compileShaderProgram(const std::string& _vertShaderSource, const std::string& _fragShaderSource, const std::string& _defines)
 {
+    GLuint program = startShaderProgram(_vertShaderSource, _fragShaderSource, _defines);
+    finishShaderProgram(program);
+    return program;
+}
+
+
+GLuint DrawableMesh::startShaderProgram(const std::string& _vertShaderSource, const std::string& _fragShaderSource, const std::string& _defines)
+{
+    std::string vertexShaderSource = insertDefines(insertUniformBlocks(_vertShaderSource), _defines);
+    std::string fragmentShaderSource = insertDefines(insertUniformBlocks(_fragShaderSource), _defines);
+
+    PendingProgram pending;
+    pending.cacheKey = getProgramCacheKey(vertexShaderSource, fragmentShaderSource);
+
+    // Program already compiled by a previous run of the application
+    GLuint program = loadProgramBinary(pending.cacheKey);
+    if(program)
+        return program;
 
     // Load and compile vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER); 
-    std::string vertexShaderSource = readShaderSource(_vertShaderFilename);
+    pending.vertexShader = glCreateShader(GL_VERTEX_SHADER); 
     const char *vertexShaderSourcePtr = vertexShaderSource.c_str();
-    glShaderSource(vertexShader, 1, &vertexShaderSourcePtr, nullptr);
-    
-    glCompileShader(vertexShader);
-    GLint compiled = 0;
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &compiled);
-    if (!compiled) 
-    {
-        qCritical() << "[ERROR] DrawableMesh::loadShaderProgram: Vertex shader compilation failed:";
-        showShaderInfoLog(vertexShader);
-        glDeleteShader(vertexShader);
-        return 0;
-    }
+    glShaderSource(pending.vertexShader, 1, &vertexShaderSourcePtr, nullptr);
+    glCompileShader(pending.vertexShader);
 
     // Load and compile fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    std::string fragmentShaderSource = readShaderSource(_fragShaderFilename);
+    pending.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
     const char *fragmentShaderSourcePtr = fragmentShaderSource.c_str();
-    glShaderSource(fragmentShader, 1, &fragmentShaderSourcePtr, nullptr);
+    glShaderSource(pending.fragmentShader, 1, &fragmentShaderSourcePtr, nullptr);
+    glCompileShader(pending.fragmentShader);
+
+    // Create program object, attach shaders and link
+    program = glCreateProgram();
+    glAttachShader(program, pending.vertexShader);
+    glAttachShader(program, pending.fragmentShader);
+    if(m_programBinarySupported)
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program);
+
+    // statuses are not queried yet: with KHR_parallel_shader_compile, the driver compiles meanwhile in its own threads
+    m_pendingPrograms[program] = pending;
+
+    return program;
+}
+
 
-    glCompileShader(fragmentShader);
+bool DrawableMesh::isShaderProgramReady(GLuint _program)
+{
+    if(m_pendingPrograms.find(_program) == m_pendingPrograms.end())
+        return true;
+    // without KHR_parallel_shader_compile, the status cannot be polled: querying it may wait for the driver
+    if(!m_parallelCompileSupported)
+        return false;
+
+    GLint completed = GL_FALSE;
+    glGetProgramiv(_program, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed == GL_TRUE;
+}
+
+
+bool DrawableMesh::finishShaderProgram(GLuint& _program)
+{
+    auto it = m_pendingPrograms.find(_program);
+    if(it == m_pendingPrograms.end())
+        return _program != 0;
+    PendingProgram pending = it->second;
+    m_pendingPrograms.erase(it);
+
+    // Check compilation and linking status (waits for the driver if needed)
+    bool success = true;
+    GLint compiled = 0;
+    glGetShaderiv(pending.vertexShader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) 
+    {
+        qCritical() << "[ERROR] DrawableMesh::finishShaderProgram: Vertex shader compilation failed:";
+        showShaderInfoLog(pending.vertexShader);
+        success = false;
+    }
     compiled = 0;
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &compiled);
+    glGetShaderiv(pending.fragmentShader, GL_COMPILE_STATUS, &compiled);
     if (!compiled) 
     {
-        qCritical() << "[ERROR] DrawableMesh::loadShaderProgram(): Fragment shader compilation failed:";
-        showShaderInfoLog(fragmentShader);
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
-        return 0;
+        qCritical() << "[ERROR] DrawableMesh::finishShaderProgram: Fragment shader compilation failed:";
+        showShaderInfoLog(pending.fragmentShader);
+        success = false;
+    }
+    if (success)
+    {
+        GLint linked = 0;
+        glGetProgramiv(_program, GL_LINK_STATUS, &linked);
+        if (!linked) 
+        {
+            qCritical() << "[ERROR] DrawableMesh::finishShaderProgram: Linking failed:";
+            showProgramInfoLog(_program);
+            success = false;
+        }
     }
 
-    // Create program object
-    GLuint program = glCreateProgram();
+    // Clean up
+    glDetachShader(_program, pending.vertexShader);
+    glDetachShader(_program, pending.fragmentShader);
+    glDeleteShader(pending.vertexShader);
+    glDeleteShader(pending.fragmentShader);
+
+    if (!success)
+    {
+        glDeleteProgram(_program);
+        _program = 0;
+        return false;
+    }
 
-    // Attach shaders to the program
-    glAttachShader(program, vertexShader);
-    glAttachShader(program, fragmentShader);
+    // Next runs of the application will skip compilation
+    saveProgramBinary(_program, pending.cacheKey);
+
+    // Uniforms set once for all
+    initProgramUniforms(_program);
+
+    return true;
+}
+
+
+void DrawableMesh::deleteShaderProgram(GLuint _program)
+{
+    auto it = m_pendingPrograms.find(_program);
+    if(it != m_pendingPrograms.end())
+    {
+        glDeleteShader(it->second.vertexShader);
+        glDeleteShader(it->second.fragmentShader);
+        m_pendingPrograms.erase(it);
+    }
+    m_wireClusterLocations.erase(_program);
+    glDeleteProgram(_program);
+}
+
+
+std::string DrawableMesh::getProgramCacheKey(const std::string& _vertShaderSource, const std::string& _fragShaderSource)
+{
+    // binaries are only valid for the driver that produced them
+    if(m_driverId.empty())
+    {
+        const GLubyte* strings[3] = { glGetString(GL_VENDOR), glGetString(GL_RENDERER), glGetString(GL_VERSION) };
+        for(const GLubyte* str : strings)
+            m_driverId += std::string(str ? reinterpret_cast<const char*>(str) : "") + "|";
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::fromStdString(m_driverId));
+    hash.addData(QByteArray::fromStdString(_vertShaderSource));
+    hash.addData(QByteArray::fromStdString(_fragShaderSource));
+    return hash.result().toHex().toStdString();
+}
+
+
+QString DrawableMesh::getProgramCacheFilename(const std::string& _cacheKey) const
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/programs/" + QString::fromStdString(_cacheKey) + ".bin";
+}
 
-    // Link program
-    glLinkProgram(program);
 
-    // Check linking status
+GLuint DrawableMesh::loadProgramBinary(const std::string& _cacheKey)
+{
+    if(!m_programBinarySupported)
+        return 0;
+
+    // file content: binary format (GLenum) followed by the binary
+    QFile file(getProgramCacheFilename(_cacheKey));
+    if(!file.open(QIODevice::ReadOnly))
+        return 0;
+    QByteArray content = file.readAll();
+    file.close();
+    if(content.size() <= (qsizetype)sizeof(GLenum))
+        return 0;
+
+    GLenum format = 0;
+    std::memcpy(&format, content.constData(), sizeof(GLenum));
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, format, content.constData() + sizeof(GLenum), (GLsizei)(content.size() - sizeof(GLenum)));
     GLint linked = 0;
     glGetProgramiv(program, GL_LINK_STATUS, &linked);
-    if (!linked) 
+    if(!linked)
     {
-        qCritical() << "[ERROR] DrawableMesh::loadShaderProgram(): Linking failed:";
-        showProgramInfoLog(program);
+        // e.g. the driver has been updated: compile from sources instead
+        qWarning() << "[Warning] DrawableMesh::loadProgramBinary: cached program rejected by the driver, compiling it";
         glDeleteProgram(program);
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
+        QFile::remove(getProgramCacheFilename(_cacheKey));
         return 0;
     }
 
-    // Clean up
-    glDetachShader(program, vertexShader);
-    glDetachShader(program, fragmentShader);
+    // uniforms are not part of the binary
+    initProgramUniforms(program);
+    m_programCacheHits++;
 
     return program;
 }
 
 
+void DrawableMesh::saveProgramBinary(GLuint _program, const std::string& _cacheKey)
+{
+    if(!m_programBinarySupported)
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(_program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length <= 0)
+        return;
+
+    QByteArray content(sizeof(GLenum) + length, 0);
+    GLenum format = 0;
+    glGetProgramBinary(_program, length, nullptr, &format, content.data() + sizeof(GLenum));
+    std::memcpy(content.data(), &format, sizeof(GLenum));
+
+    // QSaveFile: a partially written file is never read by another instance
+    QString filename = getProgramCacheFilename(_cacheKey);
+    QDir().mkpath(QFileInfo(filename).absolutePath());
+    QSaveFile file(filename);
+    if(!file.open(QIODevice::WriteOnly) || file.write(content) != content.size() || !file.commit())
+        qWarning() << "[Warning] DrawableMesh::saveProgramBinary: cannot write " << filename;
+}
+
+
+std::string DrawableMesh::insertDefines(const std::string& _source, const std::string& _defines)
+{
+    if(_defines.empty())
+        return _source;
+
+    // defines must follow the #version line (and may precede #extension directives)
+    size_t versionPos = _source.find("#version");
+    if(versionPos == std::string::npos)
+        return _defines + _source;
+    size_t lineEnd = _source.find('\n', versionPos);
+    if(lineEnd == std::string::npos)
+        return _source + "\n" + _defines;
+    return _source.substr(0, lineEnd + 1) + _defines + _source.substr(lineEnd + 1);
+}
+
+
+std::string DrawableMesh::insertUniformBlocks(const std::string& _source)
+{
+    // declarations must follow the #version line and the #extension directives
+    size_t insertPos = 0;
+    size_t directivePos = _source.find("#version");
+    while(directivePos != std::string::npos)
+    {
+        size_t lineEnd = _source.find('\n', directivePos);
+        if(lineEnd == std::string::npos)
+            return _source + "\n" + m_uniformBlocksSource;
+        insertPos = lineEnd + 1;
+        directivePos = _source.find("#extension", insertPos);
+    }
+    return _source.substr(0, insertPos) + m_uniformBlocksSource + _source.substr(insertPos);
+}
+
+
 std::string DrawableMesh::readShaderSource(const std::string& _filename)
 {
     std::ifstream file(_filename);
@@ -4,7 +4,14 @@
 #define QT_NO_OPENGL_ES_2
 #include <GL/glew.h>
 
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <QString>
+
 #include "mesh.h"
+#include "indexoptimizer.h"
 
 
 // The attribute locations we will use in the vertex shader
@@ -16,7 +23,150 @@ enum AttributeLocation
     UV = 3,
     TANGENT = 4,
     BITANGENT = 5,
-    FACENORMAL = 6
+    SCALAR = 7
+};
+
+
+// The colormaps available to display scalar fields (layers of the colormap texture)
+enum Colormap
+{
+    CMAP_REDGREEN = 0,
+    CMAP_VIRIDIS = 1,
+    CMAP_COOLWARM = 2,
+    CMAP_GRAYSCALE = 3,
+    CMAP_COUNT = 4
+};
+
+
+// The binding points of the uniform blocks declared in the shaders
+enum UniformBinding
+{
+    UBO_FRAME = 0,
+    UBO_MATERIAL = 1
+};
+
+
+// The features of the Phong shaders, compiled in or out with #define (one program per combination, see DrawableMesh::getPhongProgram())
+enum ShaderFeature
+{
+    SHADER_AMBIENT = 1 << 0,
+    SHADER_DIFFUSE = 1 << 1,
+    SHADER_SPECULAR = 1 << 2,
+    SHADER_TEX = 1 << 3,
+    SHADER_NORMAL_MAP = 1 << 4,
+    SHADER_SHOW_NORMALS = 1 << 5,
+    SHADER_FLAT_SHADING = 1 << 6,
+    SHADER_GAMMA_CORREC = 1 << 7,
+    SHADER_MESH_COL = 1 << 8,
+    SHADER_SCALAR = 1 << 9,
+    SHADER_WIREFRAME = 1 << 10,
+    SHADER_FEATURE_COUNT = 11
+};
+
+
+/*!
+* \struct FrameUniforms
+* \brief Content of the FrameData uniform block (std140 layout, see shaders/uniforms.glsl): per-frame matrices and light
+*/
+struct FrameUniforms
+{
+    glm::mat4 mv;               /*!< modelview matrix */
+    glm::mat4 mvp;              /*!< modelview-projection matrix */
+    glm::vec4 lightPosition;    /*!< 3D coords of light position (w unused) */
+    glm::vec4 lightColor;       /*!< RGB color of the light (w unused) */
+};
+static_assert(sizeof(FrameUniforms) == 160, "FrameUniforms must match the std140 layout of FrameData");
+
+
+/*!
+* \struct MaterialUniforms
+* \brief Content of the MaterialData uniform block (std140 layout, see shaders/uniforms.glsl): colors and rendering flags
+*/
+struct MaterialUniforms
+{
+    glm::vec4 ambientColor;     /*!< ambient color (w unused) */
+    glm::vec4 diffuseColor;     /*!< diffuse color (w unused) */
+    glm::vec4 specularColor;    /*!< specular color (w unused) */
+    glm::vec4 wireColor;        /*!< line color for wireframe rendering (w unused) */
+    glm::vec2 scalarRange;      /*!< scalar values mapped to the first and last colormap texels */
+    float specularPower;        /*!< specular power */
+    int colormapId;             /*!< index of the colormap */
+    int wireShading;            /*!< 1 to shade the wireframe, 0 otherwise */
+    float wireWidth;            /*!< line width of the single-pass wireframe, in pixels */
+    int padding[2];             /*!< block size multiple of 16 bytes */
+};
+static_assert(sizeof(MaterialUniforms) == 96, "MaterialUniforms must match the std140 layout of MaterialData");
+
+
+/*!
+* \struct DrawStats
+* \brief Number of GL calls issued by the last DrawableMesh::draw()
+*/
+struct DrawStats
+{
+    int glCalls = 0;            /*!< total number of GL calls */
+    int drawCalls = 0;          /*!< number of glDraw* calls */
+    int uniformUpdates = 0;     /*!< number of uniform buffers actually updated */
+    int meshletsDrawn = 0;      /*!< number of meshlets drawn (see DrawableMesh::cullMeshlets()) */
+    int meshletsFrustumCulled = 0;  /*!< number of meshlets outside the view frustum */
+    int meshletsBackfaceCulled = 0; /*!< number of meshlets entirely back-facing */
+    int lod = 0;                /*!< level of detail drawn (0: full resolution mesh, see DrawableMesh::selectLOD()) */
+    double gpuTime = -1.0;      /*!< GPU time of the previous draw(), in ms (-1 if unknown) */
+};
+
+
+/*!
+* \struct PendingProgram
+* \brief Program whose shaders are being compiled and linked (see DrawableMesh::startShaderProgram())
+*/
+struct PendingProgram
+{
+    GLuint vertexShader = 0;    /*!< vertex shader attached to the program */
+    GLuint fragmentShader = 0;  /*!< fragment shader attached to the program */
+    std::string cacheKey;       /*!< key of the program in the binary cache */
+};
+
+
+/*!
+* \struct BufferUpload
+* \brief Pending upload of one attribute array into a new VBO, done chunk by chunk (see DrawableMesh::queueUpload())
+*/
+struct BufferUpload
+{
+    MeshAttrib attrib;          /*!< uploaded attribute (single bit of MeshAttrib) */
+    GLuint vbo;                 /*!< new VBO, swapped with the current one by DrawableMesh::finishUpload() */
+    const char* data;           /*!< data to upload (nullptr if the attribute is not provided) */
+    size_t nbBytes;             /*!< size of the data, in bytes */
+    size_t offset;              /*!< number of bytes already uploaded */
+    size_t nbElements;          /*!< number of elements (i.e. vertices, or indices) */
+};
+
+
+/*!
+* \struct LODBuffers
+* \brief CPU arrays of a level of detail, built in background (see GLWidget::buildLODs()) and uploaded by DrawableMesh::setLODs()
+*/
+struct LODBuffers
+{
+    MeshBuffers buffers;        /*!< positions, normals, UVs, colors and indices of the simplified mesh */
+    IndexLayout layout;         /*!< 16 bits indices of the simplified mesh (empty for 32 bits indices, levels are not culled by meshlets) */
+    float error = 0.0f;         /*!< geometric error of the simplified mesh, in model space (see Mesh::decimate()) */
+};
+
+
+/*!
+* \struct MeshLOD
+* \brief Level of detail on the GPU, drawn instead of the mesh when its error is not visible (see DrawableMesh::selectLOD())
+*/
+struct MeshLOD
+{
+    GLuint vao = 0;             /*!< VAO of the level (attributes which are not provided read a constant value) */
+    GLuint vbos[4] = {};        /*!< VBOs of positions, normals, UVs and colors (0 if not provided) */
+    GLuint indexVBO = 0;        /*!< index VBO */
+    int numIndices = 0;         /*!< number of indices */
+    GLenum indexType = GL_UNSIGNED_INT;         /*!< type of the indices (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT) */
+    std::vector<IndexCluster> indexClusters;    /*!< ranges of 16 bits indices (empty for 32 bits indices) */
+    float error = 0.0f;         /*!< geometric error, in model space */
 };
 
 
@@ -52,8 +202,20 @@ class DrawableMesh //: protected QOpenGLFunctions_3_3_Core
         |                                              GETTERS/SETTERS                                                |
         +-------------------------------------------------------------------------------------------------------------*/
 
-        /*! \fn setProgram */
-        inline void setProgram(const std::string& _vertShaderFilename, const std::string& _fragShaderFilename) { m_program = loadShaderProgram(_vertShaderFilename, _fragShaderFilename); }
+        /*!
+        * \fn setProgram
+        * \brief set the Phong shaders, from which a program is compiled for each combination of features on first use
+        * \param _vertShaderFilename : vertex shader filename
+        * \param _fragShaderFilename : fragment shader filename
+        */
+        void setProgram(const std::string& _vertShaderFilename, const std::string& _fragShaderFilename);
+
+        /*!
+        * \fn finishPrograms
+        * \brief finish the programs being compiled: the ones already compiled by the driver are finished first (see isShaderProgramReady())
+        * \param _wait : true to wait for the other ones as well, false to leave them for a next call (or their first use)
+        */
+        void finishPrograms(bool _wait = true);
 
         /*! \fn setSpeculatPower */
         inline void setSpeculatPower(float _specPow) { m_specPow = _specPow; }
@@ -65,6 +227,9 @@ class DrawableMesh //: protected QOpenGLFunctions_3_3_Core
         /*! \fn setAmbientColor */
         inline void setSpecularColor(int _r, int _g, int _b) { m_specularColor = glm::vec3( (float)_r/255.0f, (float)_g/255.0f, (float)_b/255.0f ); }
 
+        /*! \fn setWireWidth */
+        inline void setWireWidth(float _wireWidth) { m_wireWidth = _wireWidth; }
+
         /*! \fn setWireColor */
         inline void setWireColor(int _r, int _g, int _b) { m_wireColor = glm::vec3( (float)_r/255.0f, (float)_g/255.0f, (float)_b/255.0f ); }
 
@@ -105,6 +270,17 @@ class DrawableMesh //: protected QOpenGLFunctions_3_3_Core
         inline void setUseFaceNormalsFlag(bool useFaceNormals) { m_useFaceNormals = useFaceNormals; }
         /*! \fn setUseMeshColFlag */
         inline void setUseMeshColFlag(bool useMeshCol) { m_useMeshCol = useMeshCol; }
+        /*! \fn setUseScalarFlag */
+        inline void setUseScalarFlag(bool _useScalar) 
+        { 
+            if(!m_scalarProvided && _useScalar)
+                qWarning() << "[Warning] DrawableMesh::setUseScalarFlag: No scalar field available";
+            m_useScalar = _useScalar; 
+        }
+        /*! \fn setScalarRange */
+        inline void setScalarRange(float _min, float _max) { m_scalarRange = glm::vec2(_min, _max); }
+        /*! \fn setColormap */
+        inline void setColormap(int _colormapId) { m_colormapId = std::max(0, std::min(_colormapId, (int)CMAP_COUNT-1)); }
 
         /*! \fn getAmbientFlag */
         inline bool getAmbientFlag() { return m_useAmbient; }
@@ -126,6 +302,18 @@ class DrawableMesh //: protected QOpenGLFunctions_3_3_Core
         inline bool getUseFaceNormalsFlag() { return m_useFaceNormals; }
         /*! \fn getUseMeshColFlag */
         inline bool getUseMeshColFlag() { return m_useMeshCol; }
+        /*! \fn getUseScalarFlag */
+        inline bool getUseScalarFlag() { return m_useScalar; }
+        /*! \fn getScalarProvidedFlag */
+        inline bool getScalarProvidedFlag() { return m_scalarProvided; }
+        /*! \fn getNbTriangles */
+        inline int getNbTriangles() const { return m_numIndices / 3; }
+        /*! \fn getDrawStats */
+        inline const DrawStats& getDrawStats() const { return m_drawStats; }
+        /*! \fn getProgramCacheHits */
+        inline int getProgramCacheHits() const { return m_programCacheHits; }
+        /*! \fn getNbPendingPrograms */
+        inline int getNbPendingPrograms() const { return (int)m_pendingPrograms.size(); }
 
 
         /*------------------------------------------------------------------------------------------------------------+
@@ -134,25 +322,88 @@ class DrawableMesh //: protected QOpenGLFunctions_3_3_Core
 
         /*!
         * \fn createVAO
-        * \brief Create mesh VAO and VBOs, calling fillVAO().
-        * \param _triMesh : Mesh to update mesh VAO and VBOs from
+        * \brief Create mesh VAO and VBOs, empty until updateVAO() or an upload fills them
         */
-        void createVAO(std::shared_ptr<Mesh> _triMesh);
+        void createVAO();
 
         /*!
         * \fn updateVAO
-        * \brief Update mesh VAO and VBOs, calling fillVAO().
-        * \param _triMesh : Mesh to update mesh VAO and VBOs from
+        * \brief Fill mesh VBOs, reusing their storage when possible (levels of detail are left untouched, see clearLODs()).
+        *        Buffers are prepared beforehand, e.g. in a worker thread (see GLWidget::updateMeshBuffers()).
+        * \param _buffers : arrays of the mesh (face normals are not used)
+        * \param _layout : 16 bits indices and meshlets of _buffers (see IndexOptimizer::buildLayout()),
+        *                  empty to upload 32 bits indices without meshlet culling
+        * \param _remap : reordering already applied to _buffers, becomes current (see getRemap())
         */
-        void updateVAO(std::shared_ptr<Mesh> _triMesh);
+        void updateVAO(const MeshBuffers& _buffers, const IndexLayout& _layout, std::shared_ptr<MeshRemap> _remap);
 
         /*!
-        * \fn createVAO
-        * \brief Fill mesh VAO and VBOs
-        * \param _triMesh : Mesh to fill mesh VAO and VBOs from
-        * \param _create : true to init the VBOs and VAO, false to update them 
+        * \fn updateScalars
+        * \brief Update the scalar field VBO only, leaving the other VBOs untouched
+        * \param _triMesh : Mesh to get the scalar field from
+        */
+        void updateScalars(std::shared_ptr<Mesh> _triMesh);
+
+        /*!
+        * \fn getRemap
+        * \return reordering applied to the buffers of the mesh (nullptr if none), also applied by updateScalars()
         */
-        void fillVAO(std::shared_ptr<Mesh> _triMesh, bool _create);
+        inline std::shared_ptr<MeshRemap> getRemap() const { return m_remap; }
+
+        /*!
+        * \fn queueUpload
+        * \brief Allocate new VBOs for some attributes, to be filled chunk by chunk with continueUpload().
+        *        Current VBOs are still drawn until finishUpload() swaps them with the new ones.
+        * \param _buffers : arrays to upload (kept alive until the upload is finished)
+        * \param _attribs : bitmask of attributes to upload from _buffers (see enum MeshAttrib)
+        * \param _remap : reordering already applied to _buffers, becomes current with the new VBOs (see getRemap())
+        * \param _layout : 16 bits indices and meshlets of _buffers (see IndexOptimizer::buildLayout()), used if indices are uploaded:
+        *                  without it, indices are uploaded in 32 bits and meshlets are not culled
+        */
+        void queueUpload(std::shared_ptr<MeshBuffers> _buffers, unsigned int _attribs, std::shared_ptr<MeshRemap> _remap = nullptr,
+                         std::shared_ptr<IndexLayout> _layout = nullptr);
+
+        /*!
+        * \fn continueUpload
+        * \brief Upload the next chunk of the queued arrays
+        * \param _maxBytes : maximal number of bytes uploaded by this call
+        * \return number of bytes still waiting to be uploaded
+        */
+        size_t continueUpload(size_t _maxBytes);
+
+        /*!
+        * \fn finishUpload
+        * \brief Replace the current VBOs by the uploaded ones, and update the VAO accordingly
+        */
+        void finishUpload();
+
+        /*!
+        * \fn cancelUpload
+        * \brief Delete the VBOs of the pending upload (current VBOs are kept)
+        */
+        void cancelUpload();
+
+        /*!
+        * \fn isUploadPending
+        * \return true if some arrays have been queued but not swapped yet
+        */
+        inline bool isUploadPending() const { return !m_uploads.empty(); }
+
+        /*!
+        * \fn beginStream
+        * \brief Replace the current mesh by an empty streamed mesh (positions and normals only), 
+        *        to be filled progressively with appendStream() while the file is loading
+        * \param _vertexCapacity : initial number of vertices allocated in the VBOs
+        * \param _indexCapacity : initial number of indices allocated in the index VBO
+        */
+        void beginStream(size_t _vertexCapacity, size_t _indexCapacity);
+
+        /*!
+        * \fn appendStream
+        * \brief Append a batch of vertices and triangles to the streamed mesh (VBOs are grown if needed)
+        * \param _batch : new vertices (positions, normals) and triangles, indices refer to all the vertices streamed so far
+        */
+        void appendStream(const MeshBuffers& _batch);
 
         /*!
         * \fn draw
@@ -162,47 +413,57 @@ class DrawableMesh //: protected QOpenGLFunctions_3_3_Core
         * \param _lightPos : 3D coords of light position
         * \param _lightCol : RGB color of the light
         */
-        void draw(glm::mat4& _mv, glm::mat4& _mvp, glm::vec3& _lightPos, glm::vec3& _lightCol) const;
+        void draw(glm::mat4& _mv, glm::mat4& _mvp, glm::vec3& _lightPos, glm::vec3& _lightCol);
 
         /*!
-        * \fn loadTex
-        * \brief load the texture from a file
-        * \param _filename : name of texture image
+        * \fn setTex
+        * \brief set the texture (loaded and owned by TextureManager)
+        * \param _texture : name of the texture (0 for none)
         */
-        inline void loadTex(const std::string& _filename) { m_tex = load2DTexture(_filename, true); }
+        inline void setTex(GLuint _texture) { m_tex = _texture; }
         /*!
-        * \fn loadNormalMap
-        * \brief load the normal map texture from a file
-        * \param _filename : name of texture image
+        * \fn setNormalMap
+        * \brief set the normal map texture (loaded and owned by TextureManager)
+        * \param _texture : name of the texture (0 for none)
         */
-        inline void loadNormalMap(const std::string& _filename) { m_normalMap = load2DTexture(_filename, true); }
+        inline void setNormalMap(GLuint _texture) { m_normalMap = _texture; }
         /*!
-        * \fn loadMetalMap
-        * \brief load the metal map (PBR) texture from a file
-        * \param _filename : name of texture image
+        * \fn setMetalMap
+        * \brief set the metal map (PBR) texture (loaded and owned by TextureManager)
+        * \param _texture : name of the texture (0 for none)
         */
-        inline void loadMetalMap(const std::string& _filename) { m_metalMap = load2DTexture(_filename, true); }
+        inline void setMetalMap(GLuint _texture) { m_metalMap = _texture; }
         /*!
-        * \fn loadGlossMap
-        * \brief load the gloss mao (PBR) texture from a file
-        * \param _filename : name of texture image
+        * \fn setGlossMap
+        * \brief set the gloss map (PBR) texture (loaded and owned by TextureManager)
+        * \param _texture : name of the texture (0 for none)
         */
-        inline void loadGlossMap(const std::string& _filename) { m_glossMap = load2DTexture(_filename, true); }
+        inline void setGlossMap(GLuint _texture) { m_glossMap = _texture; }
         /*!
-        * \fn loadAmbientMap
-        * \brief load the ambient map texture from a file
-        * \param _filename : name of texture image
+        * \fn setAmbientMap
+        * \brief set the ambient map texture (loaded and owned by TextureManager)
+        * \param _texture : name of the texture (0 for none)
         */
-        inline void loadAmbientMap(const std::string& _filename) { m_ambientMap = load2DTexture(_filename, true); }
+        inline void setAmbientMap(GLuint _texture) { m_ambientMap = _texture; }
 
         /*!
         * \fn loadShaderProgram
-        * \brief load shader program from shader files
+        * \brief load shader program from shader files, and bind its uniform blocks and texture units (see initProgramUniforms())
         * \param _vertShaderFilename : vertex shader filename
         * \param _fragShaderFilename : fragment shader filename
         */
         GLuint loadShaderProgram(const std::string& _vertShaderFilename, const std::string& _fragShaderFilename);
 
+        /*!
+        * \fn compileShaderProgram
+        * \brief compile and link shader program from shader sources (or get it from the binary cache), 
+        *        and bind its uniform blocks and texture units
+        * \param _vertShaderSource : vertex shader source
+        * \param _fragShaderSource : fragment shader source
+        * \param _defines : preprocessor directives inserted after the #version line of both shaders
+        */
+        GLuint compileShaderProgram(const std::string& _vertShaderSource, const std::string& _fragShaderSource, const std::string& _defines = "");
+
         /*! 
         * \fn toggleShadedRenderFlag 
         * \brief reverse shaded rendering flag
@@ -221,6 +482,61 @@ class DrawableMesh //: protected QOpenGLFunctions_3_3_Core
         * \brief reverse wireframe shading flag
         */
         inline void toggleWireframeShadingFlag() { m_wireframeShadingOn = !m_wireframeShadingOn; }
+
+        /*! 
+        * \fn toggleWireframeSinglePassFlag 
+        * \brief switch between the single-pass wireframe (edges drawn by the Phong shader over the surface) 
+        *        and the line pass (mesh drawn a second time with glPolygonMode(GL_LINE), also used when the surface is hidden)
+        */
+        inline void toggleWireframeSinglePassFlag() { m_wireframeSinglePassOn = !m_wireframeSinglePassOn; }
+        /*! \fn getWireframeSinglePassFlag */
+        inline bool getWireframeSinglePassFlag() { return m_wireframeSinglePassOn; }
+
+        /*! 
+        * \fn toggleFrustumCullingFlag 
+        * \brief activate/deactivate the culling of the meshlets outside the view frustum
+        */
+        inline void toggleFrustumCullingFlag() { m_frustumCullingOn = !m_frustumCullingOn; }
+        /*! \fn getFrustumCullingFlag */
+        inline bool getFrustumCullingFlag() { return m_frustumCullingOn; }
+
+        /*! 
+        * \fn toggleBackfaceCullingFlag 
+        * \brief activate/deactivate the culling of back-facing meshlets (closed meshes only: back faces are rendered otherwise)
+        */
+        inline void toggleBackfaceCullingFlag() { m_backfaceCullingOn = !m_backfaceCullingOn; }
+        /*! \fn getBackfaceCullingFlag */
+        inline bool getBackfaceCullingFlag() { return m_backfaceCullingOn; }
+
+        /*!
+        * \fn setLODs
+        * \brief upload the levels of detail of the mesh (the previous ones are deleted)
+        * \param _levels : simplified versions of the current mesh, from the finest to the coarsest
+        */
+        void setLODs(const std::vector<LODBuffers>& _levels);
+
+        /*!
+        * \fn clearLODs
+        * \brief delete the levels of detail (they are not valid anymore once the mesh changes)
+        */
+        void clearLODs();
+
+        /*! \fn getNbLODs */
+        inline int getNbLODs() const { return (int)m_lods.size(); }
+
+        /*! 
+        * \fn toggleLODFlag 
+        * \brief activate/deactivate the rendering of levels of detail
+        */
+        inline void toggleLODFlag() { m_lodOn = !m_lodOn; }
+        /*! \fn getLODFlag */
+        inline bool getLODFlag() { return m_lodOn; }
+
+        /*! 
+        * \fn setViewportHeight 
+        * \brief height of the viewport in pixels, converts the error of the levels of detail to pixels
+        */
+        inline void setViewportHeight(int _height) { m_viewportHeight = _height; }
         
 
     protected:
@@ -229,12 +545,33 @@ class DrawableMesh //: protected QOpenGLFunctions_3_3_Core
         |                                                ATTRIBUTES                                                   |
         +-------------------------------------------------------------------------------------------------------------*/
 
-        GLuint m_program;           /*!< handle of the program object (i.e. shaders) for shaded surface rendering */
+        std::string m_phongVertSource;      /*!< source of the Phong vertex shader (without feature defines) */
+        std::string m_phongFragSource;      /*!< source of the Phong fragment shader (without feature defines) */
+        std::string m_uniformBlocksSource;  /*!< declaration of the FrameData and MaterialData blocks, inserted in every shader (see shaders/uniforms.glsl) */
+        std::unordered_map<unsigned int, GLuint> m_programs;    /*!< programs for shaded surface rendering, one per combination of features (see enum ShaderFeature) */
+        std::unordered_map<GLuint, PendingProgram> m_pendingPrograms;   /*!< programs started but not checked yet (see finishShaderProgram()) */
+        std::unordered_map<GLuint, GLint> m_wireClusterLocations;       /*!< location of the u_wireCluster uniform, for the programs using it (see initProgramUniforms()) */
+        bool m_programBinarySupported;      /*!< true if programs binaries can be cached (ARB_get_program_binary) */
+        bool m_parallelCompileSupported;    /*!< true if the driver compiles shaders in its own threads (KHR_parallel_shader_compile) */
+        std::string m_driverId;             /*!< vendor, renderer and version of the driver, part of the binary cache keys */
+        int m_programCacheHits;             /*!< number of programs loaded from the binary cache */
         GLuint m_programWF;         /*!< handle of the program object (i.e. shaders) for wireframe rendering */
 
         GLuint m_meshVAO;           /*!< mesh VAO (i.e. array in which the generated vertex array object names are stored) */
         GLuint m_defaultVAO;        /*!< default VAO */
 
+        GLuint m_frameUBO;          /*!< uniform buffer of the FrameData block */
+        GLuint m_materialUBO;       /*!< uniform buffer of the MaterialData block */
+        FrameUniforms m_frameUniforms;          /*!< content of m_frameUBO */
+        MaterialUniforms m_materialUniforms;    /*!< content of m_materialUBO */
+        bool m_uniformsUploaded;    /*!< false until the uniform buffers are filled for the first time */
+
+        DrawStats m_drawStats;      /*!< GL calls issued by the last draw() */
+        bool m_timerQuerySupported; /*!< true if the GPU time of draw() can be measured (ARB_timer_query) */
+        GLuint m_timerQueries[2];   /*!< GL_TIME_ELAPSED queries, one being read while the other one is measured */
+        unsigned int m_timerFrame;  /*!< number of draw() measured so far */
+        double m_gpuTime;           /*!< last GPU time read from the queries, in ms */
+
         GLuint m_vertexVBO;         /*!< name of vertex 3D coords VBO */
         GLuint m_normalVBO;         /*!< name of normal vector VBO */
         GLuint m_colorVBO;          /*!< name of rgb color VBO */
@@ -242,10 +579,12 @@ class DrawableMesh //: protected QOpenGLFunctions_3_3_Core
         GLuint m_bitangentVBO;      /*!< name of bitangent vector VBO */
         GLuint m_uvVBO;             /*!< name of UV coords VBO */
         GLuint m_indexVBO;          /*!< name of index VBO */
-        GLuint m_facenormalVBO;     /*!< name of face normal VBO */
+        GLuint m_scalarVBO;         /*!< name of scalar field VBO */
 
         int m_numVertices;          /*!< number of vertices in the VBOs */
         int m_numIndices;           /*!< number of indices in the index VBO */
+        GLenum m_indexType;         /*!< type of the indices in the index VBO (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT) */
+        std::vector<IndexCluster> m_indexClusters;  /*!< ranges of a 16 bits index VBO, one draw call each (empty for 32 bits indices) */
 
         GLuint m_tex;               /*!< name of texture */
         GLuint m_normalMap;         /*!< name of normal map texture */
@@ -253,6 +592,7 @@ class DrawableMesh //: protected QOpenGLFunctions_3_3_Core
         GLuint m_glossMap;          /*!< name of gloss map texture */
         GLuint m_ambientMap;        /*!< name of ambient map texture */
         GLuint m_cubeMap;           /*!< name of cube map texture */
+        GLuint m_colormapTex;       /*!< name of colormap texture (1D array, one layer per colormap) */
 
         float m_specPow;            /*!< specular power */
 
@@ -261,6 +601,12 @@ class DrawableMesh //: protected QOpenGLFunctions_3_3_Core
         glm::vec3 m_specularColor;  /*!< specular color */
 
         glm::vec3 m_wireColor;      /*!< line color for wireframe rendering */
+        float m_wireWidth;          /*!< line width of the single-pass wireframe, in pixels */
+        GLuint m_wireIndexTex;      /*!< buffer texture reading the index VBO (single-pass wireframe) */
+        GLuint m_wirePositionTex;   /*!< buffer texture reading the vertex VBO (single-pass wireframe) */
+
+        glm::vec2 m_scalarRange;    /*!< scalar values mapped to the first and last colormap texels */
+        int m_colormapId;           /*!< index of the colormap used to display the scalar field */
 
         bool m_useAmbient;          /*!< flag to use ambient shading or not */
         bool m_useDiffuse;          /*!< flag to use diffuse shading or not */
@@ -272,6 +618,7 @@ class DrawableMesh //: protected QOpenGLFunctions_3_3_Core
         bool m_useGammaCorrec;      /*!< flag to apply gamma correction or not */
         bool m_useFaceNormals;      /*!< flag to use face normals or not */
         bool m_useMeshCol;          /*!< flag to use mesh color or not */
+        bool m_useScalar;           /*!< flag to display scalar field or not */
 
         bool m_vertexProvided;      /*!< flag to indicate if vertex coords are available or not */
         bool m_normalProvided;      /*!< flag to indicate if normals are available or not */
@@ -280,23 +627,145 @@ class DrawableMesh //: protected QOpenGLFunctions_3_3_Core
         bool m_bitangentProvided;   /*!< flag to indicate if bitangnets are available or not */
         bool m_uvProvided;          /*!< flag to indicate if uv coords are available or not */
         bool m_indexProvided;       /*!< flag to indicate if indices are available or not */
-        bool m_facenormalProvided;   /*!< flag to indicate if face normals are available or not */
+        bool m_scalarProvided;      /*!< flag to indicate if a scalar field is available or not */
 
         bool m_shadedRenderOn;      /*!< flag to indicate if shaded rendering is on */
         bool m_wireframeRenderOn;   /*!< flag to indicate if wireframe rendering is on */
         bool m_wireframeShadingOn;  /*!< flag to indicate if wireframe shading is on */
+        bool m_wireframeSinglePassOn;   /*!< flag to draw the wireframe in the same pass as the surface */
+        bool m_frustumCullingOn;    /*!< flag to cull the meshlets outside the view frustum */
+        bool m_backfaceCullingOn;   /*!< flag to cull the back-facing meshlets */
+
+        std::vector<Meshlet> m_meshlets;            /*!< meshlets of the index VBO, in index order (see IndexOptimizer::buildMeshlets()) */
+        std::vector<char> m_meshletVisible;         /*!< result of the culling of each meshlet, for the current frame */
+        bool m_meshletRunsOn = false;               /*!< true if the current frame draws the runs below instead of the whole index VBO */
+        std::vector<GLsizei> m_runCounts;           /*!< number of indices of each run of consecutive visible meshlets */
+        std::vector<const void*> m_runOffsets;      /*!< offset of each run in the index VBO, in bytes */
+        std::vector<GLint> m_runBaseVertices;       /*!< base vertex of each run */
+
+        bool m_lodOn;                               /*!< flag to draw a level of detail instead of the mesh when the difference is not visible */
+        std::vector<MeshLOD> m_lods;                /*!< levels of detail, from the finest to the coarsest (see setLODs()) */
+        int m_activeLOD = -1;                       /*!< level drawn by the current frame (-1: full resolution mesh) */
+        glm::vec3 m_lodCenter;                      /*!< center of the bounding sphere of the levels, in model space */
+        float m_lodRadius = 0.0f;                   /*!< radius of the bounding sphere of the levels, in model space */
+        float m_lodPixelError = 1.0f;               /*!< largest error of a level on screen, in pixels */
+        int m_viewportHeight = 0;                   /*!< height of the viewport, in pixels */
+
+        std::vector<BufferUpload> m_uploads;                        /*!< arrays being uploaded into new VBOs */
+        std::vector<std::shared_ptr<MeshBuffers> > m_uploadData;    /*!< CPU arrays of the pending upload */
+        std::shared_ptr<MeshRemap> m_uploadRemap;                   /*!< reordering of the pending upload */
+        std::shared_ptr<MeshRemap> m_remap;                         /*!< reordering applied to the buffers of the mesh (see IndexOptimizer) */
+        std::shared_ptr<IndexLayout> m_uploadLayout;                /*!< 16 bits indices and meshlets of the pending upload (null for 32 bits indices) */
+
+        size_t m_vboCapacity[9] = {};       /*!< size of the storage allocated for each VBO, in bytes (one per bit of MeshAttrib) */
+
+        size_t m_streamVertexCapacity = 0;  /*!< number of vertices allocated in the VBOs of the streamed mesh */
+        size_t m_streamIndexCapacity = 0;   /*!< number of indices allocated in the index VBO of the streamed mesh */
 
         /*------------------------------------------------------------------------------------------------------------+
         |                                               OTHER METHODS                                                 |
         +-------------------------------------------------------------------------------------------------------------*/
 
         /*!
-        * \fn load2DTexture
-        * \brief load a 2D image to be used as texture
-        * \param _filename : name of texture image
-        * \param _repeat : repeat (true) or clamptoedge (false)
+        * \fn setVAOAttribs
+        * \brief bind the current VBOs to the attributes of the mesh VAO. 
+        *        Absent attributes (see m_*Provided flags) are disabled, the shader then reads a constant value.
+        */
+        void setVAOAttribs();
+
+        /*!
+        * \fn uploadBuffer
+        * \brief fill the VBO of an attribute, reusing its storage when the data fits 
+        *        (i.e. no reallocation when the size does not change much, e.g. when a mesh is updated)
+        * \param _attrib : attribute (single bit of MeshAttrib)
+        * \param _data : data to upload
+        * \param _nbBytes : size of the data (0 if the attribute is absent: nothing is uploaded)
+        */
+        void uploadBuffer(MeshAttrib _attrib, const void* _data, size_t _nbBytes);
+
+        /*!
+        * \fn getVBOCapacity
+        * \brief get the size of the storage allocated for the VBO of an attribute, in bytes
+        * \param _attrib : attribute (single bit of MeshAttrib)
+        */
+        size_t& getVBOCapacity(MeshAttrib _attrib);
+
+        /*!
+        * \fn growBuffer
+        * \brief reallocate a VBO with a larger size, keeping its content
+        * \param _attrib : attribute whose VBO is grown (the VBO name changes)
+        * \param _usedBytes : number of bytes to keep
+        * \param _newBytes : new size of the VBO
+        */
+        void growBuffer(MeshAttrib _attrib, size_t _usedBytes, size_t _newBytes);
+
+        /*!
+        * \fn drawTriangles
+        * \brief draw all the triangles of the index VBO (one draw call per range of 16 bits indices),
+        *        or of the level of detail selected by selectLOD()
+        * \param _wireClusterLocation : location of the u_wireCluster uniform of the current program (-1 if unused)
+        */
+        void drawTriangles(GLint _wireClusterLocation);
+
+        /*!
+        * \fn cullMeshlets
+        * \brief test the meshlets against the view frustum and the view direction (in parallel), 
+        *        and gather the visible ones into runs drawn by drawTriangles()
+        * \param _mv : modelview matrix
+        * \param _mvp : modelview-projection matrix
+        */
+        void cullMeshlets(const glm::mat4& _mv, const glm::mat4& _mvp);
+
+        /*!
+        * \fn selectLOD
+        * \brief select the coarsest level of detail whose error, projected at the closest point of the mesh, is below m_lodPixelError.
+        *        The full resolution mesh is drawn if the current features need attributes the levels do not provide
+        *        (tangents, scalar field). Flat shading does not, its normals are derived by the fragment shader.
+        * \param _mv : modelview matrix
+        * \param _mvp : modelview-projection matrix
+        */
+        void selectLOD(const glm::mat4& _mv, const glm::mat4& _mvp);
+
+        /*!
+        * \fn getVBO
+        * \brief get the VBO name storing an attribute
+        * \param _attrib : attribute (single bit of MeshAttrib)
+        */
+        GLuint* getVBO(MeshAttrib _attrib);
+
+        /*!
+        * \fn getShaderFeatures
+        * \brief get the bitmask of the Phong shader features required by the current flags (see enum ShaderFeature)
+        */
+        unsigned int getShaderFeatures() const;
+
+        /*!
+        * \fn getPhongProgram
+        * \brief get the program for a combination of features, compiling it on first use
+        * \param _features : bitmask of features (see enum ShaderFeature)
+        * \param _wait : false to only start the compilation (the program is not usable yet)
+        */
+        GLuint getPhongProgram(unsigned int _features, bool _wait = true);
+
+        /*!
+        * \fn updateUniformBuffers
+        * \brief update the uniform buffers whose content changed since the last draw, and bind them
+        */
+        void updateUniformBuffers(const glm::mat4& _mv, const glm::mat4& _mvp, const glm::vec3& _lightPos, const glm::vec3& _lightCol);
+
+        /*!
+        * \fn initProgramUniforms
+        * \brief bind the uniform blocks of a program to their binding points (see enum UniformBinding) 
+        *        and set its texture units, once for all (the location of the only per-draw uniform, u_wireCluster, is cached)
+        * \param _program : linked program
+        */
+        void initProgramUniforms(GLuint _program);
+
+        /*!
+        * \fn createColormapTexture
+        * \brief create the 1D array texture holding all the colormaps (see enum Colormap)
         */
-        GLuint load2DTexture(const std::string& _filename, bool _repeat = false);
+        GLuint createColormapTexture();
 
         /*!
         * \fn readShaderSource
@@ -306,6 +775,80 @@ class DrawableMesh //: protected QOpenGLFunctions_3_3_Core
         */
         std::string readShaderSource(const std::string& _filename); 
         /*!
+        * \fn startShaderProgram
+        * \brief start compiling and linking a program (or load it from the binary cache), without waiting for the result
+        * \param _vertShaderSource : vertex shader source
+        * \param _fragShaderSource : fragment shader source
+        * \param _defines : preprocessor directives inserted after the #version line of both shaders
+        * \return program name, to be checked by finishShaderProgram() before use
+        */
+        GLuint startShaderProgram(const std::string& _vertShaderSource, const std::string& _fragShaderSource, const std::string& _defines = "");
+
+        /*!
+        * \fn isShaderProgramReady
+        * \brief poll a program started by startShaderProgram(), without waiting for the driver
+        * \param _program : program
+        * \return true if finishShaderProgram() will not stall (always false for a pending program without KHR_parallel_shader_compile)
+        */
+        bool isShaderProgramReady(GLuint _program);
+
+        /*!
+        * \fn finishShaderProgram
+        * \brief wait for a program started by startShaderProgram(), check it, store it in the binary cache and set its uniforms
+        * \param _program : program (set to 0 if compilation or linking failed)
+        * \return false if compilation or linking failed
+        */
+        bool finishShaderProgram(GLuint& _program);
+
+        /*!
+        * \fn deleteShaderProgram
+        * \brief delete a program, finished or not
+        */
+        void deleteShaderProgram(GLuint _program);
+
+        /*!
+        * \fn getProgramCacheKey
+        * \brief hash of the shader sources and of the driver identification
+        */
+        std::string getProgramCacheKey(const std::string& _vertShaderSource, const std::string& _fragShaderSource);
+
+        /*!
+        * \fn getProgramCacheFilename
+        * \brief file storing a program binary, in the cache directory of the application
+        */
+        QString getProgramCacheFilename(const std::string& _cacheKey) const;
+
+        /*!
+        * \fn loadProgramBinary
+        * \brief create a program from the binary cache
+        * \return program name, 0 if not in cache or rejected by the driver
+        */
+        GLuint loadProgramBinary(const std::string& _cacheKey);
+
+        /*!
+        * \fn saveProgramBinary
+        * \brief store the binary of a linked program in the cache
+        */
+        void saveProgramBinary(GLuint _program, const std::string& _cacheKey);
+
+        /*!
+        * \fn insertDefines
+        * \brief insert preprocessor directives in a shader source, right after its #version line
+        * \param _source : shader source
+        * \param _defines : directives to insert (one per line)
+        * \return modified source
+        */
+        std::string insertDefines(const std::string& _source, const std::string& _defines);
+
+        /*!
+        * \fn insertUniformBlocks
+        * \brief insert the declaration of the uniform blocks shared by all shaders (see m_uniformBlocksSource),
+        *        right after the #version and #extension directives of a shader source
+        * \param _source : shader source
+        * \return modified source
+        */
+        std::string insertUniformBlocks(const std::string& _source);
+        /*!
         * \fn showShaderInfoLog
         * \brief print out shader info log (i.e. compilation errors)
         * \param _shader : shader
@@ -14,15 +14,41 @@
 
 GLWidget::GLWidget(QWidget* parent) : QOpenGLWidget(parent)
     , m_triMesh(nullptr), m_drawMesh(nullptr)
-{}
+{
+    QObject::connect(&m_jobRunner, &MeshJobRunner::jobFinished, this, &GLWidget::applyMeshJob);
+    m_loadPool.setMaxThreadCount(1);
+    QObject::connect(&m_uploadTimer, &QTimer::timeout, this, &GLWidget::uploadChunk);
+    m_idleTimer.setSingleShot(true);
+    QObject::connect(&m_idleTimer, &QTimer::timeout, this, &GLWidget::endInteraction);
+    QObject::connect(this, &QOpenGLWidget::frameSwapped, this, &GLWidget::frameDisplayed);
+    QObject::connect(&m_textureTimer, &QTimer::timeout, this, &GLWidget::uploadTextureChunk);
+    QObject::connect(&m_textureManager, &TextureManager::textureDecoded, this, [this]() { if (!m_textureTimer.isActive()) m_textureTimer.start(0); });
+}
 
 GLWidget::GLWidget() : QOpenGLWidget()
     , m_triMesh(nullptr), m_drawMesh(nullptr)
-{}
+{
+    QObject::connect(&m_jobRunner, &MeshJobRunner::jobFinished, this, &GLWidget::applyMeshJob);
+    m_loadPool.setMaxThreadCount(1);
+    QObject::connect(&m_uploadTimer, &QTimer::timeout, this, &GLWidget::uploadChunk);
+    m_idleTimer.setSingleShot(true);
+    QObject::connect(&m_idleTimer, &QTimer::timeout, this, &GLWidget::endInteraction);
+    QObject::connect(this, &QOpenGLWidget::frameSwapped, this, &GLWidget::frameDisplayed);
+    QObject::connect(&m_textureTimer, &QTimer::timeout, this, &GLWidget::uploadTextureChunk);
+    QObject::connect(&m_textureManager, &TextureManager::textureDecoded, this, [this]() { if (!m_textureTimer.isActive()) m_textureTimer.start(0); });
+}
 
 
 GLWidget::~GLWidget()
 {
+    // results of a load still running are dropped
+    m_loadId++;
+    m_loadPool.waitForDone();
+    m_textureTimer.stop();
+    makeCurrent();
+    deleteLowResFBO();
+    m_textureManager.clear();
+    doneCurrent();
     m_drawMesh = nullptr;
     m_triMesh = nullptr;
     std::cout << std::endl << "Bye!" << std::endl;
@@ -55,9 +81,23 @@ void GLWidget::initializeGL()
     m_triMesh->readFile("../../models/misc/gargo.obj");
     m_triMesh->computeAABB();
 
+    // programs are compiled by the driver while the buffers of the mesh are built (if KHR_parallel_shader_compile is available)
+    auto shaderStart = std::chrono::high_resolution_clock::now();
     m_drawMesh = std::make_unique<DrawableMesh>();
     m_drawMesh->setProgram("../../src/shaders/phong.vert", "../../src/shaders/phong.frag");
-    m_drawMesh->createVAO(m_triMesh);
+    auto shaderEnd = std::chrono::high_resolution_clock::now();
+    double shaderTime = std::chrono::duration<double, std::milli>(shaderEnd - shaderStart).count();
+
+    m_drawMesh->createVAO();
+    updateMeshBuffers(nullptr);
+
+    // programs still being compiled are finished by the next frames, or waited for on first use
+    shaderStart = std::chrono::high_resolution_clock::now();
+    m_drawMesh->finishPrograms(false);
+    shaderEnd = std::chrono::high_resolution_clock::now();
+    shaderTime += std::chrono::duration<double, std::milli>(shaderEnd - shaderStart).count();
+    qInfo() << "[info] GLWidget::initializeGL: " << shaderTime << " ms spent on shader programs ("
+            << m_drawMesh->getProgramCacheHits() << " loaded from binary cache, " << m_drawMesh->getNbPendingPrograms() << " still compiling)";
 
     m_camera.setFieldOfView(glm::radians(45.0));
 
@@ -71,6 +111,26 @@ void GLWidget::initializeGL()
 
 void GLWidget::paintGL()
 {
+    m_frameStart = std::chrono::high_resolution_clock::now();
+    m_framePending = true;
+
+    // size of the widget framebuffer in device pixels (widget size is in device independent pixels on high DPI screens)
+    m_viewportWidth = std::max((int)(width() * devicePixelRatio()), 1);
+    m_viewportHeight = std::max((int)(height() * devicePixelRatio()), 1);
+
+    // camera moving: reduced resolution (coarser levels of detail are then selected as well)
+    const bool lowRes = m_interacting && m_interactiveOn && m_adaptiveScale > 1.0f && bindLowResFBO();
+    if (lowRes)
+    {
+        glViewport(0, 0, m_lowResWidth, m_lowResHeight);
+        m_drawMesh->setViewportHeight(m_lowResHeight);
+    }
+    else
+    {
+        glViewport(0, 0, m_viewportWidth, m_viewportHeight);
+        m_drawMesh->setViewportHeight(m_viewportHeight);
+    }
+
     glClearColor(m_backCol.redF(), m_backCol.greenF(), m_backCol.blueF(), m_backCol.alphaF());
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -82,12 +142,40 @@ void GLWidget::paintGL()
 
     m_lightPos = m_camera.position();
     m_drawMesh->draw(mv, mvp, m_lightPos, m_lightCol);
+    // programs compiled meanwhile by the driver (e.g. the wireframe one) are finished before their first use
+    m_drawMesh->finishPrograms(false);
+
+    if (lowRes)
+    {
+        // upscale to the widget framebuffer
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_lowResFBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, defaultFramebufferObject());
+        glBlitFramebuffer(0, 0, m_lowResWidth, m_lowResHeight, 0, 0, m_viewportWidth, m_viewportHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+        glViewport(0, 0, m_viewportWidth, m_viewportHeight);
+        m_drawMesh->setViewportHeight(m_viewportHeight);
+    }
+
+    if (m_logFirstFrame)
+    {
+        m_logFirstFrame = false;
+        auto end = std::chrono::high_resolution_clock::now();
+        qInfo() << "[info] GLWidget::paintGL: frame displayed " 
+                << std::chrono::duration<double, std::milli>(end - m_loadStart).count() << " ms after load request";
+        const DrawStats& stats = m_drawMesh->getDrawStats();
+        qInfo() << "[info] GLWidget::paintGL: " << stats.glCalls << " GL calls per frame (" 
+                << stats.drawCalls << " draw calls, " << stats.uniformUpdates << " uniform buffer updates)";
+        logCullingStats();
+    }
+    else if (m_logCulling)
+        logCullingStats();
+    m_logCulling = false;
 
+    emit frameDrawn();
 }
 void GLWidget::resizeGL(int width, int height)
 {
-    glViewport(0, 0, width, height);
-
+    // viewport is set by paintGL(), in device pixels
     m_camera.setScreenWidthAndHeight(width, height);
 }
 
@@ -101,14 +189,17 @@ void GLWidget::mousePressEvent(QMouseEvent* event)
 void GLWidget::wheelEvent(QWheelEvent* const event)
 {
     m_camera.wheelEvent(event);
-    this->update();
+    beginInteraction();
+    requestFrame();
 }
 
 void GLWidget::mouseMoveEvent(QMouseEvent* event)
 {
     m_camera.mouseMoveEvent(event);
 
-    this->update();
+    if (event->buttons() != Qt::NoButton)
+        beginInteraction();
+    requestFrame();
 }
 
 void GLWidget::mouseReleaseEvent(QMouseEvent* /* event */)
@@ -124,19 +215,115 @@ void GLWidget::mouseDoubleClickEvent(QMouseEvent* event )
 }
 
 
+void GLWidget::requestFrame()
+{
+    // (a frame never swapped, e.g. rendered offscreen, does not block the next ones)
+    const double pendingTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_frameStart).count();
+    if (m_framePending && pendingTime < 4.0 * s_targetFrameTime)
+        m_frameRequested = true;
+    else
+        update();
+}
+
+
+void GLWidget::beginInteraction()
+{
+    m_interacting = true;
+    m_idleTimer.start(m_idleDelay);
+}
+
+
+void GLWidget::endInteraction()
+{
+    m_interacting = false;
+    update();
+}
+
+
+void GLWidget::frameDisplayed()
+{
+    m_framePending = false;
+
+    // resolution of the next interactive frames: slow frames are rendered at a lower resolution, fast ones get it back
+    if (m_interacting && m_interactiveOn)
+    {
+        auto end = std::chrono::high_resolution_clock::now();
+        double frameTime = std::chrono::duration<double, std::milli>(end - m_frameStart).count();
+        if (frameTime > s_targetFrameTime)
+            m_adaptiveScale = std::min(1.25f * m_adaptiveScale, s_maxInteractiveScale);
+        else if (frameTime < 0.5 * s_targetFrameTime)
+            m_adaptiveScale = std::max(m_adaptiveScale / 1.1f, (float)m_interactiveScale);
+    }
+
+    if (m_frameRequested)
+    {
+        m_frameRequested = false;
+        update();
+    }
+}
+
+
+bool GLWidget::bindLowResFBO()
+{
+    const int width = std::max((int)(m_viewportWidth / m_adaptiveScale), 1);
+    const int height = std::max((int)(m_viewportHeight / m_adaptiveScale), 1);
+
+    bool create = (m_lowResFBO == 0);
+    if (create)
+    {
+        glGenFramebuffers(1, &m_lowResFBO);
+        glGenRenderbuffers(1, &m_lowResColorRBO);
+        glGenRenderbuffers(1, &m_lowResDepthRBO);
+    }
+    if (create || width != m_lowResWidth || height != m_lowResHeight)
+    {
+        glBindRenderbuffer(GL_RENDERBUFFER, m_lowResColorRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_lowResDepthRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        m_lowResWidth = width;
+        m_lowResHeight = height;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_lowResFBO);
+    if (create)
+    {
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_lowResColorRBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_lowResDepthRBO);
+    }
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        qWarning() << "[Warning] GLWidget::bindLowResFBO: framebuffer incomplete, reduced resolution rendering disabled";
+        glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+        deleteLowResFBO();
+        m_interactiveOn = false;
+        return false;
+    }
+    return true;
+}
+
+
+void GLWidget::deleteLowResFBO()
+{
+    if (m_lowResFBO)
+    {
+        glDeleteFramebuffers(1, &m_lowResFBO);
+        glDeleteRenderbuffers(1, &m_lowResColorRBO);
+        glDeleteRenderbuffers(1, &m_lowResDepthRBO);
+    }
+    m_lowResFBO = m_lowResColorRBO = m_lowResDepthRBO = 0;
+    m_lowResWidth = m_lowResHeight = 0;
+}
+
+
 void GLWidget::loadTriMeshSoup(QString _fileName)
 {
     if (!_fileName.isEmpty())
     {
         qInfo() << "[info] GLWidget::loadTriMeshSoup: Load " <<  _fileName.toStdString();
-        // Load mesh
-        m_triMesh = std::make_shared<TriMeshSoup>();
-        m_triMesh->readFile(_fileName.toStdString());
-        m_drawMesh->updateVAO(m_triMesh);
-        m_drawMesh->setFlatShadingFlag(false);
-        m_triMesh->computeAABB();
-        updateScene();
-        paintGL();
+        loadMesh(_fileName, std::make_shared<TriMeshSoup>());
     }
     else
         qCritical() << "[ERROR] Viewer::loadTriMeshSoup: filename empty";
@@ -148,20 +335,470 @@ void GLWidget::loadTriMeshHE(QString _fileName)
     if (!_fileName.isEmpty())
     {
         qInfo() << "[info] GLWidget::loadTriMeshHE: Load " << _fileName.toStdString();
-        // Load mesh
-        m_triMesh = std::make_shared<TriMeshHE>(true, true, true, true);
-        m_triMesh->readFile(_fileName.toStdString());
-        m_drawMesh->updateVAO(m_triMesh);
-        m_drawMesh->setFlatShadingFlag(false);
-        m_triMesh->computeAABB();
-        updateScene();
-        paintGL();
+        loadMesh(_fileName, std::make_shared<TriMeshHE>());
     }
     else
         qCritical() << "[ERROR] Viewer::loadTriMeshSoup: filename empty";
 }
 
 
+void GLWidget::loadTriMeshCHE(QString _fileName)
+{
+    if (!_fileName.isEmpty())
+    {
+        qInfo() << "[info] GLWidget::loadTriMeshCHE: Load " << _fileName.toStdString();
+        loadMesh(_fileName, std::make_shared<TriMeshCHE>());
+    }
+    else
+        qCritical() << "[ERROR] Viewer::loadTriMeshCHE: filename empty";
+}
+
+
+void GLWidget::loadMesh(QString _fileName, std::shared_ptr<Mesh> _mesh)
+{
+    // a new load replaces the previous one (if still running)
+    const int loadId = ++m_loadId;
+    m_loadedMesh = nullptr;
+    m_uploadTimer.stop();
+    makeCurrent();
+    m_drawMesh->cancelUpload();
+    doneCurrent();
+    restoreMesh();
+    m_loadStart = std::chrono::high_resolution_clock::now();
+
+    std::string fileName = _fileName.toStdString();
+    auto loadStart = m_loadStart;
+
+    // progressive loading: batches of triangles are displayed while the file is parsed
+    std::shared_ptr<TriMeshSoup> soup = std::dynamic_pointer_cast<TriMeshSoup>(_mesh);
+    const bool streamed = m_progressiveLoading && soup && _fileName.endsWith(".obj", Qt::CaseInsensitive);
+    if (streamed)
+    {
+        soup->setStreamCallback(512 * 1024, [this, loadId](std::shared_ptr<MeshBuffers> _batch)
+        {
+            QMetaObject::invokeMethod(this, [this, loadId, _batch]() { appendMeshStream(loadId, _batch); }, Qt::QueuedConnection);
+        });
+    }
+
+    const bool optimizeIndices = m_optimizeIndices;
+    const bool proxyPreview = m_proxyPreview && !streamed;
+    const size_t proxyBudget = (size_t)m_proxyBudget;
+    const float proxyCellSize = m_proxyCellSize;
+
+    m_loadPool.start([this, loadId, fileName, _mesh, soup, streamed, loadStart, optimizeIndices, proxyPreview, proxyBudget, proxyCellSize]()
+    {
+        // 1. parse
+        bool read = _mesh->readFile(fileName);
+        if (streamed)
+            soup->setStreamCallback(0, nullptr);
+        if (!read)
+        {
+            QMetaObject::invokeMethod(this, [this, loadId]() { meshLoaded(loadId, nullptr); }, Qt::QueuedConnection);
+            return;
+        }
+        auto parsed = std::chrono::high_resolution_clock::now();
+
+        // 2. CPU processing: GPU-ready arrays are built by groups, each group being uploaded as soon as it is ready
+        _mesh->computeAABB();
+        const unsigned int geomAttribs = ATTRIB_VERTEX | ATTRIB_NORMAL | ATTRIB_INDEX;
+        std::shared_ptr<MeshBuffers> geomBuffers = std::make_shared<MeshBuffers>();
+        _mesh->getBuffers(*geomBuffers, geomAttribs);
+
+        // large meshes: a coarse proxy is displayed first (posted before the full resolution, which replaces it once uploaded)
+        if (proxyPreview && geomBuffers->indices.size() / 3 > proxyBudget)
+        {
+            const glm::vec3 bBoxMin = _mesh->getBBoxMin();
+            const glm::vec3 bBoxMax = _mesh->getBBoxMax();
+            float cellSize = proxyCellSize * glm::length(bBoxMax - bBoxMin);
+            if (cellSize <= 0.0f)
+                cellSize = VertexClustering::cellSizeForBudget(*geomBuffers, proxyBudget);
+
+            std::shared_ptr<MeshBuffers> proxy = std::make_shared<MeshBuffers>();
+            if (VertexClustering::simplify(*geomBuffers, cellSize, *proxy))
+                QMetaObject::invokeMethod(this, [this, loadId, proxy, bBoxMin, bBoxMax]() { showProxy(loadId, proxy, bBoxMin, bBoxMax); }, Qt::QueuedConnection);
+        }
+
+        // triangles and vertices reordered for the post-transform cache, overdraw and vertex fetch
+        std::shared_ptr<MeshRemap> remap = nullptr;
+        if (optimizeIndices)
+        {
+            remap = std::make_shared<MeshRemap>(IndexOptimizer::optimize(geomBuffers->indices, geomBuffers->vertices));
+            if (!IndexOptimizer::applyRemap(*geomBuffers, *remap))
+                remap = nullptr;
+        }
+        std::shared_ptr<IndexLayout> layout = std::make_shared<IndexLayout>();
+        IndexOptimizer::buildLayout(*geomBuffers, *layout);
+        QMetaObject::invokeMethod(this, [this, loadId, geomBuffers, remap, layout]() { queueMeshUpload(loadId, geomBuffers, geomAttribs, remap, layout); }, Qt::QueuedConnection);
+
+        const unsigned int otherAttribs = ATTRIB_ALL & ~geomAttribs & ~ATTRIB_FACENORMAL;   // face normals are derived by the shader
+        std::shared_ptr<MeshBuffers> otherBuffers = std::make_shared<MeshBuffers>();
+        _mesh->getBuffers(*otherBuffers, otherAttribs);
+        if (remap)
+            IndexOptimizer::applyRemap(*otherBuffers, *remap);
+        QMetaObject::invokeMethod(this, [this, loadId, otherBuffers]() { queueMeshUpload(loadId, otherBuffers, otherAttribs); }, Qt::QueuedConnection);
+
+        auto processed = std::chrono::high_resolution_clock::now();
+        qInfo() << "[info] GLWidget::loadMesh: parsed in " << std::chrono::duration<double, std::milli>(parsed - loadStart).count()
+                << " ms, processed in " << std::chrono::duration<double, std::milli>(processed - parsed).count() << " ms";
+
+        QMetaObject::invokeMethod(this, [this, loadId, _mesh]() { meshLoaded(loadId, _mesh); }, Qt::QueuedConnection);
+    });
+}
+
+
+void GLWidget::queueMeshUpload(int _loadId, std::shared_ptr<MeshBuffers> _buffers, unsigned int _attribs, std::shared_ptr<MeshRemap> _remap,
+                               std::shared_ptr<IndexLayout> _layout)
+{
+    if (_loadId != m_loadId)
+        return;
+
+    makeCurrent();
+    m_drawMesh->queueUpload(_buffers, _attribs, _remap, _layout);
+    doneCurrent();
+
+    // upload while the event loop keeps running (and rendering the current mesh)
+    if (!m_uploadTimer.isActive())
+        m_uploadTimer.start(0);
+}
+
+
+void GLWidget::meshLoaded(int _loadId, std::shared_ptr<Mesh> _mesh)
+{
+    if (_loadId != m_loadId)
+        return;
+
+    if (!_mesh)
+    {
+        qCritical() << "[ERROR] GLWidget::meshLoaded: mesh could not be loaded, current mesh kept";
+        m_uploadTimer.stop();
+        makeCurrent();
+        m_drawMesh->cancelUpload();
+        doneCurrent();
+        restoreMesh();
+        return;
+    }
+
+    m_loadedMesh = _mesh;
+    // swap happens at the end of the upload
+    if (!m_uploadTimer.isActive())
+        m_uploadTimer.start(0);
+}
+
+
+void GLWidget::appendMeshStream(int _loadId, std::shared_ptr<MeshBuffers> _batch)
+{
+    if (_loadId != m_loadId || _batch->vertices.empty())
+        return;
+
+    makeCurrent();
+    if (m_streamedLoadId != _loadId)
+    {
+        // first batch: the partial mesh replaces the current one, camera is set from the first batch
+        m_streamedLoadId = _loadId;
+        showPartialMesh();
+        m_drawMesh->beginStream(2 * _batch->vertices.size(), 2 * _batch->indices.size());
+        m_drawMesh->setFlatShadingFlag(false);
+        m_drawMesh->setUseScalarFlag(false);
+
+        glm::vec3 bBoxMin = _batch->vertices[0];
+        glm::vec3 bBoxMax = _batch->vertices[0];
+        for (const glm::vec3& v : _batch->vertices)
+        {
+            bBoxMin = glm::min(bBoxMin, v);
+            bBoxMax = glm::max(bBoxMax, v);
+        }
+        if (bBoxMin != bBoxMax)
+            m_camera.setSceneBoundingBox(bBoxMin, bBoxMax);
+        m_logFirstFrame = true;
+    }
+    m_drawMesh->appendStream(*_batch);
+    doneCurrent();
+
+    update();
+}
+
+
+void GLWidget::setTex(const QString& _fileName)
+{
+    if (_fileName.isEmpty())
+    {
+        qCritical() << "[ERROR] GLWidget::setTex: filename empty";
+        return;
+    }
+
+    // the current texture is kept until the new one is uploaded (called at once if it is cached)
+    const int requestId = ++m_texRequest;
+    makeCurrent();
+    m_textureManager.request(_fileName, true, [this, requestId](GLuint _texture)
+    {
+        if (requestId != m_texRequest || _texture == 0)
+        {
+            m_textureManager.release(_texture);
+            return;
+        }
+        m_textureManager.release(m_tex);
+        m_tex = _texture;
+        m_drawMesh->setTex(_texture);
+        update();
+        emit texLoaded();
+    });
+    doneCurrent();
+}
+
+
+void GLWidget::setNormalMap(const QString& _fileName)
+{
+    if (_fileName.isEmpty())
+    {
+        qCritical() << "[ERROR] GLWidget::setNormalMap: filename empty";
+        return;
+    }
+
+    const int requestId = ++m_normalMapRequest;
+    makeCurrent();
+    m_textureManager.request(_fileName, true, [this, requestId](GLuint _texture)
+    {
+        if (requestId != m_normalMapRequest || _texture == 0)
+        {
+            m_textureManager.release(_texture);
+            return;
+        }
+        m_textureManager.release(m_normalMap);
+        m_normalMap = _texture;
+        m_drawMesh->setNormalMap(_texture);
+        update();
+        emit normalMapLoaded();
+    });
+    doneCurrent();
+}
+
+
+void GLWidget::uploadTextureChunk()
+{
+    // smaller chunks than meshes: textures are uploaded while the user interacts with the scene
+    const size_t chunkBytes = 8 * 1024 * 1024;
+
+    makeCurrent();
+    size_t remaining = m_textureManager.continueUploads(chunkBytes);
+    doneCurrent();
+    if (remaining == 0)
+        m_textureTimer.stop();
+}
+
+
+void GLWidget::setProgressiveLoading(bool _progressive)
+{
+    m_progressiveLoading = _progressive;
+}
+
+
+void GLWidget::showProxy(int _loadId, std::shared_ptr<MeshBuffers> _proxy, glm::vec3 _bBoxMin, glm::vec3 _bBoxMax)
+{
+    // the upload of the full resolution is queued after the proxy, and must not be canceled by beginStream()
+    if (_loadId != m_loadId || m_drawMesh->isUploadPending())
+        return;
+
+    // the proxy is drawn as a streamed mesh made of a single batch (mesh operations are blocked until the full resolution replaces it)
+    showPartialMesh();
+    makeCurrent();
+    m_drawMesh->beginStream(_proxy->vertices.size(), _proxy->indices.size());
+    m_drawMesh->appendStream(*_proxy);
+    m_drawMesh->setFlatShadingFlag(false);
+    m_drawMesh->setUseScalarFlag(false);
+    doneCurrent();
+
+    if (_bBoxMin != _bBoxMax)
+        m_camera.setSceneBoundingBox(_bBoxMin, _bBoxMax);
+    auto end = std::chrono::high_resolution_clock::now();
+    qInfo() << "[info] GLWidget::showProxy: proxy of " << _proxy->indices.size() / 3 << " triangles ready "
+            << std::chrono::duration<double, std::milli>(end - m_loadStart).count() << " ms after load request";
+    m_logFirstFrame = true;
+    update();
+}
+
+
+void GLWidget::setInteractiveMode(bool _interactive)
+{
+    m_interactiveOn = _interactive;
+    if (!_interactive)
+    {
+        makeCurrent();
+        deleteLowResFBO();
+        doneCurrent();
+    }
+}
+
+
+void GLWidget::setInteractiveScale(int _scale)
+{
+    m_interactiveScale = std::max(_scale, 1);
+    m_adaptiveScale = (float)m_interactiveScale;
+}
+
+
+void GLWidget::setIdleDelay(int _ms)
+{
+    m_idleDelay = std::max(_ms, 0);
+}
+
+
+void GLWidget::setProxyPreview(bool _preview)
+{
+    m_proxyPreview = _preview;
+}
+
+
+void GLWidget::setProxyBudget(int _nbTriangles)
+{
+    m_proxyBudget = std::max(_nbTriangles, 1);
+}
+
+
+void GLWidget::setProxyCellSize(double _percent)
+{
+    m_proxyCellSize = (float)std::max(0.01 * _percent, 0.0);
+}
+
+
+void GLWidget::setIndexOptimization(bool _optimize)
+{
+    m_optimizeIndices = _optimize;
+    // during a load, the setting only applies to the loaded mesh
+    if (!m_triMesh || m_partialMeshShown)
+        return;
+
+    // current mesh: reordered (or restored) in the loading thread, a pending update is superseded
+    updateMeshBuffers(nullptr, _optimize);
+}
+
+
+void GLWidget::updateMeshBuffers(std::shared_ptr<MeshRemap> _remap, bool _optimize)
+{
+    // arrays are copied from the mesh here, then reordered and packed in the loading thread (the current buffers are drawn meanwhile)
+    std::shared_ptr<MeshBuffers> buffers = std::make_shared<MeshBuffers>();
+    m_triMesh->getBuffers(*buffers, ATTRIB_ALL & ~ATTRIB_FACENORMAL);     // face normals are derived by the shader
+    std::shared_ptr<Mesh> mesh = m_triMesh;
+    const int request = ++m_bufferRequest;
+    m_loadPool.start([this, request, mesh, buffers, _remap, _optimize]()
+    {
+        std::shared_ptr<MeshRemap> remap = _optimize ? std::make_shared<MeshRemap>(IndexOptimizer::optimize(buffers->indices, buffers->vertices)) : _remap;
+        if (remap && !IndexOptimizer::applyRemap(*buffers, *remap))
+        {
+            qInfo() << "[info] GLWidget::updateMeshBuffers: mesh topology changed, buffers uploaded without reordering";
+            remap = nullptr;
+        }
+        std::shared_ptr<IndexLayout> layout = std::make_shared<IndexLayout>();
+        IndexOptimizer::buildLayout(*buffers, *layout);
+        QMetaObject::invokeMethod(this, [this, request, mesh, buffers, remap, layout]() { applyMeshBuffers(request, mesh, buffers, remap, layout); }, Qt::QueuedConnection);
+    });
+}
+
+
+void GLWidget::applyMeshBuffers(int _request, std::shared_ptr<Mesh> _mesh, std::shared_ptr<MeshBuffers> _buffers,
+                                std::shared_ptr<MeshRemap> _remap, std::shared_ptr<IndexLayout> _layout)
+{
+    // newer buffers requested, or mesh replaced meanwhile
+    if (_request != m_bufferRequest || _mesh != m_triMesh || m_partialMeshShown)
+        return;
+
+    makeCurrent();
+    m_drawMesh->updateVAO(*_buffers, *_layout, _remap);
+    doneCurrent();
+    update();
+}
+
+
+void GLWidget::uploadChunk()
+{
+    // chunk size: large enough to limit the number of ticks, small enough to keep the GUI responsive
+    const size_t chunkBytes = 32 * 1024 * 1024;
+
+    makeCurrent();
+    size_t remaining = m_drawMesh->continueUpload(chunkBytes);
+    if (remaining > 0 || !m_loadedMesh)
+    {
+        // wait for more data (or for the worker thread to finish)
+        doneCurrent();
+        if (remaining == 0)
+            m_uploadTimer.stop();
+        return;
+    }
+
+    // everything is uploaded: swap meshes
+    m_uploadTimer.stop();
+    m_drawMesh->finishUpload();
+    doneCurrent();
+
+    m_triMesh = m_loadedMesh;
+    m_loadedMesh = nullptr;
+    m_partialMeshShown = false;
+    m_restoreRemap = nullptr;
+    m_drawMesh->setFlatShadingFlag(false);
+    m_drawMesh->setUseScalarFlag(false);
+    updateScene();
+    m_logFirstFrame = true;
+    update();
+
+    const bool halfEdge = std::dynamic_pointer_cast<TriMeshHE>(m_triMesh) || std::dynamic_pointer_cast<TriMeshCHE>(m_triMesh);
+    emit meshReplaced(halfEdge);
+}
+
+
+bool GLWidget::convertMesh(bool _toHalfEdge)
+{
+    if (!isMeshAvailable("Conversion"))
+        return false;
+
+    std::shared_ptr<TriMeshSoup> meshSoup = std::dynamic_pointer_cast<TriMeshSoup>(m_triMesh);
+
+    if (_toHalfEdge)
+    {
+        if (std::dynamic_pointer_cast<TriMeshHE>(m_triMesh))
+            return true;
+
+        // other meshes (e.g. TriMeshCHE) go through a soup first
+        if (!meshSoup)
+        {
+            meshSoup = std::make_shared<TriMeshSoup>();
+            if (!meshSoup->fromMesh(*m_triMesh))
+                return false;
+        }
+
+        std::shared_ptr<TriMeshHE> meshHE = std::make_shared<TriMeshHE>();
+        if (!meshHE->buildFromSoup(*meshSoup))
+        {
+            qCritical() << "[ERROR] GLWidget::convertMesh: conversion to TriMeshHE failed";
+            return false;
+        }
+        m_triMesh = meshHE;
+    }
+    else
+    {
+        if (meshSoup)
+            return true;
+
+        meshSoup = std::make_shared<TriMeshSoup>();
+        if (!meshSoup->fromMesh(*m_triMesh))
+        {
+            qCritical() << "[ERROR] GLWidget::convertMesh: conversion to TriMeshSoup failed";
+            return false;
+        }
+        m_triMesh = meshSoup;
+    }
+
+    // vertices are not duplicated anymore
+    m_triMesh->computeAABB();
+    makeCurrent();
+    m_drawMesh->clearLODs();
+    doneCurrent();
+    updateMeshBuffers(m_drawMesh->getRemap());
+    m_drawMesh->setFlatShadingFlag(false);
+    qInfo() << "[info] GLWidget::convertMesh: converted to " << (_toHalfEdge ? "TriMeshHE" : "TriMeshSoup");
+    update();
+    return true;
+}
+
+
 void GLWidget::saveMesh(QString _fileName)
 {
     if (!_fileName.isEmpty())
@@ -195,15 +832,93 @@ void GLWidget::updateScene()
 }
 
 
-void GLWidget::lapSmooth(int _nbIter, float _factor)
+void GLWidget::updateScalarRange()
+{
+    float minVal = 0.0f, maxVal = 1.0f;
+    m_triMesh->getScalarPercentiles(m_scalarLowPct, m_scalarHighPct, minVal, maxVal);
+    m_drawMesh->setScalarRange(minVal, maxVal);
+}
+
+
+bool GLWidget::startMeshJob(const QString& _name, std::function<void(Mesh&)> _job, bool _scalarOutput)
 {
-    m_triMesh->lapSmooth(_nbIter, _factor);
-    m_drawMesh->updateVAO(m_triMesh);
-    qInfo() << "[info] GLWidget::lapSmooth: Laplacian smoothing applied";
+    // the viewport keeps rendering the current buffers until the job is done
+    if (!isMeshAvailable(_name) || !m_jobRunner.start(_name, m_triMesh, _job))
+        return false;
+
+    m_jobSource = m_triMesh;
+    m_jobScalarOutput = _scalarOutput;
+    m_jobRemap = nullptr;
+    m_jobLODs = nullptr;
+    m_jobReadOnly = false;
+    return true;
+}
+
+
+bool GLWidget::isMeshAvailable(const QString& _name)
+{
+    if (!m_partialMeshShown)
+        return true;
+
+    qWarning() << "[Warning] GLWidget::isMeshAvailable: " << _name << " unavailable while a mesh is being loaded";
+    return false;
+}
+
+
+void GLWidget::showPartialMesh()
+{
+    if (m_partialMeshShown)
+        return;
+
+    // beginStream() drops the reordering of the current buffers
+    m_partialMeshShown = true;
+    m_restoreRemap = m_drawMesh->getRemap();
+    m_restoreFlatShading = m_drawMesh->getFlatShadingFlag();
+    m_restoreUseScalar = m_drawMesh->getUseScalarFlag();
+}
+
+
+void GLWidget::restoreMesh()
+{
+    if (!m_partialMeshShown)
+        return;
+
+    m_partialMeshShown = false;
+    updateMeshBuffers(m_restoreRemap);
+    m_drawMesh->setFlatShadingFlag(m_restoreFlatShading);
+    m_drawMesh->setUseScalarFlag(m_restoreUseScalar);
+    m_restoreRemap = nullptr;
+    updateScene();
+    qInfo() << "[info] GLWidget::restoreMesh: partial mesh replaced by the current mesh";
     update();
 }
 
 
+void GLWidget::lapSmooth(int _nbIter, float _factor)
+{
+    startMeshJob("Laplacian smoothing", [_nbIter, _factor](Mesh& _mesh) { _mesh.lapSmooth(_nbIter, _factor); });
+}
+
+
+void GLWidget::decimate(float _ratio)
+{
+    // the topology changes: the reordering of the buffers is computed in the worker thread as well
+    std::shared_ptr<MeshRemap> remap = m_optimizeIndices ? std::make_shared<MeshRemap>() : nullptr;
+    if (startMeshJob("Decimation", [_ratio, remap](Mesh& _mesh)
+        {
+            if (_mesh.decimate(_ratio) >= 0.0f && remap)
+            {
+                MeshBuffers buffers;
+                _mesh.getBuffers(buffers, ATTRIB_VERTEX | ATTRIB_INDEX);
+                *remap = IndexOptimizer::optimize(buffers.indices, buffers.vertices);
+            }
+        }))
+    {
+        m_jobRemap = remap;
+    }
+}
+
+
 
 /*------------------------------------------------------------------------------------------------------------+
 |                                                  SLOTS                                                      |
@@ -227,6 +942,129 @@ void GLWidget::toggleShadingLines()
     update();
 }
 
+void GLWidget::toggleSinglePassLines()
+{
+    // GPU time of the mode being left, to compare both modes on the same view
+    const DrawStats& stats = m_drawMesh->getDrawStats();
+    if (stats.gpuTime >= 0.0)
+        qInfo() << "[info] GLWidget::toggleSinglePassLines: " << (m_drawMesh->getWireframeSinglePassFlag() ? "single-pass" : "line pass")
+                << " wireframe: " << stats.gpuTime << " ms per frame (GPU), " << m_drawMesh->getNbTriangles() << " triangles";
+
+    m_drawMesh->toggleWireframeSinglePassFlag();
+    update();
+}
+
+void GLWidget::toggleFrustumCulling()
+{
+    // statistics are logged once the next frame is drawn with the new option
+    m_logCulling = true;
+    m_drawMesh->toggleFrustumCullingFlag();
+    update();
+}
+
+void GLWidget::toggleBackfaceCulling()
+{
+    m_logCulling = true;
+    m_drawMesh->toggleBackfaceCullingFlag();
+    update();
+}
+
+void GLWidget::toggleLOD()
+{
+    m_logCulling = true;
+    m_drawMesh->toggleLODFlag();
+    update();
+}
+
+void GLWidget::buildLODs()
+{
+    // each level is decimated from the previous one: its error is bounded by the sum of the errors of the successive decimations
+    const int nbLevels = 4;
+    const bool optimizeIndices = m_optimizeIndices;
+    std::shared_ptr<std::vector<LODBuffers> > lods = std::make_shared<std::vector<LODBuffers> >();
+    if (startMeshJob("Levels of detail", [lods, optimizeIndices, nbLevels](Mesh& _mesh)
+        {
+            float error = 0.0f;
+            for (int l = 0; l < nbLevels; l++)
+            {
+                float levelError = _mesh.decimate(0.5f);
+                if (levelError < 0.0f)
+                    return;     // not available, or canceled
+                error += levelError;
+
+                LODBuffers level;
+                _mesh.getBuffers(level.buffers, ATTRIB_VERTEX | ATTRIB_NORMAL | ATTRIB_TEXCOORD | ATTRIB_COLOR | ATTRIB_INDEX);
+                if (optimizeIndices)
+                    IndexOptimizer::applyRemap(level.buffers, IndexOptimizer::optimize(level.buffers.indices, level.buffers.vertices));
+                IndexOptimizer::packIndices16(level.buffers.indices, level.layout.indices16, level.layout.clusters);
+                level.error = error;
+                lods->push_back(std::move(level));
+            }
+        }))
+    {
+        m_jobLODs = lods;
+    }
+}
+
+void GLWidget::benchmarkHalfEdge()
+{
+    const unsigned int nbIter = 10;
+    if (startMeshJob("Half-edge benchmark", [nbIter](Mesh& _mesh)
+        {
+            // both structures are built from the same welded soup, and run the same operations
+            TriMeshSoup soup;
+            if (!soup.fromMesh(_mesh))
+                return;
+            TriMeshHE meshHE;
+            TriMeshCHE meshCHE;
+
+            auto timeOps = [nbIter, &soup](auto& _halfEdge, double _times[3])
+            {
+                auto t0 = std::chrono::high_resolution_clock::now();
+                if (!_halfEdge.buildFromSoup(soup))
+                    return false;
+                auto t1 = std::chrono::high_resolution_clock::now();
+                _halfEdge.lapSmooth(nbIter, 1.0f);
+                auto t2 = std::chrono::high_resolution_clock::now();
+                _halfEdge.computeMeanCurv();
+                auto t3 = std::chrono::high_resolution_clock::now();
+
+                _times[0] = std::chrono::duration<double, std::milli>(t1 - t0).count();
+                _times[1] = std::chrono::duration<double, std::milli>(t2 - t1).count();
+                _times[2] = std::chrono::duration<double, std::milli>(t3 - t2).count();
+                return true;
+            };
+
+            double timesHE[3], timesCHE[3];
+            if (!timeOps(meshHE, timesHE) || !timeOps(meshCHE, timesCHE))
+            {
+                qWarning() << "[Warning] GLWidget::benchmarkHalfEdge: half-edge structures cannot be built from this mesh";
+                return;
+            }
+
+            const char* opNames[3] = { "build from soup", "lapSmooth", "computeMeanCurv" };
+            qInfo() << "[info] GLWidget::benchmarkHalfEdge: " << meshCHE.nbVertices() << " vertices, " << meshCHE.nbFaces()
+                    << " faces, " << nbIter << " smoothing iterations";
+            for (int op = 0; op < 3; op++)
+                qInfo() << "[info] GLWidget::benchmarkHalfEdge: " << opNames[op] << ": TriMeshHE " << timesHE[op] << " ms, TriMeshCHE "
+                        << timesCHE[op] << " ms (x" << timesHE[op] / std::max(timesCHE[op], 1e-3) << ")";
+        }))
+    {
+        m_jobReadOnly = true;
+    }
+}
+
+void GLWidget::logCullingStats()
+{
+    const DrawStats& stats = m_drawMesh->getDrawStats();
+    qInfo() << "[info] GLWidget::logCullingStats: " << stats.meshletsDrawn << " meshlets drawn, " 
+            << stats.meshletsFrustumCulled << " outside the frustum, " << stats.meshletsBackfaceCulled << " back-facing";
+    if (stats.lod > 0)
+        qInfo() << "[info] GLWidget::logCullingStats: level of detail " << stats.lod << " drawn";
+    if (stats.gpuTime >= 0.0)
+        qInfo() << "[info] GLWidget::logCullingStats: " << stats.gpuTime << " ms per frame (GPU)";
+}
+
 void GLWidget::toggleAmbient()
 {
     // Reverse state of ambient flag
@@ -295,41 +1133,136 @@ void GLWidget::toggleMeshCol()
     update();
 }
 
+void GLWidget::toggleScalarField()
+{
+    // Reverse state of scalar field rendering flag
+    m_drawMesh->setUseScalarFlag(!m_drawMesh->getUseScalarFlag());
+    update();
+}
+
+void GLWidget::setColormap(int _colormapId)
+{
+    // only a uniform changes, no VBO update needed
+    m_drawMesh->setColormap(_colormapId);
+    update();
+}
+
+void GLWidget::setScalarPercentiles(double _lowPct, double _highPct)
+{
+    m_scalarLowPct = (float)_lowPct;
+    m_scalarHighPct = (float)_highPct;
+    // only a uniform changes, no VBO update needed
+    updateScalarRange();
+    update();
+}
+
 void GLWidget::duplVertices()
 {
+    if (!isMeshAvailable("Vertex duplication"))
+        return;
+
     m_triMesh->duplicateVertices();
-    m_drawMesh->updateVAO(m_triMesh);
-    update();
+    makeCurrent();
+    m_drawMesh->clearLODs();
+    doneCurrent();
+    updateMeshBuffers(m_drawMesh->getRemap());
 }
 
 void GLWidget::compNormals()
 {
-    m_triMesh->computeNormals();
-    m_drawMesh->updateVAO(m_triMesh);
-    update();
+    NormalWeighting weighting = m_normalWeighting;
+    startMeshJob("Normals", [weighting](Mesh& _mesh)
+    {
+        _mesh.setNormalWeighting(weighting);
+        _mesh.computeNormals();
+    });
+}
+
+void GLWidget::setNormalWeighting(int _weighting)
+{
+    m_normalWeighting = (NormalWeighting)_weighting;
 }
 
 void GLWidget::compTBs()
 {
-    m_triMesh->computeTB();
-    m_drawMesh->updateVAO(m_triMesh);
-    update();
+    startMeshJob("Tangents and bitangents", [](Mesh& _mesh) { _mesh.computeTB(); });
 }
 
 
 void GLWidget::compMeanCurv()
 {
-    m_triMesh->computeMeanCurv();
-    m_drawMesh->updateVAO(m_triMesh);
-    update();
+    startMeshJob("Mean curvature", [](Mesh& _mesh) { _mesh.computeMeanCurv(); }, true);
 }
 
 void GLWidget::compSurfVar()
 {
-    m_triMesh->computeSurfVar();
-    m_drawMesh->updateVAO(m_triMesh);
-    update();
+    startMeshJob("Surface variation", [](Mesh& _mesh) { _mesh.computeSurfVar(); }, true);
 }
 
 
+void GLWidget::applyMeshJob(QString _name, bool _canceled)
+{
+    std::shared_ptr<Mesh> result = m_jobRunner.takeResult();
+    std::shared_ptr<Mesh> source = std::move(m_jobSource);
+    std::shared_ptr<MeshRemap> remap = std::move(m_jobRemap);
+    std::shared_ptr<std::vector<LODBuffers> > lods = std::move(m_jobLODs);
 
+    if (_canceled || !result)
+    {
+        qInfo() << "[info] GLWidget::applyMeshJob: " << _name << " canceled, mesh unchanged";
+        return;
+    }
+    // the job has logged its results, its copy of the mesh is dropped
+    if (m_jobReadOnly)
+    {
+        qInfo() << "[info] GLWidget::applyMeshJob: " << _name << " finished, mesh unchanged";
+        return;
+    }
+    // another mesh has been loaded meanwhile
+    if (source != m_triMesh)
+    {
+        qWarning() << "[Warning] GLWidget::applyMeshJob: mesh changed during " << _name << ", result discarded";
+        return;
+    }
+    // a mesh is being loaded: the displayed buffers are not the ones of m_triMesh
+    if (m_partialMeshShown)
+    {
+        qWarning() << "[Warning] GLWidget::applyMeshJob: a mesh is being loaded, result of " << _name << " discarded";
+        return;
+    }
+
+    if (lods)
+    {
+        // the job only used its copy of the mesh to build the levels: the mesh is unchanged
+        makeCurrent();
+        m_drawMesh->setLODs(*lods);
+        doneCurrent();
+        qInfo() << "[info] GLWidget::applyMeshJob: " << _name << " applied, " << m_drawMesh->getNbLODs() << " levels";
+        update();
+        return;
+    }
+
+    // swap meshes, then upload the new buffers once
+    m_triMesh = result;
+    makeCurrent();
+    if (m_jobScalarOutput)
+    {
+        // only the scalar field VBO needs to be refreshed
+        m_drawMesh->updateScalars(m_triMesh);
+        updateScalarRange();
+        m_drawMesh->setUseScalarFlag(true);
+    }
+    else
+    {
+        // levels of detail were built from the previous version of the mesh
+        m_drawMesh->clearLODs();
+        updateMeshBuffers((remap && !remap->indices.empty()) ? remap : m_drawMesh->getRemap());
+    }
+    doneCurrent();
+
+    qInfo() << "[info] GLWidget::applyMeshJob: " << _name << " applied";
+    update();
+
+    if (m_jobScalarOutput)
+        emit scalarFieldComputed();
+}
@@ -19,12 +19,20 @@
 #include "drawablemesh.h"
 #include "trimeshsoup.h"
 #include "trimeshhe.h"
+#include "trimeshche.h"
+#include "meshjobrunner.h"
+#include "vertexclustering.h"
+#include "texturemanager.h"
 
 #include "QGLtoolkit/camera.h"
 
 
 #include <QOpenGLWidget>
 #include <QMouseEvent>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <chrono>
 
 //#include <QOpenGLFunctions>
 //#include <QOpenGLBuffer>
@@ -47,6 +55,16 @@ public:
     GLWidget();
     ~GLWidget();
 
+    /*!
+    * \fn loadMesh
+    * \brief load a mesh from a file in background: parsing and CPU processing run in a worker thread,
+    *        arrays are then uploaded to the GPU by chunks while the current mesh is still displayed,
+    *        and the new mesh is swapped in once fully uploaded
+    * \param _fileName: mesh file
+    * \param _mesh: empty mesh of the requested type, filled in the worker thread
+    */
+    void loadMesh(QString _fileName, std::shared_ptr<Mesh> _mesh);
+
     /*!
     * \fn loadTriMeshSoup
     * \brief load a TriMeshSoup from a file
@@ -59,6 +77,21 @@ public:
     */
     void loadTriMeshHE(QString _fileName);
 
+    /*!
+    * \fn loadTriMeshCHE
+    * \brief load a TriMeshCHE from a file
+    */
+    void loadTriMeshCHE(QString _fileName);
+
+    /*!
+    * \fn convertMesh
+    * \brief convert the current mesh in place (i.e. without reloading the file) 
+    *        to a TriMeshHE (e.g. for curvature and smoothing) or to a TriMeshSoup
+    * \param _toHalfEdge: true to convert to a TriMeshHE, false to convert to a TriMeshSoup
+    * \return false if the conversion failed (the current mesh is then kept)
+    */
+    bool convertMesh(bool _toHalfEdge);
+
     /*!
     * \fn saveMesh
     * \brief save the current Mesh into a file
@@ -67,6 +100,32 @@ public:
 
 signals:
     void clicked();
+    /*!
+    * \fn scalarFieldComputed
+    * \brief SIGNAL: a scalar field (e.g. curvature) has been computed and is displayed
+    */
+    void scalarFieldComputed();
+    /*!
+    * \fn meshReplaced
+    * \brief SIGNAL: a loaded mesh has been fully uploaded and replaces the current one
+    * \param _halfEdge : true if the new mesh is a half-edge mesh (TriMeshHE or TriMeshCHE)
+    */
+    void meshReplaced(bool _halfEdge);
+    /*!
+    * \fn texLoaded
+    * \brief SIGNAL: a texture requested by setTex() has been uploaded and is used by the mesh
+    */
+    void texLoaded();
+    /*!
+    * \fn normalMapLoaded
+    * \brief SIGNAL: a normal map requested by setNormalMap() has been uploaded and is used by the mesh
+    */
+    void normalMapLoaded();
+    /*!
+    * \fn frameDrawn
+    * \brief SIGNAL: a frame has been drawn, its statistics are given by getDrawStats()
+    */
+    void frameDrawn();
 
 protected:
 
@@ -95,10 +154,221 @@ private:
     std::shared_ptr<Mesh> m_triMesh = nullptr;
     std::unique_ptr<DrawableMesh> m_drawMesh = nullptr;
 
+    MeshJobRunner m_jobRunner;                  /*!< runs long mesh operations in a worker thread */
+    std::shared_ptr<Mesh> m_jobSource = nullptr; /*!< mesh the running job has been started on */
+    bool m_jobScalarOutput = false;             /*!< true if the running job only computes a scalar field */
+    std::shared_ptr<MeshRemap> m_jobRemap = nullptr;            /*!< reordering computed by the running job for its result (if its topology changes) */
+    std::shared_ptr<std::vector<LODBuffers> > m_jobLODs = nullptr;  /*!< levels of detail built by the running job (the mesh is then unchanged) */
+    bool m_jobReadOnly = false;                 /*!< true if the running job only reads its copy of the mesh (the mesh is then unchanged) */
+
+    TextureManager m_textureManager;            /*!< decodes and uploads textures in background, shares them between meshes */
+    QTimer m_textureTimer;                      /*!< uploads a chunk of the decoded textures at each tick */
+    GLuint m_tex = 0;                           /*!< texture used by m_drawMesh (reference held on TextureManager) */
+    GLuint m_normalMap = 0;                     /*!< normal map used by m_drawMesh (reference held on TextureManager) */
+    int m_texRequest = 0;                       /*!< id of the last texture request (older ones are ignored when ready) */
+    int m_normalMapRequest = 0;                 /*!< id of the last normal map request */
+
+    QThreadPool m_loadPool;                     /*!< worker thread parsing and processing loaded meshes */
+    QTimer m_uploadTimer;                       /*!< uploads a chunk of the loaded mesh at each tick */
+    int m_loadId = 0;                           /*!< id of the last requested load (results of older loads are ignored) */
+    std::shared_ptr<Mesh> m_loadedMesh = nullptr; /*!< loaded mesh waiting for the end of its upload */
+    std::chrono::high_resolution_clock::time_point m_loadStart; /*!< time of the last load request */
+    bool m_logFirstFrame = false;               /*!< true to log time-to-first-frame at next paintGL() */
+    bool m_logCulling = false;                  /*!< true to log the culling statistics at next paintGL() (after a culling option changed) */
+    bool m_progressiveLoading = false;          /*!< true to display OBJ soups while they are parsed (see TriMeshSoup::setStreamCallback()) */
+    int m_streamedLoadId = 0;                   /*!< id of the load currently streamed to DrawableMesh */
+    bool m_partialMeshShown = false;            /*!< true while DrawableMesh displays a streamed mesh or a proxy instead of m_triMesh */
+    std::shared_ptr<MeshRemap> m_restoreRemap = nullptr; /*!< reordering of the buffers of m_triMesh, restored by restoreMesh() */
+    bool m_restoreFlatShading = false;          /*!< flat shading flag of m_triMesh, restored by restoreMesh() */
+    bool m_restoreUseScalar = false;            /*!< scalar field flag of m_triMesh, restored by restoreMesh() */
+    bool m_optimizeIndices = true;              /*!< true to reorder triangles and vertices of loaded meshes for the GPU (see IndexOptimizer) */
+    int m_bufferRequest = 0;                    /*!< id of the last update of the buffers of the current mesh (see updateMeshBuffers()) */
+    bool m_proxyPreview = true;                 /*!< true to display a coarse proxy of large meshes while the full resolution is processed and uploaded (see VertexClustering) */
+    int m_proxyBudget = 500000;                 /*!< number of triangles targeted by the proxy (meshes below this size are not previewed) */
+    float m_proxyCellSize = 0.0f;               /*!< cell size of the proxy, relative to the bounding box diagonal (0 to derive it from m_proxyBudget) */
+
+    bool m_interactiveOn = true;                /*!< true to render at reduced resolution while the camera moves */
+    bool m_interacting = false;                 /*!< true while the camera moves (until it has been idle for m_idleDelay) */
+    QTimer m_idleTimer;                         /*!< restores full quality once the camera is idle */
+    int m_idleDelay = 300;                      /*!< idle time (ms) before full quality is restored */
+    int m_interactiveScale = 2;                 /*!< minimal resolution divisor of interactive frames (set by the user) */
+    float m_adaptiveScale = 2.0f;               /*!< current resolution divisor of interactive frames, raised when frames are too slow */
+    bool m_framePending = false;                /*!< true from paintGL() until the frame is swapped */
+    bool m_frameRequested = false;              /*!< true if a camera move requested a frame while another one was pending */
+    std::chrono::high_resolution_clock::time_point m_frameStart; /*!< start of the last paintGL() */
+    int m_viewportWidth = 0;                    /*!< size of the widget framebuffer, in device pixels */
+    int m_viewportHeight = 0;
+    GLuint m_lowResFBO = 0;                     /*!< reduced resolution framebuffer of interactive frames, upscaled to the widget framebuffer */
+    GLuint m_lowResColorRBO = 0;
+    GLuint m_lowResDepthRBO = 0;
+    int m_lowResWidth = 0;                      /*!< size of the reduced resolution framebuffer */
+    int m_lowResHeight = 0;
+    static constexpr float s_maxInteractiveScale = 8.0f;    /*!< maximal resolution divisor of interactive frames */
+    static constexpr double s_targetFrameTime = 1000.0 / 30.0;  /*!< duration (ms) above which interactive frames are rendered at a lower resolution (heuristic threshold) */
+
     QColor m_backCol = Qt::black;
     glm::vec3 m_lightPos = { 0.0f, 0.0f, 0.0f };
     glm::vec3 m_lightCol = { 1.0f, 1.0f, 1.0f };
 
+    float m_scalarLowPct = 0.0f;    /*!< percentile of the scalar field mapped to the first colormap texel */
+    float m_scalarHighPct = 0.95f;  /*!< percentile of the scalar field mapped to the last colormap texel (ignore 5% of outliers) */
+
+    NormalWeighting m_normalWeighting = NORMAL_WEIGHT_UNIFORM;  /*!< weighting of face normals used when recomputing normals */
+
+    /*!
+    * \fn updateScalarRange
+    * \brief compute scalar range from current percentiles and send it to DrawableMesh
+    */
+    void updateScalarRange();
+
+    /*!
+    * \fn logCullingStats
+    * \brief log the meshlets drawn and culled by the last frame (i.e. with the current culling options)
+    */
+    void logCullingStats();
+
+    /*!
+    * \fn requestFrame
+    * \brief schedule a frame after a camera move: moves received while a frame is pending are coalesced
+    *        into the next one, which is requested once the pending frame has been swapped (i.e. at most one frame per vsync)
+    */
+    void requestFrame();
+
+    /*!
+    * \fn beginInteraction
+    * \brief the camera moves: switch to reduced resolution (if activated) and restart the idle timer
+    */
+    void beginInteraction();
+
+    /*!
+    * \fn endInteraction
+    * \brief the camera has been idle for m_idleDelay: render again at full resolution
+    */
+    void endInteraction();
+
+    /*!
+    * \fn frameDisplayed
+    * \brief (connected to QOpenGLWidget::frameSwapped) adapt the resolution of interactive frames to their duration,
+    *        and render the frame requested while the last one was pending (if any)
+    */
+    void frameDisplayed();
+
+    /*!
+    * \fn bindLowResFBO
+    * \brief bind the reduced resolution framebuffer (created or resized to the current resolution divisor)
+    * \return false if the framebuffer is incomplete (frames are then rendered at full resolution)
+    */
+    bool bindLowResFBO();
+
+    /*!
+    * \fn deleteLowResFBO
+    * \brief delete the reduced resolution framebuffer (GL context must be current)
+    */
+    void deleteLowResFBO();
+
+    /*!
+    * \fn startMeshJob
+    * \brief run an operation on (a copy of) the current mesh in a worker thread, see MeshJobRunner
+    * \param _name : name of the operation
+    * \param _job : operation to apply
+    * \param _scalarOutput : true if the operation only computes a scalar field (only scalars are uploaded)
+    * \return false if another job is running, or if a mesh is being loaded (see isMeshAvailable())
+    */
+    bool startMeshJob(const QString& _name, std::function<void(Mesh&)> _job, bool _scalarOutput = false);
+
+    /*!
+    * \fn isMeshAvailable
+    * \brief check that m_drawMesh displays m_triMesh, i.e. that no streamed mesh or proxy is shown during a load
+    *        (an operation on m_triMesh would upload it over the partial mesh)
+    * \param _name : name of the operation (logged if it is refused)
+    * \return false if the operation must be refused
+    */
+    bool isMeshAvailable(const QString& _name);
+
+    /*!
+    * \fn showPartialMesh
+    * \brief (GUI thread) a streamed mesh or a proxy is about to replace the buffers of m_triMesh: save what restoreMesh() needs
+    */
+    void showPartialMesh();
+
+    /*!
+    * \fn restoreMesh
+    * \brief (GUI thread) upload m_triMesh again if a streamed mesh or a proxy replaced it, when its load fails or is superseded
+    *        (levels of detail are not restored)
+    */
+    void restoreMesh();
+
+    /*!
+    * \fn queueMeshUpload
+    * \brief (GUI thread) queue arrays of the mesh being loaded for upload, and start uploading them
+    * \param _loadId: id of the load the arrays belong to
+    * \param _buffers: arrays to upload
+    * \param _attribs: bitmask of attributes to upload from _buffers
+    * \param _remap: reordering applied to _buffers (nullptr if none)
+    * \param _layout: 16 bits indices and meshlets of _buffers (nullptr if no index is uploaded)
+    */
+    void queueMeshUpload(int _loadId, std::shared_ptr<MeshBuffers> _buffers, unsigned int _attribs, std::shared_ptr<MeshRemap> _remap = nullptr,
+                         std::shared_ptr<IndexLayout> _layout = nullptr);
+
+    /*!
+    * \fn meshLoaded
+    * \brief (GUI thread) the worker thread is done with the mesh: swap it in once its upload is finished
+    * \param _loadId: id of the load
+    * \param _mesh: loaded mesh (nullptr if the file could not be read)
+    */
+    void meshLoaded(int _loadId, std::shared_ptr<Mesh> _mesh);
+
+    /*!
+    * \fn appendMeshStream
+    * \brief (GUI thread) display a new batch of triangles of the mesh being parsed (progressive loading)
+    * \param _loadId: id of the load the batch belongs to
+    * \param _batch: new vertices and triangles
+    */
+    void appendMeshStream(int _loadId, std::shared_ptr<MeshBuffers> _batch);
+
+    /*!
+    * \fn showProxy
+    * \brief Display the proxy of the mesh being loaded (called in the GUI thread before the upload of the full resolution is queued,
+    *        which replaces the proxy once finished, see restoreMesh() if the load fails)
+    * \param _loadId : id of the load the proxy belongs to (ignored if a newer load has been requested)
+    * \param _proxy : simplified positions, normals and indices (see VertexClustering::simplify())
+    * \param _bBoxMin : min point of the bounding box of the full resolution mesh
+    * \param _bBoxMax : max point of the bounding box of the full resolution mesh
+    */
+    void showProxy(int _loadId, std::shared_ptr<MeshBuffers> _proxy, glm::vec3 _bBoxMin, glm::vec3 _bBoxMax);
+
+    /*!
+    * \fn updateMeshBuffers
+    * \brief (GUI thread) upload the buffers of m_triMesh once modified: arrays are copied, then reordered and packed
+    *        in the loading thread, and uploaded by applyMeshBuffers() (the previous buffers are drawn meanwhile)
+    * \param _remap : reordering to apply (dropped if computed for another topology), nullptr for the mesh order
+    * \param _optimize : true to compute a new reordering instead of _remap (see IndexOptimizer::optimize())
+    */
+    void updateMeshBuffers(std::shared_ptr<MeshRemap> _remap, bool _optimize = false);
+
+    /*!
+    * \fn applyMeshBuffers
+    * \brief (GUI thread) upload the buffers prepared by updateMeshBuffers()
+    * \param _request : id of the request (ignored if newer buffers have been requested since)
+    * \param _mesh : mesh the buffers have been built from (ignored if it is not the current mesh anymore)
+    * \param _buffers : arrays of the mesh, reordered
+    * \param _remap : reordering applied to _buffers (nullptr if none)
+    * \param _layout : 16 bits indices and meshlets of _buffers
+    */
+    void applyMeshBuffers(int _request, std::shared_ptr<Mesh> _mesh, std::shared_ptr<MeshBuffers> _buffers,
+                          std::shared_ptr<MeshRemap> _remap, std::shared_ptr<IndexLayout> _layout);
+
+    /*!
+    * \fn uploadTextureChunk
+    * \brief (GUI thread) upload the next chunk of the decoded textures, textures fully uploaded are applied to DrawableMesh
+    */
+    void uploadTextureChunk();
+
+    /*!
+    * \fn uploadChunk
+    * \brief (GUI thread) upload the next chunk of the loaded mesh, and swap it in once complete
+    */
+    void uploadChunk();
 
 
 public:
@@ -179,42 +449,43 @@ public:
 
     /*!
     * \fn setTex
-    * \brief get texture file and send it to DrawableMesh
+    * \brief load a texture file in background (see TextureManager), DrawableMesh uses it once uploaded
     */
-    inline void setTex(const QString& _fileName)
-    {
-        if (!_fileName.isEmpty())
-        {
-            // Load texture
-            m_drawMesh->loadTex(_fileName.toStdString());
-        }
-        else
-            qCritical() << "[ERROR] Viewer::setTex: filename empty";
-    }
+    void setTex(const QString& _fileName);
 
     /*!
     * \fn setNormalMap
-    * \brief get normal map file and send it to DrawableMesh
+    * \brief load a normal map file in background (see TextureManager), DrawableMesh uses it once uploaded
     */
-    inline void setNormalMap(const QString& _fileName)
-    {
-        if (!_fileName.isEmpty())
-        {
-            // Load normal map
-            m_drawMesh->loadNormalMap(_fileName.toStdString());
-        }
-        else
-            qCritical() << "[ERROR] Viewer::setNormalMap: filename empty";
-    }
+    void setNormalMap(const QString& _fileName);
+
+    /*!
+    * \fn getJobRunner
+    * \brief get the runner of background mesh operations (e.g. to follow their progress)
+    */
+    inline MeshJobRunner* getJobRunner() { return &m_jobRunner; }
+
+    /*!
+    * \fn getDrawStats
+    * \brief get the number of GL calls issued to draw the last frame
+    */
+    inline const DrawStats& getDrawStats() const { return m_drawMesh->getDrawStats(); }
 
     /*!
     * \fn lapSmooth
-    * \brief Laplacian smoothing of the mesh
+    * \brief Laplacian smoothing of the mesh (in background)
     * \param _nbIter: number of iterations
     * \param _factor: factor applied to the Laplacian vector
     */
     void lapSmooth(int _nbIter, float _factor);
 
+    /*!
+    * \fn decimate
+    * \brief simplification of the mesh (in background, TriMeshHE only)
+    * \param _ratio: fraction of the triangles to keep
+    */
+    void decimate(float _ratio);
+
     public slots:
 
         /*------------------------------------------------------------------------------------------------------------+
@@ -237,6 +508,37 @@ public:
         */
         void toggleShadingLines();
         /*!
+        * \fn toggleSinglePassLines
+        * \brief SLOT: switch between single-pass wireframe and line pass
+        */
+        void toggleSinglePassLines();
+        /*!
+        * \fn toggleFrustumCulling
+        * \brief SLOT: activate/deactivate the culling of meshlets outside the view frustum
+        */
+        void toggleFrustumCulling();
+        /*!
+        * \fn toggleBackfaceCulling
+        * \brief SLOT: activate/deactivate the culling of back-facing meshlets
+        */
+        void toggleBackfaceCulling();
+        /*!
+        * \fn toggleLOD
+        * \brief SLOT: activate/deactivate the rendering of levels of detail
+        */
+        void toggleLOD();
+        /*!
+        * \fn buildLODs
+        * \brief SLOT: build levels of detail of the mesh (in background, TriMeshHE only), each one with half the triangles of the previous one
+        */
+        void buildLODs();
+        /*!
+        * \fn benchmarkHalfEdge
+        * \brief SLOT: compare the run times of TriMeshHE (OpenMesh) and TriMeshCHE (compact half-edges) on the current mesh (in background):
+        *        both are built from the same soup, then smoothed and their mean curvature computed. The mesh is unchanged
+        */
+        void benchmarkHalfEdge();
+        /*!
         * \fn toggleAmbient
         * \brief SLOT: activate/deactivate ambient shading
         */
@@ -292,6 +594,25 @@ public:
         */
         void toggleMeshCol();
 
+        /*!
+        * \fn toggleScalarField
+        * \brief SLOT: activate/deactivate scalar field rendering
+        */
+        void toggleScalarField();
+        /*!
+        * \fn setColormap
+        * \brief SLOT: change colormap used to display the scalar field
+        * \param _colormapId: index of the colormap (see enum Colormap)
+        */
+        void setColormap(int _colormapId);
+        /*!
+        * \fn setScalarPercentiles
+        * \brief SLOT: change the percentiles of the scalar field mapped to the colormap extremities
+        * \param _lowPct: low percentile, in [0;1]
+        * \param _highPct: high percentile, in [0;1]
+        */
+        void setScalarPercentiles(double _lowPct, double _highPct);
+
 
         /*!
         * \fn duplVertices
@@ -304,6 +625,58 @@ public:
         */
         void compNormals();
         /*!
+        * \fn setNormalWeighting
+        * \brief SLOT: set the weighting of face normals used by compNormals()
+        * \param _weighting : see enum NormalWeighting (uniform, area, angle)
+        */
+        void setNormalWeighting(int _weighting);
+        /*!
+        * \fn setProgressiveLoading
+        * \brief SLOT: activate/deactivate progressive display of the next loaded meshes
+        */
+        void setProgressiveLoading(bool _progressive);
+        /*!
+        * \fn setProxyPreview
+        * \brief SLOT: activate/deactivate the display of a proxy of the next loaded meshes (if larger than the proxy budget)
+        */
+        void setProxyPreview(bool _preview);
+        /*!
+        * \fn setProxyBudget
+        * \brief SLOT: set the number of triangles targeted by the proxy of the next loaded meshes
+        * \param _nbTriangles : triangle budget (used when the proxy cell size is 0)
+        */
+        void setProxyBudget(int _nbTriangles);
+        /*!
+        * \fn setProxyCellSize
+        * \brief SLOT: set the cell size of the proxy of the next loaded meshes
+        * \param _percent : cell size, in percent of the bounding box diagonal (0 to derive it from the triangle budget)
+        */
+        void setProxyCellSize(double _percent);
+        /*!
+        * \fn setInteractiveMode
+        * \brief SLOT: activate/deactivate reduced resolution rendering while the camera moves
+        */
+        void setInteractiveMode(bool _interactive);
+        /*!
+        * \fn setInteractiveScale
+        * \brief SLOT: set the resolution divisor of the frames rendered while the camera moves
+        *        (raised automatically, up to s_maxInteractiveScale, if frames take more than 1/30 s)
+        * \param _scale : 1 for full resolution, 2 for half resolution, ...
+        */
+        void setInteractiveScale(int _scale);
+        /*!
+        * \fn setIdleDelay
+        * \brief SLOT: set the time without camera move after which full quality is restored
+        * \param _ms : delay in milliseconds
+        */
+        void setIdleDelay(int _ms);
+        /*!
+        * \fn setIndexOptimization
+        * \brief SLOT: activate/deactivate the reordering of triangles and vertices for the GPU (see IndexOptimizer),
+        *        for the current mesh and the next loaded ones
+        */
+        void setIndexOptimization(bool _optimize);
+        /*!
         * \fn compTBs
         * \brief SLOT: compute tangents and bitangents
         */
@@ -320,6 +693,14 @@ public:
         */
         void compSurfVar();
 
+        /*!
+        * \fn applyMeshJob
+        * \brief SLOT: replace the current mesh with the result of the finished background job, and upload it once
+        * \param _name : name of the job
+        * \param _canceled : true if the job has been canceled (the current mesh is then kept)
+        */
+        void applyMeshJob(QString _name, bool _canceled);
+
 };
 
 #endif
\ No newline at end of file
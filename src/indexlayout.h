@@ -0,0 +1,64 @@
+/*********************************************************************************************************************
+ *
+ * indexlayout.h
+ *
+ * Layout of index buffers on the GPU: 16 bits ranges and meshlets
+ *
+ * Mesh_viewer
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+#ifndef INDEXLAYOUT_H
+#define INDEXLAYOUT_H
+
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+
+/*!
+* \struct IndexCluster
+* \brief Range of a 16 bits index buffer drawn with a single glDrawElementsBaseVertex() call
+*/
+struct IndexCluster
+{
+    uint32_t firstIndex = 0;    /*!< first index of the range */
+    uint32_t nbIndices = 0;     /*!< number of indices of the range (3 per triangle) */
+    uint32_t baseVertex = 0;    /*!< added to the 16 bits indices of the range */
+};
+
+
+/*!
+* \struct Meshlet
+* \brief Small group of consecutive triangles of the index buffer, culled as a whole (see DrawableMesh::cullMeshlets())
+*/
+struct Meshlet
+{
+    uint32_t firstIndex = 0;                /*!< first index of the meshlet */
+    uint32_t nbIndices = 0;                 /*!< number of indices of the meshlet (3 per triangle) */
+    uint32_t baseVertex = 0;                /*!< base vertex of the 16 bits range the meshlet belongs to (0 for 32 bits indices) */
+    glm::vec3 center = glm::vec3(0.0f);     /*!< center of the bounding sphere */
+    float radius = 0.0f;                    /*!< radius of the bounding sphere */
+    glm::vec3 coneAxis = glm::vec3(0.0f);   /*!< axis of the cone containing the normals of the triangles */
+    float coneCutoff = 2.0f;                /*!< sine of the half-angle of the normal cone (> 1 if the meshlet is never back-facing) */
+};
+
+
+/*!
+* \struct IndexLayout
+* \brief How an index buffer is drawn: 16 bits ranges and meshlets, built in a worker thread by IndexOptimizer::buildLayout()
+*        so that DrawableMesh only uploads them
+*/
+struct IndexLayout
+{
+    std::vector<uint16_t> indices16;        /*!< 16 bits version of the indices, by ranges (empty if 32 bits are needed) */
+    std::vector<IndexCluster> clusters;     /*!< ranges of indices16 */
+    std::vector<Meshlet> meshlets;          /*!< meshlets of the indices, in index order */
+};
+
+#endif // INDEXLAYOUT_H
@@ -0,0 +1,548 @@
+/*********************************************************************************************************************
+ *
+ * indexoptimizer.cpp
+ *
+ * Mesh_viewer
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+#include <chrono>
+
+#include "indexoptimizer.h"
+#include "parallelsort.h"
+
+
+
+MeshRemap IndexOptimizer::optimize(const std::vector<uint32_t>& _indices, const std::vector<glm::vec3>& _vertices)
+{
+    MeshRemap remap;
+
+    const int nbTriangles = (int)(_indices.size() / 3);
+    const size_t nbVertices = _vertices.size();
+    if (nbTriangles == 0 || nbVertices == 0 || _indices.size() % 3 != 0)
+        return remap;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // 0. triangles are sorted along a Morton curve, so that chunks are compact whatever the file order
+    glm::vec3 bBoxMin = _vertices[0];
+    glm::vec3 bBoxMax = _vertices[0];
+    for (const glm::vec3& p : _vertices)
+    {
+        bBoxMin = glm::min(bBoxMin, p);
+        bBoxMax = glm::max(bBoxMax, p);
+    }
+    const glm::vec3 bBoxSize = glm::max(bBoxMax - bBoxMin, glm::vec3(1e-20f));
+
+    std::vector<uint64_t> mortonTriangles(nbTriangles);     // Morton code (high bits) and triangle (low bits)
+    #pragma omp parallel for
+    for (int t = 0; t < nbTriangles; t++)
+    {
+        glm::vec3 centroid = (_vertices[_indices[3 * t]] + _vertices[_indices[3 * t + 1]] + _vertices[_indices[3 * t + 2]]) / 3.0f;
+        glm::vec3 cell = (centroid - bBoxMin) / bBoxSize * 1023.0f;
+        mortonTriangles[t] = ((uint64_t)mortonCode(cell) << 32) | (uint64_t)t;
+    }
+    parallelSort(mortonTriangles, std::less<uint64_t>());
+
+    // 1. vertex cache: each chunk of triangles is reordered independently
+    const int nbChunks = (nbTriangles + s_chunkTriangles - 1) / s_chunkTriangles;
+    std::vector<std::vector<int> > chunkTriangles(nbChunks);
+    std::vector<std::vector<int> > chunkClusters(nbChunks);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < nbChunks; c++)
+    {
+        const int firstTriangle = c * s_chunkTriangles;
+        const int nbChunkTriangles = std::min(s_chunkTriangles, nbTriangles - firstTriangle);
+        std::vector<int> triangles(nbChunkTriangles);
+        for (int i = 0; i < nbChunkTriangles; i++)
+            triangles[i] = (int)(mortonTriangles[firstTriangle + i] & 0xFFFFFFFFull);
+        tipsify(_indices, triangles, chunkTriangles[c], chunkClusters[c]);
+    }
+
+    // 2. overdraw: clusters facing outwards (i.e. likely to occlude the others) are drawn first
+    struct Cluster
+    {
+        int chunk;
+        int begin;
+        int end;
+        glm::vec3 centroid;
+        glm::vec3 normal;
+        float area;
+        float sortKey;
+    };
+    std::vector<Cluster> clusters;
+    for (int c = 0; c < nbChunks; c++)
+    {
+        const std::vector<int>& starts = chunkClusters[c];
+        for (size_t i = 0; i < starts.size(); i++)
+        {
+            int end = (i + 1 < starts.size()) ? starts[i + 1] : (int)chunkTriangles[c].size();
+            clusters.push_back({c, starts[i], end, glm::vec3(0.0f), glm::vec3(0.0f), 0.0f, 0.0f});
+        }
+    }
+
+    const int nbClusters = (int)clusters.size();
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < nbClusters; i++)
+    {
+        Cluster& cluster = clusters[i];
+        for (int j = cluster.begin; j < cluster.end; j++)
+        {
+            const int t = chunkTriangles[cluster.chunk][j];
+            const glm::vec3& p0 = _vertices[_indices[3 * t]];
+            const glm::vec3& p1 = _vertices[_indices[3 * t + 1]];
+            const glm::vec3& p2 = _vertices[_indices[3 * t + 2]];
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);     // length = 2 * area
+            float area = 0.5f * glm::length(n);
+            cluster.normal += n;
+            cluster.centroid += (p0 + p1 + p2) * (area / 3.0f);
+            cluster.area += area;
+        }
+        if (cluster.area > 0.0f)
+            cluster.centroid /= cluster.area;
+    }
+
+    glm::vec3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+    for (const Cluster& cluster : clusters)
+    {
+        meshCenter += cluster.centroid * cluster.area;
+        meshArea += cluster.area;
+    }
+    if (meshArea > 0.0f)
+        meshCenter /= meshArea;
+
+    for (Cluster& cluster : clusters)
+    {
+        float normalLength = glm::length(cluster.normal);
+        cluster.sortKey = (normalLength > 0.0f) ? glm::dot(cluster.centroid - meshCenter, cluster.normal / normalLength) : 0.0f;
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& _a, const Cluster& _b) { return _a.sortKey > _b.sortKey; });
+
+    // 3. vertex fetch: vertices are renumbered in order of first use, by ranges of s_rangeVertices vertices
+    //    (16 bits indices, see packIndices16()): a vertex used again by a later range is duplicated in this range
+    const uint32_t unused = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> newIds(nbVertices, unused);
+    remap.vertexOrder.reserve(nbVertices);
+    remap.indices.resize(_indices.size());
+    size_t pos = 0;
+    uint32_t rangeBase = 0;
+    for (const Cluster& cluster : clusters)
+    {
+        for (int j = cluster.begin; j < cluster.end; j++)
+        {
+            const int t = chunkTriangles[cluster.chunk][j];
+            if (remap.vertexOrder.size() + 3 > (size_t)rangeBase + s_rangeVertices)
+                rangeBase = (uint32_t)remap.vertexOrder.size();
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t v = _indices[3 * t + k];
+                if (newIds[v] == unused || newIds[v] < rangeBase)
+                {
+                    newIds[v] = (uint32_t)remap.vertexOrder.size();
+                    remap.vertexOrder.push_back(v);
+                }
+                remap.indices[pos++] = newIds[v];
+            }
+        }
+    }
+    const size_t nbDuplicated = remap.vertexOrder.size() - (nbVertices - std::count(newIds.begin(), newIds.end(), unused));
+    // vertices used by no triangle are kept at the end
+    for (size_t v = 0; v < nbVertices; v++)
+    {
+        if (newIds[v] == unused)
+            remap.vertexOrder.push_back((uint32_t)v);
+    }
+
+    remap.sourceHash = hashIndices(_indices);
+    remap.nbSourceVertices = nbVertices;
+
+    auto end = std::chrono::high_resolution_clock::now();
+    VertexCacheStats before = analyzeVertexCache(_indices, nbVertices);
+    VertexCacheStats after = analyzeVertexCache(remap.indices, remap.vertexOrder.size());
+    qInfo() << "[info] IndexOptimizer::optimize: " << nbTriangles << " triangles, " << nbClusters << " clusters, "
+            << nbDuplicated << " vertices duplicated at 16 bits range boundaries, in "
+            << std::chrono::duration<double, std::milli>(end - start).count() << " ms";
+    qInfo() << "[info] IndexOptimizer::optimize: ACMR " << before.acmr << " -> " << after.acmr
+            << ", ATVR " << before.atvr << " -> " << after.atvr << " (FIFO cache of " << s_cacheSize << " vertices)";
+
+    return remap;
+}
+
+
+void IndexOptimizer::tipsify(const std::vector<uint32_t>& _indices, const std::vector<int>& _chunkTriangles,
+                             std::vector<int>& _triangles, std::vector<int>& _clusterStarts)
+{
+    const int nbTriangles = (int)_chunkTriangles.size();
+    const size_t nbCorners = 3 * (size_t)nbTriangles;
+
+    // local numbering of the vertices of the chunk
+    std::vector<uint32_t> chunkIndices(nbCorners);
+    for (int t = 0; t < nbTriangles; t++)
+    {
+        for (int k = 0; k < 3; k++)
+            chunkIndices[3 * (size_t)t + k] = _indices[3 * (size_t)_chunkTriangles[t] + k];
+    }
+    std::vector<uint32_t> localVertices(chunkIndices);
+    std::sort(localVertices.begin(), localVertices.end());
+    localVertices.erase(std::unique(localVertices.begin(), localVertices.end()), localVertices.end());
+    const int nbLocal = (int)localVertices.size();
+
+    std::vector<int> corners(nbCorners);
+    for (size_t c = 0; c < nbCorners; c++)
+        corners[c] = (int)(std::lower_bound(localVertices.begin(), localVertices.end(), chunkIndices[c]) - localVertices.begin());
+
+    // vertex -> triangles adjacency (compressed rows), and number of triangles not emitted yet per vertex
+    std::vector<int> live(nbLocal, 0);
+    for (size_t c = 0; c < nbCorners; c++)
+        live[corners[c]]++;
+    std::vector<int> adjOffsets(nbLocal + 1, 0);
+    for (int v = 0; v < nbLocal; v++)
+        adjOffsets[v + 1] = adjOffsets[v] + live[v];
+    std::vector<int> adjTriangles(nbCorners);
+    std::vector<int> adjFill(adjOffsets.begin(), adjOffsets.end() - 1);
+    for (size_t c = 0; c < nbCorners; c++)
+        adjTriangles[adjFill[corners[c]]++] = (int)(c / 3);
+
+    std::vector<int> cacheTime(nbLocal, 0);     // time stamp of the vertices in the simulated cache
+    std::vector<char> emitted(nbTriangles, 0);
+    std::vector<int> deadEnd;                   // recently used vertices, to restart from when fanning is stuck
+    std::vector<int> candidates;
+    int time = s_cacheSize + 1;
+    int cursor = 0;                             // restart point in local ids (i.e. in vertex index order), when the dead-end stack is empty
+
+    _triangles.clear();
+    _triangles.reserve(nbTriangles);
+    _clusterStarts.assign(1, 0);
+
+    int fanning = 0;
+    while (fanning >= 0)
+    {
+        // emit all the triangles around the fanning vertex
+        candidates.clear();
+        for (int a = adjOffsets[fanning]; a < adjOffsets[fanning + 1]; a++)
+        {
+            const int t = adjTriangles[a];
+            if (emitted[t])
+                continue;
+            emitted[t] = 1;
+            _triangles.push_back(_chunkTriangles[t]);
+
+            for (int k = 0; k < 3; k++)
+            {
+                const int v = corners[3 * (size_t)t + k];
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cacheTime[v] > s_cacheSize)
+                {
+                    cacheTime[v] = time;
+                    time++;
+                }
+            }
+        }
+
+        // next fanning vertex: the candidate that will still be in cache once fanned, and that entered the cache first
+        int best = -1;
+        int bestPriority = -1;
+        for (int v : candidates)
+        {
+            if (live[v] <= 0)
+                continue;
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * live[v] <= s_cacheSize)
+                priority = time - cacheTime[v];
+            if (priority > bestPriority)
+            {
+                best = v;
+                bestPriority = priority;
+            }
+        }
+
+        if (best == -1)
+        {
+            // dead end: restart from a recently used vertex, or from the live vertex with the lowest index
+            // (local ids are sorted by vertex index, not by first use in the triangles)
+            while (best == -1 && !deadEnd.empty())
+            {
+                int v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0)
+                    best = v;
+            }
+            while (best == -1 && cursor < nbLocal)
+            {
+                if (live[cursor] > 0)
+                    best = cursor;
+                else
+                    cursor++;
+            }
+
+            // cache locality is lost: a new cluster starts (small clusters are merged)
+            if (best != -1 && (int)_triangles.size() - _clusterStarts.back() >= s_minClusterTriangles)
+                _clusterStarts.push_back((int)_triangles.size());
+        }
+
+        fanning = best;
+    }
+}
+
+
+bool IndexOptimizer::applyRemap(MeshBuffers& _buffers, const MeshRemap& _remap)
+{
+    const size_t nbVertices = _remap.nbSourceVertices;
+    if (nbVertices == 0)
+        return false;
+
+    // check everything before modifying anything
+    auto matches = [nbVertices](size_t _size) { return _size == 0 || _size == nbVertices; };
+    if (!matches(_buffers.vertices.size()) || !matches(_buffers.normals.size()) || !matches(_buffers.colors.size())
+        || !matches(_buffers.texcoords.size()) || !matches(_buffers.tangents.size()) || !matches(_buffers.bitangents.size())
+        || !matches(_buffers.facenormals.size()) || !matches(_buffers.scalars.size()))
+        return false;
+    if (!_buffers.indices.empty() && (_buffers.indices.size() != _remap.indices.size() || hashIndices(_buffers.indices) != _remap.sourceHash))
+        return false;
+
+    if (!_buffers.indices.empty())
+        _buffers.indices = _remap.indices;
+    permute(_buffers.vertices, _remap.vertexOrder);
+    permute(_buffers.normals, _remap.vertexOrder);
+    permute(_buffers.colors, _remap.vertexOrder);
+    permute(_buffers.texcoords, _remap.vertexOrder);
+    permute(_buffers.tangents, _remap.vertexOrder);
+    permute(_buffers.bitangents, _remap.vertexOrder);
+    permute(_buffers.facenormals, _remap.vertexOrder);
+    permute(_buffers.scalars, _remap.vertexOrder);
+
+    return true;
+}
+
+
+VertexCacheStats IndexOptimizer::analyzeVertexCache(const std::vector<uint32_t>& _indices, size_t _nbVertices, int _cacheSize)
+{
+    VertexCacheStats stats;
+    const size_t nbTriangles = _indices.size() / 3;
+    if (nbTriangles == 0)
+        return stats;
+
+    // FIFO: a vertex is in cache if less than _cacheSize vertices have been inserted since its own insertion
+    std::vector<long long> insertTime(_nbVertices, -(long long)_cacheSize - 1);
+    std::vector<char> used(_nbVertices, 0);
+    long long nbMisses = 0;
+    size_t nbUsed = 0;
+    for (uint32_t v : _indices)
+    {
+        if (nbMisses - insertTime[v] > _cacheSize)
+        {
+            insertTime[v] = nbMisses;
+            nbMisses++;
+        }
+        if (!used[v])
+        {
+            used[v] = 1;
+            nbUsed++;
+        }
+    }
+
+    stats.acmr = (float)nbMisses / (float)nbTriangles;
+    stats.atvr = (float)nbMisses / (float)std::max<size_t>(nbUsed, 1);
+    return stats;
+}
+
+
+uint64_t IndexOptimizer::hashIndices(const std::vector<uint32_t>& _indices)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (uint32_t index : _indices)
+    {
+        hash ^= index;
+        hash *= 1099511628211ull;
+    }
+    return hash ^ _indices.size();
+}
+
+
+bool IndexOptimizer::packIndices16(const std::vector<uint32_t>& _indices, std::vector<uint16_t>& _packed, std::vector<IndexCluster>& _clusters)
+{
+    _packed.clear();
+    _clusters.clear();
+    const size_t nbTriangles = _indices.size() / 3;
+    if (nbTriangles == 0)
+        return false;
+
+    // consecutive triangles are grouped as long as their vertices fit in a window of 65536 vertices
+    const uint32_t maxOffset = std::numeric_limits<uint16_t>::max();
+    uint32_t rangeMin = std::numeric_limits<uint32_t>::max();
+    uint32_t rangeMax = 0;
+    size_t rangeStart = 0;
+    for (size_t t = 0; t < nbTriangles; t++)
+    {
+        const uint32_t* tri = &_indices[3 * t];
+        uint32_t newMin = std::min(rangeMin, std::min(tri[0], std::min(tri[1], tri[2])));
+        uint32_t newMax = std::max(rangeMax, std::max(tri[0], std::max(tri[1], tri[2])));
+        if (newMax - newMin > maxOffset && t > rangeStart)
+        {
+            _clusters.push_back({ (uint32_t)(3 * rangeStart), (uint32_t)(3 * (t - rangeStart)), rangeMin });
+            rangeStart = t;
+            newMin = std::min(tri[0], std::min(tri[1], tri[2]));
+            newMax = std::max(tri[0], std::max(tri[1], tri[2]));
+        }
+        if (newMax - newMin > maxOffset)
+        {
+            // a single triangle spans more than 65536 vertices
+            _clusters.clear();
+            return false;
+        }
+        rangeMin = newMin;
+        rangeMax = newMax;
+    }
+    _clusters.push_back({ (uint32_t)(3 * rangeStart), (uint32_t)(3 * (nbTriangles - rangeStart)), rangeMin });
+
+    // each range is one draw call: not worth it for scattered index buffers
+    if (_clusters.size() > 1 && nbTriangles / _clusters.size() < (size_t)s_minRangeTriangles)
+    {
+        _clusters.clear();
+        return false;
+    }
+
+    _packed.resize(3 * nbTriangles);
+    const int nbClusters = (int)_clusters.size();
+    #pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < nbClusters; c++)
+    {
+        const IndexCluster& cluster = _clusters[c];
+        for (uint32_t i = cluster.firstIndex; i < cluster.firstIndex + cluster.nbIndices; i++)
+            _packed[i] = (uint16_t)(_indices[i] - cluster.baseVertex);
+    }
+
+    return true;
+}
+
+
+void IndexOptimizer::buildMeshlets(const std::vector<uint32_t>& _indices, const std::vector<glm::vec3>& _vertices,
+                                   const std::vector<IndexCluster>& _ranges, std::vector<Meshlet>& _meshlets)
+{
+    _meshlets.clear();
+    if (_indices.empty() || _vertices.empty())
+        return;
+
+    // meshlets are cut in each range of the index buffer (a single one for 32 bits indices)
+    std::vector<IndexCluster> ranges = _ranges;
+    if (ranges.empty())
+        ranges.push_back({ 0, (uint32_t)_indices.size(), 0 });
+    const uint32_t meshletIndices = 3 * s_meshletTriangles;
+    for (const IndexCluster& range : ranges)
+    {
+        const uint32_t rangeEnd = range.firstIndex + range.nbIndices;
+        for (uint32_t first = range.firstIndex; first < rangeEnd; first += meshletIndices)
+        {
+            Meshlet meshlet;
+            meshlet.firstIndex = first;
+            meshlet.nbIndices = std::min(meshletIndices, rangeEnd - first);
+            meshlet.baseVertex = range.baseVertex;
+            _meshlets.push_back(meshlet);
+        }
+    }
+
+    const int nbMeshlets = (int)_meshlets.size();
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < nbMeshlets; i++)
+    {
+        Meshlet& meshlet = _meshlets[i];
+        const uint32_t end = meshlet.firstIndex + meshlet.nbIndices;
+
+        // bounding sphere: centered on the bounding box
+        glm::vec3 bBoxMin = _vertices[_indices[meshlet.firstIndex]];
+        glm::vec3 bBoxMax = bBoxMin;
+        for (uint32_t c = meshlet.firstIndex; c < end; c++)
+        {
+            bBoxMin = glm::min(bBoxMin, _vertices[_indices[c]]);
+            bBoxMax = glm::max(bBoxMax, _vertices[_indices[c]]);
+        }
+        meshlet.center = 0.5f * (bBoxMin + bBoxMax);
+        meshlet.radius = 0.0f;
+        for (uint32_t c = meshlet.firstIndex; c < end; c++)
+            meshlet.radius = std::max(meshlet.radius, glm::length(_vertices[_indices[c]] - meshlet.center));
+
+        // normal cone: average of the unit normals, and largest angle to this average
+        auto faceNormal = [&](uint32_t _c)
+        {
+            const glm::vec3& p0 = _vertices[_indices[_c]];
+            return glm::cross(_vertices[_indices[_c + 1]] - p0, _vertices[_indices[_c + 2]] - p0);
+        };
+        glm::vec3 normalSum(0.0f);
+        for (uint32_t c = meshlet.firstIndex; c < end; c += 3)
+        {
+            glm::vec3 n = faceNormal(c);
+            float length = glm::length(n);
+            if (length > 0.0f)
+                normalSum += n / length;
+        }
+        float sumLength = glm::length(normalSum);
+        if (sumLength <= 0.0f)
+            continue;   // never back-facing
+        meshlet.coneAxis = normalSum / sumLength;
+        float minDot = 1.0f;
+        for (uint32_t c = meshlet.firstIndex; c < end; c += 3)
+        {
+            glm::vec3 n = faceNormal(c);
+            float length = glm::length(n);
+            if (length > 0.0f)
+                minDot = std::min(minDot, glm::dot(n / length, meshlet.coneAxis));
+        }
+        // normals spread over more than a half-space: never back-facing
+        meshlet.coneCutoff = (minDot > 0.0f) ? std::sqrt(1.0f - minDot * minDot) : 2.0f;
+    }
+}
+
+
+void IndexOptimizer::buildLayout(const MeshBuffers& _buffers, IndexLayout& _layout)
+{
+    _layout = IndexLayout();
+    if (_buffers.indices.empty())
+        return;
+
+    if (packIndices16(_buffers.indices, _layout.indices16, _layout.clusters))
+    {
+        qInfo() << "[info] IndexOptimizer::buildLayout: 16 bits indices, " << _layout.clusters.size() << " draw call(s), "
+                << (_layout.indices16.size() * sizeof(uint16_t)) / 1024 << " KB instead of " << (_buffers.indices.size() * sizeof(uint32_t)) / 1024 << " KB";
+    }
+
+    // meshlets need the positions of the vertices
+    if (!_buffers.vertices.empty())
+        buildMeshlets(_buffers.indices, _buffers.vertices, _layout.clusters, _layout.meshlets);
+}
+
+
+uint32_t IndexOptimizer::mortonCode(const glm::vec3& _cell)
+{
+    // interleave the 10 lower bits of each coordinate
+    auto spread = [](uint32_t _x)
+    {
+        _x &= 0x3FF;
+        _x = (_x | (_x << 16)) & 0x030000FF;
+        _x = (_x | (_x << 8)) & 0x0300F00F;
+        _x = (_x | (_x << 4)) & 0x030C30C3;
+        _x = (_x | (_x << 2)) & 0x09249249;
+        return _x;
+    };
+    return (spread((uint32_t)_cell.x) << 2) | (spread((uint32_t)_cell.y) << 1) | spread((uint32_t)_cell.z);
+}
+
+
+template <typename T>
+void IndexOptimizer::permute(std::vector<T>& _array, const std::vector<uint32_t>& _order)
+{
+    if (_array.empty())
+        return;
+
+    std::vector<T> permuted(_order.size());
+    const long long n = (long long)_order.size();
+    #pragma omp parallel for
+    for (long long i = 0; i < n; i++)
+        permuted[i] = _array[_order[i]];
+    _array.swap(permuted);
+}
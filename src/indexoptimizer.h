@@ -0,0 +1,165 @@
+/*********************************************************************************************************************
+ *
+ * indexoptimizer.h
+ *
+ * Reorders index and vertex buffers for the GPU: post-transform vertex cache, overdraw and vertex fetch
+ *
+ * Mesh_viewer
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+#ifndef INDEXOPTIMIZER_H
+#define INDEXOPTIMIZER_H
+
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+#include "indexlayout.h"
+
+
+/*!
+* \struct MeshRemap
+* \brief Reordering of the GPU buffers of a mesh, computed once by IndexOptimizer::optimize()
+*        and applied to every buffer built from the same mesh afterwards (see IndexOptimizer::applyRemap())
+*/
+struct MeshRemap
+{
+    std::vector<uint32_t> vertexOrder;  /*!< new vertex i is the original vertex vertexOrder[i] (a few vertices may be duplicated) */
+    std::vector<uint32_t> indices;      /*!< optimized index buffer, referring to the new vertices */
+    uint64_t sourceHash = 0;            /*!< hash of the original index buffer (the remap is only valid for this topology) */
+    size_t nbSourceVertices = 0;        /*!< number of vertices of the original buffers */
+};
+
+
+/*!
+* \struct VertexCacheStats
+* \brief Efficiency of an index buffer with a FIFO post-transform cache
+*/
+struct VertexCacheStats
+{
+    float acmr = 0.0f;      /*!< average cache miss ratio: transformed vertices per triangle (0.5 at best, 3 at worst) */
+    float atvr = 0.0f;      /*!< average transformed vertex ratio: transformed vertices per vertex (1 at best) */
+};
+
+
+/*!
+* \class IndexOptimizer
+* \brief Reorders triangles and vertices of GPU buffers, in 3 steps:
+*        1. vertex cache: triangles are reordered with Tipsify (Sander et al. 2007), independently for each chunk of triangles (in parallel),
+*           chunks being made of triangles close to each other (Morton order);
+*        2. overdraw: the clusters found by Tipsify are sorted so that triangles facing outwards are drawn first;
+*        3. vertex fetch: vertices are renumbered in order of first use by the index buffer,
+*           by ranges of 65536 vertices so that the index buffer can be drawn with 16 bits indices (see packIndices16()).
+*        The rendering is unchanged, only the order of triangles and vertices is (and a few vertices are duplicated).
+*/
+class IndexOptimizer
+{
+    public:
+
+        /*!
+        * \fn optimize
+        * \brief compute the reordering of the buffers of a mesh
+        * \param _indices : index buffer (3 indices per triangle)
+        * \param _vertices : vertex positions (used by the overdraw step)
+        * \return reordering, to be applied with applyRemap()
+        */
+        static MeshRemap optimize(const std::vector<uint32_t>& _indices, const std::vector<glm::vec3>& _vertices);
+
+        /*!
+        * \fn applyRemap
+        * \brief reorder buffers: indices are replaced by the optimized ones, per-vertex arrays are permuted (duplicated vertices included).
+        *        Buffers are left untouched if they do not match the remap (e.g. topology modified since the remap was computed).
+        * \param _buffers : buffers built from the mesh the remap was computed for (any subset of attributes)
+        * \param _remap : reordering
+        * \return false if the buffers do not match the remap
+        */
+        static bool applyRemap(MeshBuffers& _buffers, const MeshRemap& _remap);
+
+        /*!
+        * \fn analyzeVertexCache
+        * \brief simulate a FIFO post-transform cache
+        * \param _indices : index buffer (3 indices per triangle)
+        * \param _nbVertices : number of vertices
+        * \param _cacheSize : number of entries of the cache
+        */
+        static VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& _indices, size_t _nbVertices, int _cacheSize = s_cacheSize);
+
+        /*!
+        * \fn hashIndices
+        * \brief hash of an index buffer (FNV-1a), identifies the topology a remap has been computed for
+        */
+        static uint64_t hashIndices(const std::vector<uint32_t>& _indices);
+
+        /*!
+        * \fn packIndices16
+        * \brief convert an index buffer to 16 bits: triangles are split into consecutive ranges
+        *        referring to less than 65536 vertices each, indices being relative to the first vertex of their range.
+        *        Works best on buffers reordered by optimize() (vertices in order of first use).
+        * \param _indices : index buffer (3 indices per triangle)
+        * \param _packed : output, 16 bits index buffer
+        * \param _clusters : output, ranges of _packed (one draw call each)
+        * \return false if the buffer should be kept in 32 bits (too many ranges), outputs are then empty
+        */
+        static bool packIndices16(const std::vector<uint32_t>& _indices, std::vector<uint16_t>& _packed, std::vector<IndexCluster>& _clusters);
+
+        /*!
+        * \fn buildMeshlets
+        * \brief split an index buffer into meshlets of consecutive triangles, and compute their bounding sphere and normal cone.
+        *        Meshlets are compact when the buffer has been reordered by optimize().
+        * \param _indices : index buffer (3 indices per triangle, 32 bits)
+        * \param _vertices : vertex positions
+        * \param _ranges : 16 bits ranges of the index buffer (see packIndices16()), meshlets do not overlap two ranges (empty for 32 bits indices)
+        * \param _meshlets : output, meshlets in index buffer order
+        */
+        static void buildMeshlets(const std::vector<uint32_t>& _indices, const std::vector<glm::vec3>& _vertices,
+                                  const std::vector<IndexCluster>& _ranges, std::vector<Meshlet>& _meshlets);
+
+        /*!
+        * \fn buildLayout
+        * \brief compute the 16 bits indices and the meshlets of buffers (see packIndices16() and buildMeshlets()),
+        *        e.g. in the loading thread so that DrawableMesh only uploads them
+        * \param _buffers : buffers with indices and vertex positions (meshlets are left empty without positions)
+        * \param _layout : output
+        */
+        static void buildLayout(const MeshBuffers& _buffers, IndexLayout& _layout);
+
+
+    protected:
+
+        static constexpr int s_cacheSize = 16;          /*!< cache size targeted by Tipsify (conservative for current GPUs) */
+        static constexpr int s_chunkTriangles = 65536;  /*!< number of triangles optimized independently (and in parallel) */
+        static constexpr int s_minClusterTriangles = 64;/*!< minimal size of the clusters sorted by the overdraw step */
+        static constexpr int s_minRangeTriangles = 4096;/*!< minimal average size of the ranges of a 16 bits index buffer (limits draw calls) */
+        static constexpr int s_rangeVertices = 65536;   /*!< number of vertices addressed by 16 bits indices */
+        static constexpr int s_meshletTriangles = 128;  /*!< number of triangles of a meshlet */
+
+        /*!
+        * \fn tipsify
+        * \brief reorder a chunk of triangles for the vertex cache, and split it into clusters
+        * \param _indices : index buffer of the whole mesh
+        * \param _chunkTriangles : triangles of the chunk
+        * \param _triangles : output, triangles of the chunk in optimized order
+        * \param _clusterStarts : output, position in _triangles of the first triangle of each cluster
+        */
+        static void tipsify(const std::vector<uint32_t>& _indices, const std::vector<int>& _chunkTriangles,
+                            std::vector<int>& _triangles, std::vector<int>& _clusterStarts);
+
+        /*!
+        * \fn mortonCode
+        * \brief 30 bits Morton code of a cell of a 1024^3 grid
+        */
+        static uint32_t mortonCode(const glm::vec3& _cell);
+
+        /*!
+        * \fn permute
+        * \brief permute a per-vertex array: element i becomes _array[_order[i]]
+        */
+        template <typename T>
+        static void permute(std::vector<T>& _array, const std::vector<uint32_t>& _order);
+};
+
+#endif // INDEXOPTIMIZER_H
@@ -18,6 +18,10 @@
 #include <vector>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <limits>
+#include <atomic>
+#include <memory>
 
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
@@ -26,6 +30,62 @@
 #include <QtLogging>
 #include <QtDebug>
 
+// Attributes that can be requested from Mesh::getBuffers() (bitmask)
+enum MeshAttrib
+{
+    ATTRIB_VERTEX = 1 << 0,
+    ATTRIB_NORMAL = 1 << 1,
+    ATTRIB_INDEX = 1 << 2,
+    ATTRIB_COLOR = 1 << 3,
+    ATTRIB_TEXCOORD = 1 << 4,
+    ATTRIB_TANGENT = 1 << 5,
+    ATTRIB_BITANGENT = 1 << 6,
+    ATTRIB_FACENORMAL = 1 << 7,
+    ATTRIB_SCALAR = 1 << 8,
+    ATTRIB_ALL = (1 << 9) - 1
+};
+
+
+// Weighting of the face normals averaged into vertex normals (see Mesh::setNormalWeighting())
+enum NormalWeighting
+{
+    NORMAL_WEIGHT_UNIFORM = 0,      /*!< all adjacent faces have the same weight */
+    NORMAL_WEIGHT_AREA,             /*!< faces are weighted by their area */
+    NORMAL_WEIGHT_ANGLE             /*!< faces are weighted by their angle at the vertex */
+};
+
+
+/*!
+* \struct MeshBuffers
+* \brief GPU-ready arrays of a mesh, filled by Mesh::getBuffers()
+* Optional attributes are left empty when the mesh does not provide them
+*/
+struct MeshBuffers
+{
+    std::vector<glm::vec3> vertices;        /*!< vertex 3D coords */
+    std::vector<glm::vec3> normals;         /*!< vertex normals */
+    std::vector<uint32_t> indices;          /*!< triangle indices (3 per triangle) */
+    std::vector<glm::vec3> colors;          /*!< vertex colors, in [0;1] */
+    std::vector<glm::vec2> texcoords;       /*!< vertex UV coords */
+    std::vector<glm::vec3> tangents;        /*!< vertex tangents */
+    std::vector<glm::vec3> bitangents;      /*!< vertex bitangents */
+    std::vector<glm::vec3> facenormals;     /*!< normal of the face each vertex belongs to */
+    std::vector<float> scalars;             /*!< vertex scalar field */
+};
+
+
+/*!
+* \struct MeshJobControl
+* \brief Shared state between a long mesh operation running in a worker thread and the GUI (see MeshJobRunner):
+*        the operation reports its progress, the GUI requests a cooperative cancellation
+*/
+struct MeshJobControl
+{
+    std::atomic<int> progress{ 0 };         /*!< progress of the current operation, in [0;100] */
+    std::atomic<bool> cancel{ false };      /*!< set by the GUI to ask the operation to stop as soon as possible */
+};
+
+
 /*!
 * \class Mesh
 * \brief Abstract class for mesh data structure
@@ -50,6 +110,49 @@ class Mesh
 
         virtual void getFaceNormals(std::vector<glm::vec3>& _facenormals) = 0;
 
+        virtual void getScalars(std::vector<float>& _scalars) = 0;
+
+        /*!
+        * \fn getBuffers
+        * \brief get all the requested attributes at once, in GPU-ready arrays.
+        *        Default implementation calls the individual getters, derived classes can provide a faster one.
+        * \param _buffers : arrays to fill
+        * \param _attribs : bitmask of requested attributes (see enum MeshAttrib)
+        */
+        virtual void getBuffers(MeshBuffers& _buffers, unsigned int _attribs = ATTRIB_ALL)
+        {
+            if(_attribs & ATTRIB_VERTEX)
+                getVertices(_buffers.vertices);
+            if(_attribs & ATTRIB_NORMAL)
+                getNormals(_buffers.normals);
+            if(_attribs & ATTRIB_INDEX)
+                getIndices(_buffers.indices);
+            if(_attribs & ATTRIB_COLOR)
+                getColors(_buffers.colors);
+            if(_attribs & ATTRIB_TEXCOORD)
+                getTexCoords(_buffers.texcoords);
+            if(_attribs & ATTRIB_TANGENT)
+                getTangents(_buffers.tangents);
+            if(_attribs & ATTRIB_BITANGENT)
+                getBitangents(_buffers.bitangents);
+            if(_attribs & ATTRIB_FACENORMAL)
+                getFaceNormals(_buffers.facenormals);
+            if(_attribs & ATTRIB_SCALAR)
+                getScalars(_buffers.scalars);
+        }
+
+        /*!
+        * \fn setNormalWeighting
+        * \brief set the weighting of face normals used by the next computeNormals() (half-edge meshes only)
+        * \param _weighting : see enum NormalWeighting
+        */
+        inline void setNormalWeighting(NormalWeighting _weighting) { m_normalWeighting = _weighting; }
+        /*!
+        * \fn getNormalWeighting
+        * \return weighting of face normals used by computeNormals()
+        */
+        inline NormalWeighting getNormalWeighting() const { return m_normalWeighting; }
+
         /*!
         * \fn getBBoxMin
         * \brief get min point of the bounding box
@@ -63,10 +166,102 @@ class Mesh
         */
         inline glm::vec3 getBBoxMax() const { return m_bBoxMax; }
 
+        /*!
+        * \fn getScalarPercentiles
+        * \brief get the values of the scalar field at two given percentiles.
+        *        Percentiles are read from a histogram of the scalar field (approximated to 1/4096th of its range),
+        *        which is built in parallel and avoids sorting a copy of the values.
+        * \param _lowPct : low percentile, in [0;1]
+        * \param _highPct : high percentile, in [0;1]
+        * \param _min : value of the scalar field at the low percentile
+        * \param _max : value of the scalar field at the high percentile
+        */
+        void getScalarPercentiles(float _lowPct, float _highPct, float& _min /* return */, float& _max /* return */) const
+        {
+            _min = _max = 0.0f;
+            if (m_scalars.empty())
+                return;
+
+            // values are processed by chunks, each chunk having its own partial results
+            const int nbValues = (int)m_scalars.size();
+            const int nbChunks = 64;
+            const int nbBins = 4096;
+            const int chunkSize = (nbValues + nbChunks - 1) / nbChunks;
+
+            // 1. min and max values
+            std::vector<float> chunkMin(nbChunks, std::numeric_limits<float>::max());
+            std::vector<float> chunkMax(nbChunks, -std::numeric_limits<float>::max());
+            #pragma omp parallel for
+            for (int c = 0; c < nbChunks; c++)
+            {
+                for (int i = c * chunkSize; i < std::min(nbValues, (c + 1) * chunkSize); i++)
+                {
+                    chunkMin[c] = std::min(chunkMin[c], m_scalars[i]);
+                    chunkMax[c] = std::max(chunkMax[c], m_scalars[i]);
+                }
+            }
+            float minVal = *std::min_element(chunkMin.begin(), chunkMin.end());
+            float maxVal = *std::max_element(chunkMax.begin(), chunkMax.end());
+            if (maxVal <= minVal)
+            {
+                _min = _max = minVal;
+                return;
+            }
+
+            // 2. histogram
+            std::vector<std::vector<unsigned int> > chunkHisto(nbChunks, std::vector<unsigned int>(nbBins, 0));
+            const float binScale = (float)nbBins / (maxVal - minVal);
+            #pragma omp parallel for
+            for (int c = 0; c < nbChunks; c++)
+            {
+                for (int i = c * chunkSize; i < std::min(nbValues, (c + 1) * chunkSize); i++)
+                {
+                    int bin = std::min((int)((m_scalars[i] - minVal) * binScale), nbBins - 1);
+                    chunkHisto[c][bin]++;
+                }
+            }
+
+            // 3. cumulative histogram gives the percentiles
+            float lowCount = std::clamp(_lowPct, 0.0f, 1.0f) * (float)nbValues;
+            float highCount = std::clamp(_highPct, 0.0f, 1.0f) * (float)nbValues;
+            _min = minVal;
+            _max = maxVal;
+            bool lowFound = false;
+            unsigned int cumul = 0;
+            for (int b = 0; b < nbBins; b++)
+            {
+                for (int c = 0; c < nbChunks; c++)
+                    cumul += chunkHisto[c][b];
+
+                if (!lowFound && (float)cumul > lowCount)
+                {
+                    _min = minVal + (float)b / binScale;
+                    lowFound = true;
+                }
+                if ((float)cumul >= highCount)
+                {
+                    _max = minVal + (float)(b + 1) / binScale;
+                    break;
+                }
+            }
+        }
+
+        /*!
+        * \fn setJobControl
+        * \brief attach the progress/cancellation state of a background job (nullptr to detach)
+        */
+        inline void setJobControl(MeshJobControl* _jobControl) { m_jobControl = _jobControl; }
+
         /*------------------------------------------------------------------------------------------------------------+
         |                                               OTHER METHODS                                                 |
         +-------------------------------------------------------------------------------------------------------------*/
 
+        /*!
+        * \fn clone
+        * \brief deep copy of the mesh (background jobs work on a copy, see MeshJobRunner)
+        */
+        virtual std::shared_ptr<Mesh> clone() const = 0;
+
         virtual bool readFile(const std::string& _filename) = 0;
         virtual bool writeFile(const std::string& _filename) = 0;
         virtual void computeAABB() = 0;
@@ -74,6 +269,14 @@ class Mesh
         virtual void computeNormals() = 0;
         virtual void computeTB() = 0;
         virtual void lapSmooth(unsigned int _nbIter = 1, float _fact = 1.0f) = 0;
+
+        /*!
+        * \fn decimate
+        * \brief simplify the mesh down to a fraction of its triangles
+        * \param _ratio : fraction of the triangles to keep, in ]0;1[
+        * \return geometric error of the simplified mesh (largest distance to the original surface, estimated), negative if not available
+        */
+        virtual float decimate(float _ratio) = 0;
         virtual void computeMeanCurv() = 0;
         virtual void computeSurfVar() = 0;
 
@@ -97,10 +300,36 @@ class Mesh
         glm::vec3 m_bBoxMin = { 0.0f, 0.0f, 0.0f }; /*!< 3D coordinates of the min corner of the bounding box */
         glm::vec3 m_bBoxMax = { 0.0f, 0.0f, 0.0f }; /*!< 3D coordinates of the max corner of the bounding box */
 
+        std::vector<float> m_scalars;               /*!< scalar field (e.g. curvature), one value per vertex */
+
+        NormalWeighting m_normalWeighting = NORMAL_WEIGHT_UNIFORM;  /*!< weighting of face normals in vertex normals */
+
+        MeshJobControl* m_jobControl = nullptr;     /*!< progress/cancellation of the background job running on this mesh (if any) */
+
         /*------------------------------------------------------------------------------------------------------------+
         |                                               OTHER METHODS                                                 |
         +-------------------------------------------------------------------------------------------------------------*/
 
+        /*!
+        * \fn reportProgress
+        * \brief report the progress of a long operation to the background job (if any)
+        * \param _fraction : fraction of the operation done, in [0;1]
+        * \return false if the job has been canceled (i.e. the operation should stop)
+        */
+        inline bool reportProgress(float _fraction)
+        {
+            if (!m_jobControl)
+                return true;
+            m_jobControl->progress = (int)(100.0f * std::clamp(_fraction, 0.0f, 1.0f));
+            return !m_jobControl->cancel;
+        }
+
+        /*!
+        * \fn isJobCanceled
+        * \return true if the background job running on this mesh has been canceled
+        */
+        inline bool isJobCanceled() const { return m_jobControl && m_jobControl->cancel; }
+
         /*!
         * \fn compTandBTt
         * \brief Compute tangent and bitangent vectors from delta uv and delta pos
@@ -0,0 +1,98 @@
+/*********************************************************************************************************************
+ *
+ * meshjobrunner.cpp
+ *
+ * Mesh_viewer
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+#include <chrono>
+
+#include "meshjobrunner.h"
+
+
+
+MeshJobRunner::MeshJobRunner(QObject* _parent) : QObject(_parent)
+    , m_running(false)
+{
+    m_pool.setMaxThreadCount(1);
+    m_progressTimer.setInterval(100);
+    QObject::connect(&m_progressTimer, &QTimer::timeout, this, [this]() { emit progressChanged(m_jobControl.progress); });
+}
+
+
+MeshJobRunner::~MeshJobRunner()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+
+bool MeshJobRunner::start(const QString& _name, const std::shared_ptr<Mesh>& _mesh, std::function<void(Mesh&)> _job)
+{
+    if (m_running)
+    {
+        qWarning() << "[Warning] MeshJobRunner::start: " << m_jobName << " is still running, " << _name << " ignored";
+        return false;
+    }
+    if (!_mesh)
+        return false;
+
+    // the job works on a copy, the current mesh stays valid (and displayed) until the job is done
+    std::shared_ptr<Mesh> work = _mesh->clone();
+    m_jobControl.progress = 0;
+    m_jobControl.cancel = false;
+    work->setJobControl(&m_jobControl);
+
+    m_running = true;
+    m_jobName = _name;
+    m_progressTimer.start();
+    emit jobStarted(_name);
+    emit progressChanged(0);
+
+    m_pool.start([this, work, _job]()
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        _job(*work);
+        work->setJobControl(nullptr);
+        auto end = std::chrono::high_resolution_clock::now();
+        qInfo() << "[info] MeshJobRunner: " << m_jobName << " finished in "
+                << std::chrono::duration<double, std::milli>(end - start).count() << " ms";
+
+        // hand the result over to the GUI thread
+        QMetaObject::invokeMethod(this, [this, work]() { finishJob(work); }, Qt::QueuedConnection);
+    });
+
+    return true;
+}
+
+
+std::shared_ptr<Mesh> MeshJobRunner::takeResult()
+{
+    return std::move(m_result);
+}
+
+
+void MeshJobRunner::cancel()
+{
+    if (m_running)
+    {
+        qInfo() << "[info] MeshJobRunner::cancel: cancel " << m_jobName;
+        m_jobControl.cancel = true;
+    }
+}
+
+
+void MeshJobRunner::finishJob(std::shared_ptr<Mesh> _result)
+{
+    m_progressTimer.stop();
+    m_running = false;
+
+    const bool canceled = m_jobControl.cancel;
+    m_result = canceled ? nullptr : _result;
+
+    emit progressChanged(100);
+    emit jobFinished(m_jobName, canceled);
+}
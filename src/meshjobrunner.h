@@ -0,0 +1,135 @@
+/*********************************************************************************************************************
+ *
+ * meshjobrunner.h
+ *
+ * Runs long Mesh operations (smoothing, curvature, ...) in a worker thread
+ *
+ * Mesh_viewer
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+#ifndef MESHJOBRUNNER_H
+#define MESHJOBRUNNER_H
+
+
+#include <functional>
+#include <memory>
+
+#include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "mesh.h"
+
+
+/*!
+* \class MeshJobRunner
+* \brief Runs one Mesh operation at a time in a worker thread, so that the GUI keeps responding (and rendering) meanwhile.
+*        The job works on a copy of the mesh: the original mesh is left untouched until the job is done,
+*        the result is then handed over in a single step (see takeResult()).
+*        Progress is polled from the GUI thread, cancellation is cooperative (see Mesh::reportProgress()).
+*/
+class MeshJobRunner : public QObject
+{
+    Q_OBJECT
+
+    public:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn MeshJobRunner
+        * \brief Default constructor of MeshJobRunner
+        */
+        MeshJobRunner(QObject* _parent = nullptr);
+
+        /*!
+        * \fn ~MeshJobRunner
+        * \brief Destructor of MeshJobRunner: cancel the running job (if any) and wait for it
+        */
+        ~MeshJobRunner();
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                   JOBS                                                      |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn start
+        * \brief start a job on a copy of a mesh
+        * \param _name : name of the job (for log and GUI)
+        * \param _mesh : mesh to process (not modified)
+        * \param _job : operation applied to the copy of the mesh, in a worker thread
+        * \return false if another job is already running
+        */
+        bool start(const QString& _name, const std::shared_ptr<Mesh>& _mesh, std::function<void(Mesh&)> _job);
+
+        /*!
+        * \fn takeResult
+        * \brief get the mesh processed by the last finished job (nullptr if canceled), and release it from the runner
+        */
+        std::shared_ptr<Mesh> takeResult();
+
+        /*!
+        * \fn isRunning
+        * \return true if a job is running
+        */
+        inline bool isRunning() const { return m_running; }
+
+
+    public slots:
+
+        /*!
+        * \fn cancel
+        * \brief SLOT: ask the running job to stop (the job stops at its next progress report)
+        */
+        void cancel();
+
+
+    signals:
+
+        /*!
+        * \fn jobStarted
+        * \brief SIGNAL: a job has been started
+        */
+        void jobStarted(QString _name);
+
+        /*!
+        * \fn progressChanged
+        * \brief SIGNAL: progress of the running job, in [0;100]
+        */
+        void progressChanged(int _progress);
+
+        /*!
+        * \fn jobFinished
+        * \brief SIGNAL: the job is done (result available with takeResult()), or has been canceled
+        */
+        void jobFinished(QString _name, bool _canceled);
+
+
+    private:
+
+        /*!
+        * \fn finishJob
+        * \brief called in the GUI thread once the worker thread is done
+        */
+        void finishJob(std::shared_ptr<Mesh> _result);
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        QThreadPool m_pool;                 /*!< worker threads (a single job at a time, each job being parallelized with OpenMP) */
+        QTimer m_progressTimer;             /*!< polls the progress of the running job */
+        MeshJobControl m_jobControl;        /*!< progress/cancellation shared with the running job */
+
+        bool m_running;                     /*!< true if a job is running */
+        QString m_jobName;                  /*!< name of the running (or last) job */
+        std::shared_ptr<Mesh> m_result;     /*!< mesh processed by the last finished job */
+};
+
+#endif // MESHJOBRUNNER_H
@@ -0,0 +1,73 @@
+/*********************************************************************************************************************
+ *
+ * parallelsort.h
+ *
+ * Parallel sort of std::vector using OpenMP
+ *
+ * Mesh_viewer
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+#ifndef PARALLELSORT_H
+#define PARALLELSORT_H
+
+#include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+/*!
+* \fn parallelSort
+* \brief Sort a vector in parallel: the vector is split in chunks sorted independently,
+*        then sorted chunks are merged pairwise (each round of merges being also parallel).
+*        Falls back to std::sort for small vectors or without OpenMP.
+* \param _data : vector to sort
+* \param _comp : comparison function (strict weak ordering, as for std::sort)
+*/
+template <typename T, typename Compare>
+void parallelSort(std::vector<T>& _data, Compare _comp)
+{
+    const long long n = (long long)_data.size();
+
+    int nbChunks = 1;
+#ifdef _OPENMP
+    nbChunks = omp_get_max_threads();
+#endif
+    // not worth it for small arrays
+    if (nbChunks < 2 || n < 100000)
+    {
+        std::sort(_data.begin(), _data.end(), _comp);
+        return;
+    }
+
+    // bounds of each chunk
+    std::vector<long long> bounds(nbChunks + 1);
+    for (int c = 0; c <= nbChunks; c++)
+        bounds[c] = n * c / nbChunks;
+
+    // sort each chunk
+    #pragma omp parallel for
+    for (int c = 0; c < nbChunks; c++)
+        std::sort(_data.begin() + bounds[c], _data.begin() + bounds[c + 1], _comp);
+
+    // merge chunks pairwise, until a single chunk remains
+    for (int step = 1; step < nbChunks; step *= 2)
+    {
+        #pragma omp parallel for
+        for (int c = 0; c < nbChunks; c += 2 * step)
+        {
+            if (c + step < nbChunks)
+            {
+                int last = std::min(c + 2 * step, nbChunks);
+                std::inplace_merge(_data.begin() + bounds[c], _data.begin() + bounds[c + step], _data.begin() + bounds[last], _comp);
+            }
+        }
+    }
+}
+
+#endif // PARALLELSORT_H
@@ -15,25 +15,20 @@
 // Fragment shader
 #version 150
 
-// UNIFORMS
-uniform vec3 u_lightColor;
+// FEATURES: USE_AMBIENT, USE_DIFFUSE, USE_SPECULAR, USE_TEX, USE_NORMAL_MAP, SHOW_NORMALS, USE_GAMMA_CORREC, 
+// USE_MESH_COL, USE_SCALAR, USE_WIREFRAME and FLAT_SHADING are defined by DrawableMesh for the enabled features only (see enum ShaderFeature)
 
-uniform vec3 u_ambientColor;
-uniform vec3 u_diffuseColor;
-uniform vec3 u_specularColor;
-uniform float u_specularPower;
+// UNIFORM BLOCKS: FrameData and MaterialData are inserted by DrawableMesh (see uniforms.glsl)
 
+// UNIFORMS (texture units, set once at link time)
 uniform sampler2D u_tex;
 uniform sampler2D u_normalMap;
-
-uniform int u_useAmbient;
-uniform int u_useDiffuse;
-uniform int u_useSpecular;
-uniform int u_useTex;
-uniform int u_useNormalMap;
-uniform int u_showNormals;
-uniform int u_useGammaCorrec;
-uniform int u_useMeshCol;
+uniform sampler1DArray u_colormap;
+#ifdef USE_WIREFRAME
+uniform usamplerBuffer u_wireIndices;	// index VBO (3 indices per triangle, 16 or 32 bits)
+uniform samplerBuffer u_wirePositions;	// vertex VBO (3 floats per vertex)
+uniform ivec2 u_wireCluster;			// first triangle and base vertex of the current draw call (16 bits indices)
+#endif
 	
 // INPUT	
 in vec3 vecN;
@@ -45,6 +40,13 @@ in vec3 vert_pos;
 in vec3 vert_uv;
 in vec3 col;
 in vec3 modelN;
+in float scalar;
+#ifdef USE_WIREFRAME
+in vec4 clip_pos;
+#endif
+#ifdef FLAT_SHADING
+in vec3 view_pos;
+#endif
 
 // OUTPUT
 out vec4 frag_color;
@@ -74,111 +76,143 @@ vec3 linear_to_gamma(in vec3 _color)
 }
 
 
-// MAIN
-void main()
+#ifdef USE_WIREFRAME
+vec3 cornerClip(in int _corner)
 {
+	// corners of the current triangle, read from the VBOs (no duplicated vertices nor geometry shader)
+	int vertexId = int(texelFetch(u_wireIndices, 3 * (u_wireCluster.x + gl_PrimitiveID) + _corner).r) + u_wireCluster.y;
+	vec4 position = vec4(texelFetch(u_wirePositions, 3 * vertexId).r, 
+	                     texelFetch(u_wirePositions, 3 * vertexId + 1).r, 
+	                     texelFetch(u_wirePositions, 3 * vertexId + 2).r, 1.0);
+	return (u_mvp * position).xyw;
+}
 
+
+float edgeDistance()
+{
+	// barycentrics of the fragment in its triangle, from the 2D homogeneous corners (Olano and Greer 1997):
+	// no division by w, so corners behind the eye (triangles clipped by the near plane) are handled as well
+	vec3 c0 = cornerClip(0);
+	vec3 c1 = cornerClip(1);
+	vec3 c2 = cornerClip(2);
+	vec3 p = vec3(clip_pos.xy / clip_pos.w, 1.0);		// the fragment itself is in front of the eye
 	
+	vec3 edges = vec3(dot(cross(c1, c2), p), dot(cross(c2, c0), p), dot(cross(c0, c1), p));
+	float sum = edges.x + edges.y + edges.z;
+	if(abs(sum) < 1e-12)
+		return 0.0;
+	vec3 bary = edges / sum;
 	
+	// screen-space derivatives turn barycentrics into pixels, i.e. constant line width
+	vec3 pixels = bary / max(fwidth(bary), vec3(1e-6));
+	return min(pixels.x, min(pixels.y, pixels.z));
+}
+#endif
+
+
+// MAIN
+void main()
+{
 	vec3 l_vecN;
 	vec3 l_vecL;
 	vec3 l_vecV;
 	
+	// interpolated normals, or face normals derived from the position (no face normal attribute, no duplicated vertices)
+#ifdef FLAT_SHADING
+	vec3 l_surfN = normalize(cross(dFdx(view_pos), dFdy(view_pos)));
+	vec3 l_modelN = normalize(cross(dFdx(vert_pos), dFdy(vert_pos)));
+#else
+	vec3 l_surfN = vecN;
 	vec3 l_modelN = modelN;
+#endif
 	
-	if(u_useNormalMap == 1)
-	{
-		// Read new normal from normal map
-		l_vecN = texture(u_normalMap, vert_uv.xy).rgb * 2.0 - 1.0;
-		l_vecN = normalize(l_vecN);
-		
-		// compute TBN matrix
-		mat3 TBN = transpose( mat3(vecT, vecBT, vecN) );
-		// compute new version of L and V in tangent space
-		l_vecL = normalize( TBN * vecL );
-		l_vecV = normalize( TBN * vecV );
-		
-		l_modelN = l_vecN;
+#ifdef USE_NORMAL_MAP
+	// Read new normal from normal map
+	l_vecN = texture(u_normalMap, vert_uv.xy).rgb * 2.0 - 1.0;
+	l_vecN = normalize(l_vecN);
 	
-	}
-	else
-	{
-		l_vecN = vecN;
-		l_vecL = vecL;
-		l_vecV = vecV;
-	}
+	// compute TBN matrix
+	mat3 TBN = transpose( mat3(vecT, vecBT, l_surfN) );
+	// compute new version of L and V in tangent space
+	l_vecL = normalize( TBN * vecL );
+	l_vecV = normalize( TBN * vecV );
+	
+	l_modelN = l_vecN;
+#else
+	l_vecN = l_surfN;
+	l_vecL = vecL;
+	l_vecV = vecV;
+#endif
 	
 	// final color
 	vec4 color = vec4(0.0f, 0.0f, 0.0f, 1.0f);
 	
-	if(u_showNormals == 1)
-	{
-		// -- Render normals --
-		color = vec4(0.5 * l_modelN + 0.5, 1.0);
-	}
-	else
-	{
-		vec3 diff_col = u_diffuseColor;
-		
-		
-		// GET MESH COLOR
-		if(u_useMeshCol == 1)
-		{
-			diff_col = col;
-		}
-		
-		// GET TEXTURE COLOR
-		if(u_useTex == 1)
-		{
-			diff_col = texture(u_tex, vert_uv.xy).rgb;
-		}
-		
-		
-	
-		// -- Render Blinn-Phong shading --
-		
-		vec3 l_vecH = normalize(l_vecL + l_vecV);
-	
-		//DIFFUSE
-		float diffuse = compDiff(l_vecN, l_vecL);
-		if(u_useDiffuse == 1)
-		{
-			color.rgb += diff_col * u_lightColor * diffuse;
-		}
-
-		
-		//SPECULAR
-		if(u_useSpecular == 1)
-		{
-			float specular = specular_normalized(l_vecN, l_vecH, u_specularPower);
-
-			color.rgb += u_specularColor * u_lightColor * specular;
-		}
-		
-		
-		//AMBIENT
-		if(u_useAmbient == 1)
-		{
-			if(u_useTex == 1 || u_useMeshCol == 1)
-			{
-				color.rgb += diff_col * 0.05f;
-			}
-			else
-			{
-				color.rgb += u_ambientColor;
-			}
-		}
-
+#ifdef SHOW_NORMALS
+	// -- Render normals --
+	color = vec4(0.5 * l_modelN + 0.5, 1.0);
+#else
+	vec3 diff_col = u_diffuseColor.rgb;
 	
-	}
+	// GET MESH COLOR
+#ifdef USE_MESH_COL
+	diff_col = col;
+#endif
+	
+	// GET TEXTURE COLOR
+#ifdef USE_TEX
+	diff_col = texture(u_tex, vert_uv.xy).rgb;
+#endif
+	
+	// GET SCALAR FIELD COLOR
+#ifdef USE_SCALAR
+	float range = max(u_scalarRange.y - u_scalarRange.x, 1e-20);
+	float t = clamp((scalar - u_scalarRange.x) / range, 0.0, 1.0);
+	diff_col = texture(u_colormap, vec2(t, float(u_colormapId))).rgb;
+#endif
+	
+	
+	// -- Render Blinn-Phong shading --
+	
+	//DIFFUSE
+#ifdef USE_DIFFUSE
+	float diffuse = compDiff(l_vecN, l_vecL);
+	color.rgb += diff_col * u_lightColor.rgb * diffuse;
+#endif
+	
+	//SPECULAR
+#ifdef USE_SPECULAR
+	vec3 l_vecH = normalize(l_vecL + l_vecV);
+	float specular = specular_normalized(l_vecN, l_vecH, u_specularPower);
+	color.rgb += u_specularColor.rgb * u_lightColor.rgb * specular;
+#endif
+	
+	//AMBIENT
+#ifdef USE_AMBIENT
+#if defined(USE_TEX) || defined(USE_MESH_COL) || defined(USE_SCALAR)
+	color.rgb += diff_col * 0.05f;
+#else
+	color.rgb += u_ambientColor.rgb;
+#endif
+#endif
+	
+#endif // SHOW_NORMALS
 	
 	//GAMMA CORRECTION
-	if(u_useGammaCorrec == 1)
+#ifdef USE_GAMMA_CORREC
+	color.rgb = linear_to_gamma(color.rgb);
+#endif
+	
+	//WIREFRAME (same color as the line pass, see wireframe.frag)
+#ifdef USE_WIREFRAME
+	float edge = 1.0 - smoothstep(0.5 * u_wireWidth - 0.5, 0.5 * u_wireWidth + 0.5, edgeDistance());
+	vec3 wire_col = u_wireColor.rgb;
+	if(u_wireShading == 1)
 	{
-		color.rgb = linear_to_gamma(color.rgb);
+		wire_col *= compDiff(l_surfN, vecL);
 	}
+	color.rgb = mix(color.rgb, wire_col, edge);
+#endif
 	
 	frag_color = color;
 
 }
-
@@ -14,18 +14,17 @@
 #version 150
 #extension GL_ARB_explicit_attrib_location : require
 
+// FEATURES: FLAT_SHADING and USE_WIREFRAME are defined by DrawableMesh when enabled (see enum ShaderFeature)
+
 layout(location = 0) in vec4 a_position;
 layout(location = 1) in vec3 a_normal;
 layout(location = 2) in vec3 a_color;
 layout(location = 3) in vec2 a_uv;
 layout(location = 4) in vec3 a_tangent;
 layout(location = 5) in vec3 a_bitangent;
-layout(location = 6) in vec3 a_facenormal;
+layout(location = 7) in float a_scalar;
 
-uniform int u_flatShading;
-uniform mat4 u_mvp;
-uniform mat4 u_mv;
-uniform vec3 u_lightPosition;
+// UNIFORM BLOCKS: FrameData and MaterialData are inserted by DrawableMesh (see uniforms.glsl)
 
 out vec3 vecN;
 out vec3 vecL;
@@ -36,33 +35,38 @@ out vec3 vert_pos;
 out vec3 vert_uv;
 out vec3 col;
 out vec3 modelN;
+out float scalar;
+#ifdef USE_WIREFRAME
+out vec4 clip_pos;
+#endif
+#ifdef FLAT_SHADING
+out vec3 view_pos;
+#endif
 
 
 void main()
 {
 	vec3 v_eye = vec3(u_mv * a_position);
 
-	// Calculate the view-space normal
-	if(u_flatShading == 1)
-	{
-		modelN = normalize(a_facenormal);
-		vecN = normalize(mat3(u_mv) * a_facenormal);
-	}
-	else
-	{
-		modelN = normalize(a_normal);
-		vecN = normalize(mat3(u_mv) * a_normal);
-	}
+	// Calculate the view-space normal (face normals are computed by the fragment shader for flat shading)
+	modelN = normalize(a_normal);
+	vecN = normalize(mat3(u_mv) * a_normal);
+#ifdef FLAT_SHADING
+	view_pos = v_eye;
+#endif
 
 	
 	// Calculate the view-space light direction
-	vec3 l_vecLight = vec3(mat3(u_mv) * u_lightPosition) ;
+	vec3 l_vecLight = vec3(mat3(u_mv) * u_lightPosition.xyz) ;
 	vecL = normalize(normalize(l_vecLight) - v_eye);
 
 	vecV = -normalize(v_eye);
 	
 	
 	gl_Position = u_mvp * a_position;
+#ifdef USE_WIREFRAME
+	clip_pos = gl_Position;
+#endif
 	
 	vert_pos = a_position.xyz;
 	vert_uv = vec3(a_uv.x, 1.0 - a_uv.y, 0.0);
@@ -71,5 +75,6 @@ void main()
 	vecBT = normalize(mat3(u_mv) * a_bitangent);
 	
 	col = a_color;
+	scalar = a_scalar;
 	
 }
@@ -0,0 +1,36 @@
+/*********************************************************************************************************************
+ *
+ * uniforms.glsl
+ *
+ * Uniform blocks shared by all shaders, inserted by DrawableMesh after the #version and #extension directives
+ *
+ * Mesh_viewer
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+// UNIFORM BLOCKS (see FrameUniforms and MaterialUniforms in drawablemesh.h)
+layout(std140) uniform FrameData
+{
+	mat4 u_mv;
+	mat4 u_mvp;
+	vec4 u_lightPosition;
+	vec4 u_lightColor;
+};
+
+layout(std140) uniform MaterialData
+{
+	vec4 u_ambientColor;
+	vec4 u_diffuseColor;
+	vec4 u_specularColor;
+	vec4 u_wireColor;
+	vec2 u_scalarRange;
+	float u_specularPower;
+	int u_colormapId;
+	int u_wireShading;
+	float u_wireWidth;
+	int u_padding1;
+	int u_padding2;
+};
+
@@ -13,9 +13,7 @@
 // Fragment shader
 #version 150
 
-// UNIFORMS
-uniform vec3 u_diffuseColor;
-uniform int u_shading;
+// UNIFORM BLOCKS: FrameData and MaterialData are inserted by DrawableMesh (see uniforms.glsl)
 
 // INPUT	
 in vec3 vecN;
@@ -39,12 +37,12 @@ void main()
 
 	float diffuse = 1;
 	
-	if(u_shading == 1)
+	if(u_wireShading == 1)
 	{
 		diffuse = compDiff(vecN, vecL);
 	}
 	
-	color.rgb += u_diffuseColor * diffuse;
+	color.rgb += u_wireColor.rgb * diffuse;
 	
 	frag_color = color;
 }
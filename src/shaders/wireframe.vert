@@ -17,9 +17,7 @@
 layout(location = 0) in vec4 a_position;
 layout(location = 1) in vec3 a_normal;
 
-uniform mat4 u_mvp;
-uniform mat4 u_mv;
-uniform vec3 u_lightPosition;
+// UNIFORM BLOCKS: FrameData and MaterialData are inserted by DrawableMesh (see uniforms.glsl)
 
 out vec3 vecN;
 out vec3 vecL;
@@ -32,7 +30,7 @@ void main()
 	vecN = normalize(mat3(u_mv) * a_normal);
 
 	// Calculate the view-space light direction
-	vec3 l_vecLight = vec3(mat3(u_mv) * u_lightPosition) ;
+	vec3 l_vecLight = vec3(mat3(u_mv) * u_lightPosition.xyz) ;
 	vecL = normalize(normalize(l_vecLight) - v_eye);
 	
 	gl_Position = u_mvp * a_position;
@@ -0,0 +1,330 @@
+/*********************************************************************************************************************
+ *
+ * texturemanager.cpp
+ *
+ * Mesh_viewer
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include <QDateTime>
+#include <QtDebug>
+#include <QtLogging>
+#include <QFileInfo>
+#include <QImage>
+
+#include "texturemanager.h"
+
+
+
+TextureManager::TextureManager(QObject* _parent) : QObject(_parent)
+{
+    // each decoding builds its mip chain with OpenMP: a few images at a time are enough
+    m_pool.setMaxThreadCount(2);
+}
+
+
+TextureManager::~TextureManager()
+{
+    m_generation++;
+    m_pool.waitForDone();
+}
+
+
+void TextureManager::request(const QString& _fileName, bool _repeat, std::function<void(GLuint)> _ready)
+{
+    const std::string key = getCacheKey(_fileName, _repeat);
+    if (key.empty())
+    {
+        qCritical() << "[ERROR] TextureManager::request: file not found: " << _fileName;
+        _ready(0);
+        return;
+    }
+
+    auto found = m_cache.find(key);
+    if (found != m_cache.end())
+    {
+        CacheEntry& entry = found->second;
+        entry.refCount++;
+        if (entry.ready)
+        {
+            qInfo() << "[info] TextureManager::request: " << _fileName << " found in cache";
+            _ready(entry.texture);
+        }
+        else
+            entry.callbacks.push_back(_ready);
+        return;
+    }
+
+    CacheEntry& entry = m_cache[key];
+    entry.repeat = _repeat;
+    entry.refCount = 1;
+    entry.callbacks.push_back(_ready);
+
+    const int generation = m_generation;
+    m_pool.start([this, key, _fileName, generation]()
+    {
+        std::shared_ptr<std::vector<TextureLevel> > levels = std::make_shared<std::vector<TextureLevel> >();
+        if (!decode(_fileName, *levels))
+            levels = nullptr;
+
+        // hand the levels over to the GUI thread (dropped if the cache has been cleared meanwhile)
+        QMetaObject::invokeMethod(this, [this, key, levels, generation]()
+        {
+            if (generation == m_generation)
+                finishDecode(key, levels);
+        }, Qt::QueuedConnection);
+    });
+}
+
+
+void TextureManager::release(GLuint _texture)
+{
+    if (_texture == 0)
+        return;
+
+    for (auto it = m_cache.begin(); it != m_cache.end(); ++it)
+    {
+        if (it->second.texture != _texture)
+            continue;
+
+        if (--(it->second.refCount) <= 0)
+        {
+            glDeleteTextures(1, &(it->second.texture));
+            m_cache.erase(it);
+        }
+        return;
+    }
+}
+
+
+size_t TextureManager::continueUploads(size_t _maxBytes)
+{
+    while (!m_uploadQueue.empty() && _maxBytes > 0)
+    {
+        auto found = m_cache.find(m_uploadQueue.front());
+        if (found == m_cache.end() || !found->second.levels)
+        {
+            // released (or queued again) before the end of its decoding
+            m_uploadQueue.pop_front();
+            continue;
+        }
+
+        CacheEntry& entry = found->second;
+        if (entry.texture == 0)
+            createTexture(entry);
+
+        // next rows of the current level (at least one)
+        const TextureLevel& level = (*entry.levels)[entry.uploadLevel];
+        const size_t rowBytes = 4 * (size_t)level.width;
+        const int nbRows = (int)std::clamp<size_t>(_maxBytes / rowBytes, 1, (size_t)(level.height - entry.uploadRow));
+        glBindTexture(GL_TEXTURE_2D, entry.texture);
+        _maxBytes -= std::min(_maxBytes, uploadRows(level, (int)entry.uploadLevel, entry.uploadRow, nbRows));
+
+        entry.uploadRow += nbRows;
+        if (entry.uploadRow < level.height)
+            continue;
+        entry.uploadRow = 0;
+        if (++entry.uploadLevel < entry.levels->size())
+            continue;
+
+        // every level is uploaded: hand the texture over to its requests
+        entry.levels = nullptr;
+        entry.ready = true;
+        m_uploadQueue.pop_front();
+        const GLuint texture = entry.texture;
+        std::vector<std::function<void(GLuint)> > callbacks;
+        callbacks.swap(entry.callbacks);
+        for (auto& callback : callbacks)
+            callback(texture);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // bytes still to upload
+    size_t remaining = 0;
+    for (const std::string& key : m_uploadQueue)
+    {
+        auto found = m_cache.find(key);
+        if (found == m_cache.end() || !found->second.levels)
+            continue;
+
+        const CacheEntry& entry = found->second;
+        for (size_t l = entry.uploadLevel; l < entry.levels->size(); l++)
+            remaining += (*entry.levels)[l].pixels.size();
+        remaining -= 4 * (size_t)(*entry.levels)[entry.uploadLevel].width * entry.uploadRow;
+    }
+    return remaining;
+}
+
+
+void TextureManager::clear()
+{
+    m_generation++;
+    for (auto& cached : m_cache)
+    {
+        if (cached.second.texture)
+            glDeleteTextures(1, &(cached.second.texture));
+    }
+    m_cache.clear();
+    m_uploadQueue.clear();
+
+    if (m_pbos[0])
+        glDeleteBuffers(2, m_pbos);
+    m_pbos[0] = m_pbos[1] = 0;
+}
+
+
+bool TextureManager::decode(const QString& _fileName, std::vector<TextureLevel>& _levels)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    QImage image(_fileName);
+    if (image.isNull())
+        return false;
+    image = image.convertToFormat(QImage::Format_RGBA8888);
+
+    _levels.resize(1);
+    TextureLevel& base = _levels[0];
+    base.width = image.width();
+    base.height = image.height();
+    base.pixels.resize(4 * (size_t)base.width * base.height);
+    const size_t rowBytes = 4 * (size_t)base.width;
+    for (int y = 0; y < base.height; y++)
+        std::memcpy(base.pixels.data() + y * rowBytes, image.constScanLine(y), rowBytes);
+    image = QImage();
+
+    buildMipChain(_levels);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    qInfo() << "[info] TextureManager::decode: " << _fileName << " (" << _levels[0].width << "x" << _levels[0].height << ", "
+            << _levels.size() << " levels) decoded in " << std::chrono::duration<double, std::milli>(end - start).count() << " ms";
+    return true;
+}
+
+
+void TextureManager::buildMipChain(std::vector<TextureLevel>& _levels)
+{
+    while (_levels.back().width > 1 || _levels.back().height > 1)
+    {
+        _levels.emplace_back();
+        const TextureLevel& src = _levels[_levels.size() - 2];
+        TextureLevel& dst = _levels.back();
+        dst.width = std::max(src.width / 2, 1);
+        dst.height = std::max(src.height / 2, 1);
+        dst.pixels.resize(4 * (size_t)dst.width * dst.height);
+
+        // 2x2 box filter (the last row/column of odd sizes is clamped)
+        #pragma omp parallel for
+        for (int y = 0; y < dst.height; y++)
+        {
+            const uint8_t* row0 = src.pixels.data() + 4 * (size_t)src.width * std::min(2 * y, src.height - 1);
+            const uint8_t* row1 = src.pixels.data() + 4 * (size_t)src.width * std::min(2 * y + 1, src.height - 1);
+            uint8_t* out = dst.pixels.data() + 4 * (size_t)dst.width * y;
+            for (int x = 0; x < dst.width; x++)
+            {
+                const int x0 = 4 * std::min(2 * x, src.width - 1);
+                const int x1 = 4 * std::min(2 * x + 1, src.width - 1);
+                for (int c = 0; c < 4; c++)
+                    out[4 * x + c] = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+            }
+        }
+    }
+}
+
+
+void TextureManager::finishDecode(const std::string& _key, std::shared_ptr<std::vector<TextureLevel> > _levels)
+{
+    auto found = m_cache.find(_key);
+    if (found == m_cache.end())
+        return;
+
+    if (!_levels)
+    {
+        qCritical() << "[ERROR] TextureManager::finishDecode: image could not be decoded: " << QString::fromStdString(_key);
+        std::vector<std::function<void(GLuint)> > callbacks;
+        callbacks.swap(found->second.callbacks);
+        m_cache.erase(found);
+        for (auto& callback : callbacks)
+            callback(0);
+        return;
+    }
+
+    found->second.levels = _levels;
+    m_uploadQueue.push_back(_key);
+    emit textureDecoded();
+}
+
+
+void TextureManager::createTexture(CacheEntry& _entry)
+{
+    if (m_pbos[0] == 0)
+        glGenBuffers(2, m_pbos);
+
+    glGenTextures(1, &(_entry.texture));
+    glBindTexture(GL_TEXTURE_2D, _entry.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, _entry.repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, _entry.repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)_entry.levels->size() - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (GLEW_EXT_texture_filter_anisotropic)
+    {
+        GLfloat maxAnisotropy = 1.0f;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::min(maxAnisotropy, s_maxAnisotropy));
+    }
+
+    // storage of every level, filled by uploadRows()
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    for (size_t l = 0; l < _entry.levels->size(); l++)
+    {
+        const TextureLevel& level = (*_entry.levels)[l];
+        glTexImage2D(GL_TEXTURE_2D, (GLint)l, GL_RGBA8, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+}
+
+
+size_t TextureManager::uploadRows(const TextureLevel& _level, int _levelId, int _firstRow, int _nbRows)
+{
+    const size_t rowBytes = 4 * (size_t)_level.width;
+    const size_t nbBytes = rowBytes * _nbRows;
+    const uint8_t* rows = _level.pixels.data() + rowBytes * _firstRow;
+
+    // orphaned pixel buffer: the copy does not wait for the transfer of the previous chunk
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbos[m_nextPBO]);
+    m_nextPBO = 1 - m_nextPBO;
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, nbBytes, nullptr, GL_STREAM_DRAW);
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, nbBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped)
+    {
+        std::memcpy(mapped, rows, nbBytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glTexSubImage2D(GL_TEXTURE_2D, _levelId, 0, _firstRow, _level.width, _nbRows, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    else
+    {
+        // mapping failed: synchronous upload from client memory
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glTexSubImage2D(GL_TEXTURE_2D, _levelId, 0, _firstRow, _level.width, _nbRows, GL_RGBA, GL_UNSIGNED_BYTE, rows);
+    }
+    return nbBytes;
+}
+
+
+std::string TextureManager::getCacheKey(const QString& _fileName, bool _repeat)
+{
+    QFileInfo info(_fileName);
+    if (!info.exists())
+        return std::string();
+
+    // a file modified since it has been cached is loaded again
+    return (info.canonicalFilePath() + "|" + QString::number(info.lastModified().toMSecsSinceEpoch())
+            + (_repeat ? "|repeat" : "|clamp")).toStdString();
+}
@@ -0,0 +1,192 @@
+/*********************************************************************************************************************
+ *
+ * texturemanager.h
+ *
+ * Loads 2D textures in background (decoding, mipmaps) and shares them between meshes
+ *
+ * Mesh_viewer
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+#ifndef TEXTUREMANAGER_H
+#define TEXTUREMANAGER_H
+
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+
+/*!
+* \struct TextureLevel
+* \brief Mipmap level of a decoded texture, RGBA 8 bits per channel
+*/
+struct TextureLevel
+{
+    int width = 0;                  /*!< width in pixels */
+    int height = 0;                 /*!< height in pixels */
+    std::vector<uint8_t> pixels;    /*!< rows of RGBA pixels (first row at t = 0) */
+};
+
+
+/*!
+* \class TextureManager
+* \brief Loads 2D textures without blocking the GUI thread:
+*        1. image files are decoded and their mip chain is built (in parallel) by worker threads;
+*        2. levels are uploaded by chunks through pixel buffer objects, one chunk per call to continueUploads() (GUI thread, GL context current).
+*        Textures are cached by file path and modification time, so that the same file is decoded and uploaded once
+*        and its GL texture is shared by all the meshes using it (textures are reference counted, see release()).
+*/
+class TextureManager : public QObject
+{
+    Q_OBJECT
+
+    public:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn TextureManager
+        * \brief Default constructor of TextureManager
+        */
+        TextureManager(QObject* _parent = nullptr);
+
+        /*!
+        * \fn ~TextureManager
+        * \brief Destructor of TextureManager: wait for the decoding threads (GL textures must be deleted before with clear())
+        */
+        ~TextureManager();
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                 TEXTURES                                                    |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn request
+        * \brief get the texture of an image file (GUI thread, GL context current):
+        *        _ready is called immediately if the texture is in the cache, or once it has been decoded and uploaded otherwise.
+        *        Each call holds a reference on the texture, to be released with release() once unused.
+        * \param _fileName : image file
+        * \param _repeat : true for GL_REPEAT wrapping, false for GL_CLAMP_TO_EDGE
+        * \param _ready : receives the texture (0 if the file could not be decoded)
+        */
+        void request(const QString& _fileName, bool _repeat, std::function<void(GLuint)> _ready);
+
+        /*!
+        * \fn release
+        * \brief release a reference on a texture given by request(), the texture is deleted with its last reference (GL context current)
+        */
+        void release(GLuint _texture);
+
+        /*!
+        * \fn continueUploads
+        * \brief upload the next chunk of the decoded textures (GUI thread, GL context current),
+        *        and hand over the textures whose upload is finished
+        * \param _maxBytes : maximal number of bytes uploaded by this call
+        * \return number of bytes of decoded textures still to upload
+        */
+        size_t continueUploads(size_t _maxBytes);
+
+        /*!
+        * \fn clear
+        * \brief delete all textures and pixel buffers, pending requests are dropped (GL context current)
+        */
+        void clear();
+
+
+    signals:
+
+        /*!
+        * \fn textureDecoded
+        * \brief SIGNAL: a texture has been decoded and waits for continueUploads()
+        */
+        void textureDecoded();
+
+
+    private:
+
+        /*!
+        * \struct CacheEntry
+        * \brief texture of an image file (in the cache as soon as it is requested)
+        */
+        struct CacheEntry
+        {
+            GLuint texture = 0;                                     /*!< GL texture (0 until the upload starts) */
+            bool repeat = true;                                     /*!< wrapping mode */
+            bool ready = false;                                     /*!< true once every level is uploaded */
+            int refCount = 0;                                       /*!< number of requests not released yet */
+            std::vector<std::function<void(GLuint)> > callbacks;    /*!< requests waiting for the texture */
+            std::shared_ptr<std::vector<TextureLevel> > levels;     /*!< decoded levels, released once uploaded */
+            size_t uploadLevel = 0;                                 /*!< level being uploaded */
+            int uploadRow = 0;                                      /*!< first row of the level not uploaded yet */
+        };
+
+        /*!
+        * \fn decode
+        * \brief (worker thread) decode an image file and build its mip chain
+        * \return false if the file could not be decoded
+        */
+        static bool decode(const QString& _fileName, std::vector<TextureLevel>& _levels);
+
+        /*!
+        * \fn buildMipChain
+        * \brief append the levels down to 1x1 to a decoded image (2x2 box filter, rows computed in parallel)
+        */
+        static void buildMipChain(std::vector<TextureLevel>& _levels);
+
+        /*!
+        * \fn finishDecode
+        * \brief (GUI thread) queue a decoded texture for upload, or hand the failure over to its requests
+        */
+        void finishDecode(const std::string& _key, std::shared_ptr<std::vector<TextureLevel> > _levels);
+
+        /*!
+        * \fn createTexture
+        * \brief create the GL texture of an entry and allocate its levels (sampling with trilinear and anisotropic filtering)
+        */
+        void createTexture(CacheEntry& _entry);
+
+        /*!
+        * \fn uploadRows
+        * \brief copy rows of a level to the next pixel buffer, and from it to the texture
+        * \return number of bytes uploaded
+        */
+        size_t uploadRows(const TextureLevel& _level, int _levelId, int _firstRow, int _nbRows);
+
+        /*!
+        * \fn getCacheKey
+        * \brief key of an image file in the cache: canonical path, modification time and wrapping mode
+        */
+        static std::string getCacheKey(const QString& _fileName, bool _repeat);
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        QThreadPool m_pool;                                         /*!< decoding threads */
+        std::unordered_map<std::string, CacheEntry> m_cache;        /*!< textures by cache key */
+        std::deque<std::string> m_uploadQueue;                      /*!< keys of the decoded textures waiting for upload, in decoding order */
+        GLuint m_pbos[2] = { 0, 0 };                                /*!< pixel buffers used alternately, a chunk is copied while the previous one is transferred */
+        int m_nextPBO = 0;                                          /*!< pixel buffer used by the next chunk */
+        int m_generation = 0;                                       /*!< incremented by clear(), decodings started before are dropped */
+
+        static constexpr float s_maxAnisotropy = 8.0f;              /*!< anisotropic filtering (if supported) */
+};
+
+#endif // TEXTUREMANAGER_H
@@ -0,0 +1,769 @@
+/*********************************************************************************************************************
+ *
+ * trimeshche.cpp
+ *
+ * Mesh_viewer
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+#include <chrono>
+
+#include "trimeshche.h"
+#include "parallelsort.h"
+#include "curvature.h"
+
+
+
+TriMeshCHE::TriMeshCHE() : Mesh()
+    , m_isVertDuplicated(false)
+{}
+
+
+TriMeshCHE::~TriMeshCHE()
+{}
+
+
+std::shared_ptr<Mesh> TriMeshCHE::clone() const
+{
+    return std::make_shared<TriMeshCHE>(*this);
+}
+
+
+void TriMeshCHE::getVertices(std::vector<glm::vec3>& _vertices)
+{
+    MeshBuffers buffers;
+    getBuffers(buffers, ATTRIB_VERTEX);
+    _vertices.swap(buffers.vertices);
+}
+
+
+void TriMeshCHE::getNormals(std::vector<glm::vec3>& _normals)
+{
+    MeshBuffers buffers;
+    getBuffers(buffers, ATTRIB_NORMAL);
+    _normals.swap(buffers.normals);
+}
+
+
+void TriMeshCHE::getIndices(std::vector<uint32_t>& _indices)
+{
+    MeshBuffers buffers;
+    getBuffers(buffers, ATTRIB_INDEX);
+    _indices.swap(buffers.indices);
+}
+
+
+void TriMeshCHE::getColors(std::vector<glm::vec3>& _colors)
+{
+    MeshBuffers buffers;
+    getBuffers(buffers, ATTRIB_COLOR);
+    _colors.swap(buffers.colors);
+}
+
+
+void TriMeshCHE::getTexCoords(std::vector<glm::vec2>& _texcoords)
+{
+    MeshBuffers buffers;
+    getBuffers(buffers, ATTRIB_TEXCOORD);
+    _texcoords.swap(buffers.texcoords);
+}
+
+
+void TriMeshCHE::getTangents(std::vector<glm::vec3>& _tangents)
+{
+    MeshBuffers buffers;
+    getBuffers(buffers, ATTRIB_TANGENT);
+    _tangents.swap(buffers.tangents);
+}
+
+
+void TriMeshCHE::getBitangents(std::vector<glm::vec3>& _bitangents)
+{
+    MeshBuffers buffers;
+    getBuffers(buffers, ATTRIB_BITANGENT);
+    _bitangents.swap(buffers.bitangents);
+}
+
+
+void TriMeshCHE::getFaceNormals(std::vector<glm::vec3>& _facenormals)
+{
+    MeshBuffers buffers;
+    getBuffers(buffers, ATTRIB_FACENORMAL);
+    _facenormals.swap(buffers.facenormals);
+}
+
+
+void TriMeshCHE::getScalars(std::vector<float>& _scalars)
+{
+    MeshBuffers buffers;
+    getBuffers(buffers, ATTRIB_SCALAR);
+    _scalars.swap(buffers.scalars);
+}
+
+
+void TriMeshCHE::getBuffers(MeshBuffers& _buffers, unsigned int _attribs)
+{
+    const bool hasNormals = (m_normals.size() == m_positions.size());
+    const bool hasColors = (m_colors.size() == m_positions.size());
+    const bool hasScalars = (m_scalars.size() == m_positions.size());
+
+    if(!useCornerLayout())
+    {
+        // vertices are shared by adjacent faces: vertex arrays are exported as they are
+        if(_attribs & ATTRIB_VERTEX)
+            _buffers.vertices = m_positions;
+        if(_attribs & ATTRIB_NORMAL)
+            _buffers.normals = hasNormals ? m_normals : std::vector<glm::vec3>();
+        if(_attribs & ATTRIB_INDEX)
+            _buffers.indices = m_indices;
+        if(_attribs & ATTRIB_COLOR)
+            _buffers.colors = hasColors ? m_colors : std::vector<glm::vec3>();
+        if(_attribs & ATTRIB_TEXCOORD)
+            _buffers.texcoords.clear();
+        if(_attribs & ATTRIB_TANGENT)
+            _buffers.tangents.clear();
+        if(_attribs & ATTRIB_BITANGENT)
+            _buffers.bitangents.clear();
+        if(_attribs & ATTRIB_FACENORMAL)
+            _buffers.facenormals.clear();
+        if(_attribs & ATTRIB_SCALAR)
+            _buffers.scalars = hasScalars ? m_scalars : std::vector<float>();
+        return;
+    }
+
+    // one vertex per face corner (i.e. per halfedge)
+    const int nbCorners = (int)nbHalfedges();
+    const bool hasTexCoords = (m_texcoords.size() == m_indices.size());
+    const bool hasTB = m_TBComputed && (m_tangents.size() == m_indices.size());
+    const bool hasFaceNormals = (m_faceNormals.size() == nbFaces());
+
+    // select arrays to fill, empty the others
+    auto prepare = [&](auto& _array, MeshAttrib _attrib, bool _available)
+    {
+        if((_attribs & _attrib) && _available)
+            _array.resize(nbCorners);
+        else if(_attribs & _attrib)
+            _array.clear();
+        return (_attribs & _attrib) && _available;
+    };
+    const bool fillVertices = prepare(_buffers.vertices, ATTRIB_VERTEX, true);
+    const bool fillNormals = prepare(_buffers.normals, ATTRIB_NORMAL, hasNormals);
+    const bool fillIndices = prepare(_buffers.indices, ATTRIB_INDEX, true);
+    const bool fillColors = prepare(_buffers.colors, ATTRIB_COLOR, hasColors);
+    const bool fillTexCoords = prepare(_buffers.texcoords, ATTRIB_TEXCOORD, hasTexCoords);
+    const bool fillTangents = prepare(_buffers.tangents, ATTRIB_TANGENT, hasTB);
+    const bool fillBitangents = prepare(_buffers.bitangents, ATTRIB_BITANGENT, hasTB);
+    const bool fillFaceNormals = prepare(_buffers.facenormals, ATTRIB_FACENORMAL, hasFaceNormals);
+    const bool fillScalars = prepare(_buffers.scalars, ATTRIB_SCALAR, hasScalars);
+
+    #pragma omp parallel for
+    for (int c = 0; c < nbCorners; c++)
+    {
+        uint32_t v = m_indices[c];
+        if(fillVertices)
+            _buffers.vertices[c] = m_positions[v];
+        if(fillNormals)
+            _buffers.normals[c] = m_normals[v];
+        if(fillIndices)
+            _buffers.indices[c] = c;
+        if(fillColors)
+            _buffers.colors[c] = m_colors[v];
+        if(fillTexCoords)
+            _buffers.texcoords[c] = m_texcoords[c];
+        if(fillTangents)
+            _buffers.tangents[c] = m_tangents[c];
+        if(fillBitangents)
+            _buffers.bitangents[c] = m_bitangents[c];
+        if(fillFaceNormals)
+            _buffers.facenormals[c] = m_faceNormals[c / 3];
+        if(fillScalars)
+            _buffers.scalars[c] = m_scalars[v];
+    }
+}
+
+
+bool TriMeshCHE::readFile(const std::string& _filename)
+{
+    TriMeshSoup soup;
+    if(!soup.readFile(_filename))
+        return false;
+
+    if(!buildFromSoup(soup))
+    {
+        qCritical() << "[ERROR] TriMeshCHE::readFile: no face in " << _filename;
+        return false;
+    }
+
+    qInfo() << "[info] TriMeshCHE::readFile: finished ";
+    return true;
+}
+
+
+bool TriMeshCHE::buildFromSoup(const TriMeshSoup& _soup)
+{
+    const std::vector<glm::vec3>& soupVertices = _soup.getVertexArray();
+    const std::vector<glm::vec3>& soupNormals = _soup.getNormalArray();
+    const std::vector<uint32_t>& soupIndices = _soup.getIndexArray();
+    const std::vector<glm::vec3>& soupColors = _soup.getColorArray();
+    const std::vector<glm::vec2>& soupTexcoords = _soup.getTexCoordArray();
+
+    const bool hasNormals = (soupNormals.size() == soupVertices.size());
+    const bool hasColors = (soupColors.size() == soupVertices.size());
+    const bool hasUVs = (soupTexcoords.size() == soupVertices.size());
+
+    // triangles on the vertices of the file
+    std::vector<uint32_t> weldedSrc;        // soup vertex of each vertex
+    std::vector<uint32_t> faceSrc;          // soup face of each face
+    int nbDiscarded = _soup.getWeldedTriangles(weldedSrc, m_indices, faceSrc);
+    if(nbDiscarded > 0)
+        qWarning() << "[Warning] TriMeshCHE::buildFromSoup: " << nbDiscarded << " degenerated faces discarded";
+    if(m_indices.empty())
+        return false;
+
+    const int nbVerts = (int)weldedSrc.size();
+    const int nbCorners = (int)m_indices.size();
+
+    m_positions.resize(nbVerts);
+    m_colors.resize(hasColors ? nbVerts : 0);
+    m_normals.resize(nbVerts);
+    #pragma omp parallel for
+    for (int v = 0; v < nbVerts; v++)
+    {
+        m_positions[v] = soupVertices[weldedSrc[v]];
+        if(hasColors)
+            m_colors[v] = soupColors[weldedSrc[v]];
+        if(hasNormals)
+            m_normals[v] = soupNormals[weldedSrc[v]];
+    }
+
+    // per-corner attributes come from the soup vertex of each corner
+    m_texcoords.resize(hasUVs ? nbCorners : 0);
+    int nbInconsistent = 0;
+    #pragma omp parallel for reduction(+:nbInconsistent)
+    for (int c = 0; c < nbCorners; c++)
+    {
+        uint32_t soupVert = soupIndices[3 * faceSrc[c / 3] + c % 3];
+        if(hasUVs)
+            m_texcoords[c] = soupTexcoords[soupVert];
+        // soup normals are only kept if all the soup vertices welded together agree
+        if(hasNormals && soupNormals[soupVert] != m_normals[m_indices[c]])
+            nbInconsistent++;
+    }
+
+    m_tangents.clear();
+    m_bitangents.clear();
+    m_faceNormals.clear();
+    m_scalars.clear();
+    m_TBComputed = false;
+    m_isVertDuplicated = false;
+
+    buildTopology();
+
+    if(!hasNormals || nbInconsistent > 0)
+    {
+        qInfo() << "[info] TriMeshCHE::buildFromSoup: Normals not provided, compute them ";
+        computeNormals();
+    }
+
+    qInfo() << "[info] TriMeshCHE::buildFromSoup: " << nbVerts << " vertices, " << nbFaces() << " faces";
+
+    return true;
+}
+
+
+bool TriMeshCHE::writeFile(const std::string& _filename)
+{
+    std::string ext = _filename.substr(_filename.find_last_of(".") + 1);
+    if(ext != "obj" && ext != "off")
+    {
+        qCritical() << "[ERROR] TriMeshCHE::writeFile: Invalid file extension: only .obj and .off are supported";
+        return false;
+    }
+
+    std::ofstream file(_filename);
+    if(!file.is_open())
+    {
+        qCritical() << "[ERROR] TriMeshCHE::writeFile: Cannot write to " << _filename;
+        return false;
+    }
+
+    if(ext == "obj")
+    {
+        const bool hasNormals = (m_normals.size() == m_positions.size());
+        file << "# " << nbVertices() << " vertices, " << nbFaces() << " faces\n";
+        for (const glm::vec3& p : m_positions)
+            file << "v " << p.x << " " << p.y << " " << p.z << "\n";
+        if(hasNormals)
+            for (const glm::vec3& n : m_normals)
+                file << "vn " << n.x << " " << n.y << " " << n.z << "\n";
+        for (uint32_t f = 0; f < nbFaces(); f++)
+        {
+            file << "f";
+            for (int k = 0; k < 3; k++)
+            {
+                // OBJ indices start at 1
+                uint32_t v = m_indices[3 * f + k] + 1;
+                if(hasNormals)
+                    file << " " << v << "//" << v;
+                else
+                    file << " " << v;
+            }
+            file << "\n";
+        }
+    }
+    else
+    {
+        file << "OFF\n" << nbVertices() << " " << nbFaces() << " 0\n";
+        for (const glm::vec3& p : m_positions)
+            file << p.x << " " << p.y << " " << p.z << "\n";
+        for (uint32_t f = 0; f < nbFaces(); f++)
+            file << "3 " << m_indices[3 * f] << " " << m_indices[3 * f + 1] << " " << m_indices[3 * f + 2] << "\n";
+    }
+
+    file.close();
+    return true;
+}
+
+
+void TriMeshCHE::buildTopology()
+{
+    const int nbVerts = (int)nbVertices();
+    const int nbHes = (int)nbHalfedges();
+
+    // sort halfedges by undirected edge key (min vertex, max vertex)
+    std::vector< std::pair<uint64_t, uint32_t> > sortedHe(nbHes);
+    #pragma omp parallel for
+    for (int h = 0; h < nbHes; h++)
+    {
+        uint64_t a = fromVertex(h);
+        uint64_t b = toVertex(h);
+        sortedHe[h] = std::make_pair( (std::min(a, b) << 32) | std::max(a, b), (uint32_t)h );
+    }
+    parallelSort(sortedHe, std::less< std::pair<uint64_t, uint32_t> >());
+
+    // pair halfedges of each edge (each group is processed from its first element)
+    m_opposite.assign(nbHes, INVALID_INDEX);
+    int nbComplexEdges = 0;
+    #pragma omp parallel for reduction(+:nbComplexEdges)
+    for (int i = 0; i < nbHes; i++)
+    {
+        if(i > 0 && sortedHe[i].first == sortedHe[i-1].first)
+            continue;
+
+        int groupEnd = i + 1;
+        while(groupEnd < nbHes && sortedHe[groupEnd].first == sortedHe[i].first)
+            groupEnd++;
+
+        if(groupEnd - i == 2)
+        {
+            uint32_t h0 = sortedHe[i].second;
+            uint32_t h1 = sortedHe[i + 1].second;
+            // faces must have consistent orientations
+            if(fromVertex(h0) == toVertex(h1))
+            {
+                m_opposite[h0] = h1;
+                m_opposite[h1] = h0;
+            }
+            else
+                nbComplexEdges++;
+        }
+        else if(groupEnd - i > 2)
+            nbComplexEdges++;
+    }
+    if(nbComplexEdges > 0)
+        qWarning() << "[Warning] TriMeshCHE::buildTopology: " << nbComplexEdges << " complex edges left open";
+
+    // outgoing halfedge of each vertex: any one, then a boundary one if any
+    m_vertHalfedge.assign(nbVerts, INVALID_INDEX);
+    std::vector<uint32_t> nbOut(nbVerts, 0);
+    #pragma omp parallel for
+    for (int h = 0; h < nbHes; h++)
+    {
+        #pragma omp atomic write
+        m_vertHalfedge[fromVertex(h)] = (uint32_t)h;
+        #pragma omp atomic
+        nbOut[fromVertex(h)]++;
+    }
+    #pragma omp parallel for
+    for (int h = 0; h < nbHes; h++)
+    {
+        if(m_opposite[h] == INVALID_INDEX)
+        {
+            #pragma omp atomic write
+            m_vertHalfedge[fromVertex(h)] = (uint32_t)h;
+        }
+    }
+
+    // a vertex is manifold if turning around it reaches all its outgoing halfedges
+    m_vertManifold.assign(nbVerts, 1);
+    int nbNonManifold = 0;
+    #pragma omp parallel for reduction(+:nbNonManifold)
+    for (int v = 0; v < nbVerts; v++)
+    {
+        uint32_t cpt = 0;
+        forEachOutHalfedge(v, [&cpt](uint32_t) { cpt++; });
+        if(cpt != nbOut[v])
+        {
+            m_vertManifold[v] = 0;
+            nbNonManifold++;
+        }
+    }
+    if(nbNonManifold > 0)
+        qWarning() << "[Warning] TriMeshCHE::buildTopology: " << nbNonManifold << " non-manifold vertices";
+}
+
+
+void TriMeshCHE::computeAABB()
+{
+    if(!m_positions.empty())
+    {
+        glm::vec3 bbMin = m_positions[0];
+        glm::vec3 bbMax = m_positions[0];
+
+        #pragma omp parallel
+        {
+            glm::vec3 localMin = bbMin, localMax = bbMax;
+            #pragma omp for nowait
+            for (int v = 0; v < (int)m_positions.size(); v++)
+            {
+                localMin = glm::min(localMin, m_positions[v]);
+                localMax = glm::max(localMax, m_positions[v]);
+            }
+            #pragma omp critical
+            {
+                bbMin = glm::min(bbMin, localMin);
+                bbMax = glm::max(bbMax, localMax);
+            }
+        }
+
+        m_bBoxMin = bbMin;
+        m_bBoxMax = bbMax;
+    }
+    else
+    {
+        qWarning() << "[Warning] TriMeshCHE::computeAABB: Empty vertices array";
+        m_bBoxMin = glm::vec3(0.0f, 0.0f, 0.0f);
+        m_bBoxMax = glm::vec3(0.0f, 0.0f, 0.0f);
+    }
+}
+
+
+void TriMeshCHE::computeNormals()
+{
+    computeFaceNormals();
+    if ( !reportProgress(0.5f) )
+    {
+        qInfo() << "[info] TriMeshCHE::computeNormals: Normals calculation canceled";
+        return;
+    }
+
+    // vertex normals: weighted sum of the normals of adjacent faces (each vertex only writes its own normal)
+    const int nbVerts = (int)nbVertices();
+    m_normals.resize(nbVerts);
+    #pragma omp parallel for
+    for (int v = 0; v < nbVerts; v++)
+    {
+        glm::vec3 n(0.0f);
+        forEachOutHalfedge(v, [&](uint32_t _h)
+        {
+            float weight = 1.0f;
+            if ( m_normalWeighting != NORMAL_WEIGHT_UNIFORM )
+            {
+                glm::vec3 e1 = m_positions[toVertex(_h)] - m_positions[v];
+                glm::vec3 e2 = m_positions[fromVertex(prevHalfedge(_h))] - m_positions[v];
+                glm::vec3 c = glm::cross(e1, e2);
+                weight = (m_normalWeighting == NORMAL_WEIGHT_AREA) ? 0.5f * glm::length(c)
+                                                                    : std::atan2(glm::length(c), glm::dot(e1, e2));
+            }
+            n += weight * m_faceNormals[face(_h)];
+        });
+        float l = glm::length(n);
+        m_normals[v] = (l > 0.0f) ? n / l : glm::vec3(0.0f);
+    }
+
+    qInfo() << "[info] TriMeshCHE::computeNormals: Normals computed";
+}
+
+
+void TriMeshCHE::computeFaceNormals()
+{
+    const int nbF = (int)nbFaces();
+    m_faceNormals.resize(nbF);
+    #pragma omp parallel for
+    for (int f = 0; f < nbF; f++)
+    {
+        const glm::vec3& p0 = m_positions[m_indices[3 * f]];
+        const glm::vec3& p1 = m_positions[m_indices[3 * f + 1]];
+        const glm::vec3& p2 = m_positions[m_indices[3 * f + 2]];
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float l = glm::length(n);
+        m_faceNormals[f] = (l > 0.0f) ? n / l : glm::vec3(0.0f);
+    }
+}
+
+
+void TriMeshCHE::computeTB()
+{
+    if(m_texcoords.size() != m_indices.size())
+    {
+        qWarning() << "[Warning] TriMeshCHE::computeTB: vertex UV not available";
+        return;
+    }
+
+    const int nbF = (int)nbFaces();
+    m_tangents.resize(m_indices.size());
+    m_bitangents.resize(m_indices.size());
+
+    // each face writes the tangent and bitangent of its own three corners,
+    // faces are processed by blocks to report progress (and check cancellation) between them
+    const int blockFaces = 65536;
+    for (int first = 0; first < nbF; first += blockFaces)
+    {
+        const int last = std::min(first + blockFaces, nbF);
+        #pragma omp parallel for
+        for (int f = first; f < last; f++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t c1 = 3 * f + k;
+                uint32_t c2 = 3 * f + (k + 1) % 3;
+                uint32_t c3 = 3 * f + (k + 2) % 3;
+                const glm::vec3& p1 = m_positions[m_indices[c1]];
+                const glm::vec3& p2 = m_positions[m_indices[c2]];
+                const glm::vec3& p3 = m_positions[m_indices[c3]];
+
+                // compute delta vecors (i.e. variation in point coords and uv coords along each edge)
+                glm::vec3 tangent, bitangent;
+                glm::vec3 delta_uv1(m_texcoords[c2] - m_texcoords[c1], 0.0f);
+                glm::vec3 delta_uv2(m_texcoords[c3] - m_texcoords[c1], 0.0f);
+                compTandBT(p2 - p1, p3 - p1, delta_uv1, delta_uv2, tangent, bitangent);
+
+                m_tangents[c1] = tangent;
+                m_bitangents[c1] = bitangent;
+            }
+        }
+
+        if ( !reportProgress( (float)last / (float)nbF ) )
+        {
+            qInfo() << "[info] TriMeshCHE::computeTB: Tangents and Bitangents calculation canceled";
+            return;
+        }
+    }
+
+    qInfo() << "[info] TriMeshCHE::computeTB: Tangents and Bitangents computed";
+    m_TBComputed = true;
+}
+
+
+void TriMeshCHE::lapSmooth(unsigned int _nbIter, float _fact)
+{
+    if ( _fact > 1.0f )
+    {
+        qWarning() << "[Warning] TriMeshCHE::lapSmooth: factor larger than 1";
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    const int nbVerts = (int)nbVertices();
+    // this vector stores the computed centers of gravity
+    std::vector<glm::vec3> vecCogs(nbVerts);
+
+    for (unsigned int i = 0; i < _nbIter; i++)
+    {
+        // First pass: center of gravity of the 1-ring neighborhood of each vertex
+        #pragma omp parallel for
+        for (int v = 0; v < nbVerts; v++)
+        {
+            glm::vec3 cog(0.0f);
+            float valence = 0.0f;
+            forEachNeighbor(v, [&](uint32_t _vj) { cog += m_positions[_vj]; valence++; });
+            vecCogs[v] = (valence > 0.0f) ? cog / valence : m_positions[v];
+        }
+
+        // Second pass: move inner vertices along the Laplacian vector
+        #pragma omp parallel for
+        for (int v = 0; v < nbVerts; v++)
+        {
+            if ( !isBoundary(v) && isManifold(v) )
+                m_positions[v] += _fact * (vecCogs[v] - m_positions[v]);
+        }
+
+        if ( !reportProgress( (float)(i + 1) / (float)_nbIter ) )
+        {
+            qInfo() << "[info] TriMeshCHE::lapSmooth: Laplacian smoothing canceled after " << i + 1 << " iterations";
+            return;
+        }
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    computeNormals();
+
+    qInfo() << "[info] TriMeshCHE::lapSmooth: Laplacian smoothing finished in "
+            << std::chrono::duration<double, std::milli>(end - start).count() << " ms";
+}
+
+
+void TriMeshCHE::duplicateVertices()
+{
+    // vertices are only duplicated in the exported buffers (see getBuffers())
+    if ( m_faceNormals.size() != nbFaces() )
+        computeFaceNormals();
+    m_isVertDuplicated = true;
+
+    qInfo() << "[info] TriMeshCHE::duplicateVertices: Vertices duplicated";
+}
+
+
+void TriMeshCHE::computeSurfVar()
+{
+    // Surface variation is calculated using the algorithm described in :
+    // Pauly et al., "Efficient Simplification of Point-Sampled Surfaces", IEEE Visualization, 2002
+    // https://www.graphics.rwth-aachen.de/media/papers/p_Pau021.pdf
+
+    qInfo() << "[info] TriMeshCHE::computeSurfVar: scalar field will be overwritten by surface variation ";
+
+    const int nbVerts = (int)nbVertices();
+    m_scalars.resize(nbVerts);
+    // vertices are processed by blocks, to report progress (and check for cancellation) between blocks
+    const int blockSize = 65536;
+    for (int b = 0; b < nbVerts; b += blockSize)
+    {
+        #pragma omp parallel for
+        for (int v = b; v < std::min(b + blockSize, nbVerts); v++)
+            m_scalars[v] = (float)compLocalVariation(v);
+
+        if ( !reportProgress( (float)std::min(b + blockSize, nbVerts) / (float)nbVerts ) )
+        {
+            qInfo() << "[info] TriMeshCHE::computeSurfVar: Surface variation calculation canceled";
+            return;
+        }
+    }
+
+    qInfo() << "[info] TriMeshCHE::computeSurfVar: Surface variation calculation finished, show scalar field to see the result ";
+}
+
+
+double TriMeshCHE::compLocalVariation(uint32_t _v) const
+{
+    // point cloud = the current vertex and its 1-ring neighborhood
+    std::vector<glm::vec3> points;
+    points.push_back(m_positions[_v]);
+    forEachNeighbor(_v, [&](uint32_t _vj) { points.push_back(m_positions[_vj]); });
+
+    // Compute the centroid (center of gravity)
+    glm::vec3 cog(0.0f);
+    for (const glm::vec3& p : points)
+        cog += p;
+    cog /= (float)points.size();
+
+    // Compute C matrix (C = M^t * M, with M the difference between centroid and each vertex)
+    Eigen::Matrix3d C = Eigen::Matrix3d::Zero();
+    for (const glm::vec3& p : points)
+    {
+        Eigen::Vector3d var(p.x - cog.x, p.y - cog.y, p.z - cog.z);
+        C += var * var.transpose();
+    }
+
+    // eigen values decomposition of C (symmetric), sorted in increasing order
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(C, Eigen::EigenvaluesOnly);
+    Eigen::Vector3d lambda = solver.eigenvalues();
+
+    // Compute surface variation sigma = lambda0 / (lambda0 + lambda1 + lambda2)
+    double sum = lambda(0) + lambda(1) + lambda(2);
+    return (sum > 0.0) ? lambda(0) / sum : 0.0;
+}
+
+
+void TriMeshCHE::computeMeanCurv()
+{
+    // Discrete Mean Curvature is calculated using the algorithm described in :
+    // Using Meyer et al., "Discrete Differential-Geometry Operators for Triangulated 2-Manifolds", Visualization and Mathematics III, 2003
+    // http://multires.caltech.edu/pubs/diffGeoOps.pdf
+
+    qInfo() << "[info] TriMeshCHE::computeMeanCurv: scalar field will be overwritten by mean curvature ";
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // mean, Gaussian and principal curvatures are all computed in a single sweep
+    compVertCurvatures();
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    m_scalars = m_meanCurv;
+
+    qInfo() << "[info] TriMeshCHE::computeMeanCurv: Mean curvature calculation finished in "
+            << std::chrono::duration<double, std::milli>(end - start).count() << " ms, show scalar field to see the result ";
+}
+
+
+void TriMeshCHE::compFaceCurvTerms(std::vector<float>& _cotOpp, std::vector<float>& _angle, std::vector<float>& _areaMixed)
+{
+    // corner k of the face f is the from-vertex of the halfedge 3f+k
+    compCurvatureTerms((int)nbFaces(), nbHalfedges(), [this](int _f, size_t* _hh, glm::vec3* _p)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                _hh[k] = 3 * _f + k;
+                _p[k] = m_positions[m_indices[3 * _f + k]];
+            }
+        },
+        _cotOpp, _angle, _areaMixed);
+}
+
+
+void TriMeshCHE::compVertCurvatures()
+{
+    std::vector<float> cotOpp, angle, areaMixed;
+    compFaceCurvTerms(cotOpp, angle, areaMixed);
+    if ( !reportProgress(0.5f) )
+        return;
+
+    const int nbVerts = (int)nbVertices();
+    m_meanCurv.assign(nbVerts, 0.0f);
+    m_gaussCurv.assign(nbVerts, 0.0f);
+    m_minCurv.assign(nbVerts, 0.0f);
+    m_maxCurv.assign(nbVerts, 0.0f);
+
+    // gather cached face terms around each vertex (each vertex only writes its own values)
+    #pragma omp parallel for
+    for (int v = 0; v < nbVerts; v++)
+    {
+        if (!isManifold(v) || vertexHalfedge(v) == INVALID_INDEX)
+            continue;
+
+        const glm::vec3& x_i = m_positions[v];
+
+        glm::vec3 K(0.0f);
+        double A = 0.0;
+        double sumAngles = 0.0;
+        uint32_t last = INVALID_INDEX;
+
+        // for each outgoing halfedge (x_i -> x_j) ...
+        forEachOutHalfedge(v, [&](uint32_t _h)
+        {
+            const glm::vec3& x_j = m_positions[toVertex(_h)];
+
+            // cotan(alpha_ij) + cotan(beta_ij)
+            uint32_t opp = m_opposite[_h];
+            float sumCot = cotOpp[_h] + ((opp != INVALID_INDEX) ? cotOpp[opp] : 0.0f);
+            K += sumCot * (x_i - x_j);
+
+            // corner of x_i in the face of the outgoing halfedge
+            A += areaMixed[_h];
+            sumAngles += angle[_h];
+            last = _h;
+        });
+
+        // on boundary, the last neighbor is only reached by an incoming halfedge (no face on the other side)
+        uint32_t lastIn = prevHalfedge(last);
+        if (m_opposite[lastIn] == INVALID_INDEX)
+            K += cotOpp[lastIn] * (x_i - m_positions[fromVertex(lastIn)]);
+
+        compCurvatures(K, A, sumAngles, isBoundary(v), m_meanCurv[v], m_gaussCurv[v], m_minCurv[v], m_maxCurv[v]);
+    }
+
+    qInfo() << "[info] TriMeshCHE::compVertCurvatures: mean, Gaussian and principal curvatures computed";
+}
@@ -0,0 +1,353 @@
+/*********************************************************************************************************************
+ *
+ * trimeshche.h
+ *
+ * Mesh class for triangle mesh, using a compact (index-based) half-edge data structure
+ *
+ * Mesh_viewer
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+#ifndef TRIMESHCHE_H
+#define TRIMESHCHE_H
+
+#include "mesh.h"
+#include "trimeshsoup.h"
+
+#include <Eigen/Dense>
+
+
+/*!
+* \class TriMeshCHE
+* \brief Triangle mesh using a compact half-edge data structure (alternative to TriMeshHE, without OpenMesh)
+* Halfedges are implicit: halfedge 3f+k goes from corner k to corner k+1 of face f,
+* so next and previous halfedges are computed and only opposite halfedges are stored.
+* All handles are 32-bit indices, and each attribute is stored in its own array.
+* Per-corner attributes (UV coords, tangents) are indexed by the halfedge leaving the corner.
+*/
+class TriMeshCHE : public Mesh
+{
+    public:
+
+        static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();   /*!< invalid handle (e.g. opposite of a boundary halfedge) */
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn TriMeshCHE
+        * \brief Default constructor of TriMeshCHE
+        */
+        TriMeshCHE();
+
+        /*!
+        * \fn ~TriMeshCHE
+        * \brief Destructor of TriMeshCHE
+        */
+        ~TriMeshCHE();
+
+        /*!
+        * \fn clone
+        * \brief deep copy of the mesh
+        */
+        std::shared_ptr<Mesh> clone() const;
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                              GETTERS/SETTERS                                                |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn getVertices */
+        void getVertices(std::vector<glm::vec3>& _vertices);
+        /*! \fn getNormals */
+        void getNormals(std::vector<glm::vec3>& _normals);
+        /*! \fn getIndices */
+        void getIndices(std::vector<uint32_t>& _indices);
+
+        /*! \fn getColors */
+        void getColors(std::vector<glm::vec3>& _colors);
+        /*! \fn getTexCoords */
+        void getTexCoords(std::vector<glm::vec2>& _texcoords);
+        /*! \fn getTangents */
+        void getTangents(std::vector<glm::vec3>& _tangents);
+        /*! \fn getBitangents */
+        void getBitangents(std::vector<glm::vec3>& _bitangents);
+
+        /*! \fn getFaceNormals */
+        void getFaceNormals(std::vector<glm::vec3>& _facenormals);
+
+        /*! \fn getScalars */
+        void getScalars(std::vector<float>& _scalars);
+
+        /*!
+        * \fn getBuffers
+        * \brief get all the requested attributes at once, in parallel.
+        *        Vertices are shared by adjacent faces, unless the mesh has per-corner attributes (UV coords)
+        *        or duplicateVertices() has been called, in which case one vertex is exported per face corner.
+        *        The individual getters use the same layout.
+        * \param _buffers : arrays to fill
+        * \param _attribs : bitmask of requested attributes (see enum MeshAttrib)
+        */
+        void getBuffers(MeshBuffers& _buffers, unsigned int _attribs = ATTRIB_ALL);
+
+        /*! \fn getMeanCurv */
+        inline const std::vector<float>& getMeanCurv() const { return m_meanCurv; }
+        /*! \fn getGaussCurv */
+        inline const std::vector<float>& getGaussCurv() const { return m_gaussCurv; }
+        /*! \fn getMinCurv */
+        inline const std::vector<float>& getMinCurv() const { return m_minCurv; }
+        /*! \fn getMaxCurv */
+        inline const std::vector<float>& getMaxCurv() const { return m_maxCurv; }
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                 TOPOLOGY                                                    |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn nbVertices */
+        inline uint32_t nbVertices() const { return (uint32_t)m_positions.size(); }
+        /*! \fn nbFaces */
+        inline uint32_t nbFaces() const { return (uint32_t)(m_indices.size() / 3); }
+        /*! \fn nbHalfedges (boundary halfedges are not stored) */
+        inline uint32_t nbHalfedges() const { return (uint32_t)m_indices.size(); }
+
+        /*! \fn nextHalfedge */
+        inline uint32_t nextHalfedge(uint32_t _h) const { return (_h % 3 == 2) ? _h - 2 : _h + 1; }
+        /*! \fn prevHalfedge */
+        inline uint32_t prevHalfedge(uint32_t _h) const { return (_h % 3 == 0) ? _h + 2 : _h - 1; }
+        /*! \fn oppositeHalfedge (INVALID_INDEX on boundary) */
+        inline uint32_t oppositeHalfedge(uint32_t _h) const { return m_opposite[_h]; }
+        /*! \fn fromVertex */
+        inline uint32_t fromVertex(uint32_t _h) const { return m_indices[_h]; }
+        /*! \fn toVertex */
+        inline uint32_t toVertex(uint32_t _h) const { return m_indices[nextHalfedge(_h)]; }
+        /*! \fn face */
+        inline uint32_t face(uint32_t _h) const { return _h / 3; }
+        /*! \fn vertexHalfedge (outgoing, and boundary one for boundary vertices) */
+        inline uint32_t vertexHalfedge(uint32_t _v) const { return m_vertHalfedge[_v]; }
+        /*! \fn isBoundary (isolated vertices are boundary vertices) */
+        inline bool isBoundary(uint32_t _v) const { return m_vertHalfedge[_v] == INVALID_INDEX || m_opposite[m_vertHalfedge[_v]] == INVALID_INDEX; }
+        /*! \fn isManifold (i.e. a single fan of faces around the vertex) */
+        inline bool isManifold(uint32_t _v) const { return m_vertManifold[_v] != 0; }
+
+        /*!
+        * \fn forEachOutHalfedge
+        * \brief call a function on each outgoing halfedge of a vertex, turning around it
+        *        (from the boundary for boundary vertices)
+        * \param _v : vertex
+        * \param _func : function taking the halfedge index as parameter
+        */
+        template <typename Func>
+        inline void forEachOutHalfedge(uint32_t _v, Func _func) const
+        {
+            uint32_t start = m_vertHalfedge[_v];
+            if(start == INVALID_INDEX)
+                return;
+            uint32_t h = start;
+            do
+            {
+                _func(h);
+                h = m_opposite[prevHalfedge(h)];
+            } while(h != INVALID_INDEX && h != start);
+        }
+
+        /*!
+        * \fn forEachNeighbor
+        * \brief call a function on each vertex of the 1-ring neighborhood of a vertex
+        * \param _v : vertex
+        * \param _func : function taking the vertex index as parameter
+        */
+        template <typename Func>
+        inline void forEachNeighbor(uint32_t _v, Func _func) const
+        {
+            uint32_t last = INVALID_INDEX;
+            forEachOutHalfedge(_v, [&](uint32_t _h) { _func(toVertex(_h)); last = _h; });
+            // the last neighbor of an open fan is only reached by an incoming halfedge
+            if(last != INVALID_INDEX && m_opposite[prevHalfedge(last)] == INVALID_INDEX)
+                _func(fromVertex(prevHalfedge(last)));
+        }
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn readFile
+        * \brief read a mesh from a file (parsed by the TriMeshSoup readers, connectivity follows the vertices of the file)
+        * \param _filename : name of the file to read
+        * \return false if file extension is not supported, true if it is
+        */
+        bool readFile(const std::string& _filename);
+
+        /*!
+        * \fn buildFromSoup
+        * \brief build the compact half-edge structure from a triangle soup (used to read files, or to compare with TriMeshHE on the same soup):
+        *        vertices split by the soup are welded back (see TriMeshSoup::getWeldedTriangles()), per-corner UVs are kept per halfedge, then topology is built by buildTopology()
+        * \param _soup : triangle soup
+        * \return false if the soup has no valid face
+        */
+        bool buildFromSoup(const TriMeshSoup& _soup);
+
+        /*!
+        * \fn writeFile
+        * \brief write a mesh into a file (Wavefront OBJ and OFF supported)
+        * \param _filename : name of the file to write
+        * \return false if file extension is not supported, true if it is
+        */
+        bool writeFile(const std::string& _filename);
+
+        /*!
+        * \fn computeAABB
+        * \brief compute Axis Oriented Bounding Box
+        */
+        void computeAABB();
+
+        /*!
+        * \fn computeNormals
+        * \brief recompute the triangle normals and update vertex normals
+        *        (faces are weighted according to m_normalWeighting, see setNormalWeighting())
+        */
+        void computeNormals();
+
+        /*!
+        * \fn computeTB
+        * \brief Compute tangent and bitangent vectors for all face corners of the mesh
+        *        http://www.opengl-tutorial.org/intermediate-tutorials/tutorial-13-normal-mapping/
+        */
+        void computeTB();
+
+        /*!
+        * \fn lapSmooth
+        * \brief Apply a Laplacian smoothing of the mesh
+        * \param _nbIter : number of iterations
+        * \param _fact : factor applied to the Laplacian vector for the displacement of the vertices
+        *                (if _fact == 1 then the vertex is displaced by the complete Lapacian vector)
+        */
+        void lapSmooth(unsigned int _nbIter = 1, float _fact = 1.0f );
+
+        /*!
+        * \fn decimate
+        * \brief Simplify the mesh (not available: the compact arrays cannot be edited, use TriMeshHE instead)
+        */
+        inline float decimate(float _ratio)
+        {
+            qWarning() << "[Warning] TriMeshCHE::decimate: Decimation not available for TriMeshCHE, use TriMeshHE instead";
+            return -1.0f;
+        }
+
+        /*!
+        * \fn duplicateVertices
+        * \brief Export one vertex per face corner in getBuffers(), with face normals (required by flat shading).
+        */
+        void duplicateVertices();
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                 CURVATURE                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn computeMeanCurv
+        * \brief Compute mean curvature of the mesh, and store it as scalar field
+        * Using Meyer et al., "Discrete Differential-Geometry Operators for Triangulated 2-Manifolds", Visualization and Mathematics III, 2003
+        * http://multires.caltech.edu/pubs/diffGeoOps.pdf
+        */
+        void computeMeanCurv();
+
+        /*!
+        * \fn computeSurfVar
+        * \brief Compute surface variation of the mesh, and store it as scalar field
+        * Using Pauly et al., "Efficient Simplification of Point-Sampled Surfaces", IEEE Visualization, 2002
+        * https://www.graphics.rwth-aachen.de/media/papers/p_Pau021.pdf
+        */
+        void computeSurfVar();
+
+
+    protected:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        // topology
+        std::vector<uint32_t> m_indices;        /*!< vertex indices of the faces (i.e. from-vertex of each halfedge) */
+        std::vector<uint32_t> m_opposite;       /*!< opposite of each halfedge (INVALID_INDEX on boundary) */
+        std::vector<uint32_t> m_vertHalfedge;   /*!< outgoing halfedge of each vertex (boundary one if any) */
+        std::vector<char> m_vertManifold;       /*!< flag if the faces around each vertex form a single fan */
+
+        // vertex attributes
+        std::vector<glm::vec3> m_positions;     /*!< vertices positions array (3D coords) */
+        std::vector<glm::vec3> m_normals;       /*!< vertices normal vectors array (3D coords) */
+        std::vector<glm::vec3> m_colors;        /*!< vertices RGB colors array, in [0;1] (empty if not provided) */
+
+        // corner attributes (one per halfedge)
+        std::vector<glm::vec2> m_texcoords;     /*!< corner uvs array (empty if not provided) */
+        std::vector<glm::vec3> m_tangents;      /*!< corner tangent vectors array (empty until computeTB()) */
+        std::vector<glm::vec3> m_bitangents;    /*!< corner bitangent vectors array (empty until computeTB()) */
+
+        // face attributes
+        std::vector<glm::vec3> m_faceNormals;   /*!< face normal vectors array */
+
+        std::vector<float> m_meanCurv;          /*!< mean curvature of each vertex */
+        std::vector<float> m_gaussCurv;         /*!< Gaussian curvature of each vertex */
+        std::vector<float> m_minCurv;           /*!< minimal principal curvature of each vertex */
+        std::vector<float> m_maxCurv;           /*!< maximal principal curvature of each vertex */
+
+        bool m_isVertDuplicated;                /*!< flag if vertices are duplicated in exported buffers */
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn buildTopology
+        * \brief build opposite halfedges and vertex halfedges from m_indices, in parallel.
+        *        Opposite halfedges are paired by sorting the halfedges by edge.
+        *        Edges shared by more than 2 faces, or by 2 faces with inconsistent orientations, are left open (i.e. boundary).
+        */
+        void buildTopology();
+
+        /*!
+        * \fn computeFaceNormals
+        * \brief compute the normal of each face (in parallel)
+        */
+        void computeFaceNormals();
+
+        /*!
+        * \fn compFaceCurvTerms
+        * \brief Compute the per-corner terms of the curvature operators, once per face (in parallel, see compCurvatureTerms()).
+        *        Terms are indexed by halfedge: corner k of a face is the from-vertex of halfedge 3f+k,
+        *        and the angle opposite to halfedge 3f+k is located at corner k+2.
+        * \param _cotOpp : cotangent of the angle opposite to each halfedge
+        * \param _angle : angle at the from-vertex of each halfedge
+        * \param _areaMixed : mixed area of the from-vertex of each halfedge
+        */
+        void compFaceCurvTerms(std::vector<float>& _cotOpp, std::vector<float>& _angle, std::vector<float>& _areaMixed);
+
+        /*!
+        * \fn compVertCurvatures
+        * \brief Compute mean, Gaussian and principal curvatures of each vertex from the cached face terms (in parallel, see compCurvatures())
+        */
+        void compVertCurvatures();
+
+        /*!
+        * \fn compLocalVariation
+        * \brief Compute local surface variation of a vertex from its 1-ring neighborhood
+        * \param _v : vertex
+        * \return local surface variation
+        */
+        double compLocalVariation(uint32_t _v) const;
+
+        /*!
+        * \fn useCornerLayout
+        * \brief check if exported buffers have one vertex per face corner
+        */
+        inline bool useCornerLayout() const { return m_isVertDuplicated || !m_texcoords.empty(); }
+
+};
+#endif // TRIMESHCHE_H
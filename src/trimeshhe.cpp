@@ -8,27 +8,25 @@
  *********************************************************************************************************************/
 
 
-#include <QColor>
+#include <functional>
+#include <chrono>
+#include <queue>
 
 #include "trimeshhe.h"
+#include "parallelsort.h"
+#include "curvature.h"
 
 
 
 TriMeshHE::TriMeshHE() : Mesh()
+    , m_isVertDuplicated(false)
 {
-    // request vertex normals and texcoords
-    m_mesh.request_vertex_normals();
-    m_mesh.request_vertex_texcoords2D();
-
-    // check that we have vertex properties
-    if (!m_mesh.has_vertex_normals() )
-        qCritical() << "[ERROR] TriMeshHE::TriMeshHE: Standard vertex property 'Normals' not available!";
-    if (!m_mesh.has_vertex_texcoords2D() )
-        qCritical() << "[ERROR] TriMeshHE::TriMeshHE: Standard vertex property 'TexCoords2D' not available!";
+    // no property requested: they are allocated when a file provides them or when an operation needs them
 }
 
 
 TriMeshHE::TriMeshHE(bool _vertNormals, bool _vertTexCoords2D, bool _vertCol, bool _edgeTexCoords2D) : Mesh()
+    , m_isVertDuplicated(false)
 {
     // request vertex properties
     if(_vertNormals)
@@ -56,6 +54,12 @@ TriMeshHE::~TriMeshHE()
 {}
 
 
+std::shared_ptr<Mesh> TriMeshHE::clone() const
+{
+    return std::make_shared<TriMeshHE>(*this);
+}
+
+
 void TriMeshHE::getVertices(std::vector<glm::vec3>& _vertices)
 {
     if(_vertices.size() != 0)
@@ -234,32 +238,403 @@ void TriMeshHE::getFaceNormals(std::vector<glm::vec3>& _facenormals)
 }
 
 
+void TriMeshHE::getScalars(std::vector<float>& _scalars)
+{
+    if(_scalars.size() != 0)
+        _scalars.clear();
+
+    if(m_scalars.size() == m_mesh.n_vertices())
+    {
+        // for each triangle of the mesh...
+        for (OpMesh::FaceIter f_it = m_mesh.faces_begin(); f_it != m_mesh.faces_end(); ++f_it)
+        {
+            // for each vertex of the triangle
+            for (OpMesh::FaceVertexIter fv_it = m_mesh.fv_iter( *f_it ); fv_it.is_valid(); ++fv_it)
+            {
+                _scalars.push_back(m_scalars[(*fv_it).idx()]);                      // current vertex scalar
+            }
+        }
+    }
+}
+
+
+void TriMeshHE::getBuffers(MeshBuffers& _buffers, unsigned int _attribs)
+{
+    if(m_isVertDuplicated)
+        getCornerBuffers(_buffers, _attribs);
+    else
+        getIndexedBuffers(_buffers, _attribs);
+}
+
+
+void TriMeshHE::getCornerBuffers(MeshBuffers& _buffers, unsigned int _attribs)
+{
+    const int nbFaces = (int)m_mesh.n_faces();
+    const size_t nbCorners = 3 * (size_t)nbFaces;
+
+    // select the attributes actually available
+    const bool getVert = (_attribs & ATTRIB_VERTEX);
+    const bool getNorm = (_attribs & ATTRIB_NORMAL) && m_mesh.has_vertex_normals();
+    const bool getCol = (_attribs & ATTRIB_COLOR) && m_mesh.has_vertex_colors();
+    const bool getHalfedgeUV = (_attribs & ATTRIB_TEXCOORD) && m_mesh.has_halfedge_texcoords2D();
+    const bool getVertexUV = (_attribs & ATTRIB_TEXCOORD) && !getHalfedgeUV && m_mesh.has_vertex_texcoords2D();
+    const bool getTan = (_attribs & ATTRIB_TANGENT) && m_TBComputed;
+    const bool getBitan = (_attribs & ATTRIB_BITANGENT) && m_TBComputed;
+    const bool getFaceNorm = (_attribs & ATTRIB_FACENORMAL) && m_mesh.has_face_normals();
+    const bool getScal = (_attribs & ATTRIB_SCALAR) && (m_scalars.size() == m_mesh.n_vertices());
+
+    // pre-size arrays (unavailable attributes are left empty)
+    _buffers.vertices.resize(getVert ? nbCorners : 0);
+    _buffers.normals.resize(getNorm ? nbCorners : 0);
+    _buffers.colors.resize(getCol ? nbCorners : 0);
+    _buffers.texcoords.resize((getHalfedgeUV || getVertexUV) ? nbCorners : 0);
+    _buffers.tangents.resize(getTan ? nbCorners : 0);
+    _buffers.bitangents.resize(getBitan ? nbCorners : 0);
+    _buffers.facenormals.resize(getFaceNorm ? nbCorners : 0);
+    _buffers.scalars.resize(getScal ? nbCorners : 0);
+    _buffers.indices.resize((_attribs & ATTRIB_INDEX) ? nbCorners : 0);
+
+    // each face writes its 3 corners at a fixed position: faces are processed independently
+    // (same corner order as FaceVertexIter and FaceHalfedgeIter)
+    #pragma omp parallel for
+    for (int f = 0; f < nbFaces; f++)
+    {
+        OpMesh::FaceHandle fh = m_mesh.face_handle(f);
+        OpMesh::HalfedgeHandle heh = m_mesh.halfedge_handle(fh);
+
+        OpMesh::Normal fn(0.0f, 0.0f, 0.0f);
+        if(getFaceNorm)
+            fn = m_mesh.normal(fh);
+
+        for (int k = 0; k < 3; k++)
+        {
+            const size_t c = 3 * (size_t)f + k;                          // current corner
+            OpMesh::VertexHandle vh = m_mesh.to_vertex_handle(heh);       // current vertex
+
+            if(getVert)
+            {
+                OpMesh::Point p1 = m_mesh.point(vh);
+                _buffers.vertices[c] = glm::vec3(p1[0], p1[1], p1[2]);
+            }
+            if(getNorm)
+            {
+                OpMesh::Normal n1 = m_mesh.normal(vh);
+                _buffers.normals[c] = glm::vec3(n1[0], n1[1], n1[2]);
+            }
+            if(getCol)
+            {
+                OpMesh::Color c1 = m_mesh.color(vh);
+                _buffers.colors[c] = glm::vec3(c1[0], c1[1], c1[2]) / 256.0f;   // normalize color ([0;255] -> [0;1])
+            }
+            if(getHalfedgeUV)
+            {
+                OpMesh::TexCoord2D uv1 = m_mesh.texcoord2D(heh);
+                _buffers.texcoords[c] = glm::vec2(uv1[0], uv1[1]);
+            }
+            else if(getVertexUV)
+            {
+                OpMesh::TexCoord2D uv1 = m_mesh.texcoord2D(vh);
+                _buffers.texcoords[c] = glm::vec2(uv1[0], uv1[1]);
+            }
+            if(getTan)
+            {
+                const OpenMesh::Vec3f& t1 = m_mesh.property(tangents, heh);
+                _buffers.tangents[c] = glm::vec3(t1[0], t1[1], t1[2]);
+            }
+            if(getBitan)
+            {
+                const OpenMesh::Vec3f& bt1 = m_mesh.property(bitangents, heh);
+                _buffers.bitangents[c] = glm::vec3(bt1[0], bt1[1], bt1[2]);
+            }
+            if(getFaceNorm)
+                _buffers.facenormals[c] = glm::vec3(fn[0], fn[1], fn[2]);
+            if(getScal)
+                _buffers.scalars[c] = m_scalars[vh.idx()];
+            if(_attribs & ATTRIB_INDEX)
+                _buffers.indices[c] = (uint32_t)c;
+
+            heh = m_mesh.next_halfedge_handle(heh);
+        }
+    }
+}
+
+
+void TriMeshHE::getIndexedBuffers(MeshBuffers& _buffers, unsigned int _attribs)
+{
+    const int nbVertices = (int)m_mesh.n_vertices();
+    const int nbFaces = (int)m_mesh.n_faces();
+
+    // per-corner attributes (i.e. stored on halfedges) may split a vertex.
+    // NB: the layout only depends on the attributes stored in the mesh, not on the requested ones,
+    // so that a partial update (e.g. scalars only) matches the layout of a full update
+    const bool splitUV = m_mesh.has_halfedge_texcoords2D();
+    const bool splitTB = m_TBComputed;
+    const bool perCorner = splitUV || splitTB;
+
+    // 1. give each corner (i.e. each non-boundary incoming halfedge) a slot among the unique corners of its vertex
+    std::vector<int> cornerSlot(m_mesh.n_halfedges(), -1);
+    std::vector<uint32_t> vertOffset(nbVertices + 1, 0);       // number of unique corners, then offset of the vertex
+
+    #pragma omp parallel for
+    for (int v = 0; v < nbVertices; v++)
+    {
+        OpMesh::VertexHandle vh = m_mesh.vertex_handle(v);
+
+        // unique corners of the vertex: representative halfedge + hash of the corner tuple
+        std::vector< std::pair<OpMesh::HalfedgeHandle, size_t> > uniqueCorners;
+
+        for (OpMesh::VertexIHalfedgeIter vih_it = m_mesh.vih_iter(vh); vih_it.is_valid(); ++vih_it)
+        {
+            OpMesh::HalfedgeHandle heh = *vih_it;
+            if(m_mesh.is_boundary(heh))
+                continue;
+
+            int slot = -1;
+            if(!perCorner)
+            {
+                // all corners share the same vertex
+                if(uniqueCorners.empty())
+                    uniqueCorners.push_back(std::make_pair(heh, 0));
+                slot = 0;
+            }
+            else
+            {
+                size_t hash = hashCorner(heh);
+                for (int u = 0; u < (int)uniqueCorners.size(); u++)
+                {
+                    if(uniqueCorners[u].second == hash && equalCorners(uniqueCorners[u].first, heh))
+                    {
+                        slot = u;
+                        break;
+                    }
+                }
+                if(slot < 0)
+                {
+                    slot = (int)uniqueCorners.size();
+                    uniqueCorners.push_back(std::make_pair(heh, hash));
+                }
+            }
+            cornerSlot[heh.idx()] = slot;
+        }
+        vertOffset[v + 1] = (uint32_t)uniqueCorners.size();
+    }
+
+    // 2. prefix sum gives the position of the first GPU vertex of each mesh vertex
+    for (int v = 0; v < nbVertices; v++)
+        vertOffset[v + 1] += vertOffset[v];
+    const size_t nbOutVertices = vertOffset[nbVertices];
+
+    // select the attributes actually available
+    const bool getVert = (_attribs & ATTRIB_VERTEX);
+    const bool getNorm = (_attribs & ATTRIB_NORMAL) && m_mesh.has_vertex_normals();
+    const bool getCol = (_attribs & ATTRIB_COLOR) && m_mesh.has_vertex_colors();
+    const bool getHalfedgeUV = (_attribs & ATTRIB_TEXCOORD) && m_mesh.has_halfedge_texcoords2D();
+    const bool getVertexUV = (_attribs & ATTRIB_TEXCOORD) && !getHalfedgeUV && m_mesh.has_vertex_texcoords2D();
+    const bool getTan = (_attribs & ATTRIB_TANGENT) && m_TBComputed;
+    const bool getBitan = (_attribs & ATTRIB_BITANGENT) && m_TBComputed;
+    const bool getScal = (_attribs & ATTRIB_SCALAR) && (m_scalars.size() == m_mesh.n_vertices());
+
+    // pre-size arrays (unavailable attributes are left empty)
+    // face normals cannot be shared by vertices: they are only exported after duplicateVertices()
+    _buffers.vertices.resize(getVert ? nbOutVertices : 0);
+    _buffers.normals.resize(getNorm ? nbOutVertices : 0);
+    _buffers.colors.resize(getCol ? nbOutVertices : 0);
+    _buffers.texcoords.resize((getHalfedgeUV || getVertexUV) ? nbOutVertices : 0);
+    _buffers.tangents.resize(getTan ? nbOutVertices : 0);
+    _buffers.bitangents.resize(getBitan ? nbOutVertices : 0);
+    _buffers.facenormals.clear();
+    _buffers.scalars.resize(getScal ? nbOutVertices : 0);
+    _buffers.indices.resize((_attribs & ATTRIB_INDEX) ? 3 * (size_t)nbFaces : 0);
+
+    // 3. fill vertex attributes, each unique corner being written by its representative halfedge
+    #pragma omp parallel for
+    for (int v = 0; v < nbVertices; v++)
+    {
+        OpMesh::VertexHandle vh = m_mesh.vertex_handle(v);
+
+        // slots were given in circulation order: the first halfedge holding slot s comes when s slots are written
+        int nbWritten = 0;
+        for (OpMesh::VertexIHalfedgeIter vih_it = m_mesh.vih_iter(vh); vih_it.is_valid(); ++vih_it)
+        {
+            OpMesh::HalfedgeHandle heh = *vih_it;
+            if(cornerSlot[heh.idx()] != nbWritten)
+                continue;
+
+            const size_t c = vertOffset[v] + nbWritten;                    // current GPU vertex
+            nbWritten++;
+
+            if(getVert)
+            {
+                OpMesh::Point p1 = m_mesh.point(vh);
+                _buffers.vertices[c] = glm::vec3(p1[0], p1[1], p1[2]);
+            }
+            if(getNorm)
+            {
+                OpMesh::Normal n1 = m_mesh.normal(vh);
+                _buffers.normals[c] = glm::vec3(n1[0], n1[1], n1[2]);
+            }
+            if(getCol)
+            {
+                OpMesh::Color c1 = m_mesh.color(vh);
+                _buffers.colors[c] = glm::vec3(c1[0], c1[1], c1[2]) / 256.0f;   // normalize color ([0;255] -> [0;1])
+            }
+            if(getHalfedgeUV)
+            {
+                OpMesh::TexCoord2D uv1 = m_mesh.texcoord2D(heh);
+                _buffers.texcoords[c] = glm::vec2(uv1[0], uv1[1]);
+            }
+            else if(getVertexUV)
+            {
+                OpMesh::TexCoord2D uv1 = m_mesh.texcoord2D(vh);
+                _buffers.texcoords[c] = glm::vec2(uv1[0], uv1[1]);
+            }
+            if(getTan)
+            {
+                const OpenMesh::Vec3f& t1 = m_mesh.property(tangents, heh);
+                _buffers.tangents[c] = glm::vec3(t1[0], t1[1], t1[2]);
+            }
+            if(getBitan)
+            {
+                const OpenMesh::Vec3f& bt1 = m_mesh.property(bitangents, heh);
+                _buffers.bitangents[c] = glm::vec3(bt1[0], bt1[1], bt1[2]);
+            }
+            if(getScal)
+                _buffers.scalars[c] = m_scalars[v];
+        }
+    }
+
+    // 4. indices, in the same face and corner order as getCornerBuffers()
+    if(_attribs & ATTRIB_INDEX)
+    {
+        #pragma omp parallel for
+        for (int f = 0; f < nbFaces; f++)
+        {
+            OpMesh::HalfedgeHandle heh = m_mesh.halfedge_handle(m_mesh.face_handle(f));
+            for (int k = 0; k < 3; k++)
+            {
+                int v = m_mesh.to_vertex_handle(heh).idx();
+                _buffers.indices[3 * (size_t)f + k] = vertOffset[v] + cornerSlot[heh.idx()];
+                heh = m_mesh.next_halfedge_handle(heh);
+            }
+        }
+    }
+}
+
+
+size_t TriMeshHE::getPropertyMemory(bool _allProperties) const
+{
+    const size_t nbV = m_mesh.n_vertices();
+    const size_t nbH = m_mesh.n_halfedges();
+    const size_t nbF = m_mesh.n_faces();
+
+    size_t bytes = 0;
+    if ( _allProperties || m_mesh.has_vertex_normals() )
+        bytes += nbV * sizeof(OpMesh::Normal);
+    if ( _allProperties || m_mesh.has_vertex_texcoords2D() )
+        bytes += nbV * sizeof(OpMesh::TexCoord2D);
+    if ( _allProperties || m_mesh.has_vertex_colors() )
+        bytes += nbV * sizeof(OpMesh::Color);
+    if ( _allProperties || m_mesh.has_halfedge_texcoords2D() )
+        bytes += nbH * sizeof(OpMesh::TexCoord2D);
+    if ( _allProperties || m_mesh.has_face_normals() )
+        bytes += nbF * sizeof(OpMesh::Normal);
+    if ( _allProperties || tangents.is_valid() )
+        bytes += nbH * sizeof(OpenMesh::Vec3f);
+    if ( _allProperties || bitangents.is_valid() )
+        bytes += nbH * sizeof(OpenMesh::Vec3f);
+    return bytes;
+}
+
+
+size_t TriMeshHE::hashCorner(OpMesh::HalfedgeHandle _heh) const
+{
+    // hash of the per-corner attributes (halfedge uv, tangent, bitangent)
+    size_t hash = 0;
+    auto combine = [&hash](float _val)
+    {
+        hash ^= std::hash<float>()(_val) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    };
+
+    if(m_mesh.has_halfedge_texcoords2D())
+    {
+        const OpMesh::TexCoord2D& uv = m_mesh.texcoord2D(_heh);
+        combine(uv[0]); combine(uv[1]);
+    }
+    if(m_TBComputed)
+    {
+        const OpenMesh::Vec3f& t = m_mesh.property(tangents, _heh);
+        const OpenMesh::Vec3f& bt = m_mesh.property(bitangents, _heh);
+        combine(t[0]); combine(t[1]); combine(t[2]);
+        combine(bt[0]); combine(bt[1]); combine(bt[2]);
+    }
+    return hash;
+}
+
+
+bool TriMeshHE::equalCorners(OpMesh::HalfedgeHandle _heh1, OpMesh::HalfedgeHandle _heh2) const
+{
+    if(m_mesh.has_halfedge_texcoords2D() && m_mesh.texcoord2D(_heh1) != m_mesh.texcoord2D(_heh2))
+        return false;
+    if(m_TBComputed && ( m_mesh.property(tangents, _heh1) != m_mesh.property(tangents, _heh2)
+                      || m_mesh.property(bitangents, _heh1) != m_mesh.property(bitangents, _heh2) ) )
+        return false;
+    return true;
+}
+
+
 bool TriMeshHE::readFile(const std::string& _filename)
+{
+    // parse file with the TriMeshSoup readers, then build topology in bulk
+    TriMeshSoup soup;
+    bool loaded = soup.readFile(_filename) && buildFromSoup(soup);
+    if ( !loaded )
+    {
+        qWarning() << "[Warning] TriMeshHE::readFile: bulk loading failed, use OpenMesh IO instead ";
+        loaded = readFileOpenMesh(_filename);
+    }
+
+    if ( loaded )
+    {
+        qInfo() << "[info] TriMeshHE::readFile: properties use " << getPropertyMemory() / (1024 * 1024) << " MB ("
+                << (getPropertyMemory(true) - getPropertyMemory()) / (1024 * 1024) << " MB saved by on-demand allocation)";
+        qInfo() << "[info] TriMeshHE::readFile: finished ";
+    }
+    return loaded;
+}
+
+
+bool TriMeshHE::readFileOpenMesh(const std::string& _filename)
 {
     // read options
     OpenMesh::IO::Options rOpt;
 
+    // the reader only fills requested properties: request them all, and release the ones not provided afterwards
+    if(!m_mesh.has_vertex_normals())
+        m_mesh.request_vertex_normals();
+    if(!m_mesh.has_vertex_texcoords2D())
+        m_mesh.request_vertex_texcoords2D();
+    if(!m_mesh.has_vertex_colors())
+        m_mesh.request_vertex_colors();
+    if(!m_mesh.has_halfedge_texcoords2D())
+        m_mesh.request_halfedge_texcoords2D();
+
     // add read options for vertex normals, colors, and texcoords
-    if(m_mesh.has_vertex_normals())
-        rOpt += OpenMesh::IO::Options::VertexNormal;
-    if(m_mesh.has_vertex_texcoords2D())
-        rOpt += OpenMesh::IO::Options::VertexTexCoord;
-    if(m_mesh.has_vertex_colors())
-        rOpt += OpenMesh::IO::Options::VertexColor;
-    if(m_mesh.has_halfedge_texcoords2D())
-        rOpt += OpenMesh::IO::Options::FaceTexCoord;
+    rOpt += OpenMesh::IO::Options::VertexNormal;
+    rOpt += OpenMesh::IO::Options::VertexTexCoord;
+    rOpt += OpenMesh::IO::Options::VertexColor;
+    rOpt += OpenMesh::IO::Options::FaceTexCoord;
 
     // read mesh from stdin
     if ( ! OpenMesh::IO::read_mesh(m_mesh, _filename, rOpt) )
     {
-        qCritical() << "[ERROR] TriMeshHE::readFile: Cannot read mesh from " << _filename;
+        qCritical() << "[ERROR] TriMeshHE::readFileOpenMesh: Cannot read mesh from " << _filename;
         return false;
     }
 
     // If the file did not provide vertex normals, then calculate them
-    if ( m_mesh.has_vertex_normals() && !rOpt.check( OpenMesh::IO::Options::VertexNormal ) )
+    if ( !rOpt.check( OpenMesh::IO::Options::VertexNormal ) )
     {
-        qInfo() << "[info] TriMeshHE::readFile: Normals not provided, compute them ";
+        qInfo() << "[info] TriMeshHE::readFileOpenMesh: Normals not provided, compute them ";
         computeNormals();
     }
     // If the file did not provide vertex texcoords, then release them
@@ -269,10 +644,435 @@ bool TriMeshHE::readFile(const std::string& _filename)
     if ( m_mesh.has_halfedge_texcoords2D() && !rOpt.check( OpenMesh::IO::Options::FaceTexCoord ) )
         m_mesh.release_halfedge_texcoords2D();
     // If the file did not provide vertex colors, then release them
-//    if ( m_mesh.has_vertex_colors() && !rOpt.check( OpenMesh::IO::Options::VertexColor ) )
-//        m_mesh.release_vertex_colors();
+    if ( m_mesh.has_vertex_colors() && !rOpt.check( OpenMesh::IO::Options::VertexColor ) )
+        m_mesh.release_vertex_colors();
+
+    qInfo() << "[info] TriMeshHE::readFileOpenMesh: finished ";
+
+    return true;
+}
+
+
+bool TriMeshHE::buildFromSoup(const TriMeshSoup& _soup)
+{
+    const std::vector<glm::vec3>& soupVertices = _soup.getVertexArray();
+    const std::vector<glm::vec3>& soupNormals = _soup.getNormalArray();
+    const std::vector<uint32_t>& soupIndices = _soup.getIndexArray();
+    const std::vector<glm::vec3>& soupColors = _soup.getColorArray();
+    const std::vector<glm::vec2>& soupTexcoords = _soup.getTexCoordArray();
+    const std::vector<float>& soupScalars = _soup.getScalarArray();
+
+    const int nbSoupVertices = (int)soupVertices.size();
+    const int nbSoupFaces = (int)(soupIndices.size() / 3);
+    if(nbSoupFaces == 0)
+        return false;
+
+    const bool hasNormals = ((int)soupNormals.size() == nbSoupVertices);
+    const bool hasColors = ((int)soupColors.size() == nbSoupVertices);
+    const bool hasUVs = ((int)soupTexcoords.size() == nbSoupVertices);
+    const bool hasScalars = ((int)soupScalars.size() == nbSoupVertices);
+
+    // 1. triangles on the vertices of the file
+    std::vector<uint32_t> weldedSrc;                 // soup vertex of each welded vertex
+    std::vector<uint32_t> faceVerts;
+    std::vector<uint32_t> faceSrc;                   // soup face of each triangle
+    int nbDiscarded = _soup.getWeldedTriangles(weldedSrc, faceVerts, faceSrc);
+    if(nbDiscarded > 0)
+        qWarning() << "[Warning] TriMeshHE::buildFromSoup: " << nbDiscarded << " degenerated faces discarded";
+
+    const int nbWelded = (int)weldedSrc.size();
+    std::vector<glm::vec3> positions(nbWelded);
+    #pragma omp parallel for
+    for (int w = 0; w < nbWelded; w++)
+        positions[w] = soupVertices[weldedSrc[w]];
+
+    // 2. soup normals are only kept if all the soup vertices welded together agree
+    bool normalsConsistent = hasNormals;
+    if(hasNormals)
+    {
+        int nbInconsistent = 0;
+        #pragma omp parallel for reduction(+:nbInconsistent)
+        for (int c = 0; c < (int)faceVerts.size(); c++)
+        {
+            if(soupNormals[soupIndices[3 * faceSrc[c / 3] + c % 3]] != soupNormals[weldedSrc[faceVerts[c]]])
+                nbInconsistent++;
+        }
+        normalsConsistent = (nbInconsistent == 0);
+    }
+
+    // 3. half-edge topology
+    std::vector<uint32_t> vertSource;
+    if(!buildFromArrays(positions, faceVerts, vertSource))
+        return false;
+
+    // 4. properties, only allocated when the file provides them (and released otherwise)
+    const int nbVertices = (int)m_mesh.n_vertices();
+    const int nbFaces = (int)m_mesh.n_faces();
+
+    if(normalsConsistent && !m_mesh.has_vertex_normals())
+        m_mesh.request_vertex_normals();
+    if(hasColors && !m_mesh.has_vertex_colors())
+        m_mesh.request_vertex_colors();
+    if(!hasColors && m_mesh.has_vertex_colors())
+        m_mesh.release_vertex_colors();
+    if(hasUVs && !m_mesh.has_halfedge_texcoords2D())
+        m_mesh.request_halfedge_texcoords2D();
+    if(hasUVs && !m_mesh.has_vertex_texcoords2D())
+        m_mesh.request_vertex_texcoords2D();
+
+    const bool setNormals = normalsConsistent;
+    const bool setColors = hasColors;
+    const bool setVertexUVs = hasUVs;
+
+    m_scalars.resize(hasScalars ? nbVertices : 0);
+
+    #pragma omp parallel for
+    for (int v = 0; v < nbVertices; v++)
+    {
+        OpMesh::VertexHandle vh = m_mesh.vertex_handle(v);
+        uint32_t sv = weldedSrc[vertSource[v]];
+
+        if(setNormals)
+            m_mesh.set_normal(vh, OpMesh::Normal(soupNormals[sv].x, soupNormals[sv].y, soupNormals[sv].z));
+        if(setColors)
+        {
+            // soup colors are in [0;1]
+            glm::vec3 col = glm::clamp(soupColors[sv] * 256.0f, 0.0f, 255.0f);
+            m_mesh.set_color(vh, OpMesh::Color((unsigned char)col.x, (unsigned char)col.y, (unsigned char)col.z));
+        }
+        if(setVertexUVs)
+            m_mesh.set_texcoord2D(vh, OpMesh::TexCoord2D(soupTexcoords[sv].x, soupTexcoords[sv].y));
+        if(hasScalars)
+            m_scalars[v] = soupScalars[sv];
+    }
+
+    if(hasUVs)
+    {
+        // per-corner UVs are stored on the halfedge pointing to the corner (face f = triangle f of faceVerts)
+        #pragma omp parallel for
+        for (int f = 0; f < nbFaces; f++)
+        {
+            OpMesh::HalfedgeHandle heh = m_mesh.halfedge_handle(m_mesh.face_handle(f));
+            for (int k = 0; k < 3; k++)
+            {
+                const glm::vec2& uv = soupTexcoords[soupIndices[3 * faceSrc[f] + k]];
+                m_mesh.set_texcoord2D(heh, OpMesh::TexCoord2D(uv.x, uv.y));
+                heh = m_mesh.next_halfedge_handle(heh);
+            }
+        }
+    }
+    else
+    {
+        // If the file did not provide texcoords, then release them
+        if ( m_mesh.has_vertex_texcoords2D() )
+            m_mesh.release_vertex_texcoords2D();
+        if ( m_mesh.has_halfedge_texcoords2D() )
+            m_mesh.release_halfedge_texcoords2D();
+    }
+
+    // If the file did not provide (consistent) vertex normals, then calculate them
+    if ( !setNormals )
+    {
+        qInfo() << "[info] TriMeshHE::buildFromSoup: Normals not provided, compute them ";
+        computeNormals();
+    }
+
+    qInfo() << "[info] TriMeshHE::buildFromSoup: " << nbVertices << " vertices, " << nbFaces << " faces";
+
+    return true;
+}
+
+
+bool TriMeshHE::buildFromArrays(const std::vector<glm::vec3>& _positions, std::vector<uint32_t>& _faceVerts, std::vector<uint32_t>& _vertSource)
+{
+    // Face halfedges are numbered implicitly: halfedge 3f+k goes from corner k to corner k+1 of face f
+    const int nbFaces = (int)(_faceVerts.size() / 3);
+    const int nbFaceHalfedges = 3 * nbFaces;
+    if(nbFaces == 0)
+        return false;
+
+    auto nextHe = [](int _h) { return 3 * (_h / 3) + (_h % 3 + 1) % 3; };
+    auto prevHe = [](int _h) { return 3 * (_h / 3) + (_h % 3 + 2) % 3; };
+
+    int nbVertices = (int)_positions.size();
+    _vertSource.resize(nbVertices);
+    for (int v = 0; v < nbVertices; v++)
+        _vertSource[v] = v;
+
+    // 1. pair opposite halfedges: sort directed edges by undirected key (min vertex, max vertex),
+    //    then in each group of equal keys, halfedges are processed in face order (as add_face() would):
+    //    the first one is paired with the first one of opposite direction, all the others are rejected (complex edge)
+    std::vector<int> oppFace(nbFaceHalfedges, -1);       // opposite face halfedge (-1 if boundary)
+    std::vector< std::pair<uint64_t, int> > sortedHe(nbFaceHalfedges);
+    std::vector<char> rejectedFace(nbFaces, 0);
+
+    auto pairHalfedges = [&]()
+    {
+        #pragma omp parallel for
+        for (int h = 0; h < nbFaceHalfedges; h++)
+        {
+            uint64_t a = _faceVerts[h];
+            uint64_t b = _faceVerts[nextHe(h)];
+            sortedHe[h] = std::make_pair( (std::min(a, b) << 32) | std::max(a, b), h );
+            oppFace[h] = -1;
+        }
+        parallelSort(sortedHe, std::less< std::pair<uint64_t, int> >());
+
+        int nbRejected = 0;
+        #pragma omp parallel for reduction(+:nbRejected)
+        for (int i = 0; i < nbFaceHalfedges; i++)
+        {
+            // process each group from its first element
+            if(i > 0 && sortedHe[i].first == sortedHe[i-1].first)
+                continue;
+
+            int first = sortedHe[i].second;
+            int paired = -1;
+            for (int j = i + 1; j < nbFaceHalfedges && sortedHe[j].first == sortedHe[i].first; j++)
+            {
+                int h = sortedHe[j].second;
+                // opposite direction: from(h) == to(first)
+                if(paired < 0 && _faceVerts[h] == _faceVerts[nextHe(first)])
+                {
+                    paired = h;
+                }
+                else
+                {
+                    #pragma omp atomic write
+                    rejectedFace[h / 3] = 1;
+                    nbRejected++;
+                }
+            }
+            if(paired >= 0)
+            {
+                oppFace[first] = paired;
+                oppFace[paired] = first;
+            }
+        }
+        return nbRejected;
+    };
+
+    if(pairHalfedges() > 0)
+    {
+        // faces with complex edges get their own copy of their vertices (i.e. become isolated triangles),
+        // then pairing is done again (no new rejection can occur, only groups with at most 2 valid halfedges remain)
+        int nbRejectedFaces = 0;
+        for (int f = 0; f < nbFaces; f++)
+        {
+            if(!rejectedFace[f])
+                continue;
+            for (int k = 0; k < 3; k++)
+            {
+                _vertSource.push_back(_vertSource[_faceVerts[3*f+k]]);
+                _faceVerts[3*f+k] = nbVertices++;
+            }
+            nbRejectedFaces++;
+        }
+        qWarning() << "[Warning] TriMeshHE::buildFromArrays: " << nbRejectedFaces << " faces with complex edges, duplicate their vertices";
+
+        pairHalfedges();
+    }
+
+    // one edge per group: the first halfedge of the group is the first halfedge of the edge
+    std::vector<int> edgeOffset(nbFaceHalfedges + 1, 0);
+    #pragma omp parallel for
+    for (int i = 0; i < nbFaceHalfedges; i++)
+        edgeOffset[i + 1] = (i == 0 || sortedHe[i].first != sortedHe[i-1].first) ? 1 : 0;
+    for (int i = 0; i < nbFaceHalfedges; i++)
+        edgeOffset[i + 1] += edgeOffset[i];
+    const int nbEdges = edgeOffset[nbFaceHalfedges];
+
+    std::vector<int> omHe(nbFaceHalfedges);               // OpenMesh halfedge of each face halfedge
+    std::vector<int> edgeFirstHe(nbEdges);                // first face halfedge of each edge
+    #pragma omp parallel for
+    for (int i = 0; i < nbFaceHalfedges; i++)
+    {
+        int h = sortedHe[i].second;
+        int e = edgeOffset[i + 1] - 1;
+        // halfedges 2e and 2e+1 belong to edge e
+        if(i == 0 || sortedHe[i].first != sortedHe[i-1].first)
+        {
+            omHe[h] = 2 * e;
+            edgeFirstHe[e] = h;
+        }
+        else
+            omHe[h] = 2 * e + 1;
+    }
+    sortedHe.clear();
+    sortedHe.shrink_to_fit();
+    edgeOffset.clear();
+
+    // 2. fans around each vertex, using outgoing face halfedges of each vertex (CSR arrays)
+    std::vector<int> outOffset(nbVertices + 1, 0);
+    for (int h = 0; h < nbFaceHalfedges; h++)
+        outOffset[_faceVerts[h] + 1]++;
+    for (int v = 0; v < nbVertices; v++)
+        outOffset[v + 1] += outOffset[v];
+    std::vector<int> outHe(nbFaceHalfedges);
+    {
+        std::vector<int> fill(outOffset.begin(), outOffset.end() - 1);
+        for (int h = 0; h < nbFaceHalfedges; h++)
+            outHe[fill[_faceVerts[h]]++] = h;
+    }
+
+    // walk all the fans of a vertex: a fan is given by its first and last outgoing halfedges (turning around the vertex),
+    // for an open fan, the boundary halfedges are the opposite of first (incoming) and of prev(last) (outgoing)
+    std::vector<char> visited(nbFaceHalfedges, 0);
+    auto walkFans = [&](int _v, std::vector<int>& _first, std::vector<int>& _last, std::vector<char>& _closed)
+    {
+        _first.clear(); _last.clear(); _closed.clear();
+        for (int i = outOffset[_v]; i < outOffset[_v + 1]; i++)
+        {
+            int h = outHe[i];
+            if(visited[h])
+                continue;
+
+            // rotate backward until the boundary (or back to h if the fan is closed)
+            int start = h;
+            bool closed = false;
+            while(oppFace[start] >= 0)
+            {
+                start = nextHe(oppFace[start]);
+                if(start == h)
+                {
+                    closed = true;
+                    break;
+                }
+            }
+            // rotate forward, marking visited halfedges
+            int cur = start, last = start;
+            do
+            {
+                visited[cur] = 1;
+                last = cur;
+                int p = prevHe(cur);
+                if(oppFace[p] < 0)
+                    break;
+                cur = oppFace[p];
+            } while(cur != start);
+
+            _first.push_back(start);
+            _last.push_back(last);
+            _closed.push_back(closed);
+        }
+        // reset visited flags for next walk
+        for (int i = outOffset[_v]; i < outOffset[_v + 1]; i++)
+            visited[outHe[i]] = 0;
+    };
+
+    // count closed fans that need their own copy of the vertex
+    std::vector<int> dupOffset(nbVertices + 1, 0);
+    #pragma omp parallel for
+    for (int v = 0; v < nbVertices; v++)
+    {
+        std::vector<int> first, last;
+        std::vector<char> closed;
+        walkFans(v, first, last, closed);
+        int nbClosed = (int)std::count(closed.begin(), closed.end(), 1);
+        int nbOpen = (int)closed.size() - nbClosed;
+        dupOffset[v + 1] = (nbOpen > 0) ? nbClosed : std::max(nbClosed - 1, 0);
+    }
+    for (int v = 0; v < nbVertices; v++)
+        dupOffset[v + 1] += dupOffset[v];
+    const int nbDuplicated = dupOffset[nbVertices];
+    if(nbDuplicated > 0)
+        qWarning() << "[Warning] TriMeshHE::buildFromArrays: " << nbDuplicated << " non-manifold vertices duplicated";
+
+    const int nbOrigVertices = nbVertices;
+    nbVertices += nbDuplicated;
+    _vertSource.resize(nbVertices);
+
+    // link boundary halfedges, and choose the halfedge of each vertex (a boundary one if any)
+    std::vector<int> nextBoundary(nbFaceHalfedges, -1);   // for the boundary opposite to face halfedge h, face halfedge whose opposite is next
+    std::vector<int> vertHe(nbVertices, -1);               // OpenMesh halfedge of each vertex
+    #pragma omp parallel for
+    for (int v = 0; v < nbOrigVertices; v++)
+    {
+        std::vector<int> first, last;
+        std::vector<char> closed;
+        walkFans(v, first, last, closed);
+
+        std::vector<int> openFans;
+        for (int i = 0; i < (int)first.size(); i++)
+            if(!closed[i])
+                openFans.push_back(i);
+
+        // open fans share the vertex, boundary going into a fan is followed by boundary going out of the next fan
+        for (int j = 0; j < (int)openFans.size(); j++)
+        {
+            int fanIn = openFans[j];
+            int fanOut = openFans[(j + 1) % openFans.size()];
+            nextBoundary[first[fanIn]] = prevHe(last[fanOut]);
+        }
+        if(!openFans.empty())
+            vertHe[v] = omHe[prevHe(last[openFans[0]])] ^ 1;
+
+        // closed fans: the first one keeps the vertex if there is no open fan, others get a copy of the vertex
+        int nbDup = 0;
+        for (int i = 0; i < (int)first.size(); i++)
+        {
+            if(!closed[i])
+                continue;
+            if(vertHe[v] < 0)
+            {
+                vertHe[v] = omHe[first[i]];
+                continue;
+            }
+            int newV = nbOrigVertices + dupOffset[v] + nbDup;
+            nbDup++;
+            _vertSource[newV] = _vertSource[v];
+            vertHe[newV] = omHe[first[i]];
+            int cur = first[i];
+            do
+            {
+                _faceVerts[cur] = newV;
+                cur = oppFace[prevHe(cur)];
+            } while(cur != first[i]);
+        }
+    }
+
+    // 3. fill OpenMesh kernel
+    m_mesh.clean();
+    m_mesh.reserve(nbVertices, nbEdges, nbFaces);
+    for (int v = 0; v < nbVertices; v++)
+    {
+        const glm::vec3& p = _positions[_vertSource[v]];
+        m_mesh.new_vertex(OpMesh::Point(p.x, p.y, p.z));
+    }
+    for (int e = 0; e < nbEdges; e++)
+    {
+        int h = edgeFirstHe[e];
+        m_mesh.new_edge(OpMesh::VertexHandle(_faceVerts[h]), OpMesh::VertexHandle(_faceVerts[nextHe(h)]));
+    }
+    for (int f = 0; f < nbFaces; f++)
+        m_mesh.new_face();
 
-    qInfo() << "[info] TriMeshHE::readFile: finished ";
+    // connectivity (each halfedge, face, and vertex is written once)
+    #pragma omp parallel for
+    for (int h = 0; h < nbFaceHalfedges; h++)
+    {
+        OpMesh::HalfedgeHandle heh(omHe[h]);
+        m_mesh.set_face_handle(heh, OpMesh::FaceHandle(h / 3));
+        m_mesh.set_next_halfedge_handle(heh, OpMesh::HalfedgeHandle(omHe[nextHe(h)]));
+        if(oppFace[h] < 0)
+        {
+            // boundary halfedge opposite to h
+            OpMesh::HalfedgeHandle bheh(omHe[h] ^ 1);
+            m_mesh.set_next_halfedge_handle(bheh, OpMesh::HalfedgeHandle(omHe[nextBoundary[h]] ^ 1));
+        }
+    }
+    #pragma omp parallel for
+    for (int f = 0; f < nbFaces; f++)
+    {
+        // halfedge of the face points to its first corner
+        m_mesh.set_halfedge_handle(OpMesh::FaceHandle(f), OpMesh::HalfedgeHandle(omHe[3 * f + 2]));
+    }
+    #pragma omp parallel for
+    for (int v = 0; v < nbVertices; v++)
+    {
+        if(vertHe[v] >= 0)
+            m_mesh.set_halfedge_handle(OpMesh::VertexHandle(v), OpMesh::HalfedgeHandle(vertHe[v]));
+    }
 
     return true;
 }
@@ -354,29 +1154,128 @@ void TriMeshHE::computeNormals()
         m_mesh.request_vertex_normals();
     }
 
-    // we need face normals to update the vertex normals
-    m_mesh.request_face_normals();
-    // let the mesh update the normals
-    m_mesh.update_normals();
-    // dispose the face normals, as we don't need them anymore
-//    m_mesh.release_face_normals(); // @@@ keep face normals
+    const int nbFaces = (int)m_mesh.n_faces();
+    const int nbVertices = (int)m_mesh.n_vertices();
+
+    // 1. unit normal and area of each face (each face is evaluated once)
+    std::vector<glm::vec3> faceNormals(nbFaces);
+    std::vector<float> faceAreas(nbFaces);
+    #pragma omp parallel for
+    for (int f = 0; f < nbFaces; f++)
+        faceNormals[f] = compFaceNormal(m_mesh.face_handle(f), faceAreas[f]);
+
+    // face normals are only stored when they are exported (see duplicateVertices())
+    if ( m_mesh.has_face_normals() )
+    {
+        #pragma omp parallel for
+        for (int f = 0; f < nbFaces; f++)
+            m_mesh.set_normal(m_mesh.face_handle(f), OpMesh::Normal(faceNormals[f].x, faceNormals[f].y, faceNormals[f].z));
+    }
+
+    if ( !reportProgress(0.5f) )
+    {
+        qInfo() << "[info] TriMeshHE::computeNormals: Normals calculation canceled";
+        return;
+    }
+
+    // 2. gather face normals around each vertex (each vertex only writes its own normal)
+    #pragma omp parallel for
+    for (int v = 0; v < nbVertices; v++)
+    {
+        OpMesh::VertexHandle vh = m_mesh.vertex_handle(v);
+        glm::vec3 n = compVertexNormal(vh, faceNormals.data(), faceAreas.data());
+        m_mesh.set_normal(vh, OpMesh::Normal(n.x, n.y, n.z));
+    }
 
     qInfo() << "[info] TriMeshHE::computeNormals: Normals computed";
 }
 
 
+glm::vec3 TriMeshHE::compFaceNormal(OpMesh::FaceHandle _fh, float& _area) const
+{
+    OpMesh::ConstFaceVertexIter fv_it = m_mesh.cfv_iter(_fh);
+    OpMesh::Point p0 = m_mesh.point(*fv_it);
+    OpMesh::Point p1 = m_mesh.point(*(++fv_it));
+    OpMesh::Point p2 = m_mesh.point(*(++fv_it));
+
+    glm::vec3 n = glm::cross( glm::vec3(p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]),
+                              glm::vec3(p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]) );
+    float l = glm::length(n);
+    _area = 0.5f * l;
+    return (l > 0.0f) ? n / l : glm::vec3(0.0f);
+}
+
+
+glm::vec3 TriMeshHE::compVertexNormal(OpMesh::VertexHandle _vh, const glm::vec3* _faceNormals, const float* _faceAreas) const
+{
+    OpMesh::Point pi = m_mesh.point(_vh);
+    glm::vec3 p(pi[0], pi[1], pi[2]);
+
+    glm::vec3 n(0.0f);
+    // for each outgoing halfedge (i.e. each corner of the vertex) ...
+    for (OpMesh::ConstVertexOHalfedgeIter voh_it = m_mesh.cvoh_iter(_vh); voh_it.is_valid(); ++voh_it)
+    {
+        OpMesh::FaceHandle fh = m_mesh.face_handle(*voh_it);
+        if ( !fh.is_valid() )
+            continue;
+
+        float weight = 1.0f;
+        if ( m_normalWeighting == NORMAL_WEIGHT_AREA )
+            weight = _faceAreas[fh.idx()];
+        else if ( m_normalWeighting == NORMAL_WEIGHT_ANGLE )
+        {
+            // angle between the two edges of the face adjacent to the vertex
+            OpMesh::Point pNext = m_mesh.point( m_mesh.to_vertex_handle(*voh_it) );
+            OpMesh::Point pPrev = m_mesh.point( m_mesh.from_vertex_handle(m_mesh.prev_halfedge_handle(*voh_it)) );
+            glm::vec3 e1 = glm::vec3(pNext[0], pNext[1], pNext[2]) - p;
+            glm::vec3 e2 = glm::vec3(pPrev[0], pPrev[1], pPrev[2]) - p;
+            weight = std::atan2( glm::length(glm::cross(e1, e2)), glm::dot(e1, e2) );
+        }
+        n += weight * _faceNormals[fh.idx()];
+    }
+
+    float l = glm::length(n);
+    return (l > 0.0f) ? n / l : glm::vec3(0.0f);
+}
+
+
+void TriMeshHE::updateFaceNormals()
+{
+    if ( !m_mesh.has_face_normals() )
+        m_mesh.request_face_normals();
+
+    #pragma omp parallel for
+    for (int f = 0; f < (int)m_mesh.n_faces(); f++)
+    {
+        float area;
+        OpMesh::FaceHandle fh = m_mesh.face_handle(f);
+        glm::vec3 n = compFaceNormal(fh, area);
+        m_mesh.set_normal(fh, OpMesh::Normal(n.x, n.y, n.z));
+    }
+}
+
+
 void TriMeshHE::computeTB()
 {
-    if ( m_mesh.has_vertex_texcoords2D() && m_mesh.has_halfedge_texcoords2D() )
+    if ( m_mesh.has_halfedge_texcoords2D() )
     {
         // add tangent as hafledge property (several tangent per vertex, one for each face)
-        m_mesh.add_property(tangents);
+        if ( !tangents.is_valid() )
+            m_mesh.add_property(tangents);
         // add bitangent as hafledge property (several tangent per vertex, one for each face)
-        m_mesh.add_property(bitangents);
+        if ( !bitangents.is_valid() )
+            m_mesh.add_property(bitangents);
 
         // for each triangle of the mesh...
-        for (OpMesh::FaceIter f_it = m_mesh.faces_begin(); f_it != m_mesh.faces_end(); ++f_it)
+        int nbFacesDone = 0;
+        for (OpMesh::FaceIter f_it = m_mesh.faces_begin(); f_it != m_mesh.faces_end(); ++f_it, ++nbFacesDone)
         {
+            if ( nbFacesDone % 4096 == 0 && !reportProgress( (float)nbFacesDone / (float)m_mesh.n_faces() ) )
+            {
+                qInfo() << "[info] TriMeshHE::computeTB: Tangents and Bitangents calculation canceled";
+                return;
+            }
+
             // for each halfedge of the triangle
             for (OpMesh::FaceHalfedgeIter fh_it = m_mesh.fh_iter( *f_it ); fh_it.is_valid(); ++fh_it)
             {
@@ -443,6 +1342,8 @@ void TriMeshHE::lapSmooth(unsigned int _nbIter, float _fact)
     OpMesh::Point               cog;                                    // center of gravity (i.e. barycenter, avg coords of first-ring neighborhood)
     OpMesh::Scalar              valence;                                // valence of the vertex (i.e. nb of direct neighbors)
 
+    auto start = std::chrono::high_resolution_clock::now();
+
     for (unsigned int i = 0; i < _nbIter; i++)
     {
         vecCogs.clear();
@@ -482,16 +1383,439 @@ void TriMeshHE::lapSmooth(unsigned int _nbIter, float _fact)
                 }
             }
         }
+
+        if ( !reportProgress( (float)(i + 1) / (float)_nbIter ) )
+        {
+            qInfo() << "[info] TriMeshHE::lapSmooth: Laplacian smoothing canceled after " << i + 1 << " iterations";
+            return;
+        }
     }
 
+    auto end = std::chrono::high_resolution_clock::now();
+
     computeNormals();
 
-    qInfo() << "[info] TriMeshHE::lapSmooth: Laplacian smoothing finished";
+    qInfo() << "[info] TriMeshHE::lapSmooth: Laplacian smoothing finished in "
+            << std::chrono::duration<double, std::milli>(end - start).count() << " ms";
+}
+
+float TriMeshHE::decimate(float _ratio)
+{
+    const int nbFacesInit = (int)m_mesh.n_faces();
+    if ( _ratio <= 0.0f || _ratio >= 1.0f || nbFacesInit == 0 )
+    {
+        qWarning() << "[Warning] TriMeshHE::decimate: ratio must be in ]0;1[";
+        return -1.0f;
+    }
+    const int targetFaces = std::max(1, (int)std::lround(_ratio * nbFacesInit));
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // status flags are needed to delete elements
+    m_mesh.request_vertex_status();
+    m_mesh.request_edge_status();
+    m_mesh.request_face_status();
+    m_mesh.request_halfedge_status();
+
+    const int nbVertices = (int)m_mesh.n_vertices();
+    const int nbEdges = (int)m_mesh.n_edges();
+    const bool hasUVSeams = m_mesh.has_halfedge_texcoords2D();
+
+    // 1. plane of each face
+    std::vector<glm::vec3> faceNormals(nbFacesInit);
+    std::vector<Eigen::Vector4d> facePlanes(nbFacesInit);
+    #pragma omp parallel for
+    for (int f = 0; f < nbFacesInit; f++)
+    {
+        OpMesh::FaceHandle fh = m_mesh.face_handle(f);
+        float area;
+        faceNormals[f] = compFaceNormal(fh, area);
+        const OpMesh::Point& p = m_mesh.point( m_mesh.to_vertex_handle(m_mesh.halfedge_handle(fh)) );
+        const glm::vec3& n = faceNormals[f];
+        facePlanes[f] = Eigen::Vector4d(n.x, n.y, n.z, -(n.x * p[0] + n.y * p[1] + n.z * p[2]));
+    }
+
+    // 2. feature edges: boundaries, UV seams (corners differ on each side of the edge) and creases
+    std::vector<char> featureEdges(nbEdges, 0);
+    const float creaseCos = std::cos(glm::radians(s_creaseAngle));
+    #pragma omp parallel for
+    for (int e = 0; e < nbEdges; e++)
+    {
+        OpMesh::EdgeHandle eh = m_mesh.edge_handle(e);
+        if ( m_mesh.is_boundary(eh) )
+        {
+            featureEdges[e] = 1;
+            continue;
+        }
+        OpMesh::HalfedgeHandle h0 = m_mesh.halfedge_handle(eh, 0);
+        OpMesh::HalfedgeHandle h1 = m_mesh.halfedge_handle(eh, 1);
+        if ( glm::dot(faceNormals[m_mesh.face_handle(h0).idx()], faceNormals[m_mesh.face_handle(h1).idx()]) < creaseCos )
+            featureEdges[e] = 1;
+        // h0 and prev(h1) point to the same vertex, from each side of the edge (same for h1 and prev(h0))
+        else if ( hasUVSeams && ( m_mesh.texcoord2D(h0) != m_mesh.texcoord2D(m_mesh.prev_halfedge_handle(h1))
+                               || m_mesh.texcoord2D(h1) != m_mesh.texcoord2D(m_mesh.prev_halfedge_handle(h0)) ) )
+            featureEdges[e] = 1;
+    }
+
+    auto countFeatureEdges = [&](OpMesh::VertexHandle _vh)
+    {
+        int count = 0;
+        for (OpMesh::VertexEdgeIter ve_it = m_mesh.ve_iter(_vh); ve_it.is_valid(); ++ve_it)
+            count += featureEdges[ve_it->idx()];
+        return count;
+    };
+
+    // 3. quadric of each vertex: planes of its faces, and planes orthogonal to its feature edges
+    //    (each vertex only writes its own quadric)
+    std::vector<Eigen::Matrix4d> quadrics(nbVertices);
+    std::vector<Eigen::Matrix4d> planeQuadrics(nbVertices);     // face planes only (measure of the error, see step 5)
+    std::vector<int> featureValence(nbVertices, 0);
+    #pragma omp parallel for
+    for (int v = 0; v < nbVertices; v++)
+    {
+        OpMesh::VertexHandle vh = m_mesh.vertex_handle(v);
+        Eigen::Matrix4d Q = Eigen::Matrix4d::Zero();
+        for (OpMesh::VertexFaceIter vf_it = m_mesh.vf_iter(vh); vf_it.is_valid(); ++vf_it)
+        {
+            const Eigen::Vector4d& plane = facePlanes[vf_it->idx()];
+            Q += plane * plane.transpose();
+        }
+        planeQuadrics[v] = Q;
+        for (OpMesh::VertexOHalfedgeIter voh_it = m_mesh.voh_iter(vh); voh_it.is_valid(); ++voh_it)
+        {
+            if ( !featureEdges[m_mesh.edge_handle(*voh_it).idx()] )
+                continue;
+            featureValence[v]++;
+
+            // plane containing the edge, orthogonal to its (inner) face
+            OpMesh::HalfedgeHandle inner = m_mesh.is_boundary(*voh_it) ? m_mesh.opposite_halfedge_handle(*voh_it) : *voh_it;
+            const OpMesh::Point& p0 = m_mesh.point(vh);
+            const OpMesh::Point& p1 = m_mesh.point(m_mesh.to_vertex_handle(*voh_it));
+            glm::vec3 dir(p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]);
+            glm::vec3 n = glm::cross(dir, faceNormals[m_mesh.face_handle(inner).idx()]);
+            float len = glm::length(n);
+            if ( len == 0.0f )
+                continue;
+            n /= len;
+            Eigen::Vector4d plane(n.x, n.y, n.z, -(n.x * p0[0] + n.y * p0[1] + n.z * p0[2]));
+            Q += s_featureWeight * plane * plane.transpose();
+        }
+        quadrics[v] = Q;
+    }
+
+    // normal of a face after one of its vertices has been moved (null if degenerated)
+    auto movedFaceNormal = [this](OpMesh::FaceHandle _fh, OpMesh::VertexHandle _vh, const OpMesh::Point& _pos)
+    {
+        OpMesh::Point p[3];
+        int i = 0;
+        for (OpMesh::FaceVertexIter fv_it = m_mesh.fv_iter(_fh); fv_it.is_valid(); ++fv_it, ++i)
+            p[i] = (*fv_it == _vh) ? _pos : m_mesh.point(*fv_it);
+        OpMesh::Point n = (p[1] - p[0]) % (p[2] - p[0]);
+        float len = n.norm();
+        return (len > 0.0f) ? glm::vec3(n[0], n[1], n[2]) / len : glm::vec3(0.0f);
+    };
+
+    // cost and position of the collapse of a halfedge (its from-vertex is removed), false if the collapse is not allowed
+    auto evalCollapse = [&](OpMesh::HalfedgeHandle _heh, double& _cost, OpMesh::Point& _pos) -> bool
+    {
+        OpMesh::VertexHandle v0 = m_mesh.from_vertex_handle(_heh);
+        OpMesh::VertexHandle v1 = m_mesh.to_vertex_handle(_heh);
+
+        // a vertex on a feature line only slides along it, the corners of the features stay
+        const int valence0 = featureValence[v0.idx()];
+        if ( valence0 != 0 && ( valence0 != 2 || !featureEdges[m_mesh.edge_handle(_heh).idx()] ) )
+            return false;
+        if ( !isCollapseOk(_heh) )
+            return false;
+
+        const Eigen::Matrix4d Q = quadrics[v0.idx()] + quadrics[v1.idx()];
+        const OpMesh::Point& p0 = m_mesh.point(v0);
+        const OpMesh::Point& p1 = m_mesh.point(v1);
+        Eigen::Vector4d x(p1[0], p1[1], p1[2], 1.0);
+        if ( valence0 == 0 && featureValence[v1.idx()] == 0 )
+        {
+            // optimal position, if the quadric is well conditioned and the position stays close to the edge
+            Eigen::FullPivLU<Eigen::Matrix3d> lu(Q.topLeftCorner<3, 3>());
+            if ( lu.isInvertible() )
+            {
+                Eigen::Vector3d opt = lu.solve(-Q.topRightCorner<3, 1>());
+                Eigen::Vector3d mid(0.5 * (p0[0] + p1[0]), 0.5 * (p0[1] + p1[1]), 0.5 * (p0[2] + p1[2]));
+                if ( (opt - mid).norm() <= (p1 - p0).norm() )
+                    x.head<3>() = opt;
+            }
+        }
+        _cost = std::max(0.0, x.dot(Q * x));
+        _pos = OpMesh::Point((float)x[0], (float)x[1], (float)x[2]);
+
+        // the faces which remain around v0 and v1 must not flip
+        OpMesh::FaceHandle fl = m_mesh.face_handle(_heh);
+        OpMesh::FaceHandle fr = m_mesh.face_handle(m_mesh.opposite_halfedge_handle(_heh));
+        for (OpMesh::VertexHandle vh : { v0, v1 })
+        {
+            for (OpMesh::VertexFaceIter vf_it = m_mesh.vf_iter(vh); vf_it.is_valid(); ++vf_it)
+            {
+                if ( *vf_it == fl || *vf_it == fr )
+                    continue;
+                float area;
+                glm::vec3 before = compFaceNormal(*vf_it, area);
+                glm::vec3 after = movedFaceNormal(*vf_it, vh, _pos);
+                // (already degenerated faces are not checked)
+                if ( area > 0.0f && glm::dot(before, after) < s_minNormalDot )
+                    return false;
+            }
+        }
+        return true;
+    };
+
+    // 4. priority queue of collapses, one candidate per vertex (its cheapest outgoing halfedge).
+    //    Candidates are not removed from the queue when they become outdated: each vertex has a stamp,
+    //    incremented when its candidate is recomputed, and outdated entries are skipped when popped (lazy deletion).
+    struct Collapse
+    {
+        double cost;
+        int heh;
+        int vertex;
+        unsigned int stamp;
+        bool operator<(const Collapse& _other) const { return cost > _other.cost; }    // cheapest on top
+    };
+    std::vector<unsigned int> stamps(nbVertices, 0);
+
+    auto findCandidate = [&](OpMesh::VertexHandle _vh, Collapse& _candidate) -> bool
+    {
+        _candidate = { std::numeric_limits<double>::max(), -1, _vh.idx(), stamps[_vh.idx()] };
+        for (OpMesh::VertexOHalfedgeIter voh_it = m_mesh.voh_iter(_vh); voh_it.is_valid(); ++voh_it)
+        {
+            double cost;
+            OpMesh::Point pos;
+            if ( evalCollapse(*voh_it, cost, pos) && cost < _candidate.cost )
+            {
+                _candidate.cost = cost;
+                _candidate.heh = voh_it->idx();
+            }
+        }
+        return _candidate.heh >= 0;
+    };
+
+    // initial candidates are evaluated in parallel (the mesh is only read)
+    std::vector<Collapse> candidates(nbVertices);
+    std::vector<char> hasCandidate(nbVertices);
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int v = 0; v < nbVertices; v++)
+        hasCandidate[v] = findCandidate(m_mesh.vertex_handle(v), candidates[v]);
+    size_t nbCandidates = 0;
+    for (int v = 0; v < nbVertices; v++)
+    {
+        if ( hasCandidate[v] )
+            candidates[nbCandidates++] = candidates[v];
+    }
+    candidates.resize(nbCandidates);
+    std::priority_queue<Collapse> queue(std::less<Collapse>(), std::move(candidates));
+
+    auto updateCandidate = [&](OpMesh::VertexHandle _vh)
+    {
+        stamps[_vh.idx()]++;
+        Collapse candidate;
+        if ( findCandidate(_vh, candidate) )
+            queue.push(candidate);
+    };
+
+    // 5. collapse the cheapest edges until the target number of faces is reached
+    int nbFaces = nbFacesInit;
+    int nbCollapses = 0;
+    double maxDistance = 0.0;
+    while ( nbFaces > targetFaces && !queue.empty() )
+    {
+        Collapse collapse = queue.top();
+        queue.pop();
+
+        OpMesh::VertexHandle v0 = m_mesh.vertex_handle(collapse.vertex);
+        if ( collapse.stamp != stamps[collapse.vertex] || m_mesh.status(v0).deleted() )
+            continue;
+
+        // the neighborhood may have moved since the candidate was computed: check again
+        OpMesh::HalfedgeHandle heh = m_mesh.halfedge_handle(collapse.heh);
+        double cost;
+        OpMesh::Point pos;
+        if ( m_mesh.status(m_mesh.edge_handle(heh)).deleted() || !evalCollapse(heh, cost, pos) )
+        {
+            updateCandidate(v0);
+            continue;
+        }
+
+        OpMesh::VertexHandle v1 = m_mesh.to_vertex_handle(heh);
+        OpMesh::HalfedgeHandle opp = m_mesh.opposite_halfedge_handle(heh);
+
+        // the two edges of each removed face are merged into one, which is a feature edge if any of them is
+        OpMesh::VertexHandle sides[2];
+        bool sideFeatures[2] = { false, false };
+        int nbRemovedFaces = 0;
+        for (OpMesh::HalfedgeHandle h : { heh, opp })
+        {
+            if ( m_mesh.is_boundary(h) )
+                continue;
+            OpMesh::HalfedgeHandle next = m_mesh.next_halfedge_handle(h);
+            sides[nbRemovedFaces] = m_mesh.to_vertex_handle(next);
+            sideFeatures[nbRemovedFaces] = featureEdges[m_mesh.edge_handle(next).idx()] || featureEdges[m_mesh.edge_handle(m_mesh.prev_halfedge_handle(h)).idx()];
+            nbRemovedFaces++;
+        }
+
+        // v1 moves to pos, and now stands for the original faces of v0 as well: the sum of the squared distances
+        // to their planes (unweighted quadric) bounds the largest of these distances
+        planeQuadrics[v1.idx()] += planeQuadrics[v0.idx()];
+        const Eigen::Vector4d x(pos[0], pos[1], pos[2], 1.0);
+        maxDistance = std::max(maxDistance, std::sqrt(std::max(0.0, x.dot(planeQuadrics[v1.idx()] * x))));
+
+        if ( hasUVSeams )
+            collapseTexCoords(heh, featureEdges);
+        quadrics[v1.idx()] += quadrics[v0.idx()];
+        m_mesh.set_point(v1, pos);
+        m_mesh.collapse(heh);
+
+        for (int s = 0; s < nbRemovedFaces; s++)
+        {
+            OpMesh::HalfedgeHandle merged = m_mesh.find_halfedge(v1, sides[s]);
+            if ( merged.is_valid() && sideFeatures[s] )
+                featureEdges[m_mesh.edge_handle(merged).idx()] = 1;
+            featureValence[sides[s].idx()] = countFeatureEdges(sides[s]);
+        }
+        featureValence[v1.idx()] = countFeatureEdges(v1);
+
+        nbFaces -= nbRemovedFaces;
+        nbCollapses++;
+
+        // the quadric of v1 and the position of v1 changed: recompute the candidates of v1 and its neighbors
+        updateCandidate(v1);
+        for (OpMesh::VertexVertexIter vv_it = m_mesh.vv_iter(v1); vv_it.is_valid(); ++vv_it)
+            updateCandidate(*vv_it);
+
+        if ( nbCollapses % 4096 == 0 && !reportProgress( (float)(nbFacesInit - nbFaces) / (float)(nbFacesInit - targetFaces) ) )
+        {
+            qInfo() << "[info] TriMeshHE::decimate: decimation canceled after " << nbCollapses << " collapses";
+            return -1.0f;
+        }
+    }
+
+    // 6. remove deleted elements, then update the data depending on vertices
+    m_mesh.garbage_collection();
+    m_mesh.release_vertex_status();
+    m_mesh.release_edge_status();
+    m_mesh.release_face_status();
+    m_mesh.release_halfedge_status();
+
+    m_scalars.clear();
+    m_meanCurv.clear();
+    m_gaussCurv.clear();
+    m_minCurv.clear();
+    m_maxCurv.clear();
+    computeNormals();
+    if ( m_TBComputed )
+        computeTB();
+    computeAABB();
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    const float error = (float)maxDistance;
+    if ( nbFaces > targetFaces )
+        qWarning() << "[Warning] TriMeshHE::decimate: no more edge can be collapsed, " << nbFaces << " faces left (" << targetFaces << " requested)";
+    qInfo() << "[info] TriMeshHE::decimate: " << nbFacesInit << " -> " << nbFaces << " faces, error " << error << ", in "
+            << std::chrono::duration<double, std::milli>(end - start).count() << " ms";
+
+    return error;
+}
+
+
+bool TriMeshHE::isCollapseOk(OpMesh::HalfedgeHandle _heh) const
+{
+    OpMesh::HalfedgeHandle opp = m_mesh.opposite_halfedge_handle(_heh);
+    OpMesh::VertexHandle v0 = m_mesh.from_vertex_handle(_heh);
+    OpMesh::VertexHandle v1 = m_mesh.to_vertex_handle(_heh);
+
+    // opposite vertices of the faces removed by the collapse
+    OpMesh::VertexHandle vl, vr;
+    if ( !m_mesh.is_boundary(_heh) )
+    {
+        OpMesh::HalfedgeHandle next = m_mesh.next_halfedge_handle(_heh);
+        vl = m_mesh.to_vertex_handle(next);
+        // the two other edges of the face cannot both be on the boundary (the face is an ear)
+        if ( m_mesh.is_boundary(m_mesh.opposite_halfedge_handle(next)) && m_mesh.is_boundary(m_mesh.opposite_halfedge_handle(m_mesh.prev_halfedge_handle(_heh))) )
+            return false;
+    }
+    if ( !m_mesh.is_boundary(opp) )
+    {
+        OpMesh::HalfedgeHandle next = m_mesh.next_halfedge_handle(opp);
+        vr = m_mesh.to_vertex_handle(next);
+        if ( m_mesh.is_boundary(m_mesh.opposite_halfedge_handle(next)) && m_mesh.is_boundary(m_mesh.opposite_halfedge_handle(m_mesh.prev_halfedge_handle(opp))) )
+            return false;
+    }
+    if ( vl.is_valid() && vl == vr )
+        return false;
+
+    // an inner edge between two boundary vertices would pinch the surface
+    if ( m_mesh.is_boundary(v0) && m_mesh.is_boundary(v1) && !m_mesh.is_boundary(m_mesh.edge_handle(_heh)) )
+        return false;
+
+    // link condition: v0 and v1 have no other common neighbor than vl and vr
+    for (OpMesh::ConstVertexVertexIter vv0_it = m_mesh.cvv_iter(v0); vv0_it.is_valid(); ++vv0_it)
+    {
+        if ( *vv0_it == v1 || *vv0_it == vl || *vv0_it == vr )
+            continue;
+        for (OpMesh::ConstVertexVertexIter vv1_it = m_mesh.cvv_iter(v1); vv1_it.is_valid(); ++vv1_it)
+        {
+            if ( *vv1_it == *vv0_it )
+                return false;
+        }
+    }
+
+    return true;
+}
+
+
+void TriMeshHE::collapseTexCoords(OpMesh::HalfedgeHandle _heh, const std::vector<char>& _featureEdges)
+{
+    // corners of v0 are visited by rotating around v0, each halfedge pointing to v0 getting the UV of v1 in the same face.
+    // The UV of v1 is the same in all the faces between two feature edges:
+    // the walk starting from the face of _heh stops at the first feature edge, 
+    // the walk starting from the opposite face (in the other direction) stops at the other one.
+    OpMesh::HalfedgeHandle opp = m_mesh.opposite_halfedge_handle(_heh);
+
+    if ( !m_mesh.is_boundary(_heh) )
+    {
+        const OpMesh::TexCoord2D uv = m_mesh.texcoord2D(_heh);
+        OpMesh::HalfedgeHandle out = _heh;
+        do
+        {
+            OpMesh::HalfedgeHandle in = m_mesh.prev_halfedge_handle(out);
+            m_mesh.set_texcoord2D(in, uv);
+            if ( _featureEdges[m_mesh.edge_handle(in).idx()] )
+                break;
+            out = m_mesh.opposite_halfedge_handle(in);
+        } while ( out != _heh && !m_mesh.is_boundary(out) );
+    }
+
+    if ( !m_mesh.is_boundary(opp) )
+    {
+        const OpMesh::TexCoord2D uv = m_mesh.texcoord2D(m_mesh.prev_halfedge_handle(opp));
+        OpMesh::HalfedgeHandle out = m_mesh.next_halfedge_handle(opp);
+        do
+        {
+            m_mesh.set_texcoord2D(m_mesh.prev_halfedge_handle(out), uv);
+            if ( _featureEdges[m_mesh.edge_handle(out).idx()] )
+                break;
+            out = m_mesh.next_halfedge_handle(m_mesh.opposite_halfedge_handle(out));
+        } while ( !m_mesh.is_boundary(out) && out != m_mesh.next_halfedge_handle(opp) );
+    }
 }
 
+
 void TriMeshHE::duplicateVertices()
 {
-    // todo
+    // vertices are not duplicated in the half-edge structure, only in the exported buffers:
+    // each face corner becomes a separate vertex, which allows per-face attributes (i.e. face normals)
+    if ( !m_mesh.has_face_normals() )
+        updateFaceNormals();
+    m_isVertDuplicated = true;
+
+    qInfo() << "[info] TriMeshHE::duplicateVertices: Vertices duplicated";
 }
 
 
@@ -501,45 +1825,24 @@ void TriMeshHE::computeSurfVar()
     // Pauly et al., "Efficient Simplification of Point-Sampled Surfaces", IEEE Visualization, 2002
     // https://www.graphics.rwth-aachen.de/media/papers/p_Pau021.pdf
 
-    qInfo() << "[info] TriMeshHE::computeSurfVar: mesh color will be overwritten by surface variation ";
+    qInfo() << "[info] TriMeshHE::computeSurfVar: scalar field will be overwritten by surface variation ";
 
     OpMesh::VertexIter v_it, v_end(m_mesh.vertices_end());
 
-    std::vector<double> values, sortedVal;
-
-    double maxCurv = 0.0f;
+    m_scalars.clear();
+    m_scalars.reserve(m_mesh.n_vertices());
     for (v_it = m_mesh.vertices_begin(); v_it != v_end; ++v_it)
     {
-        double curv = compLocalVariation(v_it) ;
-
-        values.push_back(curv);
-    }
+        m_scalars.push_back( (float)compLocalVariation(v_it) );
 
-    // sort vector and ignore the last 5% of higher curvatures to remove outliers
-    sortedVal = values;
-    std::sort(sortedVal.begin(), sortedVal.end() );
-    float maxBound = sortedVal[(int)( (float)sortedVal.size() *0.95f )];
-    maxCurv = maxBound;
-
-    unsigned int i = 0;
-    for (v_it = m_mesh.vertices_begin(), i=0; v_it != v_end; ++v_it, ++i)
-    {
-        double H = 0.0f;
-        if(values[i] > 0.0f && values[i] < maxBound)
+        if ( m_scalars.size() % 4096 == 0 && !reportProgress( (float)m_scalars.size() / (float)m_mesh.n_vertices() ) )
         {
-            // normalize cuvature using maximum
-            double curvNormalized = values[i] / maxCurv;
-            // H in [0; 120] degrees (red to green)
-            H = 120 - curvNormalized * 120;
+            qInfo() << "[info] TriMeshHE::computeSurfVar: Surface variation calculation canceled";
+            return;
         }
-
-        // build HSV color and transform to RGB 
-        QColor rgb = QColor::fromHsv(  (int)H, 255, 255);
-        OpMesh::Color col( rgb.red() , rgb.green(), rgb.blue() );
-        m_mesh.set_color(*v_it, col );
-
     }
-    qInfo() << "[info] TriMeshHE::computeSurfVar: Surface variation calculation finished, show mesh color to see the result ";
+
+    qInfo() << "[info] TriMeshHE::computeSurfVar: Surface variation calculation finished, show scalar field to see the result ";
 }
 
 
@@ -602,338 +1905,94 @@ double TriMeshHE::compLocalVariation(OpMesh::VertexIter _hi)
 }
 
 
+
+
 void TriMeshHE::computeMeanCurv()
 {
     // Discrete Mean Curvature is calculated using the algorithm described in :
     // Using Meyer et al., "Discrete Differential-Geometry Operators for Triangulated 2-Manifolds", Visualization and Mathematics III, 2003
     // http://multires.caltech.edu/pubs/diffGeoOps.pdf
 
-    qInfo() << "[info] TriMeshHE::computeMeanCurv: mesh color will be overwritten by surface variation ";
-
-    OpMesh::VertexIter v_it, v_end(m_mesh.vertices_end());
-
-    std::vector<double> values, sortedVal;
-
-    double maxCurv = 0.0f;
-    for (v_it = m_mesh.vertices_begin(); v_it != v_end; ++v_it)
-    {
-        double curv = vertMeanCurv(v_it) ;
-
-        values.push_back(curv);
-    }
+    qInfo() << "[info] TriMeshHE::computeMeanCurv: scalar field will be overwritten by mean curvature ";
 
-    // sort vector and ignore the last 5% of higher curvatures to remove outliers
-    sortedVal = values;
-    std::sort(sortedVal.begin(), sortedVal.end() );
-    float maxBound = sortedVal[(int)( (float)sortedVal.size() *0.95f )];
-    maxCurv = maxBound;
+    auto start = std::chrono::high_resolution_clock::now();
 
-    unsigned int i = 0;
-    for (v_it = m_mesh.vertices_begin(), i=0; v_it != v_end; ++v_it, ++i)
-    {
-        double H = 0.0f;
-        if(values[i] > 0.0f && values[i] < maxBound)
-        {
-            // normalize cuvature using maximum
-            double curvNormalized = values[i] / maxCurv;
-            // H in [0; 120] degrees (red to green)
-            H = 120 - curvNormalized * 120;
-        }
+    // mean, Gaussian and principal curvatures are all computed in a single sweep
+    compVertCurvatures();
 
-        // build HSV color and transform to RGB 
-        QColor rgb = QColor::fromHsv(  (int)H, 255, 255);
-        OpMesh::Color col( rgb.red() , rgb.green(), rgb.blue() );
-        m_mesh.set_color(*v_it, col );
+    auto end = std::chrono::high_resolution_clock::now();
 
-    }
+    m_scalars = m_meanCurv;
 
-    qInfo() << "[info] TriMeshHE::computeMeanCurv: Mean curvature calculation finished, show mesh color to see the result ";
+    qInfo() << "[info] TriMeshHE::computeMeanCurv: Mean curvature calculation finished in "
+            << std::chrono::duration<double, std::milli>(end - start).count() << " ms, show scalar field to see the result ";
 }
 
-double TriMeshHE::vertMeanCurv(OpMesh::VertexIter _xi)
-{
-    if(!m_mesh.is_manifold(*_xi ) )
-        return 0.0f;
-
-    OpMesh::VertexVertexIter vv_it, next_it, prev_it;
-
-    glm::vec3 K(0.0f);
-    // for each neighbor vertex ...
-    for (vv_it = m_mesh.vv_iter( *_xi ); vv_it.is_valid(); ++vv_it)
-    {
-        // previous neighbor
-        prev_it = vv_it;
-        --prev_it;
-        // next neighbor
-        next_it = vv_it;
-        ++next_it;
-
-        OpMesh::Point xi = m_mesh.point( *_xi );
-        OpMesh::Point xj = m_mesh.point( *vv_it );
-        glm::vec3 x_i(xi[0], xi[1], xi[2]);
-        glm::vec3 x_j(xj[0], xj[1], xj[2]);
-
-        // get handle to triangle
-        OpMesh::VertexHandle v_h = *vv_it, prev_h = *prev_it, next_h = *next_it;
-
-        OpMesh::VertexIter v_Vit(m_mesh, v_h);
-        OpMesh::VertexIter prev_Vit(m_mesh, prev_h);
-        OpMesh::VertexIter next_Vit(m_mesh, next_h);
-
-        K += (float)compSumCot( _xi, v_Vit, prev_Vit, next_Vit) * (x_i - x_j);
-    }
-
-    float A = (float)compAreaMixed(_xi);
-    glm::vec3 K2;
-    if(A > std::numeric_limits<float>::epsilon() )
-        K2 = K / (2.0f * A );
-    else
-        return 0.0f;
-
 
-    return  0.5f * glm::length(K2);
-
-}
-
-double TriMeshHE::compAreaMixed(OpMesh::VertexIter _xi)
+void TriMeshHE::compFaceCurvTerms(std::vector<float>& _cotOpp, std::vector<float>& _angle, std::vector<float>& _areaMixed)
 {
-    double sumA = 0.0f;
-
-    // for each neighbor triangle ...
-    OpMesh::VertexFaceIter vf_it;
-    for (vf_it = m_mesh.vf_iter( *_xi ); vf_it.is_valid(); ++vf_it)
-    {
-        if(m_mesh.is_manifold(*_xi ) )
+    // a face (h0, h1, h2) has its corners at the from-vertices of h0, h1 and h2
+    compCurvatureTerms((int)m_mesh.n_faces(), m_mesh.n_halfedges(), [this](int _f, size_t* _hh, glm::vec3* _p)
         {
-            // get handle to triangle
-            OpMesh::FaceHandle f_h = *vf_it;
-
-            OpMesh::FaceIter f_it(m_mesh, f_h);
-        
-            if( !isTriangleObtuse(f_it) )
-            {
-                double AV = compAreaVoronoi(_xi, f_it);
-                if(AV > 0.0f)
-                    sumA += AV;
-               
-            }
-            else if( isAngleObtuse(f_it, _xi) )
+            OpMesh::HalfedgeHandle hh = m_mesh.halfedge_handle(m_mesh.face_handle(_f));
+            for (int k = 0; k < 3; k++)
             {
-                double AT = compAreaTriangle(f_it);
-                if(AT > 0.0f)
-                    sumA += AT / 2.0f;
-                
+                OpMesh::Point pk = m_mesh.point( m_mesh.from_vertex_handle(hh) );
+                _hh[k] = hh.idx();
+                _p[k] = glm::vec3(pk[0], pk[1], pk[2]);
+                hh = m_mesh.next_halfedge_handle(hh);
             }
-            else
-            {
-                double AT = compAreaTriangle(f_it);
-                if(AT > 0.0f)
-                    sumA += AT / 4.0f;
-                
-            }
-        }
-
-    }
-
-    return sumA;
+        },
+        _cotOpp, _angle, _areaMixed);
 }
 
-float TriMeshHE::compAreaVoronoi(OpMesh::VertexIter _xi, OpMesh::FaceIter _f)
-{
-    // get face iter
-    OpMesh::FaceIter f_it = m_mesh.faces_begin() + _f->idx();
-    // circulate over vertices
-    OpMesh::FaceVertexIter fv_it = m_mesh.fv_iter( *f_it );
-    OpMesh::Point pA = m_mesh.point( *fv_it ); ++fv_it;
-    OpMesh::Point pB = m_mesh.point( *fv_it ); ++fv_it;
-    OpMesh::Point pC = m_mesh.point( *fv_it );
-
-    OpMesh::Point p1 ,p2, p3;
-
-    OpMesh::Point px = m_mesh.point( *_xi );
-    if(px == pA)
-    {
-        p1 = pA;
-        p2 = pB;
-        p3 = pC;
-    }
-    else if(px == pB)
-    {
-        p1 = pB;
-        p2 = pA;
-        p3 = pC;
-    }
-    else
-    {
-        p1 = pC;
-        p2 = pA;
-        p3 = pB;
-    }
-
-
-    // get edges
-    glm::vec3 p2p1(p1[0] - p2[0], p1[1] - p2[1], p1[2] - p2[2]);
-    glm::vec3 p3p1(p1[0] - p3[0], p1[1] - p3[1], p1[2] - p3[2]);
-    glm::vec3 p2p3(p3[0] - p2[0], p3[1] - p2[1], p3[2] - p2[2]);
-
-    if( glm::length(p2p1) == 0.0f || glm::length(p3p1) == 0.0f || glm::length(p2p3) == 0.0f)
-        return 0.0f;
 
-    float cosP2 = glm::dot( glm::normalize(p2p1) , glm::normalize(p2p3));     // A.B = ||A|| * ||B|| * cos(AB)
-    float sinP2 = glm::length( glm::cross( glm::normalize(p2p1) , glm::normalize(p2p3) ) );    // ||AxB|| = ||A|| * ||B|| * sin(AB)
-    float cosP3 = glm::dot( glm::normalize(p3p1) , glm::normalize(-p2p3) );
-    float sinP3 = glm::length( glm::cross( glm::normalize(p3p1), glm::normalize(-p2p3) ) );
-
-
-    // cot alpha = cos alpha / sin alpha
-    float cotP2 = cosP2 / sinP2;
-    float cotP3 = cosP3 / sinP3;
-    
-    if( glm::length(p3p1) > std::numeric_limits<float>::epsilon() && glm::length(p2p1) > std::numeric_limits<float>::epsilon() && cotP3 != 0.0f && cotP2 != 0.0f)
-        return ( pow(glm::length(p3p1), 2) * cotP2 + pow(glm::length(p2p1), 2) * cotP3 ) / 8.0f;
-    
-    return 0.0f;
-}
-
-double TriMeshHE::compSumCot(OpMesh::VertexIter _xi, OpMesh::VertexIter _xj, OpMesh::VertexIter _xjm, OpMesh::VertexIter _xjp)
+void TriMeshHE::compVertCurvatures()
 {
-
-    //  _xjm --- _xi
-    //     \      |  \
-    //      \     |   \
-    //       \    |    \
-    //        \   |     \
-    //          _xj --- _xjp
-    //
-    // _xi the "central" vertex
-    // _xj is a neighbor of _xi
-    //_xjm is the "previous" neighbor (_xj-1) 
-    //_xjp is the "next" neighbor (_xp-1)
-    // Alpha_ij = (_xj, _xjm, _xi) angle
-    // Beta_ij = (_xi, _xjp, _xj) angle
-
-    //cot Alpha_ij + cot Beta_ij
-
-    OpMesh::Point x_i = m_mesh.point( *_xi );
-    OpMesh::Point x_j = m_mesh.point( *_xj );
-    OpMesh::Point x_jm = m_mesh.point( *_xjm );
-    OpMesh::Point x_jp = m_mesh.point( *_xjp );
-
-    glm::vec3 a_xi = glm::vec3( x_i[0] - x_jm[0], x_i[1] - x_jm[1], x_i[2] - x_jm[2] ); // vector x_j-1 -> x_i
-    glm::vec3 a_xj = glm::vec3( x_j[0] - x_jm[0], x_j[1] - x_jm[1], x_j[2] - x_jm[2] ); // vector x_j-1 -> x_j
-    glm::vec3 b_xi = glm::vec3( x_i[0] - x_jp[0], x_i[1] - x_jp[1], x_i[2] - x_jp[2] ); // vector x_j+1 -> x_i
-    glm::vec3 b_xj = glm::vec3( x_j[0] - x_jp[0], x_j[1] - x_jp[1], x_j[2] - x_jp[2] ); // vector x_j+1 -> x_j
-    if(glm::length(a_xi) > 0.0f && glm::length(a_xj) > 0.0f && glm::length(b_xi) > 0.0f && glm::length(b_xj) > 0.0f)
+    std::vector<float> cotOpp, angle, areaMixed;
+    compFaceCurvTerms(cotOpp, angle, areaMixed);
+    if ( !reportProgress(0.5f) )
+        return;
+
+    int nbVertices = (int)m_mesh.n_vertices();
+    m_meanCurv.assign(nbVertices, 0.0f);
+    m_gaussCurv.assign(nbVertices, 0.0f);
+    m_minCurv.assign(nbVertices, 0.0f);
+    m_maxCurv.assign(nbVertices, 0.0f);
+
+    // gather cached face terms around each vertex (each vertex only writes its own values)
+    #pragma omp parallel for
+    for (int v = 0; v < nbVertices; v++)
     {
-        a_xi = glm::normalize( a_xi );
-        a_xj = glm::normalize( a_xj );
-        b_xi = glm::normalize( b_xi );
-        b_xj = glm::normalize( b_xj );
-    }
-    else
-        return 0.0f;
-
-    double cosA = glm::dot(a_xi, a_xj);     // A.B = ||A|| * ||B|| * cos(AB)
-    double sinA = glm::length( glm::cross(a_xi, a_xj) );    // ||AxB|| = ||A|| * ||B|| * sin(AB)
-    double cosB = glm::dot(b_xi, b_xj);
-    double sinB = glm::length( glm::cross(b_xi, b_xj) );
-
-    // cot alpha = cos alpha / sin alpha
-    double cotA = cosA / sinA;
-    double cotB = cosB / sinB;
-
-    return cotA + cotB;
-}
+        OpMesh::VertexHandle vh = m_mesh.vertex_handle(v);
+        if (!m_mesh.is_manifold(vh))
+            continue;
 
-double TriMeshHE::compAreaTriangle(OpMesh::FaceIter _f)
-{
-    // get face iter
-    OpMesh::FaceIter f_it = m_mesh.faces_begin() + _f->idx();
-    // circulate over vertices
-    OpMesh::FaceHalfedgeIter fh_it = m_mesh.fh_iter( *f_it );
-    // point from
-    OpMesh::Point p1 = m_mesh.point( m_mesh.from_vertex_handle(*fh_it) );
-    // point to
-    OpMesh::Point p2 = m_mesh.point( m_mesh.to_vertex_handle(*fh_it) );
-    // previous point
-    OpMesh::Point p3 = m_mesh.point( m_mesh.from_vertex_handle( m_mesh.prev_halfedge_handle(*fh_it) ) );
+        OpMesh::Point xi = m_mesh.point(vh);
+        glm::vec3 x_i(xi[0], xi[1], xi[2]);
 
-    // get 2 edges
-    glm::vec3 e1(p2[0] - p1[0], p2[1] - p1[1], p2[2] - p1[2]);
-    glm::vec3 e2(p3[0] - p1[0], p3[1] - p1[1], p3[2] - p1[2]);
+        glm::vec3 K(0.0f);
+        double A = 0.0;
+        double sumAngles = 0.0;
 
-    if( glm::length(e1) > std::numeric_limits<float>::epsilon() && glm::length(e2) > std::numeric_limits<float>::epsilon() )
-    {
-        // area = (1/2) * || e1 x e2 ||
-        if(abs(glm::dot( glm::normalize(e1), glm::normalize(e2))) > std::numeric_limits<float>::epsilon())
+        // for each outgoing halfedge (x_i -> x_j) ...
+        for (OpMesh::VertexOHalfedgeIter voh_it = m_mesh.voh_iter(vh); voh_it.is_valid(); ++voh_it)
         {
-            double normCross = glm::length( glm::cross(e1, e2) );
-                return normCross / 2.0f;
-        }
+            OpMesh::HalfedgeHandle hh = *voh_it;
+            OpMesh::Point xj = m_mesh.point( m_mesh.to_vertex_handle(hh) );
+            glm::vec3 x_j(xj[0], xj[1], xj[2]);
 
-    }
-
-    return 0.0f;
-}
+            // cotan(alpha_ij) + cotan(beta_ij)
+            float sumCot = cotOpp[hh.idx()] + cotOpp[m_mesh.opposite_halfedge_handle(hh).idx()];
+            K += sumCot * (x_i - x_j);
 
-bool TriMeshHE::isTriangleObtuse(OpMesh::FaceIter _f)
-{
-    bool res = false;
-
-    // get face iter
-    OpMesh::FaceIter f_it = m_mesh.faces_begin() + _f->idx();
-    // circulate over vertices
-    for (OpMesh::FaceHalfedgeIter fh_it = m_mesh.fh_iter( *f_it ); fh_it.is_valid(); ++fh_it)
-    {   
-        // point from
-        OpMesh::Point p1 = m_mesh.point( m_mesh.from_vertex_handle(*fh_it) );
-        // point to
-        OpMesh::Point p2 = m_mesh.point( m_mesh.to_vertex_handle(*fh_it) );
-        // previous point
-        OpMesh::Point p3 = m_mesh.point( m_mesh.from_vertex_handle( m_mesh.prev_halfedge_handle(*fh_it) ) );
-
-        // get two edge vectors
-        glm::vec3 p1p2(p2[0] - p1[0], p2[1] - p1[1], p2[2] - p1[2]);
-        glm::vec3 p1p3(p3[0] - p1[0], p3[1] - p1[1], p3[2] - p1[2]);
-
-        
-        if( glm::dot( glm::normalize(p1p2), glm::normalize(p1p3) ) <= 0.0f)
-            res = true;
-    }
-
-
-    return res;
-}
-
-bool TriMeshHE::isAngleObtuse(OpMesh::FaceIter _f, OpMesh::VertexIter _xi)
-{
-    OpMesh::Point px = m_mesh.point( *_xi );
-
-    bool res = false;
-    // get face iter
-    OpMesh::FaceIter f_it = m_mesh.faces_begin() + _f->idx();
-    // circulate over vertices
-    for (OpMesh::FaceHalfedgeIter fh_it = m_mesh.fh_iter( *f_it ); fh_it.is_valid(); ++fh_it)
-    {   
-        // point from
-        OpMesh::Point p1 = m_mesh.point( m_mesh.from_vertex_handle(*fh_it) );
-        // point to
-        OpMesh::Point p2 = m_mesh.point( m_mesh.to_vertex_handle(*fh_it) );
-        // previous point
-        OpMesh::Point p3 = m_mesh.point( m_mesh.from_vertex_handle( m_mesh.prev_halfedge_handle(*fh_it) ) );
-
-        if(px == p1)
-        {
-            // get two edge vectors
-            glm::vec3 p1p2(p2[0] - p1[0], p2[1] - p1[1], p2[2] - p1[2]);
-            glm::vec3 p1p3(p3[0] - p1[0], p3[1] - p1[1], p3[2] - p1[2]);
-
-        
-            if( glm::dot( glm::normalize(p1p2), glm::normalize(p1p3) ) <= 0.0f)
-                res = true;
+            // corner of x_i in the face of the outgoing halfedge
+            A += areaMixed[hh.idx()];
+            sumAngles += angle[hh.idx()];
         }
-    }
 
+        compCurvatures(K, A, sumAngles, m_mesh.is_boundary(vh), m_meanCurv[v], m_gaussCurv[v], m_minCurv[v], m_maxCurv[v]);
+    }
 
-    return res;
+    qInfo() << "[info] TriMeshHE::compVertCurvatures: mean, Gaussian and principal curvatures computed";
 }
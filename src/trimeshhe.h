@@ -14,6 +14,7 @@
 #define TRIMESHHE_H
 
 #include "mesh.h"
+#include "trimeshsoup.h"
 
 #include <Eigen/Dense>
 #include <Eigen/SVD>
@@ -43,7 +44,8 @@ class TriMeshHE : public Mesh
 
         /*!
         * \fn TriMeshHE
-        * \brief Default constructor of TriMeshHE
+        * \brief Default constructor of TriMeshHE.
+        *        No property is allocated: they are requested when the file provides them or when an operation needs them.
         */
         TriMeshHE();
 
@@ -64,6 +66,12 @@ class TriMeshHE : public Mesh
         */
         ~TriMeshHE();
 
+        /*!
+        * \fn clone
+        * \brief deep copy of the mesh
+        */
+        std::shared_ptr<Mesh> clone() const;
+
 
         /*------------------------------------------------------------------------------------------------------------+
         |                                              GETTERS/SETTERS                                                |
@@ -88,18 +96,61 @@ class TriMeshHE : public Mesh
         /*! \fn getFaceNormals */
         void getFaceNormals(std::vector<glm::vec3>& _facenormals);
 
+        /*! \fn getScalars */
+        void getScalars(std::vector<float>& _scalars);
+
+        /*!
+        * \fn getBuffers
+        * \brief get all the requested attributes at once, in parallel.
+        *        Vertices are shared by adjacent faces (see getIndexedBuffers()),
+        *        unless duplicateVertices() has been called (see getCornerBuffers()).
+        *        NB: the individual getters always export one vertex per face corner
+        * \param _buffers : arrays to fill
+        * \param _attribs : bitmask of requested attributes (see enum MeshAttrib)
+        */
+        void getBuffers(MeshBuffers& _buffers, unsigned int _attribs = ATTRIB_ALL);
+
+        /*!
+        * \fn getPropertyMemory
+        * \brief get the memory used by the optional OpenMesh properties (normals, colors, UVs, tangents)
+        * \param _allProperties : if true, get the memory that would be used if all the properties were allocated
+        * \return size in bytes
+        */
+        size_t getPropertyMemory(bool _allProperties = false) const;
+
+        /*! \fn getMeanCurv */
+        inline const std::vector<float>& getMeanCurv() const { return m_meanCurv; }
+        /*! \fn getGaussCurv */
+        inline const std::vector<float>& getGaussCurv() const { return m_gaussCurv; }
+        /*! \fn getMinCurv */
+        inline const std::vector<float>& getMinCurv() const { return m_minCurv; }
+        /*! \fn getMaxCurv */
+        inline const std::vector<float>& getMaxCurv() const { return m_maxCurv; }
+
         /*------------------------------------------------------------------------------------------------------------+
         |                                               OTHER METHODS                                                 |
         +-------------------------------------------------------------------------------------------------------------*/
 
         /*!
         * \fn readFile
-        * \brief read a mesh from a file
+        * \brief read a mesh from a file.
+        *        The file is parsed by the TriMeshSoup readers and the half-edge structure is built in bulk (see buildFromSoup()),
+        *        OpenMesh IO is only used as a fallback (see readFileOpenMesh()).
         * \param _filename : name of the file to read
         * \return false if file extension is not supported, true if it is
         */
         bool readFile(const std::string& _filename);
 
+        /*!
+        * \fn buildFromSoup
+        * \brief build the half-edge structure from a triangle soup (used to read files, or to convert a TriMeshSoup without reloading):
+        *        vertices split by the soup are welded back (see TriMeshSoup::getWeldedTriangles()), per-corner UVs become halfedge texcoords,
+        *        then topology is built by buildFromArrays(). Normals, colors and scalar field are preserved.
+        * \param _soup : triangle soup
+        * \return false if the soup has no valid face
+        */
+        bool buildFromSoup(const TriMeshSoup& _soup);
+
         /*!
         * \fn writeFile
         * \brief write a mesh into a file
@@ -116,7 +167,8 @@ class TriMeshHE : public Mesh
 
         /*!
         * \fn computeNormals
-        * \brief recompute the triangle normals and update vertex normals
+        * \brief recompute the triangle normals and update vertex normals, in parallel
+        *        (faces are weighted according to m_normalWeighting, see setNormalWeighting())
         */
         void computeNormals();
 
@@ -136,6 +188,23 @@ class TriMeshHE : public Mesh
         */
         void lapSmooth(unsigned int _nbIter = 1, float _fact = 1.0f );
 
+        /*!
+        * \fn decimate
+        * \brief Simplify the mesh by edge collapses, the cheapest collapse first (quadric error metric)
+        * Using Garland and Heckbert, "Surface Simplification Using Quadric Error Metrics", SIGGRAPH 1997
+        * https://www.cs.cmu.edu/~garland/Papers/quadrics.pdf
+        * Boundaries, UV seams and creases (see s_creaseAngle) are preserved: their vertices only slide along them,
+        * and their corners are never removed.
+        * \param _ratio : fraction of the triangles to keep, in ]0;1[
+        * \return geometric error of the simplified mesh: bound on the distance of the moved vertices to the planes of the original faces they replace
+        *         (square root of their unweighted quadric error)
+        */
+        float decimate(float _ratio);
+
+        /*!
+        * \fn duplicateVertices
+        * \brief Export one vertex per face corner in getBuffers(), with face normals (required by flat shading).
+        */
         void duplicateVertices();
 
 
@@ -146,7 +215,7 @@ class TriMeshHE : public Mesh
 
         /*!
         * \fn computeMeanCurv
-        * \brief Compute mean curvature of the mesh
+        * \brief Compute mean curvature of the mesh, and store it as scalar field
         * Using Meyer et al., "Discrete Differential-Geometry Operators for Triangulated 2-Manifolds", Visualization and Mathematics III, 2003
         * http://multires.caltech.edu/pubs/diffGeoOps.pdf
         */
@@ -154,7 +223,7 @@ class TriMeshHE : public Mesh
 
         /*!
         * \fn computeMeanCurv
-        * \brief Compute surface variation of the mesh
+        * \brief Compute surface variation of the mesh, and store it as scalar field
         * Using Pauly et al., "Efficient Simplification of Point-Sampled Surfaces", IEEE Visualization, 2002
         * https://www.graphics.rwth-aachen.de/media/papers/p_Pau021.pdf
         */
@@ -173,88 +242,166 @@ class TriMeshHE : public Mesh
         OpenMesh::HPropHandleT<OpenMesh::Vec3f> tangents;       /* tangent property on vertices */ 
         OpenMesh::HPropHandleT<OpenMesh::Vec3f> bitangents;     /* bitangent property on vertices */ 
 
+        std::vector<float> m_meanCurv;                          /*!< mean curvature of each vertex */
+        std::vector<float> m_gaussCurv;                         /*!< Gaussian curvature of each vertex */
+        std::vector<float> m_minCurv;                           /*!< minimal principal curvature of each vertex */
+        std::vector<float> m_maxCurv;                           /*!< maximal principal curvature of each vertex */
+
+        bool m_isVertDuplicated;                                /*!< flag if vertices are duplicated in exported buffers */
+
+        static constexpr float s_creaseAngle = 45.0f;           /*!< dihedral angle (in degrees) above which an edge is preserved by decimate() */
+        static constexpr double s_featureWeight = 100.0;        /*!< weight of the planes keeping boundaries, UV seams and creases in place in decimate() */
+        static constexpr float s_minNormalDot = 0.2f;           /*!< a collapse cannot rotate a triangle normal by more than acos(s_minNormalDot) */
+
 
         /*------------------------------------------------------------------------------------------------------------+
-        |                                                 CURVATURE                                                   |
+        |                                                  IMPORT                                                     |
         +-------------------------------------------------------------------------------------------------------------*/
 
         /*!
-        * \fn compLocalVariation
-        * \brief surface variation  at a given vertex
-        * \param _hi: iterator of the vertex where surface variation is calculated
-        * \return local variation at vertex _hi
+        * \fn readFileOpenMesh
+        * \brief read a mesh from a file using OpenMesh IO (i.e. faces are added one by one)
+        * \param _filename : name of the file to read
+        * \return false if the file cannot be read
         */
-        double compLocalVariation(OpMesh::VertexIter _hi);
+        bool readFileOpenMesh(const std::string& _filename);
 
         /*!
-        * \fn compLocalVariation
-        * \brief discrete mean curvature at a given vertex
-        * \param _hi: iterator of the vertex where surface variation is calculated
-        * \return mean curvature at vertex _xi
+        * \fn buildFromArrays
+        * \brief build the half-edge structure in bulk from an indexed triangle list.
+        *        Opposite halfedges are paired by sorting directed edges (in parallel), then OpenMesh kernel arrays are filled in one pass.
+        *        Non-manifold configurations are handled as OpenMesh add_face() does:
+        *        - a face that would create a complex edge (i.e. more than 2 faces, or inconsistent orientation) is kept 
+        *          but its vertices are duplicated,
+        *        - several open fans around a vertex are linked through their boundary halfedges,
+        *        - a closed fan that shares a vertex with other fans gets its own copy of the vertex.
+        *        Face order and corner order are preserved (i.e. face f is made of the corners 3f, 3f+1, 3f+2).
+        * \param _positions : vertex 3D coords
+        * \param _faceVerts : vertex indices of the triangles, updated with indices of duplicated vertices
+        * \param _vertSource : for each vertex of the resulting mesh, index of the input vertex it comes from
+        * \return false if there is no face
         */
-        double vertMeanCurv(OpMesh::VertexIter _xi);
+        bool buildFromArrays(const std::vector<glm::vec3>& _positions, std::vector<uint32_t>& _faceVerts, std::vector<uint32_t>& _vertSource);
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                  EXPORT                                                     |
+        +-------------------------------------------------------------------------------------------------------------*/
 
         /*!
-        * \fn compAreaMixed
-        * \brief compute the "mixed area" of triangles connected to a given vertex.
-        * see Fig 4. in  http://multires.caltech.edu/pubs/diffGeoOps.pdf 
-        * \param _xi: iterator of the vertex, which area of connected triangles is computed
-        * \return mixed area of 1-ring neighborhood of _xi
+        * \fn getCornerBuffers
+        * \brief get requested attributes with one vertex per face corner, in a single pass over the faces
+        * \param _buffers : arrays to fill
+        * \param _attribs : bitmask of requested attributes (see enum MeshAttrib)
         */
-        double compAreaMixed(OpMesh::VertexIter _xi);
+        void getCornerBuffers(MeshBuffers& _buffers, unsigned int _attribs);
 
         /*!
-        * \fn compAreaVoronoi
-        * \brief compute area of a Voronoi region , defined by a triangle facet _f and one of its vertices _xi.
-        * The Voronoi region is the the part of the Triangle _f that isbelongs to the Voronoi cell of the vertex _xi.
-        * see Fig 3. in  http://multires.caltech.edu/pubs/diffGeoOps.pdf 
-        * \param _f: iterator of the triangle face
-        * \param _xi: iterator of the vertex (Voronoi cell's seed)
-        * \return area of the fraction of triangle _f that is the Voronoi cell of _xi
+        * \fn getIndexedBuffers
+        * \brief get requested attributes with vertices shared by adjacent faces, and the matching index buffer.
+        *        A vertex is only split where its per-corner attributes (halfedge UVs, tangents, bitangents) differ,
+        *        corners being compared through a hash of their attributes.
+        * \param _buffers : arrays to fill
+        * \param _attribs : bitmask of requested attributes (see enum MeshAttrib)
         */
-        float compAreaVoronoi(OpMesh::VertexIter _xi, OpMesh::FaceIter _f);
+        void getIndexedBuffers(MeshBuffers& _buffers, unsigned int _attribs);
 
         /*!
-        * \fn compSumCot
-        * \brief compute cotan(alpha_ij)+cotan(beta_ij) , for two connected vertices x_i and x_j. 
-        * The edge (x_i, x_j) connects two triangle facets. 
-        * The opposit angle on one triangle is alpha_ij.
-        * The opposit angle on the second triangle is beta_ij.
-        * For a given vertex x_i, x_j is accessed through a vertex-vertex iterator (circulates around all vertices connected to x_i, i.e., 1-st ring neighborhood)
-        * The angle alpha_ij is therefore located at the "previous" vertex on the ring (x_j-1).
-        * The angle beta_ij is similarly located at the "next" vertex on the ring (x_j+1).
-        * \param _xi, _xj: iterators of vertices x_i and x_j
-        * \param _xjm: iterator of vertex where alpha_ij is located (x_j-1).
-        * \param _xjp: iterator of vertex where beta_ij is located (x_j+1).                  
-        * \return value of cotan(alpha_ij)+cotan(beta_ij)
+        * \fn hashCorner
+        * \brief hash of the per-corner attributes of a halfedge (halfedge UVs, tangent, bitangent)
+        * \param _heh : halfedge pointing to the corner
         */
-        double compSumCot(OpMesh::VertexIter _xi, OpMesh::VertexIter _xj, OpMesh::VertexIter _xjm, OpMesh::VertexIter _xjp);
+        size_t hashCorner(OpMesh::HalfedgeHandle _heh) const;
 
         /*!
-        * \fn compAreaTriangle
-        * \brief compute area of a triangle facet 
-        * \param _f: iterator of the triangle face
-        * \return area of triangle
+        * \fn equalCorners
+        * \brief check if two corners have exactly the same per-corner attributes
+        * \param _heh1 : halfedge pointing to the first corner
+        * \param _heh2 : halfedge pointing to the second corner
         */
-        double compAreaTriangle(OpMesh::FaceIter _f);
+        bool equalCorners(OpMesh::HalfedgeHandle _heh1, OpMesh::HalfedgeHandle _heh2) const;
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                  NORMALS                                                    |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn compFaceNormal
+        * \brief compute the unit normal and the area of a face
+        * \param _fh : face handle
+        * \param _area : area of the face
+        * \return unit normal of the face (null if the face is degenerated)
+        */
+        glm::vec3 compFaceNormal(OpMesh::FaceHandle _fh, float& _area /* return */) const;
+
+        /*!
+        * \fn compVertexNormal
+        * \brief compute the normal of a vertex, by averaging the normals of its adjacent faces (weighted according to m_normalWeighting)
+        * \param _vh : vertex handle
+        * \param _faceNormals : unit normal of each face
+        * \param _faceAreas : area of each face
+        * \return unit normal of the vertex
+        */
+        glm::vec3 compVertexNormal(OpMesh::VertexHandle _vh, const glm::vec3* _faceNormals, const float* _faceAreas) const;
+
+        /*!
+        * \fn updateFaceNormals
+        * \brief update the face normal property in parallel (request it if needed)
+        */
+        void updateFaceNormals();
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                DECIMATION                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn isCollapseOk
+        * \brief check that collapsing a halfedge keeps the mesh manifold (link condition).
+        *        Unlike OpenMesh is_collapse_ok(), the mesh is not modified (no tagging): can be called in parallel.
+        * \param _heh : halfedge whose from-vertex would be collapsed into its to-vertex
+        */
+        bool isCollapseOk(OpMesh::HalfedgeHandle _heh) const;
+
+        /*!
+        * \fn collapseTexCoords
+        * \brief before the collapse of a halfedge, give the corners of its from-vertex the UVs of its to-vertex, 
+        *        on each side of the feature edges (the from-vertex must have 0 or 2 feature edges)
+        * \param _heh : halfedge to be collapsed
+        * \param _featureEdges : 1 for each edge on a boundary, a UV seam or a crease
+        */
+        void collapseTexCoords(OpMesh::HalfedgeHandle _heh, const std::vector<char>& _featureEdges);
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                 CURVATURE                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn compLocalVariation
+        * \brief surface variation  at a given vertex
+        * \param _hi: iterator of the vertex where surface variation is calculated
+        * \return local variation at vertex _hi
+        */
+        double compLocalVariation(OpMesh::VertexIter _hi);
 
         /*!
-        * \fn isTriangleObtuse
-        * \brief test if a facet is an obtuse triangle (i.e., contains an obtuse angle). 
-        * \param _f: iterator of the triangle face to test
-        * \return true if triangle is obtuse
+        * \fn compFaceCurvTerms
+        * \brief compute, once per triangle, the terms used by the discrete curvature operators (see compCurvatureTerms()).
+        * All terms are indexed by halfedge, the corner of a halfedge being located at its from-vertex.
+        * \param _cotOpp: cotangent of the angle opposite to each halfedge (0 for boundary halfedges)
+        * \param _angle: interior angle at the corner of each halfedge
+        * \param _areaMixed: "mixed area" (Voronoi area, or fraction of triangle area if obtuse) of the corner of each halfedge
         */
-        bool isTriangleObtuse(OpMesh::FaceIter _f);
+        void compFaceCurvTerms(std::vector<float>& _cotOpp, std::vector<float>& _angle, std::vector<float>& _areaMixed);
 
         /*!
-        * \fn isAngleObtuse
-        * \brief test if an angle is obtuse. 
-        * The angle is defined by the facet and vertex to which it is connected.
-        * \param _f: iterator of the triangle face in which the angle is located
-        * \param _xi: iterator of the vertex which corresponds to the angle corner in _f
-        * \return true if angle is obtuse
+        * \fn compVertCurvatures
+        * \brief compute mean, Gaussian, and principal curvatures of all vertices,
+        * by gathering the face terms cached by compFaceCurvTerms() around each vertex (see compCurvatures()).
         */
-        bool isAngleObtuse(OpMesh::FaceIter _f, OpMesh::VertexIter _xi);
+        void compVertCurvatures();
 
 };
 #endif // TRIMESHHE_H
\ No newline at end of file
@@ -11,7 +11,10 @@
 // hide fopen() and sscanf() deprecation warnings
 #define _CRT_SECURE_NO_WARNINGS
 
+#include <numeric>
+
 #include "trimeshsoup.h"
+#include "parallelsort.h"
 
 
 TriMeshSoup::TriMeshSoup() : Mesh()
@@ -25,6 +28,12 @@ TriMeshSoup::~TriMeshSoup()
 }
 
 
+std::shared_ptr<Mesh> TriMeshSoup::clone() const
+{
+    return std::make_shared<TriMeshSoup>(*this);
+}
+
+
 void TriMeshSoup::getVertices(std::vector<glm::vec3>& _vertices)
 {
     if(_vertices.size() != 0)
@@ -133,24 +142,126 @@ void TriMeshSoup::getFaceNormals(std::vector<glm::vec3>& _facenormals)
 }
 
 
+void TriMeshSoup::getScalars(std::vector<float>& _scalars)
+{
+    if(_scalars.size() != 0)
+        _scalars.clear();
+
+    if(m_scalars.size() == m_vertices.size())
+    {
+        _scalars.assign(m_scalars.begin(), m_scalars.end());
+    }
+}
+
+
+int TriMeshSoup::getWeldedTriangles(std::vector<uint32_t>& _weldedSrc, std::vector<uint32_t>& _faceVerts, std::vector<uint32_t>& _faceSrc) const
+{
+    const int nbSoupVertices = (int)m_vertices.size();
+    const int nbSoupFaces = (int)(m_indices.size() / 3);
+
+    _weldedSrc.clear();
+    _faceVerts.clear();
+    _faceSrc.clear();
+
+    // representative of each soup vertex: first soup vertex sharing its vertex in the file (the soup splits them per UV or normal),
+    // or first soup vertex with the same position if the file does not index vertices (e.g. STL) or the soup does not come from a file
+    std::vector<uint32_t> rep(nbSoupVertices);
+    if(m_fileVertexIds.size() == m_vertices.size())
+    {
+        uint32_t nbFileVertices = 0;
+        for (uint32_t id : m_fileVertexIds)
+            nbFileVertices = std::max(nbFileVertices, id + 1);
+        std::vector<uint32_t> firstSoupVertex(nbFileVertices, std::numeric_limits<uint32_t>::max());
+        for (int v = 0; v < nbSoupVertices; v++)
+        {
+            uint32_t& first = firstSoupVertex[m_fileVertexIds[v]];
+            if(first == std::numeric_limits<uint32_t>::max())
+                first = v;
+            rep[v] = first;
+        }
+    }
+    else
+    {
+        // sort vertices by position (ties broken by index, so the first of each run is the lowest index)
+        std::vector<uint32_t> order(nbSoupVertices);
+        for (int v = 0; v < nbSoupVertices; v++)
+            order[v] = v;
+        parallelSort(order, [this](uint32_t _a, uint32_t _b)
+        {
+            const glm::vec3& pa = m_vertices[_a];
+            const glm::vec3& pb = m_vertices[_b];
+            if(pa.x != pb.x) return pa.x < pb.x;
+            if(pa.y != pb.y) return pa.y < pb.y;
+            if(pa.z != pb.z) return pa.z < pb.z;
+            return _a < _b;
+        });
+
+        // representative of each soup vertex: first soup vertex with the same position
+        uint32_t runRep = 0;
+        for (int i = 0; i < nbSoupVertices; i++)
+        {
+            if(i == 0 || m_vertices[order[i]] != m_vertices[order[i-1]])
+                runRep = order[i];
+            rep[order[i]] = runRep;
+        }
+        order.clear();
+    }
+
+    // welded vertices keep the order of the soup
+    std::vector<uint32_t> weldedId(nbSoupVertices);
+    for (int v = 0; v < nbSoupVertices; v++)
+    {
+        if(rep[v] == (uint32_t)v)
+        {
+            weldedId[v] = (uint32_t)_weldedSrc.size();
+            _weldedSrc.push_back(v);
+        }
+    }
+
+    // triangles on welded vertices, degenerated ones are discarded
+    _faceVerts.reserve(m_indices.size());
+    _faceSrc.reserve(nbSoupFaces);
+    for (int f = 0; f < nbSoupFaces; f++)
+    {
+        uint32_t v0 = weldedId[rep[m_indices[3*f]]];
+        uint32_t v1 = weldedId[rep[m_indices[3*f+1]]];
+        uint32_t v2 = weldedId[rep[m_indices[3*f+2]]];
+        if(v0 == v1 || v1 == v2 || v2 == v0)
+            continue;
+        _faceVerts.push_back(v0);
+        _faceVerts.push_back(v1);
+        _faceVerts.push_back(v2);
+        _faceSrc.push_back(f);
+    }
+
+    return nbSoupFaces - (int)_faceSrc.size();
+}
+
+
 bool TriMeshSoup::readFile(const std::string& _filename)
 {
     this->clear();
     if(_filename.substr(_filename.find_last_of(".") + 1) == "obj")
     {
-        importOBJ(_filename);
+        if(!importOBJ(_filename))
+            return false;
         qInfo() << "[info] TriMeshSoup::readFile: finished ";
         return true;
     }
     if(_filename.substr(_filename.find_last_of(".") + 1) == "off")
     {
         importOFF(_filename);
+        // vertices are the ones of the file
+        m_fileVertexIds.resize(m_vertices.size());
+        std::iota(m_fileVertexIds.begin(), m_fileVertexIds.end(), 0);
         qInfo() << "[info] TriMeshSoup::readFile: finished ";
         return true;
     }
     if(_filename.substr(_filename.find_last_of(".") + 1) == "ply")
     {
         importPLY(_filename);
+        m_fileVertexIds.resize(m_vertices.size());
+        std::iota(m_fileVertexIds.begin(), m_fileVertexIds.end(), 0);
         qInfo() << "[info] TriMeshSoup::readFile: finished ";
         return true;
     }
@@ -168,6 +279,35 @@ bool TriMeshSoup::readFile(const std::string& _filename)
 }
 
 
+bool TriMeshSoup::fromMesh(Mesh& _mesh)
+{
+    this->clear();
+
+    // exported buffers are already laid out as an indexed soup (filled in parallel by TriMeshHE)
+    MeshBuffers buffers;
+    _mesh.getBuffers(buffers, ATTRIB_VERTEX | ATTRIB_NORMAL | ATTRIB_INDEX | ATTRIB_COLOR | ATTRIB_TEXCOORD | ATTRIB_SCALAR);
+    if(buffers.indices.empty())
+    {
+        qCritical() << "[ERROR] TriMeshSoup::fromMesh: mesh has no face";
+        return false;
+    }
+
+    m_vertices.swap(buffers.vertices);
+    m_normals.swap(buffers.normals);
+    m_indices.swap(buffers.indices);
+    m_colors.swap(buffers.colors);
+    m_texcoords.swap(buffers.texcoords);
+    m_scalars.swap(buffers.scalars);
+
+    if(m_normals.size() != m_vertices.size())
+        computeNormals();
+    computeAABB();
+
+    qInfo() << "[info] TriMeshSoup::fromMesh: " << m_vertices.size() << " vertices, " << m_indices.size() / 3 << " faces";
+    return true;
+}
+
+
 bool TriMeshSoup::writeFile(const std::string& _filename)
 {
     if(_filename.substr(_filename.find_last_of(".") + 1) == "obj")
@@ -382,6 +522,9 @@ void TriMeshSoup::duplicateVertices()
     std::vector<glm::vec3> temp_normals = m_normals;
     std::vector<glm::vec3> temp_colors = m_colors;
     std::vector<glm::vec2> temp_texcoords = m_texcoords;
+    std::vector<uint32_t> temp_fileVertexIds = m_fileVertexIds;
+    bool hasFileIds = (m_fileVertexIds.size() == m_vertices.size());
+    m_fileVertexIds.clear();
     // clear arrays
     m_vertices.clear();
     m_normals.clear();
@@ -403,6 +546,9 @@ void TriMeshSoup::duplicateVertices()
         if(hasUVs)
             m_texcoords.push_back(temp_texcoords[ m_indices[i] ]);
 
+        if(hasFileIds)
+            m_fileVertexIds.push_back(temp_fileVertexIds[ m_indices[i] ]);
+
         // update indices
         m_indices[i] = i;
     }
@@ -455,14 +601,16 @@ bool TriMeshSoup::importOBJ(const std::string &_filename)
         return false;
     }
 
-    // First pass: read vertex data into temporary mesh
+    // Streaming import reads vertex data and faces in a single pass (so that batches can be published while reading),
+    // otherwise vertex data is read by a first pass
+    const bool streaming = (bool)m_streamCallback;
+
     std::vector<glm::vec3> vertices;
     std::vector<glm::vec3> normals;
-    std::vector<uint32_t> indices;
     std::vector<glm::vec3> texcoords;
-    while(!f.eof()) 
+
+    auto readVertexData = [&]() -> bool
     {
-        std::getline(f, line);
         if (line.substr(0, 2) == VERTEX_LINE) 
         {
             std::istringstream ss(line.substr(2));
@@ -481,39 +629,66 @@ bool TriMeshSoup::importOBJ(const std::string &_filename)
             ss >> normal.x >> normal.y >> normal.z;
             normals.push_back(normal);
         }
-        else 
-        {
-            // Ignore line
-        }
-    }
-
-    // Rewind file
-    f.clear();
-    f.seekg(0);
+        else
+            return false;
+        return true;
+    };
 
-    // Clear old mesh and pre-allocate space for new mesh data
+    // Clear old mesh
     m_vertices.clear();
-    m_vertices.reserve(vertices.size());
+    m_fileVertexIds.clear();
     m_texcoords.clear();
-    m_texcoords.reserve(texcoords.size());
     m_normals.clear();
-    m_normals.reserve(normals.size());
     m_indices.clear();
 
+    if (!streaming)
+    {
+        // First pass: read vertex data into temporary mesh
+        while(!f.eof()) 
+        {
+            std::getline(f, line);
+            readVertexData();
+        }
+
+        // Rewind file
+        f.clear();
+        f.seekg(0);
+
+        // Pre-allocate space for new mesh data
+        m_vertices.reserve(vertices.size());
+        m_texcoords.reserve(texcoords.size());
+        m_normals.reserve(normals.size());
+    }
+
     // Set up dictionary for mapping unique tuples to indices
     std::map<glm::uvec3, unsigned, uvec3Less> visited;
     unsigned next_index = 0;
     glm::uvec3 key;
 
-    // Second pass: read faces and construct per-vertex texcoords/normals.
+    // OBJ-indices start at one (0 wraps around and is rejected as well)
+    auto outOfRange = [](const std::uint32_t* _index, size_t _size)
+    {
+        return (_index[0] - 1 >= _size) || (_index[1] - 1 >= _size) || (_index[2] - 1 >= _size);
+    };
+    bool valid = true;
+
+    // first vertex/index not published yet (streaming import only)
+    size_t streamVertex = 0;
+    size_t streamIndex = 0;
+
+    // Read faces (and vertex data when streaming), and construct per-vertex texcoords/normals.
     // Note: OBJ-indices start at one, so we need to subtract indices by one.
-    while (!f.eof()) 
+    while (valid && !f.eof()) 
     {
         std::getline(f, line);
+        if (streaming && readVertexData())
+            continue;
         if (line.substr(0, 2) == FACE_LINE) 
         {
             if (std::sscanf(line.c_str(), "f %d %d %d", &vindex[0], &vindex[1], &vindex[2]) == 3) 
             {
+                if (!(valid = !outOfRange(vindex, vertices.size())))
+                    break;
                 for (unsigned i = 0; i < 3; ++i) 
                 {
                     key = glm::uvec3(vindex[i], 0, 0);
@@ -521,12 +696,15 @@ bool TriMeshSoup::importOBJ(const std::string &_filename)
                     {
                         visited[key] = next_index++;
                         m_vertices.push_back(vertices[vindex[i] - 1]);
+                        m_fileVertexIds.push_back(vindex[i] - 1);
                     }
                     m_indices.push_back(visited[key]);
                 }
             }
             else if (std::sscanf(line.c_str(), "f %d/%d %d/%d %d/%d", &vindex[0], &tindex[0], &vindex[1], &tindex[1], &vindex[2], &tindex[2]) == 6) 
             {
+                if (!(valid = !outOfRange(vindex, vertices.size()) && !outOfRange(tindex, texcoords.size())))
+                    break;
                 for (unsigned i = 0; i < 3; ++i) 
                 {
                     key = glm::uvec3(vindex[i], tindex[i], 0);
@@ -534,6 +712,7 @@ bool TriMeshSoup::importOBJ(const std::string &_filename)
                     {
                         visited[key] = next_index++;
                         m_vertices.push_back(vertices[vindex[i] - 1]);
+                        m_fileVertexIds.push_back(vindex[i] - 1);
                         m_texcoords.push_back( glm::vec2(texcoords[tindex[i] - 1].x, texcoords[tindex[i] - 1].y) );
                     }
                     m_indices.push_back(visited[key]);
@@ -541,6 +720,8 @@ bool TriMeshSoup::importOBJ(const std::string &_filename)
             }
             else if (std::sscanf(line.c_str(), "f %d//%d %d//%d %d//%d", &vindex[0], &nindex[0], &vindex[1], &nindex[1], &vindex[2], &nindex[2]) == 6) 
             {
+                if (!(valid = !outOfRange(vindex, vertices.size()) && !outOfRange(nindex, normals.size())))
+                    break;
                 for (unsigned i = 0; i < 3; ++i) 
                 {
                     key = glm::uvec3(vindex[i], nindex[i], 0);
@@ -548,6 +729,7 @@ bool TriMeshSoup::importOBJ(const std::string &_filename)
                     {
                         visited[key] = next_index++;
                         m_vertices.push_back(vertices[vindex[i] - 1]);
+                        m_fileVertexIds.push_back(vindex[i] - 1);
                         m_normals.push_back(normals[nindex[i] - 1]);
                     }
                     m_indices.push_back(visited[key]);
@@ -555,6 +737,8 @@ bool TriMeshSoup::importOBJ(const std::string &_filename)
             }
             else if(std::sscanf(line.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d", &vindex[0], &tindex[0], &nindex[0], &vindex[1], &tindex[1], &nindex[1], &vindex[2], &tindex[2], &nindex[2]) == 9) 
             {
+                if (!(valid = !outOfRange(vindex, vertices.size()) && !outOfRange(tindex, texcoords.size()) && !outOfRange(nindex, normals.size())))
+                    break;
                 for(unsigned i = 0; i < 3; ++i) 
                 {
                     key = glm::uvec3(vindex[i], tindex[i], nindex[i]);
@@ -562,15 +746,38 @@ bool TriMeshSoup::importOBJ(const std::string &_filename)
                     {
                         visited[key] = next_index++;
                         m_vertices.push_back(vertices[vindex[i] - 1]);
+                        m_fileVertexIds.push_back(vindex[i] - 1);
                         m_texcoords.push_back( glm::vec2(texcoords[tindex[i] - 1].x, texcoords[tindex[i] - 1].y) );
                         m_normals.push_back(normals[nindex[i] - 1]);
                     }
                     m_indices.push_back(visited[key]);
                 }
             }
+
+            // publish a new batch of triangles (streaming import only)
+            if (streaming && m_indices.size() - streamIndex >= 3 * m_streamBatchTriangles)
+            {
+                publishStreamBatch(streamVertex, streamIndex);
+                streamVertex = m_vertices.size();
+                streamIndex = m_indices.size();
+            }
         }
     }
 
+    if (!valid)
+    {
+        qCritical() << "[ERROR] TriMeshSoup::importOBJ: Face refers to undefined vertex data in " << _filename;
+        m_vertices.clear();
+        m_fileVertexIds.clear();
+        m_texcoords.clear();
+        m_normals.clear();
+        m_indices.clear();
+        return false;
+    }
+
+    if (streaming && m_indices.size() > streamIndex)
+        publishStreamBatch(streamVertex, streamIndex);
+
     // Compute normals (if OBJ-file did not contain normals)
     if(m_normals.size() == 0) 
     {
@@ -582,6 +789,39 @@ bool TriMeshSoup::importOBJ(const std::string &_filename)
 }
 
 
+void TriMeshSoup::publishStreamBatch(size_t _firstVertex, size_t _firstIndex)
+{
+    std::shared_ptr<MeshBuffers> batch = std::make_shared<MeshBuffers>();
+    batch->vertices.assign(m_vertices.begin() + _firstVertex, m_vertices.end());
+    batch->indices.assign(m_indices.begin() + _firstIndex, m_indices.end());
+
+    if (m_normals.size() == m_vertices.size())
+        batch->normals.assign(m_normals.begin() + _firstVertex, m_normals.end());
+    else
+    {
+        // temporary normals: only the faces of the batch contribute to the normals of its new vertices
+        batch->normals.assign(batch->vertices.size(), glm::vec3(0.0f));
+        for (size_t i = _firstIndex; i + 2 < m_indices.size(); i += 3)
+        {
+            glm::vec3 faceNormal = glm::cross(m_vertices[m_indices[i + 1]] - m_vertices[m_indices[i]], m_vertices[m_indices[i + 2]] - m_vertices[m_indices[i]]);
+            if (faceNormal != glm::vec3(0.0f))
+                faceNormal = glm::normalize(faceNormal);
+            for (size_t k = 0; k < 3; k++)
+                if (m_indices[i + k] >= _firstVertex)
+                    batch->normals[m_indices[i + k] - _firstVertex] += faceNormal;
+        }
+        #pragma omp parallel for
+        for (int v = 0; v < (int)batch->normals.size(); v++)
+        {
+            if (batch->normals[v] != glm::vec3(0.0f))
+                batch->normals[v] = glm::normalize(batch->normals[v]);
+        }
+    }
+
+    m_streamCallback(batch);
+}
+
+
 void TriMeshSoup::exportOBJ(const std::string &_filename)
 {
     // Open the file
@@ -1388,6 +1628,7 @@ void TriMeshSoup::exportSTL(const std::string &_filename)
 void TriMeshSoup::clear()
 {
     m_vertices.clear();
+    m_fileVertexIds.clear();
     m_normals.clear();
     m_indices.clear();
 
@@ -1395,4 +1636,6 @@ void TriMeshSoup::clear()
     m_texcoords.clear();
     m_tangents.clear();
     m_bitangents.clear();
+
+    m_scalars.clear();
 }
@@ -50,6 +50,12 @@ class TriMeshSoup : public Mesh
         */
         ~TriMeshSoup();
 
+        /*!
+        * \fn clone
+        * \brief deep copy of the mesh
+        */
+        std::shared_ptr<Mesh> clone() const;
+
 
         /*------------------------------------------------------------------------------------------------------------+
         |                                              GETTERS/SETTERS                                                |
@@ -74,6 +80,50 @@ class TriMeshSoup : public Mesh
         /*! \fn getFaceNormals */
         void getFaceNormals(std::vector<glm::vec3>& _facenormals);
 
+        /*! \fn getScalars */
+        void getScalars(std::vector<float>& _scalars);
+
+        /*! \fn getVertexArray (no copy) */
+        inline const std::vector<glm::vec3>& getVertexArray() const { return m_vertices; }
+        /*! \fn getNormalArray (no copy) */
+        inline const std::vector<glm::vec3>& getNormalArray() const { return m_normals; }
+        /*! \fn getIndexArray (no copy) */
+        inline const std::vector<uint32_t>& getIndexArray() const { return m_indices; }
+        /*! \fn getColorArray (no copy) */
+        inline const std::vector<glm::vec3>& getColorArray() const { return m_colors; }
+        /*! \fn getTexCoordArray (no copy) */
+        inline const std::vector<glm::vec2>& getTexCoordArray() const { return m_texcoords; }
+        /*! \fn getScalarArray (no copy) */
+        inline const std::vector<float>& getScalarArray() const { return m_scalars; }
+
+        /*!
+        * \fn getWeldedTriangles
+        * \brief get the triangles as an indexed list on shared vertices: soup vertices split from the same vertex of the file 
+        *        (e.g. per UV coords or normal) are welded back, so the connectivity is the one of the file.
+        *        Vertices with the same position are welded instead if the file does not index vertices (STL) 
+        *        or if the soup does not come from a file (see fromMesh()). Degenerated triangles are discarded.
+        * \param _weldedSrc : for each welded vertex, index of the first soup vertex welded into it
+        * \param _faceVerts : welded vertex indices of the triangles (3 per triangle)
+        * \param _faceSrc : for each triangle, index of the soup triangle it comes from
+        * \return number of discarded triangles
+        */
+        int getWeldedTriangles(std::vector<uint32_t>& _weldedSrc /* return */, std::vector<uint32_t>& _faceVerts /* return */, std::vector<uint32_t>& _faceSrc /* return */) const;
+
+        /*!
+        * \fn setStreamCallback
+        * \brief enable streaming import (OBJ files only): while the file is parsed, each new batch of triangles 
+        *        is published to a callback (called from the parsing thread), e.g. to display the mesh progressively.
+        *        The file is then read in a single pass: faces referring to vertex data defined after them make the import fail
+        * \param _batchTriangles : number of triangles per batch
+        * \param _callback : receives the vertices (positions and temporary normals) and the triangles of the batch, 
+        *                    indices refer to all the vertices published so far (nullptr to disable streaming)
+        */
+        inline void setStreamCallback(size_t _batchTriangles, std::function<void(std::shared_ptr<MeshBuffers>)> _callback)
+        {
+            m_streamBatchTriangles = std::max<size_t>(_batchTriangles, 1);
+            m_streamCallback = _callback;
+        }
+
         /*------------------------------------------------------------------------------------------------------------+
         |                                               OTHER METHODS                                                 |
         +-------------------------------------------------------------------------------------------------------------*/
@@ -86,6 +136,16 @@ class TriMeshSoup : public Mesh
         */
         bool readFile(const std::string& _filename);
 
+        /*!
+        * \fn fromMesh
+        * \brief copy the content of another mesh (e.g. a TriMeshHE) without reloading the file.
+        *        Normals, colors, UVs and scalar field are preserved, 
+        *        vertices are shared as in the buffers exported by the other mesh (see Mesh::getBuffers())
+        * \param _mesh : mesh to copy
+        * \return false if the mesh has no face
+        */
+        bool fromMesh(Mesh& _mesh);
+
         /*!
         * \fn writeFile
         * \brief write a mesh into a file (Wavefront OBJ and STL supported)
@@ -122,6 +182,16 @@ class TriMeshSoup : public Mesh
             qWarning() << "[Warning] TriMeshSoup::lapSmooth: Laplacian smooting not available for TriMeshSoup, use TriMeshHE instead";
         }
 
+        /*!
+        * \fn decimate
+        * \brief Simplify the mesh (not available)
+        */
+        inline float decimate(float _ratio)
+        {
+            qWarning() << "[Warning] TriMeshSoup::decimate: Decimation not available for TriMeshSoup, use TriMeshHE instead";
+            return -1.0f;
+        }
+
         /*
         * \fn duplicateVertices
         * \brief Duplicates vertex attributes for each adjacent triangle.
@@ -156,6 +226,7 @@ class TriMeshSoup : public Mesh
         std::vector<glm::vec3> m_vertices;      /*!< vertices positions array (3D coords) */
         std::vector<glm::vec3> m_normals;       /*!< vertices normal vectors array (3D coords) */
         std::vector<uint32_t> m_indices;        /*!< vertices indices array (uint) */
+        std::vector<uint32_t> m_fileVertexIds;  /*!< index of each vertex in the file (vertices split per UV or normal share it), empty if unknown */
 
         std::vector<glm::vec3> m_colors;        /*!< vertices RGB colors array (3D coords) */
         std::vector<glm::vec2> m_texcoords;     /*!< vertices uvs array (2D coords) */
@@ -166,6 +237,9 @@ class TriMeshSoup : public Mesh
 
         bool m_isVertDuplicated;                /*!< flag if vertices have been duplicated */
 
+        std::function<void(std::shared_ptr<MeshBuffers>)> m_streamCallback;    /*!< receives batches of triangles during streaming import */
+        size_t m_streamBatchTriangles = 1 << 20;                                /*!< number of triangles per published batch */
+
         /*------------------------------------------------------------------------------------------------------------+
         |                                               OTHER METHODS                                                 |
         +-------------------------------------------------------------------------------------------------------------*/
@@ -174,9 +248,19 @@ class TriMeshSoup : public Mesh
         * \fn importOBJ
         * \brief read OBJ file
         * \param _filename: name of file
+        * \return false if the file cannot be opened or a face refers to undefined vertex data
         */
         bool importOBJ(const std::string &_filename);
 
+        /*!
+        * \fn publishStreamBatch
+        * \brief send the triangles parsed since the last batch to the stream callback (see setStreamCallback()).
+        *        Normals are computed on the batch only (if the file has none), they are fixed up once the whole file is read.
+        * \param _firstVertex : first vertex not published yet
+        * \param _firstIndex : first index not published yet
+        */
+        void publishStreamBatch(size_t _firstVertex, size_t _firstIndex);
+
         /*!
         * \fn exportOBJ
         * \brief Writes the mesh into a file, using the Wavefront OBJ format.
@@ -0,0 +1,224 @@
+/*********************************************************************************************************************
+ *
+ * vertexclustering.cpp
+ *
+ * Mesh_viewer
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <unordered_map>
+
+#include "vertexclustering.h"
+#include "parallelsort.h"
+
+
+
+float VertexClustering::cellSizeForBudget(const MeshBuffers& _buffers, size_t _nbTriangles)
+{
+    const long long nbTriangles = (long long)(_buffers.indices.size() / 3);
+    if (nbTriangles == 0 || _nbTriangles == 0)
+        return 0.0f;
+
+    double area = 0.0;
+    #pragma omp parallel for reduction(+:area)
+    for (long long t = 0; t < nbTriangles; t++)
+    {
+        const glm::vec3& p0 = _buffers.vertices[_buffers.indices[3 * t]];
+        const glm::vec3& p1 = _buffers.vertices[_buffers.indices[3 * t + 1]];
+        const glm::vec3& p2 = _buffers.vertices[_buffers.indices[3 * t + 2]];
+        area += 0.5 * (double)glm::length(glm::cross(p1 - p0, p2 - p0));
+    }
+
+    // each cell crossed by the surface covers about cellSize^2 of area, and gives about 2 triangles
+    return (float)std::sqrt(2.0 * area / (double)_nbTriangles);
+}
+
+
+bool VertexClustering::simplify(const MeshBuffers& _input, float _cellSize, MeshBuffers& _proxy)
+{
+    _proxy = MeshBuffers();
+
+    const size_t nbVertices = _input.vertices.size();
+    const size_t nbTriangles = _input.indices.size() / 3;
+    if (nbVertices == 0 || nbTriangles == 0 || !(_cellSize > 0.0f))
+        return false;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    const bool hasNormals = (_input.normals.size() == nbVertices);
+    const int nbChunks = getNbChunks();
+    std::vector<size_t> vertexBounds(nbChunks + 1);
+    for (int c = 0; c <= nbChunks; c++)
+        vertexBounds[c] = nbVertices * c / nbChunks;
+
+    // 1. grid: aligned with the bounding box, at most 2^21 cells per axis
+    std::vector<glm::vec3> chunkMin(nbChunks, _input.vertices[0]);
+    std::vector<glm::vec3> chunkMax(nbChunks, _input.vertices[0]);
+    #pragma omp parallel for
+    for (int c = 0; c < nbChunks; c++)
+    {
+        for (size_t v = vertexBounds[c]; v < vertexBounds[c + 1]; v++)
+        {
+            chunkMin[c] = glm::min(chunkMin[c], _input.vertices[v]);
+            chunkMax[c] = glm::max(chunkMax[c], _input.vertices[v]);
+        }
+    }
+    glm::vec3 bBoxMin = chunkMin[0];
+    glm::vec3 bBoxMax = chunkMax[0];
+    for (int c = 1; c < nbChunks; c++)
+    {
+        bBoxMin = glm::min(bBoxMin, chunkMin[c]);
+        bBoxMax = glm::max(bBoxMax, chunkMax[c]);
+    }
+    const float maxCell = (float)((1 << s_keyBits) - 1);
+    const glm::vec3 bBoxSize = bBoxMax - bBoxMin;
+    const float cellSize = std::max(_cellSize, std::max({ bBoxSize.x, bBoxSize.y, bBoxSize.z }) / maxCell);
+    const float invCellSize = 1.0f / cellSize;
+
+    // 2. each chunk of vertices accumulates its own cells (key -> local cell)
+    std::vector<uint32_t> vertexCell(nbVertices);
+    std::vector<std::vector<uint64_t> > chunkKeys(nbChunks);
+    std::vector<std::vector<CellSum> > chunkSums(nbChunks);
+    #pragma omp parallel for schedule(static, 1)
+    for (int c = 0; c < nbChunks; c++)
+    {
+        std::unordered_map<uint64_t, uint32_t> cells;
+        std::vector<uint64_t>& keys = chunkKeys[c];
+        std::vector<CellSum>& sums = chunkSums[c];
+        for (size_t v = vertexBounds[c]; v < vertexBounds[c + 1]; v++)
+        {
+            const glm::vec3 cell = glm::min((_input.vertices[v] - bBoxMin) * invCellSize, glm::vec3(maxCell));
+            const uint64_t key = ((uint64_t)cell.x << (2 * s_keyBits)) | ((uint64_t)cell.y << s_keyBits) | (uint64_t)cell.z;
+
+            auto inserted = cells.emplace(key, (uint32_t)sums.size());
+            if (inserted.second)
+            {
+                keys.push_back(key);
+                sums.emplace_back();
+            }
+            CellSum& sum = sums[inserted.first->second];
+            sum.position += _input.vertices[v];
+            if (hasNormals)
+                sum.normal += _input.normals[v];
+            sum.count++;
+            vertexCell[v] = inserted.first->second;
+        }
+    }
+
+    // 3. merge the cells of all chunks (far less cells than vertices)
+    std::unordered_map<uint64_t, uint32_t> globalCells;
+    std::vector<CellSum> sums;
+    std::vector<std::vector<uint32_t> > localToGlobal(nbChunks);
+    for (int c = 0; c < nbChunks; c++)
+    {
+        localToGlobal[c].resize(chunkKeys[c].size());
+        for (size_t i = 0; i < chunkKeys[c].size(); i++)
+        {
+            auto inserted = globalCells.emplace(chunkKeys[c][i], (uint32_t)sums.size());
+            if (inserted.second)
+                sums.emplace_back();
+            CellSum& sum = sums[inserted.first->second];
+            sum.position += chunkSums[c][i].position;
+            sum.normal += chunkSums[c][i].normal;
+            sum.count += chunkSums[c][i].count;
+            localToGlobal[c][i] = inserted.first->second;
+        }
+        std::vector<uint64_t>().swap(chunkKeys[c]);
+        std::vector<CellSum>().swap(chunkSums[c]);
+    }
+    globalCells.clear();
+
+    #pragma omp parallel for
+    for (int c = 0; c < nbChunks; c++)
+    {
+        for (size_t v = vertexBounds[c]; v < vertexBounds[c + 1]; v++)
+            vertexCell[v] = localToGlobal[c][vertexCell[v]];
+    }
+
+    // 4. triangles between 3 different cells, rotated so that the smallest cell comes first (orientation is kept)
+    std::vector<size_t> triangleBounds(nbChunks + 1);
+    for (int c = 0; c <= nbChunks; c++)
+        triangleBounds[c] = nbTriangles * c / nbChunks;
+
+    std::vector<std::vector<std::array<uint32_t, 3> > > chunkTriangles(nbChunks);
+    #pragma omp parallel for schedule(static, 1)
+    for (int c = 0; c < nbChunks; c++)
+    {
+        for (size_t t = triangleBounds[c]; t < triangleBounds[c + 1]; t++)
+        {
+            std::array<uint32_t, 3> tri = { vertexCell[_input.indices[3 * t]], vertexCell[_input.indices[3 * t + 1]], vertexCell[_input.indices[3 * t + 2]] };
+            if (tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0])
+                continue;
+            while (tri[0] > tri[1] || tri[0] > tri[2])
+                tri = { tri[1], tri[2], tri[0] };
+            chunkTriangles[c].push_back(tri);
+        }
+    }
+    std::vector<uint32_t>().swap(vertexCell);
+
+    std::vector<std::array<uint32_t, 3> > triangles;
+    for (int c = 0; c < nbChunks; c++)
+    {
+        triangles.insert(triangles.end(), chunkTriangles[c].begin(), chunkTriangles[c].end());
+        std::vector<std::array<uint32_t, 3> >().swap(chunkTriangles[c]);
+    }
+
+    // many input triangles collapse on the same cells
+    parallelSort(triangles, [](const std::array<uint32_t, 3>& _a, const std::array<uint32_t, 3>& _b) { return _a < _b; });
+    triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+
+    // 5. one vertex per cell used by a triangle, at the average of the vertices of the cell
+    std::vector<uint32_t> newIndex(sums.size(), 0);
+    for (const std::array<uint32_t, 3>& tri : triangles)
+        newIndex[tri[0]] = newIndex[tri[1]] = newIndex[tri[2]] = 1;
+    uint32_t nbProxyVertices = 0;
+    for (uint32_t& id : newIndex)
+        id = id ? nbProxyVertices++ : UINT32_MAX;
+
+    _proxy.vertices.resize(nbProxyVertices);
+    if (hasNormals)
+        _proxy.normals.resize(nbProxyVertices);
+    #pragma omp parallel for
+    for (long long i = 0; i < (long long)sums.size(); i++)
+    {
+        const uint32_t id = newIndex[i];
+        if (id == UINT32_MAX)
+            continue;
+        _proxy.vertices[id] = sums[i].position / (float)sums[i].count;
+        if (hasNormals)
+        {
+            float length = glm::length(sums[i].normal);
+            _proxy.normals[id] = (length > 0.0f) ? sums[i].normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        }
+    }
+
+    _proxy.indices.resize(3 * triangles.size());
+    #pragma omp parallel for
+    for (long long t = 0; t < (long long)triangles.size(); t++)
+    {
+        for (int k = 0; k < 3; k++)
+            _proxy.indices[3 * t + k] = newIndex[triangles[t][k]];
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    qInfo() << "[info] VertexClustering::simplify: " << nbTriangles << " -> " << triangles.size() << " triangles, "
+            << nbProxyVertices << " vertices (cell size " << cellSize << "), "
+            << std::chrono::duration<double, std::milli>(end - start).count() << " ms";
+
+    return !triangles.empty();
+}
+
+
+int VertexClustering::getNbChunks()
+{
+#ifdef _OPENMP
+    return std::max(omp_get_max_threads(), 1);
+#else
+    return 1;
+#endif
+}
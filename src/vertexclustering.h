@@ -0,0 +1,77 @@
+/*********************************************************************************************************************
+ *
+ * vertexclustering.h
+ *
+ * Fast simplification of GPU buffers by vertex clustering on a regular grid (proxy of huge meshes)
+ *
+ * Mesh_viewer
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+#ifndef VERTEXCLUSTERING_H
+#define VERTEXCLUSTERING_H
+
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+
+/*!
+* \class VertexClustering
+* \brief Simplifies GPU buffers by vertex clustering (Rossignac and Borrel 1993):
+*        vertices falling in the same cell of a regular grid are merged into their average,
+*        triangles whose corners end up in less than 3 different cells are removed (as well as duplicated triangles).
+*        Much coarser than quadric error decimation (see TriMeshHE::decimate()), but runs in a few linear passes (in parallel),
+*        which is fast enough to display a proxy of a huge mesh while the full resolution one is uploaded.
+*/
+class VertexClustering
+{
+    public:
+
+        /*!
+        * \fn cellSizeForBudget
+        * \brief estimate the cell size giving about _nbTriangles triangles (2 triangles per cell crossed by the surface)
+        * \param _buffers : vertex positions and indices of the mesh
+        * \param _nbTriangles : targeted number of triangles
+        * \return cell size (0 if the mesh is empty)
+        */
+        static float cellSizeForBudget(const MeshBuffers& _buffers, size_t _nbTriangles);
+
+        /*!
+        * \fn simplify
+        * \brief merge vertices by cells of a regular grid
+        * \param _input : vertex positions, indices and (optionally) normals of the mesh
+        * \param _cellSize : size of the cells (the grid is aligned with the bounding box of the mesh)
+        * \param _proxy : output, simplified positions, normals (if provided by _input) and indices
+        * \return false if the input is empty or the cell size invalid (_proxy is then empty)
+        */
+        static bool simplify(const MeshBuffers& _input, float _cellSize, MeshBuffers& _proxy);
+
+
+    protected:
+
+        static constexpr int s_keyBits = 21;    /*!< bits per axis of the cell keys (3 axes packed in 64 bits) */
+
+        /*!
+        * \struct CellSum
+        * \brief accumulated vertices of a cell
+        */
+        struct CellSum
+        {
+            glm::vec3 position = glm::vec3(0.0f);   /*!< sum of the positions */
+            glm::vec3 normal = glm::vec3(0.0f);     /*!< sum of the normals */
+            uint32_t count = 0;                     /*!< number of vertices */
+        };
+
+        /*!
+        * \fn getNbChunks
+        * \brief number of chunks processed in parallel (one per thread)
+        */
+        static int getNbChunks();
+};
+
+#endif // VERTEXCLUSTERING_H
@@ -17,6 +17,7 @@ Window::Window()
     // Init flags
     m_texLoaded = false;
     m_normalMapLoaded = false;
+    m_meshHELoaded = false;
 
 
     this->setWindowTitle("Mesh_viewer");
@@ -59,6 +60,13 @@ Window::Window()
     QObject::connect(m_buttonLoadMeshHE, SIGNAL(clicked()), this, SLOT(loadMeshHE()));
     m_toolbarLayout->addWidget(m_buttonLoadMeshHE);
 
+    // Load TriMeshCHE button
+    m_buttonLoadMeshCHE = new QPushButton("Load TriMeshCHE", this);
+    m_buttonLoadMeshCHE->setToolTip("load a triangle mesh using compact half-edge data structure (without OpenMesh)");
+    m_buttonLoadMeshCHE->setFixedSize(120, 25);
+    QObject::connect(m_buttonLoadMeshCHE, SIGNAL(clicked()), this, SLOT(loadMeshCHE()));
+    m_toolbarLayout->addWidget(m_buttonLoadMeshCHE);
+
     // Load TriMeshSoup button
     m_buttonLoadMeshSoup = new QPushButton("Load TriMeshSoup", this);
     m_buttonLoadMeshSoup->setToolTip("load a triangle mesh using a polygon soup data structure");
@@ -66,6 +74,49 @@ Window::Window()
     QObject::connect(m_buttonLoadMeshSoup, SIGNAL(clicked()), this, SLOT(loadMeshSoup()));
     m_toolbarLayout->addWidget(m_buttonLoadMeshSoup);
 
+    // Progressive loading checkbox (connected once the viewer is created)
+    m_toggleProgressiveLoad = new QCheckBox("Progressive", this);
+    m_toggleProgressiveLoad->setToolTip("display OBJ files loaded as TriMeshSoup while they are being parsed");
+    m_toggleProgressiveLoad->setChecked(false);
+    m_toolbarLayout->addWidget(m_toggleProgressiveLoad);
+
+    // Index optimization checkbox (connected once the viewer is created)
+    m_toggleOptimizeIndices = new QCheckBox("Optimize indices", this);
+    m_toggleOptimizeIndices->setToolTip("reorder triangles and vertices for the vertex cache, overdraw and vertex fetch (ACMR/ATVR logged)");
+    m_toggleOptimizeIndices->setChecked(true);
+    m_toolbarLayout->addWidget(m_toggleOptimizeIndices);
+
+    // Proxy preview checkbox and parameters (connected once the viewer is created)
+    m_toggleProxyPreview = new QCheckBox("Proxy", this);
+    m_toggleProxyPreview->setToolTip("display a coarse proxy (vertex clustering) of large meshes until the full resolution is uploaded");
+    m_toggleProxyPreview->setChecked(true);
+    m_toolbarLayout->addWidget(m_toggleProxyPreview);
+
+    m_proxyBudgetSpinBox = new QSpinBox(this);
+    m_proxyBudgetSpinBox->setToolTip("number of triangles of the proxy (smaller meshes are not previewed)");
+    m_proxyBudgetSpinBox->setMinimum(1000);
+    m_proxyBudgetSpinBox->setMaximum(100000000);
+    m_proxyBudgetSpinBox->setSingleStep(100000);
+    m_proxyBudgetSpinBox->setValue(500000);
+    m_proxyBudgetSpinBox->setFixedWidth(85);
+    m_proxyBudgetSpinBox->setFixedHeight(20);
+    m_toolbarLayout->addWidget(m_proxyBudgetSpinBox);
+
+    m_proxyCellSpinBox = new QDoubleSpinBox(this);
+    m_proxyCellSpinBox->setToolTip("cell size of the proxy, in % of the bounding box diagonal (auto: derived from the number of triangles)");
+    m_proxyCellSpinBox->setMinimum(0.0);
+    m_proxyCellSpinBox->setMaximum(10.0);
+    m_proxyCellSpinBox->setSingleStep(0.1);
+    m_proxyCellSpinBox->setValue(0.0);
+    m_proxyCellSpinBox->setSpecialValueText("auto");
+    m_proxyCellSpinBox->setSuffix("%");
+    m_proxyCellSpinBox->setFixedWidth(65);
+    m_proxyCellSpinBox->setFixedHeight(20);
+    m_toolbarLayout->addWidget(m_proxyCellSpinBox);
+
+    QObject::connect(m_toggleProxyPreview, SIGNAL(toggled(bool)), m_proxyBudgetSpinBox, SLOT(setEnabled(bool)));
+    QObject::connect(m_toggleProxyPreview, SIGNAL(toggled(bool)), m_proxyCellSpinBox, SLOT(setEnabled(bool)));
+
     // Save mesh button
     m_buttonSaveMesh = new QPushButton("Save mesh", this);
     m_buttonSaveMesh->setToolTip("save mesh to a file (warning: file format depends on data structure)");
@@ -90,6 +141,12 @@ Window::Window()
 
     m_globalLayout->addWidget(m_glViewer);
 
+    QObject::connect(m_toggleProgressiveLoad, SIGNAL(toggled(bool)), m_glViewer, SLOT(setProgressiveLoading(bool)));
+    QObject::connect(m_toggleOptimizeIndices, SIGNAL(toggled(bool)), m_glViewer, SLOT(setIndexOptimization(bool)));
+    QObject::connect(m_toggleProxyPreview, SIGNAL(toggled(bool)), m_glViewer, SLOT(setProxyPreview(bool)));
+    QObject::connect(m_proxyBudgetSpinBox, SIGNAL(valueChanged(int)), m_glViewer, SLOT(setProxyBudget(int)));
+    QObject::connect(m_proxyCellSpinBox, SIGNAL(valueChanged(double)), m_glViewer, SLOT(setProxyCellSize(double)));
+
 
     buildVisDialogBox();
 
@@ -196,6 +253,12 @@ void Window::buildVisDialogBox()
 
     // Edges shading
     m_wireShadingLayout = new QHBoxLayout;
+    m_toggleSinglePassLines = new QCheckBox;
+    m_toggleSinglePassLines->setText("Single pass");
+    m_toggleSinglePassLines->setChecked(true);
+    m_toggleSinglePassLines->setEnabled(false);
+    QObject::connect(m_toggleSinglePassLines, SIGNAL(clicked()), m_glViewer, SLOT(toggleSinglePassLines()));
+    m_wireShadingLayout->addWidget(m_toggleSinglePassLines);
     m_toggleShadingLines = new QCheckBox;
     m_toggleShadingLines->setText("Wireframe shading");
     m_toggleShadingLines->setChecked(true);
@@ -204,6 +267,65 @@ void Window::buildVisDialogBox()
     m_wireShadingLayout->addWidget(m_toggleShadingLines);
     m_wireShadingLayout->setAlignment(Qt::AlignRight);
     m_boxSceneLayout->addLayout(m_wireShadingLayout);
+    // Meshlet culling
+    m_cullingLayout = new QHBoxLayout;
+    m_toggleFrustumCulling = new QCheckBox;
+    m_toggleFrustumCulling->setText("Frustum culling");
+    m_toggleFrustumCulling->setToolTip("do not draw the groups of triangles outside the view");
+    m_toggleFrustumCulling->setChecked(true);
+    QObject::connect(m_toggleFrustumCulling, SIGNAL(clicked()), m_glViewer, SLOT(toggleFrustumCulling()));
+    m_cullingLayout->addWidget(m_toggleFrustumCulling);
+    m_toggleBackfaceCulling = new QCheckBox;
+    m_toggleBackfaceCulling->setText("Backface culling");
+    m_toggleBackfaceCulling->setToolTip("do not draw the groups of triangles facing away from the camera (closed meshes only)");
+    m_toggleBackfaceCulling->setChecked(false);
+    QObject::connect(m_toggleBackfaceCulling, SIGNAL(clicked()), m_glViewer, SLOT(toggleBackfaceCulling()));
+    m_cullingLayout->addWidget(m_toggleBackfaceCulling);
+    m_toggleLOD = new QCheckBox;
+    m_toggleLOD->setText("Levels of detail");
+    m_toggleLOD->setToolTip("draw a simplified mesh when the difference is smaller than a pixel (see \"Build levels of detail\")");
+    m_toggleLOD->setChecked(true);
+    QObject::connect(m_toggleLOD, SIGNAL(clicked()), m_glViewer, SLOT(toggleLOD()));
+    m_cullingLayout->addWidget(m_toggleLOD);
+    m_boxSceneLayout->addLayout(m_cullingLayout);
+    m_drawStatsLabel = new QLabel;
+    m_drawStatsLabel->setAlignment(Qt::AlignRight);
+    m_boxSceneLayout->addWidget(m_drawStatsLabel);
+    // statistics are refreshed at each frame (frames are coalesced during camera moves, see GLWidget::requestFrame())
+    QObject::connect(m_glViewer, SIGNAL(frameDrawn()), this, SLOT(frameDrawn()));
+    // Interactive mode
+    m_interactiveLayout = new QHBoxLayout;
+    m_toggleInteractive = new QCheckBox;
+    m_toggleInteractive->setText("Fast camera moves");
+    m_toggleInteractive->setToolTip("render at a reduced resolution (lowered further if frames take more than 1/30 s) while the camera moves");
+    m_toggleInteractive->setChecked(true);
+    QObject::connect(m_toggleInteractive, SIGNAL(toggled(bool)), m_glViewer, SLOT(setInteractiveMode(bool)));
+    m_interactiveLayout->addWidget(m_toggleInteractive);
+    m_interactiveLayout->addStretch();
+    m_interactiveScaleSpinBox = new QSpinBox(this);
+    m_interactiveScaleSpinBox->setToolTip("resolution divisor while the camera moves");
+    m_interactiveScaleSpinBox->setMinimum(1);
+    m_interactiveScaleSpinBox->setMaximum(8);
+    m_interactiveScaleSpinBox->setValue(2);
+    m_interactiveScaleSpinBox->setPrefix("1/");
+    m_interactiveScaleSpinBox->setFixedWidth(45);
+    m_interactiveScaleSpinBox->setFixedHeight(20);
+    QObject::connect(m_interactiveScaleSpinBox, SIGNAL(valueChanged(int)), m_glViewer, SLOT(setInteractiveScale(int)));
+    m_interactiveLayout->addWidget(m_interactiveScaleSpinBox);
+    m_idleDelaySpinBox = new QSpinBox(this);
+    m_idleDelaySpinBox->setToolTip("full quality is restored once the camera has been idle for this time");
+    m_idleDelaySpinBox->setMinimum(0);
+    m_idleDelaySpinBox->setMaximum(5000);
+    m_idleDelaySpinBox->setSingleStep(50);
+    m_idleDelaySpinBox->setValue(300);
+    m_idleDelaySpinBox->setSuffix(" ms");
+    m_idleDelaySpinBox->setFixedWidth(70);
+    m_idleDelaySpinBox->setFixedHeight(20);
+    QObject::connect(m_idleDelaySpinBox, SIGNAL(valueChanged(int)), m_glViewer, SLOT(setIdleDelay(int)));
+    m_interactiveLayout->addWidget(m_idleDelaySpinBox);
+    QObject::connect(m_toggleInteractive, SIGNAL(toggled(bool)), m_interactiveScaleSpinBox, SLOT(setEnabled(bool)));
+    QObject::connect(m_toggleInteractive, SIGNAL(toggled(bool)), m_idleDelaySpinBox, SLOT(setEnabled(bool)));
+    m_boxSceneLayout->addLayout(m_interactiveLayout);
 
     m_groupBoxScene->setLayout(m_boxSceneLayout);
     m_visBoxGlobalLayout->addWidget(m_groupBoxScene);
@@ -327,7 +449,6 @@ void Window::buildVisDialogBox()
     m_toggleFlatShading = new QCheckBox;
     m_toggleFlatShading->setText("Flat shading");
     m_toggleFlatShading->setChecked(false);
-    m_toggleFlatShading->setEnabled(false);
     QObject::connect(m_toggleFlatShading, SIGNAL(clicked()), m_glViewer, SLOT(toggleFlatShading()));
     m_boxShadingLayout->addWidget(m_toggleFlatShading);
 
@@ -383,6 +504,66 @@ void Window::buildVisDialogBox()
     m_visBoxGlobalLayout->addWidget(m_groupBoxTex);
 
 
+    /*************************************** Scalar field ***************************************/
+    // GroupBox Scalar field
+    m_groupBoxScalar = new QGroupBox("Scalar field", this);
+    // Scalar field layout
+    m_boxScalarLayout = new QVBoxLayout;
+
+    // Toggle scalar field + colormap selection
+    m_scalarLayout = new QHBoxLayout;
+    m_toggleScalar = new QCheckBox;
+    m_toggleScalar->setText("Show scalar field");
+    m_toggleScalar->setChecked(false);
+    m_toggleScalar->setEnabled(false);
+    QObject::connect(m_toggleScalar, SIGNAL(clicked()), m_glViewer, SLOT(toggleScalarField()));
+    QObject::connect(m_toggleScalar, SIGNAL(clicked()), this, SLOT(toggleScalarField()));
+    m_scalarLayout->addWidget(m_toggleScalar);
+    m_scalarLayout->addStretch();
+    m_colormapComboBox = new QComboBox(this);
+    m_colormapComboBox->addItem("Red-Green");   // CMAP_REDGREEN
+    m_colormapComboBox->addItem("Viridis");     // CMAP_VIRIDIS
+    m_colormapComboBox->addItem("Cool-warm");   // CMAP_COOLWARM
+    m_colormapComboBox->addItem("Grayscale");   // CMAP_GRAYSCALE
+    m_colormapComboBox->setCurrentIndex(0);
+    m_colormapComboBox->setFixedHeight(20);
+    m_colormapComboBox->setEnabled(false);
+    QObject::connect(m_colormapComboBox, SIGNAL(currentIndexChanged(int)), m_glViewer, SLOT(setColormap(int)));
+    m_scalarLayout->addWidget(m_colormapComboBox);
+    m_boxScalarLayout->addLayout(m_scalarLayout);
+
+    // Scalar range percentiles
+    m_scalarRangeLayout = new QHBoxLayout;
+    m_scalarRangeLabel = new QLabel("Range (percentiles)");
+    m_scalarRangeLabel->setEnabled(false);
+    m_scalarRangeLayout->addWidget(m_scalarRangeLabel);
+    m_lowPctSpinBox = new QDoubleSpinBox(this);
+    m_lowPctSpinBox->setMinimum(0.0);
+    m_lowPctSpinBox->setMaximum(100.0);
+    m_lowPctSpinBox->setSingleStep(0.5);
+    m_lowPctSpinBox->setValue(0.0);
+    m_lowPctSpinBox->setFixedWidth(60);
+    m_lowPctSpinBox->setFixedHeight(20);
+    m_lowPctSpinBox->setEnabled(false);
+    QObject::connect(m_lowPctSpinBox, SIGNAL(valueChanged(double)), this, SLOT(changeScalarRange()));
+    m_scalarRangeLayout->addWidget(m_lowPctSpinBox);
+    m_highPctSpinBox = new QDoubleSpinBox(this);
+    m_highPctSpinBox->setMinimum(0.0);
+    m_highPctSpinBox->setMaximum(100.0);
+    m_highPctSpinBox->setSingleStep(0.5);
+    m_highPctSpinBox->setValue(95.0);
+    m_highPctSpinBox->setFixedWidth(60);
+    m_highPctSpinBox->setFixedHeight(20);
+    m_highPctSpinBox->setEnabled(false);
+    QObject::connect(m_highPctSpinBox, SIGNAL(valueChanged(double)), this, SLOT(changeScalarRange()));
+    m_scalarRangeLayout->addWidget(m_highPctSpinBox);
+    m_scalarRangeLayout->setAlignment(Qt::AlignRight);
+    m_boxScalarLayout->addLayout(m_scalarRangeLayout);
+
+    m_groupBoxScalar->setLayout(m_boxScalarLayout);
+    m_visBoxGlobalLayout->addWidget(m_groupBoxScalar);
+
+
     m_visDialogBox->setLayout(m_visBoxGlobalLayout);
 
     m_globalLayout->addWidget(m_visDialogBox);
@@ -413,6 +594,14 @@ void Window::buildGeomDialogBox()
     // Geometry tools layout
     m_boxGeomLayout = new QVBoxLayout;
 
+    // Switch data structure of the current mesh
+    m_toggleHalfEdge = new QCheckBox;
+    m_toggleHalfEdge->setText("Half-edge data structure");
+    m_toggleHalfEdge->setToolTip("convert the current mesh between triangle soup and half-edge data structure");
+    m_toggleHalfEdge->setChecked(false);
+    QObject::connect(m_toggleHalfEdge, SIGNAL(clicked()), this, SLOT(toggleHalfEdge()));
+    m_boxGeomLayout->addWidget(m_toggleHalfEdge);
+
     // Duplicate vertices button
     m_buttonDuplVertices = new QPushButton("Duplicate vertices", this);
     m_buttonDuplVertices->setFixedSize(200, 20);
@@ -423,9 +612,25 @@ void Window::buildGeomDialogBox()
     m_buttonCompNormals = new QPushButton("Recompute normals", this);
     m_buttonCompNormals->setFixedSize(200, 20);
     QObject::connect(m_buttonCompNormals, SIGNAL(clicked()), m_glViewer, SLOT(compNormals()));
-    QObject::connect(m_buttonCompNormals, SIGNAL(clicked()), this, SLOT(compNormals()));
     m_boxGeomLayout->addWidget(m_buttonCompNormals);
 
+    // Normal weighting selection
+    m_normalWeightLayout = new QHBoxLayout;
+    m_normalWeightLabel = new QLabel("Normal weighting");
+    m_normalWeightLabel->setVisible(false);
+    m_normalWeightLayout->addWidget(m_normalWeightLabel);
+    m_normalWeightComboBox = new QComboBox(this);
+    m_normalWeightComboBox->addItem("Uniform");     // NORMAL_WEIGHT_UNIFORM
+    m_normalWeightComboBox->addItem("Area");        // NORMAL_WEIGHT_AREA
+    m_normalWeightComboBox->addItem("Angle");       // NORMAL_WEIGHT_ANGLE
+    m_normalWeightComboBox->setCurrentIndex(0);
+    m_normalWeightComboBox->setFixedHeight(20);
+    m_normalWeightComboBox->setVisible(false);
+    QObject::connect(m_normalWeightComboBox, SIGNAL(currentIndexChanged(int)), m_glViewer, SLOT(setNormalWeighting(int)));
+    m_normalWeightLayout->addWidget(m_normalWeightComboBox);
+    m_normalWeightLayout->setAlignment(Qt::AlignRight);
+    m_boxGeomLayout->addLayout(m_normalWeightLayout);
+
     // Compute tangents + bitangents button
     m_buttonCompTB = new QPushButton("Compute tangents and bitangents", this);
     m_buttonCompTB->setFixedSize(200, 20);
@@ -468,6 +673,37 @@ void Window::buildGeomDialogBox()
     m_smoothParamLayout->setAlignment(Qt::AlignRight);
     m_boxGeomLayout->addLayout(m_smoothParamLayout);
 
+    // Decimation
+    m_buttonDecimate = new QPushButton("Decimate", this);
+    m_buttonDecimate->setFixedSize(200, 20);
+    m_buttonDecimate->setVisible(false);
+    QObject::connect(m_buttonDecimate, SIGNAL(clicked()), this, SLOT(decimate()));
+    m_boxGeomLayout->addWidget(m_buttonDecimate);
+
+    // Decimation parameter
+    m_decimateParamLayout = new QHBoxLayout;
+    m_decimateSpinBox = new QSpinBox(this);
+    m_decimateSpinBox->setVisible(false);
+    m_decimateSpinBox->setMinimum(1);
+    m_decimateSpinBox->setMaximum(99);
+    m_decimateSpinBox->setSingleStep(5);
+    m_decimateSpinBox->setValue(50);
+    m_decimateSpinBox->setFixedWidth(45);
+    m_decimateSpinBox->setFixedHeight(20);
+    m_decimateParamLayout->addWidget(m_decimateSpinBox);
+    m_decimateLabel = new QLabel("% of triangles kept");
+    m_decimateLabel->setVisible(false);
+    m_decimateParamLayout->addWidget(m_decimateLabel);
+    m_decimateParamLayout->setAlignment(Qt::AlignRight);
+    m_boxGeomLayout->addLayout(m_decimateParamLayout);
+
+    // Levels of detail
+    m_buttonBuildLODs = new QPushButton("Build levels of detail", this);
+    m_buttonBuildLODs->setFixedSize(200, 20);
+    m_buttonBuildLODs->setVisible(false);
+    QObject::connect(m_buttonBuildLODs, SIGNAL(clicked()), m_glViewer, SLOT(buildLODs()));
+    m_boxGeomLayout->addWidget(m_buttonBuildLODs);
+
 
     // Compute mean curvature
     m_buttonMeanCurv = new QPushButton("Compute mean curvature", this);
@@ -483,10 +719,42 @@ void Window::buildGeomDialogBox()
     QObject::connect(m_buttonSurfVar, SIGNAL(clicked()), m_glViewer, SLOT(compSurfVar()));
     m_boxGeomLayout->addWidget(m_buttonSurfVar);
 
+    // Compare half-edge structures (any mesh: both are built from a soup)
+    m_buttonBenchmarkHE = new QPushButton("Compare half-edge kernels", this);
+    m_buttonBenchmarkHE->setToolTip("time TriMeshHE (OpenMesh) and TriMeshCHE on the current mesh, results are logged");
+    m_buttonBenchmarkHE->setFixedSize(200, 20);
+    QObject::connect(m_buttonBenchmarkHE, SIGNAL(clicked()), m_glViewer, SLOT(benchmarkHalfEdge()));
+    m_boxGeomLayout->addWidget(m_buttonBenchmarkHE);
+
+    // scalar field is computed in background (see GLWidget::applyMeshJob())
+    QObject::connect(m_glViewer, SIGNAL(scalarFieldComputed()), this, SLOT(scalarFieldComputed()));
+    // loads are asynchronous: tools are updated once the new mesh is swapped in (see GLWidget::uploadChunk())
+    QObject::connect(m_glViewer, SIGNAL(meshReplaced(bool)), this, SLOT(meshReplaced(bool)));
+    QObject::connect(m_glViewer, SIGNAL(texLoaded()), this, SLOT(texLoaded()));
+    QObject::connect(m_glViewer, SIGNAL(normalMapLoaded()), this, SLOT(normalMapLoaded()));
+
 
     m_groupBoxGeom->setLayout(m_boxGeomLayout);
     m_geomBoxGlobalLayout->addWidget(m_groupBoxGeom);
 
+    // Progress of background operations (hidden when no operation is running)
+    m_jobLayout = new QHBoxLayout;
+    m_jobProgressBar = new QProgressBar(this);
+    m_jobProgressBar->setRange(0, 100);
+    m_jobProgressBar->setFixedHeight(20);
+    m_jobProgressBar->setVisible(false);
+    m_jobLayout->addWidget(m_jobProgressBar);
+    m_buttonCancelJob = new QPushButton("Cancel", this);
+    m_buttonCancelJob->setFixedSize(60, 20);
+    m_buttonCancelJob->setVisible(false);
+    m_jobLayout->addWidget(m_buttonCancelJob);
+    m_geomBoxGlobalLayout->addLayout(m_jobLayout);
+    MeshJobRunner* jobRunner = m_glViewer->getJobRunner();
+    QObject::connect(jobRunner, SIGNAL(jobStarted(QString)), this, SLOT(jobStarted(QString)));
+    QObject::connect(jobRunner, SIGNAL(progressChanged(int)), m_jobProgressBar, SLOT(setValue(int)));
+    QObject::connect(jobRunner, SIGNAL(jobFinished(QString, bool)), this, SLOT(jobFinished()));
+    QObject::connect(m_buttonCancelJob, SIGNAL(clicked()), jobRunner, SLOT(cancel()));
+
     m_geomDialogBox->setLayout(m_geomBoxGlobalLayout);
 
     m_globalLayout->addWidget(m_geomDialogBox);
@@ -511,7 +779,17 @@ Window::~Window()
     delete m_buttonWireColor;
     delete m_wireLayout;
     delete m_toggleShadingLines;
+    delete m_toggleSinglePassLines;
     delete m_wireShadingLayout;
+    delete m_toggleFrustumCulling;
+    delete m_toggleBackfaceCulling;
+    delete m_toggleLOD;
+    delete m_cullingLayout;
+    delete m_drawStatsLabel;
+    delete m_toggleInteractive;
+    delete m_interactiveScaleSpinBox;
+    delete m_idleDelaySpinBox;
+    delete m_interactiveLayout;
     delete m_boxSceneLayout;
     delete m_groupBoxScene;
     // Delete shading options
@@ -546,6 +824,16 @@ Window::~Window()
     delete m_normalMapLayout;
     delete m_boxTexLayout;
     delete m_groupBoxTex;
+    // Delete scalar field options
+    delete m_toggleScalar;
+    delete m_colormapComboBox;
+    delete m_scalarLayout;
+    delete m_scalarRangeLabel;
+    delete m_lowPctSpinBox;
+    delete m_highPctSpinBox;
+    delete m_scalarRangeLayout;
+    delete m_boxScalarLayout;
+    delete m_groupBoxScalar;
 
 
     //--- Delete vis tool box ----------------
@@ -556,8 +844,12 @@ Window::~Window()
     //--- Delete geom tool box widgets -------
 
     // Delete geometry tools
+    delete m_toggleHalfEdge;
     delete m_buttonDuplVertices;
     delete m_buttonCompNormals;
+    delete m_normalWeightLabel;
+    delete m_normalWeightComboBox;
+    delete m_normalWeightLayout;
     delete m_buttonCompTB;
     delete m_buttonLapSmooth;
     delete m_nbIterSpinBox;
@@ -565,10 +857,19 @@ Window::~Window()
     delete m_factorSpinBox;
     delete m_factorLabel;
     delete m_smoothParamLayout;
+    delete m_buttonDecimate;
+    delete m_decimateSpinBox;
+    delete m_decimateLabel;
+    delete m_decimateParamLayout;
+    delete m_buttonBuildLODs;
     delete m_buttonMeanCurv;
     delete m_buttonSurfVar;
+    delete m_buttonBenchmarkHE;
     delete m_boxGeomLayout;
     delete m_groupBoxGeom;
+    delete m_jobProgressBar;
+    delete m_buttonCancelJob;
+    delete m_jobLayout;
 
 
     //--- Delete geom tool box ---------------
@@ -581,7 +882,13 @@ Window::~Window()
     delete m_buttonShowVisDB;
     delete m_buttonShowGeomDB;
     delete m_buttonLoadMeshHE;
+    delete m_buttonLoadMeshCHE;
     delete m_buttonLoadMeshSoup;
+    delete m_toggleProgressiveLoad;
+    delete m_toggleOptimizeIndices;
+    delete m_toggleProxyPreview;
+    delete m_proxyBudgetSpinBox;
+    delete m_proxyCellSpinBox;
     delete m_buttonSaveMesh;
     delete m_buttonHelp;
     delete m_toolbarLayout;
@@ -670,16 +977,15 @@ void Window::loadMeshHE()
     if (!file.isEmpty())
     {
         m_glViewer->loadTriMeshHE(file);
-        m_buttonDuplVertices->setVisible(false);
-        m_buttonLapSmooth->setVisible(true);
-        m_nbIterSpinBox->setVisible(true);
-        m_nbIterLabel->setVisible(true);
-        m_factorSpinBox->setVisible(true);
-        m_factorLabel->setVisible(true);
-        m_toggleFlatShading->setChecked(false);
-        m_toggleFlatShading->setEnabled(true);
-        m_buttonMeanCurv->setVisible(true);
-        m_buttonSurfVar->setVisible(true);
+    }
+}
+
+void Window::loadMeshCHE()
+{
+    QString file = QFileDialog::getOpenFileName(this, "open file", "../../models/misc", "Mesh (*.obj *.off *.ply *.stl)");
+    if (!file.isEmpty())
+    {
+        m_glViewer->loadTriMeshCHE(file);
     }
 }
 
@@ -689,19 +995,38 @@ void Window::loadMeshSoup()
     if (!file.isEmpty())
     {
         m_glViewer->loadTriMeshSoup(file);
-        m_buttonDuplVertices->setVisible(true);
-        m_buttonLapSmooth->setVisible(false);
-        m_nbIterSpinBox->setVisible(false);
-        m_nbIterLabel->setVisible(false);
-        m_factorSpinBox->setVisible(false);
-        m_factorLabel->setVisible(false);
-        m_toggleFlatShading->setChecked(false);
-        m_toggleFlatShading->setEnabled(false);
-        m_buttonMeanCurv->setVisible(false);
-        m_buttonSurfVar->setVisible(false);
     }
 }
 
+void Window::toggleHalfEdge()
+{
+    if (m_glViewer->convertMesh(m_toggleHalfEdge->isChecked()))
+        setMeshWidgets(m_toggleHalfEdge->isChecked());
+    else
+        m_toggleHalfEdge->setChecked(m_meshHELoaded);
+}
+
+void Window::setMeshWidgets(bool _halfEdge)
+{
+    m_meshHELoaded = _halfEdge;
+    m_toggleHalfEdge->setChecked(_halfEdge);
+    m_buttonDuplVertices->setVisible(true);
+    m_normalWeightLabel->setVisible(_halfEdge);
+    m_normalWeightComboBox->setVisible(_halfEdge);
+    m_buttonLapSmooth->setVisible(_halfEdge);
+    m_nbIterSpinBox->setVisible(_halfEdge);
+    m_nbIterLabel->setVisible(_halfEdge);
+    m_factorSpinBox->setVisible(_halfEdge);
+    m_factorLabel->setVisible(_halfEdge);
+    m_buttonDecimate->setVisible(_halfEdge);
+    m_decimateSpinBox->setVisible(_halfEdge);
+    m_decimateLabel->setVisible(_halfEdge);
+    m_buttonBuildLODs->setVisible(_halfEdge);
+    m_toggleFlatShading->setChecked(false);
+    m_buttonMeanCurv->setVisible(_halfEdge);
+    m_buttonSurfVar->setVisible(_halfEdge);
+}
+
 void Window::saveMesh()
 {
     QString file = QFileDialog::getSaveFileName(this, "save file", "../../results", "Mesh (*.obj *.off *.ply *.stl)");
@@ -720,7 +1045,8 @@ void Window::help()
                            "- Middle button: panning\n"
                            "- Scroll or right button: camera zoom\n"
                            "TriMeshSoup: allows multiple attributes (e.g. UVcoords) per vertex\n"
-                           "TriMeshHE: allows curvature calculation and smoothing\n");
+                           "TriMeshHE: allows curvature calculation and smoothing\n"
+                           "TriMeshCHE: same as TriMeshHE, using a compact half-edge data structure\n");
     msgBox.setText(infoText);
     msgBox.exec();
 }
@@ -769,12 +1095,14 @@ void Window::toggleLines()
         m_buttonWireColor->setEnabled(true);
         m_wireLabel->setEnabled(true);
         m_toggleShadingLines->setEnabled(true);
+        m_toggleSinglePassLines->setEnabled(true);
     }
     else
     {
         m_buttonWireColor->setEnabled(false);
         m_wireLabel->setEnabled(false);
         m_toggleShadingLines->setEnabled(false);
+        m_toggleSinglePassLines->setEnabled(false);
     }
 }
 
@@ -964,15 +1292,63 @@ void Window::toggleMeshCol()
     }
 }
 
+void Window::toggleScalarField()
+{
+    bool enabled = m_toggleScalar->isChecked();
+    m_colormapComboBox->setEnabled(enabled);
+    m_scalarRangeLabel->setEnabled(enabled);
+    m_lowPctSpinBox->setEnabled(enabled);
+    m_highPctSpinBox->setEnabled(enabled);
+}
+
+void Window::meshReplaced(bool _halfEdge)
+{
+    // widgets follow the mesh actually displayed (unchanged if the load failed)
+    m_toggleScalar->setChecked(false);
+    m_toggleScalar->setEnabled(false);
+    toggleScalarField();
+    setMeshWidgets(_halfEdge);
+}
+
+void Window::scalarFieldComputed()
+{
+    // the viewer activates scalar field rendering after each computation
+    m_toggleScalar->setEnabled(true);
+    m_toggleScalar->setChecked(true);
+    toggleScalarField();
+}
+
+void Window::changeScalarRange()
+{
+    // keep low percentile below high percentile
+    double lowPct = std::min(m_lowPctSpinBox->value(), m_highPctSpinBox->value());
+    double highPct = std::max(m_lowPctSpinBox->value(), m_highPctSpinBox->value());
+    m_glViewer->setScalarPercentiles(lowPct / 100.0, highPct / 100.0);
+}
+
 void Window::openTexDialog()
 {
     QString file = QFileDialog::getOpenFileName(this, "open file", "../../models/misc", "Image (*.png)");
+    // the toggle is enabled once the texture is uploaded (see texLoaded())
     if (!file.isEmpty())
-    {
         m_glViewer->setTex(file);
+}
+
+void Window::texLoaded()
+{
+    m_texLoaded = true;
+    if (!m_toggleShowNormals->isChecked())
         m_toggleTex->setEnabled(true);
-        m_texLoaded = true;
-    }
+}
+
+void Window::frameDrawn()
+{
+    const DrawStats& stats = m_glViewer->getDrawStats();
+    QString text = QString("Meshlets: %1 drawn, %2 outside the view, %3 back-facing")
+                       .arg(stats.meshletsDrawn).arg(stats.meshletsFrustumCulled).arg(stats.meshletsBackfaceCulled);
+    if (stats.lod > 0)
+        text += QString(" (level of detail %1)").arg(stats.lod);
+    m_drawStatsLabel->setText(text);
 }
 
 void Window::toggleTex()
@@ -997,18 +1373,15 @@ void Window::toggleTex()
 void Window::openNormalMapDialog()
 {
     QString file = QFileDialog::getOpenFileName(this, "open file", "../../models/misc", "Image (*.png)");
+    // the toggle is enabled once the normal map is uploaded (see normalMapLoaded())
     if (!file.isEmpty())
-    {
         m_glViewer->setNormalMap(file);
-        m_toggleNormalMap->setEnabled(true);
-        m_normalMapLoaded = true;
-    }
 }
 
-
-void Window::compNormals()
+void Window::normalMapLoaded()
 {
-    m_toggleFlatShading->setEnabled(true);
+    m_normalMapLoaded = true;
+    m_toggleNormalMap->setEnabled(true);
 }
 
 
@@ -1016,3 +1389,25 @@ void Window::lapSmooth()
 {
     m_glViewer->lapSmooth(m_nbIterSpinBox->value(), m_factorSpinBox->value());
 }
+
+void Window::decimate()
+{
+    m_glViewer->decimate(0.01f * (float)m_decimateSpinBox->value());
+}
+
+void Window::jobStarted(QString _name)
+{
+    m_jobProgressBar->setFormat(_name + " %p%");
+    m_jobProgressBar->setValue(0);
+    m_jobProgressBar->setVisible(true);
+    m_buttonCancelJob->setVisible(true);
+    // the job works on a copy of the mesh, which must not be edited meanwhile
+    m_groupBoxGeom->setEnabled(false);
+}
+
+void Window::jobFinished()
+{
+    m_jobProgressBar->setVisible(false);
+    m_buttonCancelJob->setVisible(false);
+    m_groupBoxGeom->setEnabled(true);
+}
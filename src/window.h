@@ -62,6 +62,13 @@ class Window : public QWidget
         */
         void buildGeomDialogBox();
 
+        /*!
+        * \fn setMeshWidgets
+        * \brief Show the tools available for the type of the current mesh
+        * \param _halfEdge: true if current mesh is a half-edge mesh
+        */
+        void setMeshWidgets(bool _halfEdge);
+
         /********************************************* Main Window ********************************************/
 
         QVBoxLayout* m_globalLayout;        /*!< Global vertical layout of the window */
@@ -70,7 +77,13 @@ class Window : public QWidget
         QPushButton* m_buttonShowVisDB;     /*!< Button to show/hide visualization dialog box */
         QPushButton* m_buttonShowGeomDB;    /*!< Button to show/hide geometry dialog box */
         QPushButton* m_buttonLoadMeshHE;    /*!< Button to load a TriMeshHE */
+        QPushButton* m_buttonLoadMeshCHE;   /*!< Button to load a TriMeshCHE */
         QPushButton* m_buttonLoadMeshSoup;  /*!< Button to load a TriMeshSoup */
+        QCheckBox* m_toggleProgressiveLoad; /*!< CheckBox to display meshes progressively while they are loading */
+        QCheckBox* m_toggleOptimizeIndices; /*!< CheckBox to reorder triangles and vertices for the GPU */
+        QCheckBox* m_toggleProxyPreview;    /*!< CheckBox to display a proxy of large meshes while they are loading */
+        QSpinBox* m_proxyBudgetSpinBox;     /*!< SpinBox to change the number of triangles of the proxy */
+        QDoubleSpinBox* m_proxyCellSpinBox; /*!< SpinBox to change the cell size of the proxy (0 for auto) */
         QPushButton* m_buttonSaveMesh;      /*!< Button to save a Mesh */
         QPushButton* m_buttonHelp;          /*!< Button to show/hide help message box */
 
@@ -98,6 +111,16 @@ class Window : public QWidget
         QPushButton* m_buttonWireColor;     /*!< Button for wireframe color */
         QHBoxLayout* m_wireShadingLayout;   /*!< Horizontal layout for wireframe shading */
         QCheckBox* m_toggleShadingLines;    /*!< CheckBox to activate/deactivate wireframe shading */
+        QCheckBox* m_toggleSinglePassLines; /*!< CheckBox to draw the wireframe in the same pass as the surface */
+        QHBoxLayout* m_cullingLayout;       /*!< Horizontal layout for meshlet culling */
+        QCheckBox* m_toggleFrustumCulling;  /*!< CheckBox to cull meshlets outside the view frustum */
+        QCheckBox* m_toggleBackfaceCulling; /*!< CheckBox to cull back-facing meshlets */
+        QCheckBox* m_toggleLOD;             /*!< CheckBox to draw levels of detail */
+        QLabel* m_drawStatsLabel;           /*!< Label for the meshlets drawn and culled by the last frame */
+        QHBoxLayout* m_interactiveLayout;   /*!< Horizontal layout for the interactive mode */
+        QCheckBox* m_toggleInteractive;     /*!< CheckBox to render at reduced resolution while the camera moves */
+        QSpinBox* m_interactiveScaleSpinBox;/*!< SpinBox to change the resolution divisor while the camera moves */
+        QSpinBox* m_idleDelaySpinBox;       /*!< SpinBox to change the idle time before full quality is restored */
 
         QGroupBox* m_groupBoxShading;       /*!< GroupBox for shading options */
         QVBoxLayout* m_boxShadingLayout;    /*!< Layout for shading options */
@@ -132,10 +155,24 @@ class Window : public QWidget
         QPushButton* m_buttonLoadNormalMap; /*!< Button to load normal map */
         QCheckBox* m_toggleNormalMap;       /*!< CheckBox to activate/deactivate normal mapping */
 
+        QGroupBox* m_groupBoxScalar;        /*!< GroupBox for scalar field options */
+        QVBoxLayout* m_boxScalarLayout;     /*!< Layout for scalar field options */
+        QHBoxLayout* m_scalarLayout;        /*!< Horizontal layout for scalar field display and colormap */
+        QCheckBox* m_toggleScalar;          /*!< CheckBox to activate/deactivate scalar field rendering */
+        QComboBox* m_colormapComboBox;      /*!< ComboBox to select the colormap */
+        QHBoxLayout* m_scalarRangeLayout;   /*!< Horizontal layout for scalar range percentiles */
+        QLabel* m_scalarRangeLabel;         /*!< Label for scalar range percentiles */
+        QDoubleSpinBox* m_lowPctSpinBox;    /*!< SpinBox to change low percentile of scalar range */
+        QDoubleSpinBox* m_highPctSpinBox;   /*!< SpinBox to change high percentile of scalar range */
+
         QGroupBox* m_groupBoxGeom;          /*!< GroupBox for geometry tools */
         QVBoxLayout* m_boxGeomLayout;       /*!< Layout for geometry tools */
+        QCheckBox* m_toggleHalfEdge;        /*!< CheckBox to switch the current mesh between TriMeshSoup and TriMeshHE */
         QPushButton* m_buttonDuplVertices;  /*!< Button to duplicate vertices */
         QPushButton* m_buttonCompNormals;   /*!< Button to recompute geometric normals */
+        QHBoxLayout* m_normalWeightLayout;  /*!< Horizontal layout for normal weighting selection */
+        QLabel* m_normalWeightLabel;        /*!< Label for normal weighting */
+        QComboBox* m_normalWeightComboBox;  /*!< ComboBox to select the weighting of face normals (TriMeshHE only) */
         QPushButton* m_buttonCompTB;        /*!< Button to compute tangents and bitangents */
         QPushButton* m_buttonLapSmooth;     /*!< Button to compute Laplacian smoothing */
         QHBoxLayout* m_smoothParamLayout;   /*!< Horizontal layout for Laplacian smoothing parameters */
@@ -143,8 +180,18 @@ class Window : public QWidget
         QLabel* m_nbIterLabel;              /*!< Label for number of iterations */
         QDoubleSpinBox* m_factorSpinBox;    /*!< SpinBox to change smoothing factor */
         QLabel* m_factorLabel;              /*!< Label for smoothing factor */
+        QPushButton* m_buttonDecimate;      /*!< Button to decimate the mesh */
+        QHBoxLayout* m_decimateParamLayout; /*!< Horizontal layout for decimation parameters */
+        QSpinBox* m_decimateSpinBox;        /*!< SpinBox to change the percentage of triangles kept by decimation */
+        QLabel* m_decimateLabel;            /*!< Label for the percentage of triangles kept */
+        QPushButton* m_buttonBuildLODs;     /*!< Button to build levels of detail */
         QPushButton* m_buttonMeanCurv;      /*!< Button to compute mean curvature */
         QPushButton* m_buttonSurfVar;       /*!< Button to compute surface variation */
+        QPushButton* m_buttonBenchmarkHE;   /*!< Button to compare the run times of TriMeshHE and TriMeshCHE */
+
+        QHBoxLayout* m_jobLayout;           /*!< Horizontal layout for the progress of background operations */
+        QProgressBar* m_jobProgressBar;     /*!< Progress bar of the running background operation */
+        QPushButton* m_buttonCancelJob;     /*!< Button to cancel the running background operation */
 
 
         /******************************************* Geom Dialog Box ******************************************/
@@ -154,6 +201,7 @@ class Window : public QWidget
 
         bool m_texLoaded;                   /*!< True if a texture is loaded */
         bool m_normalMapLoaded;             /*!< True if a normal map is loaded */
+        bool m_meshHELoaded;                /*!< True if current mesh is a half-edge mesh (TriMeshHE or TriMeshCHE) */
 
         QColor m_ambientCol;                /*!< Current ambient color */
         QColor m_diffuseCol;                /*!< Current diffuse color */
@@ -217,12 +265,24 @@ class Window : public QWidget
             */
             void loadMeshHE();
 
+            /*!
+            * \fn loadMeshCHE
+            * \brief SLOT: open dialog box to load a TriMeshCHE
+            */
+            void loadMeshCHE();
+
             /*!
             * \fn loadMeshSoup
             * \brief SLOT: open dialog box to load a TriMeshSoup
             */
             void loadMeshSoup();
 
+            /*!
+            * \fn toggleHalfEdge
+            * \brief SLOT: convert the current mesh to a TriMeshHE or a TriMeshSoup, without reloading it
+            */
+            void toggleHalfEdge();
+
             /*!
             * \fn saveMesh
             * \brief SLOT: open dialog box to save Mesh
@@ -307,12 +367,43 @@ class Window : public QWidget
             */
             void toggleMeshCol();
 
+            /*!
+            * \fn toggleScalarField
+            * \brief SLOT: enable/disable colormap and range selection according to m_toggleScalar state
+            */
+            void toggleScalarField();
+
+            /*!
+            * \fn scalarFieldComputed
+            * \brief SLOT: enable scalar field rendering once a scalar field has been computed
+            */
+            void scalarFieldComputed();
+
+            /*!
+            * \fn meshReplaced
+            * \brief SLOT: reset scalar field rendering and show the tools of the new mesh once a load is finished
+            * \param _halfEdge: true if the new mesh is a half-edge mesh
+            */
+            void meshReplaced(bool _halfEdge);
+
+            /*!
+            * \fn changeScalarRange
+            * \brief SLOT: send percentiles of scalar range to the viewer
+            */
+            void changeScalarRange();
+
             /*!
             * \fn openTexDialog
             * \brief SLOT: open dialog box to select map texture
             */
             void openTexDialog();
 
+            /*!
+            * \fn texLoaded
+            * \brief SLOT: enable texture mapping once the selected texture is uploaded
+            */
+            void texLoaded();
+
             /*!
             * \fn toggleTex
             * \brief SLOT: use texture mapping instead of diffuse + ambient color
@@ -326,15 +417,40 @@ class Window : public QWidget
             void openNormalMapDialog();
 
             /*!
-            * \fn compNormals
-            * \brief SLOT: duplicate vertices and compute normals
+            * \fn normalMapLoaded
+            * \brief SLOT: enable normal mapping once the selected normal map is uploaded
             */
-            void compNormals();
+            void normalMapLoaded();
+
+            /*!
+            * \fn frameDrawn
+            * \brief SLOT: display the meshlets drawn and culled by the last frame
+            */
+            void frameDrawn();
+
             /*!
             * \fn lapSmooth
             * \brief SLOT: laplacian smoothing of the mesh
             */
             void lapSmooth();
+
+            /*!
+            * \fn decimate
+            * \brief SLOT: decimation of the mesh
+            */
+            void decimate();
+
+            /*!
+            * \fn jobStarted
+            * \brief SLOT: show progress of a background operation, and lock geometry tools until it is done
+            * \param _name: name of the operation
+            */
+            void jobStarted(QString _name);
+            /*!
+            * \fn jobFinished
+            * \brief SLOT: hide progress of background operation, and unlock geometry tools
+            */
+            void jobFinished();
 };
 
 #endif
\ No newline at end of file